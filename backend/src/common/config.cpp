@@ -0,0 +1,130 @@
+#include "config.hpp"
+
+#include <cstdlib>
+#include <fstream>
+
+#include <unistd.h>
+
+namespace nanookjaro::common {
+
+namespace {
+
+std::string trim(std::string_view value) {
+    const auto begin = value.find_first_not_of(" \t\r\n");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    const auto end = value.find_last_not_of(" \t\r\n");
+    return std::string(value.substr(begin, end - begin + 1));
+}
+
+std::string lowercase(std::string value) {
+    for (char& c : value) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+    return value;
+}
+
+bool readable(const std::string& path) {
+    return !path.empty() && access(path.c_str(), R_OK) == 0;
+}
+
+}
+
+Config Config::load(const std::string& path) {
+    Config config;
+    config.path_ = path;
+    std::ifstream input(path);
+    if (!input) {
+        return config;
+    }
+    config.loaded_ = true;
+    std::string section;
+    std::string line;
+    while (std::getline(input, line)) {
+        line = trim(std::string_view(line).substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+        if (line.front() == '[' && line.back() == ']') {
+            section = lowercase(trim(std::string_view(line).substr(1, line.size() - 2)));
+            continue;
+        }
+        const std::size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            continue;
+        }
+        const std::string key = lowercase(trim(std::string_view(line).substr(0, equals)));
+        if (!key.empty()) {
+            config.values_[section + '.' + key] = trim(std::string_view(line).substr(equals + 1));
+        }
+    }
+    return config;
+}
+
+const std::string* Config::find(std::string_view section, std::string_view key) const {
+    std::string name;
+    name.reserve(section.size() + 1 + key.size());
+    name.append(section).append(1, '.').append(key);
+    const auto it = values_.find(name);
+    return it != values_.end() ? &it->second : nullptr;
+}
+
+std::string Config::get(std::string_view section, std::string_view key, const std::string& fallback) const {
+    const std::string* value = find(section, key);
+    return value != nullptr ? *value : fallback;
+}
+
+long long Config::get_int(std::string_view section, std::string_view key, long long fallback) const {
+    const std::string* value = find(section, key);
+    if (value == nullptr || value->empty()) {
+        return fallback;
+    }
+    char* end = nullptr;
+    const long long parsed = std::strtoll(value->c_str(), &end, 10);
+    return end != nullptr && *end == '\0' ? parsed : fallback;
+}
+
+bool Config::get_bool(std::string_view section, std::string_view key, bool fallback) const {
+    const std::string* value = find(section, key);
+    if (value == nullptr) {
+        return fallback;
+    }
+    const std::string flag = lowercase(*value);
+    if (flag == "true" || flag == "yes" || flag == "on" || flag == "1") {
+        return true;
+    }
+    if (flag == "false" || flag == "no" || flag == "off" || flag == "0") {
+        return false;
+    }
+    return fallback;
+}
+
+std::string config_file_path() {
+    if (const char* explicit_path = std::getenv("NANOOKJARO_CONFIG"); explicit_path != nullptr && explicit_path[0]) {
+        return explicit_path;
+    }
+    std::string user_config;
+    if (const char* xdg = std::getenv("XDG_CONFIG_HOME"); xdg != nullptr && xdg[0] == '/') {
+        user_config = std::string(xdg) + "/nanookjaro/nanookjaro.conf";
+    } else if (const char* home = std::getenv("HOME"); home != nullptr && home[0] == '/') {
+        user_config = std::string(home) + "/.config/nanookjaro/nanookjaro.conf";
+    }
+    for (const std::string& candidate :
+         {user_config, std::string("/etc/nanookjaro/nanookjaro.conf"),
+          std::string("/usr/local/etc/nanookjaro/nanookjaro.conf")}) {
+        if (readable(candidate)) {
+            return candidate;
+        }
+    }
+    return {};
+}
+
+const Config& config() {
+    static const Config instance = Config::load(config_file_path());
+    return instance;
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace nanookjaro::common {
+
+// Settings from nanookjaro.conf: INI-style "[section]" headers and
+// "key = value" lines, with '#' comments.
+class Config {
+public:
+    // Missing or unreadable files give an empty configuration.
+    static Config load(const std::string& path);
+
+    const std::string& path() const { return path_; }
+    bool loaded() const { return loaded_; }
+
+    std::string get(std::string_view section, std::string_view key, const std::string& fallback = {}) const;
+    long long get_int(std::string_view section, std::string_view key, long long fallback) const;
+    // true/false, yes/no, on/off or 1/0; anything else gives `fallback`.
+    bool get_bool(std::string_view section, std::string_view key, bool fallback) const;
+
+private:
+    const std::string* find(std::string_view section, std::string_view key) const;
+
+    std::string path_;
+    bool loaded_ = false;
+    std::map<std::string, std::string, std::less<>> values_;  // "section.key" -> value
+};
+
+// The first of $NANOOKJARO_CONFIG, $XDG_CONFIG_HOME/nanookjaro/nanookjaro.conf
+// (~/.config by default), /etc/nanookjaro/nanookjaro.conf and
+// /usr/local/etc/nanookjaro/nanookjaro.conf that exists. Empty if none does.
+std::string config_file_path();
+
+// The configuration at config_file_path(), read once per process.
+const Config& config();
+
+}
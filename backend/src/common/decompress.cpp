@@ -0,0 +1,202 @@
+#include "decompress.hpp"
+
+#include <array>
+#include <cstdint>
+
+#if defined(NANOOKJARO_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(NANOOKJARO_HAVE_LZMA)
+#include <lzma.h>
+#endif
+#if defined(NANOOKJARO_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace nanookjaro::common {
+
+namespace {
+
+constexpr std::size_t kChunkSize = 64 * 1024;
+
+#if defined(NANOOKJARO_HAVE_ZLIB)
+bool inflate_gzip(std::string_view input, const std::function<bool(std::string_view)>& sink) {
+    z_stream stream{};
+    // 15 + 32: maximum window, auto-detect gzip or zlib headers.
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        return false;
+    }
+    std::array<char, kChunkSize> buffer{};
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+
+    bool ok = true;
+    while (true) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+        stream.avail_out = static_cast<uInt>(buffer.size());
+        const int status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+            ok = false;
+            break;
+        }
+        const std::size_t produced = buffer.size() - stream.avail_out;
+        if (produced > 0 && !sink(std::string_view(buffer.data(), produced))) {
+            break;
+        }
+        if (status == Z_STREAM_END) {
+            // Concatenated gzip members are valid; keep going if input remains.
+            if (stream.avail_in == 0 || inflateReset(&stream) != Z_OK) {
+                break;
+            }
+        } else if (stream.avail_in == 0 && produced == 0) {
+            ok = false;
+            break;
+        }
+    }
+    inflateEnd(&stream);
+    return ok;
+}
+#endif
+
+#if defined(NANOOKJARO_HAVE_LZMA)
+bool decode_xz(std::string_view input, const std::function<bool(std::string_view)>& sink) {
+    lzma_stream stream = LZMA_STREAM_INIT;
+    if (lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+        return false;
+    }
+    std::array<char, kChunkSize> buffer{};
+    stream.next_in = reinterpret_cast<const std::uint8_t*>(input.data());
+    stream.avail_in = input.size();
+
+    bool ok = true;
+    while (true) {
+        stream.next_out = reinterpret_cast<std::uint8_t*>(buffer.data());
+        stream.avail_out = buffer.size();
+        const lzma_ret status = lzma_code(&stream, stream.avail_in == 0 ? LZMA_FINISH : LZMA_RUN);
+        if (status != LZMA_OK && status != LZMA_STREAM_END) {
+            ok = false;
+            break;
+        }
+        const std::size_t produced = buffer.size() - stream.avail_out;
+        if (produced > 0 && !sink(std::string_view(buffer.data(), produced))) {
+            break;
+        }
+        if (status == LZMA_STREAM_END) {
+            break;
+        }
+    }
+    lzma_end(&stream);
+    return ok;
+}
+#endif
+
+#if defined(NANOOKJARO_HAVE_ZSTD)
+bool decode_zstd(std::string_view input, const std::function<bool(std::string_view)>& sink) {
+    ZSTD_DCtx* context = ZSTD_createDCtx();
+    if (context == nullptr) {
+        return false;
+    }
+    std::array<char, kChunkSize> buffer{};
+    ZSTD_inBuffer in{input.data(), input.size(), 0};
+
+    bool ok = true;
+    while (true) {
+        ZSTD_outBuffer out{buffer.data(), buffer.size(), 0};
+        const std::size_t status = ZSTD_decompressStream(context, &out, &in);
+        if (ZSTD_isError(status)) {
+            ok = false;
+            break;
+        }
+        if (out.pos > 0 && !sink(std::string_view(buffer.data(), out.pos))) {
+            break;
+        }
+        if (in.pos == in.size && out.pos < out.size) {
+            ok = status == 0;
+            break;
+        }
+    }
+    ZSTD_freeDCtx(context);
+    return ok;
+}
+#endif
+
+}
+
+Compression detect_compression(std::string_view data) {
+    auto starts_with = [&](std::string_view magic) {
+        return data.size() >= magic.size() && data.compare(0, magic.size(), magic) == 0;
+    };
+    if (starts_with("\x1f\x8b")) {
+        return Compression::gzip;
+    }
+    if (starts_with(std::string_view("\xfd" "7zXZ\0", 6))) {
+        return Compression::xz;
+    }
+    if (starts_with("\x28\xb5\x2f\xfd")) {
+        return Compression::zstd;
+    }
+    return Compression::none;
+}
+
+bool decompression_supported(Compression format) {
+    switch (format) {
+        case Compression::none:
+            return true;
+        case Compression::gzip:
+#if defined(NANOOKJARO_HAVE_ZLIB)
+            return true;
+#else
+            return false;
+#endif
+        case Compression::xz:
+#if defined(NANOOKJARO_HAVE_LZMA)
+            return true;
+#else
+            return false;
+#endif
+        case Compression::zstd:
+#if defined(NANOOKJARO_HAVE_ZSTD)
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+bool decompress(std::string_view input, const std::function<bool(std::string_view)>& sink) {
+    switch (detect_compression(input)) {
+        case Compression::none:
+            sink(input);
+            return true;
+        case Compression::gzip:
+#if defined(NANOOKJARO_HAVE_ZLIB)
+            return inflate_gzip(input, sink);
+#else
+            return false;
+#endif
+        case Compression::xz:
+#if defined(NANOOKJARO_HAVE_LZMA)
+            return decode_xz(input, sink);
+#else
+            return false;
+#endif
+        case Compression::zstd:
+#if defined(NANOOKJARO_HAVE_ZSTD)
+            return decode_zstd(input, sink);
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+bool decompress_to_string(std::string_view input, std::string& output) {
+    output.clear();
+    return decompress(input, [&output](std::string_view chunk) {
+        output.append(chunk);
+        return true;
+    });
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace nanookjaro::common {
+
+enum class Compression { none, gzip, xz, zstd };
+
+// Identifies the container format from its magic bytes.
+Compression detect_compression(std::string_view data);
+
+// Whether this build was linked against the library needed for `format`.
+bool decompression_supported(Compression format);
+
+// Streams the decompressed form of `input` to `sink` in chunks. Uncompressed
+// input is passed through unchanged. A sink returning false stops decoding
+// early, which is not treated as an error. Returns false on corrupt input or a
+// format this build cannot decode.
+bool decompress(std::string_view input, const std::function<bool(std::string_view)>& sink);
+
+bool decompress_to_string(std::string_view input, std::string& output);
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace nanookjaro::common {
+
+// Fixed part of the kernel's struct linux_dirent64; the NUL-terminated name
+// follows d_type directly.
+struct Dirent64Header {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+};
+inline constexpr std::size_t kDirentNameOffset = offsetof(Dirent64Header, d_type) + 1;
+inline constexpr std::size_t kDirentBufferSize = 64 * 1024;
+
+// Calls fn(name, d_type) for every entry of the open directory `fd` except
+// "." and "..", reading with raw getdents64 calls into `buffer` (sized to
+// kDirentBufferSize when empty). This avoids readdir()'s per-entry overhead
+// on directories with many entries. Returns false if listing failed.
+template <typename Fn>
+bool for_each_directory_entry(int fd, std::vector<char>& buffer, Fn&& fn) {
+    if (buffer.empty()) {
+        buffer.resize(kDirentBufferSize);
+    }
+    while (true) {
+        const long length = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+        if (length < 0) {
+            return false;
+        }
+        if (length == 0) {
+            return true;
+        }
+        for (long offset = 0; offset < length;) {
+            const char* record = buffer.data() + offset;
+            Dirent64Header entry{};
+            std::memcpy(&entry, record, sizeof(entry));
+            offset += entry.d_reclen;
+            const char* name = record + kDirentNameOffset;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            fn(name, entry.d_type);
+        }
+    }
+}
+
+}
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "scratch.hpp"
+
+// Field descriptors for the metric structs. Next to each struct, a
+//
+//     constexpr auto metric_fields(std::type_identity<CpuUsage>) {
+//         return std::tuple{common::Field{"user_percent", &CpuUsage::user_percent, "%"}, ...};
+//     }
+//
+// (found by argument-dependent lookup) lists the members that are reported,
+// in order, with their unit and, for reals, the number of decimals. The
+// JSON, CSV and binary encoders and the column layout of history stores are
+// generated from that one list, so every struct is formatted the same way:
+// reals in fixed notation, strings escaped by append_escaped().
+
+namespace nanookjaro::common {
+
+enum class FieldType : std::uint8_t {
+    boolean,
+    integer,
+    real,
+    text,       // std::string, std::pmr::string or std::string_view
+    text_list,  // a vector of those
+};
+
+namespace detail {
+
+template <typename T>
+inline constexpr bool is_text = std::is_convertible_v<const T&, std::string_view>;
+
+template <typename T>
+struct is_text_list : std::false_type {};
+template <typename T, typename Allocator>
+struct is_text_list<std::vector<T, Allocator>> : std::bool_constant<is_text<T>> {};
+
+}
+
+template <typename Member>
+constexpr FieldType field_type() {
+    if constexpr (std::is_same_v<Member, bool>) {
+        return FieldType::boolean;
+    } else if constexpr (std::is_integral_v<Member>) {
+        return FieldType::integer;
+    } else if constexpr (std::is_floating_point_v<Member>) {
+        return FieldType::real;
+    } else if constexpr (detail::is_text<Member>) {
+        return FieldType::text;
+    } else {
+        static_assert(detail::is_text_list<Member>::value, "unsupported field type");
+        return FieldType::text_list;
+    }
+}
+
+// One reported member of `Struct`. The pointer to member stands in for an
+// offset, which is not a constant for structs with string members.
+template <typename Struct, typename Member>
+struct Field {
+    using struct_type = Struct;
+    using member_type = Member;
+    static constexpr FieldType type = field_type<Member>();
+
+    constexpr Field(std::string_view field_name, Member Struct::*field_member, std::string_view field_unit = {},
+                    int field_precision = 2)
+        : name(field_name), member(field_member), unit(field_unit), precision(field_precision) {}
+
+    std::string_view name;
+    Member Struct::*member;
+    std::string_view unit;  // "%", "kB/s", "MiB"...; empty for counts and names
+    int precision;          // decimals of reals
+
+    constexpr const Member& get(const Struct& value) const { return value.*member; }
+};
+
+// Types with a metric_fields() description.
+template <typename T>
+concept Described = requires { metric_fields(std::type_identity<T>{}); };
+
+template <Described T>
+inline constexpr auto fields_of = metric_fields(std::type_identity<T>{});
+
+template <typename T>
+inline constexpr std::size_t field_count = std::tuple_size_v<std::remove_cvref_t<decltype(fields_of<T>)>>;
+
+template <typename T, typename Visitor>
+constexpr void for_each_field(Visitor&& visit) {
+    std::apply([&](const auto&... field) { (visit(field), ...); }, fields_of<T>);
+}
+
+// Position of the field called `name`, or field_count<T> when there is none.
+template <typename T>
+constexpr std::size_t field_index(std::string_view name) {
+    std::size_t position = 0;
+    std::size_t found = field_count<T>;
+    for_each_field<T>([&](const auto& field) {
+        if (found == field_count<T> && field.name == name) {
+            found = position;
+        }
+        ++position;
+    });
+    return found;
+}
+
+// JSON
+
+template <typename Field>
+void append_json_value(const Field& field, const typename Field::struct_type& value, std::pmr::string& out) {
+    const auto& member = field.get(value);
+    if constexpr (Field::type == FieldType::boolean) {
+        out += member ? "true" : "false";
+    } else if constexpr (Field::type == FieldType::integer) {
+        if constexpr (std::is_signed_v<typename Field::member_type>) {
+            append_int(out, member);
+        } else {
+            append_uint(out, member);
+        }
+    } else if constexpr (Field::type == FieldType::real) {
+        append_fixed(out, member, field.precision);
+    } else if constexpr (Field::type == FieldType::text) {
+        out += '"';
+        append_escaped(out, member);
+        out += '"';
+    } else {
+        out += '[';
+        for (std::size_t i = 0; i < member.size(); ++i) {
+            out += i > 0 ? ",\"" : "\"";
+            append_escaped(out, member[i]);
+            out += '"';
+        }
+        out += ']';
+    }
+}
+
+// {"<name>":<value>,...} with the fields of `T` in order.
+template <typename T>
+void append_json(const T& value, std::pmr::string& out) {
+    char separator = '{';
+    for_each_field<T>([&](const auto& field) {
+        out += separator;
+        out += '"';
+        out += field.name;
+        out += "\":";
+        append_json_value(field, value, out);
+        separator = ',';
+    });
+    out += separator == '{' ? "{}" : "}";
+}
+
+template <typename Range>
+void append_json_array(const Range& values, std::pmr::string& out) {
+    out += '[';
+    bool first = true;
+    for (const auto& value : values) {
+        if (!first) out += ',';
+        append_json(value, out);
+        first = false;
+    }
+    out += ']';
+}
+
+// For the std::string-returning *_to_json functions: built in a stack
+// buffer and copied out once.
+template <typename T>
+std::string to_json(const T& value) {
+    std::array<std::byte, 1024> buffer;
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+    std::pmr::string json(&arena);
+    append_json(value, json);
+    return std::string(json);
+}
+
+template <typename Range>
+std::string to_json_array(const Range& values) {
+    std::array<std::byte, 4096> buffer;
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+    std::pmr::string json(&arena);
+    append_json_array(values, json);
+    return std::string(json);
+}
+
+// CSV (RFC 4180): a header of field names, then one line per value. Text
+// is quoted when it holds a comma, quote or line break; lists are joined
+// with ';'.
+
+inline void append_csv_text(std::pmr::string& out, std::string_view text) {
+    if (text.find_first_of(",\"\r\n") == std::string_view::npos) {
+        out += text;
+        return;
+    }
+    out += '"';
+    for (const char c : text) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+template <typename T>
+void append_csv_header(std::pmr::string& out) {
+    bool first = true;
+    for_each_field<T>([&](const auto& field) {
+        if (!first) out += ',';
+        out += field.name;
+        first = false;
+    });
+    out += '\n';
+}
+
+template <typename T>
+void append_csv_row(const T& value, std::pmr::string& out) {
+    bool first = true;
+    for_each_field<T>([&](const auto& field) {
+        using Field = std::remove_cvref_t<decltype(field)>;
+        if (!first) out += ',';
+        first = false;
+        const auto& member = field.get(value);
+        if constexpr (Field::type == FieldType::text) {
+            append_csv_text(out, member);
+        } else if constexpr (Field::type == FieldType::text_list) {
+            std::pmr::string joined(out.get_allocator());
+            for (std::size_t i = 0; i < member.size(); ++i) {
+                if (i > 0) joined += ';';
+                joined += member[i];
+            }
+            append_csv_text(out, joined);
+        } else {
+            append_json_value(field, value, out);
+        }
+    });
+    out += '\n';
+}
+
+template <typename Range>
+void append_csv(const Range& values, std::pmr::string& out) {
+    append_csv_header<std::remove_cvref_t<decltype(*std::begin(values))>>(out);
+    for (const auto& value : values) {
+        append_csv_row(value, out);
+    }
+}
+
+// Binary: the fields in order, little-endian. Booleans take one byte,
+// integers eight (two's complement), reals eight (IEEE 754 binary64),
+// text a 32-bit length and the bytes, lists a 32-bit count and the texts.
+
+namespace detail {
+
+inline void append_u64(std::pmr::string& out, std::uint64_t value) {
+    char bytes[8];
+    for (char& byte : bytes) {
+        byte = static_cast<char>(value & 0xff);
+        value >>= 8;
+    }
+    out.append(bytes, sizeof(bytes));
+}
+
+inline void append_u32(std::pmr::string& out, std::uint32_t value) {
+    const char bytes[] = {static_cast<char>(value & 0xff), static_cast<char>((value >> 8) & 0xff),
+                          static_cast<char>((value >> 16) & 0xff), static_cast<char>(value >> 24)};
+    out.append(bytes, sizeof(bytes));
+}
+
+inline bool read_bytes(std::string_view& in, std::size_t count, std::uint64_t& value) {
+    if (in.size() < count) {
+        return false;
+    }
+    value = 0;
+    for (std::size_t i = count; i > 0; --i) {
+        value = (value << 8) | static_cast<unsigned char>(in[i - 1]);
+    }
+    in.remove_prefix(count);
+    return true;
+}
+
+inline bool read_text(std::string_view& in, std::string_view& text) {
+    std::uint64_t length = 0;
+    if (!read_bytes(in, 4, length) || in.size() < length) {
+        return false;
+    }
+    text = in.substr(0, length);
+    in.remove_prefix(length);
+    return true;
+}
+
+}
+
+template <typename T>
+void append_binary(const T& value, std::pmr::string& out) {
+    for_each_field<T>([&](const auto& field) {
+        using Field = std::remove_cvref_t<decltype(field)>;
+        const auto& member = field.get(value);
+        if constexpr (Field::type == FieldType::boolean) {
+            out += member ? '\1' : '\0';
+        } else if constexpr (Field::type == FieldType::integer) {
+            detail::append_u64(out, static_cast<std::uint64_t>(member));
+        } else if constexpr (Field::type == FieldType::real) {
+            detail::append_u64(out, std::bit_cast<std::uint64_t>(static_cast<double>(member)));
+        } else if constexpr (Field::type == FieldType::text) {
+            const std::string_view text = member;
+            detail::append_u32(out, static_cast<std::uint32_t>(text.size()));
+            out += text;
+        } else {
+            detail::append_u32(out, static_cast<std::uint32_t>(member.size()));
+            for (const std::string_view text : member) {
+                detail::append_u32(out, static_cast<std::uint32_t>(text.size()));
+                out += text;
+            }
+        }
+    });
+}
+
+// Reads what append_binary() wrote and advances `in` past it. Text members
+// must own their characters; structs with views can be encoded only.
+template <typename T>
+bool read_binary(std::string_view& in, T& value) {
+    bool ok = true;
+    for_each_field<T>([&](const auto& field) {
+        using Field = std::remove_cvref_t<decltype(field)>;
+        using Member = typename Field::member_type;
+        auto& member = value.*field.member;
+        std::uint64_t bits = 0;
+        std::string_view text;
+        if (!ok) {
+            return;
+        }
+        if constexpr (Field::type == FieldType::boolean) {
+            ok = detail::read_bytes(in, 1, bits);
+            member = bits != 0;
+        } else if constexpr (Field::type == FieldType::integer) {
+            ok = detail::read_bytes(in, 8, bits);
+            member = static_cast<Member>(bits);
+        } else if constexpr (Field::type == FieldType::real) {
+            ok = detail::read_bytes(in, 8, bits);
+            member = static_cast<Member>(std::bit_cast<double>(bits));
+        } else if constexpr (Field::type == FieldType::text) {
+            static_assert(!std::is_same_v<Member, std::string_view>, "views cannot be decoded into");
+            ok = detail::read_text(in, text);
+            member.assign(text);
+        } else {
+            static_assert(!std::is_same_v<typename Member::value_type, std::string_view>,
+                          "views cannot be decoded into");
+            std::uint64_t count = 0;
+            ok = detail::read_bytes(in, 4, count);
+            member.clear();
+            for (std::uint64_t i = 0; ok && i < count; ++i) {
+                ok = detail::read_text(in, text);
+                member.emplace_back(text);
+            }
+        }
+    });
+    return ok;
+}
+
+// Column-wise storage of `T` values, laid out from the descriptors: one
+// vector per field, so a history hands out each metric as a contiguous
+// series (for charts and aggregation) instead of striding over rows.
+template <typename T>
+class Columns {
+public:
+    void push_back(const T& value) {
+        push(value, std::make_index_sequence<field_count<T>>{});
+    }
+
+    // Drops the oldest `count` values.
+    void erase_front(std::size_t count) {
+        std::apply([&](auto&... column) { (column.erase(column.begin(), column.begin() + count), ...); }, columns_);
+    }
+
+    void clear() {
+        std::apply([](auto&... column) { (column.clear(), ...); }, columns_);
+    }
+
+    std::size_t size() const { return std::get<0>(columns_).size(); }
+    bool empty() const { return size() == 0; }
+
+    // The series of the field at `Index` (see field_index()).
+    template <std::size_t Index>
+    const auto& column() const {
+        return std::get<Index>(columns_);
+    }
+
+    // The value at `row`; members without a descriptor are left
+    // value-initialized.
+    T row(std::size_t row) const {
+        T value{};
+        assign(value, row, std::make_index_sequence<field_count<T>>{});
+        return value;
+    }
+
+private:
+    template <typename Fields>
+    struct Layout;
+    template <typename... Fields>
+    struct Layout<std::tuple<Fields...>> {
+        using type = std::tuple<std::vector<typename Fields::member_type>...>;
+    };
+
+    template <std::size_t... Index>
+    void push(const T& value, std::index_sequence<Index...>) {
+        (std::get<Index>(columns_).push_back(std::get<Index>(fields_of<T>).get(value)), ...);
+    }
+
+    template <std::size_t... Index>
+    void assign(T& value, std::size_t row, std::index_sequence<Index...>) const {
+        ((value.*std::get<Index>(fields_of<T>).member = std::get<Index>(columns_)[row]), ...);
+    }
+
+    typename Layout<std::remove_cvref_t<decltype(fields_of<T>)>>::type columns_;
+};
+
+}
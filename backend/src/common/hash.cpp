@@ -0,0 +1,358 @@
+#include "hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define NANOOKJARO_SHA_NI 1
+#endif
+
+namespace nanookjaro::common {
+
+namespace {
+
+constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+inline std::uint64_t rotl(std::uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Inputs are read as little-endian; every platform we build for is.
+inline std::uint64_t read64(const unsigned char* p) {
+    std::uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline std::uint32_t read32(const unsigned char* p) {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline std::uint64_t round(std::uint64_t accumulator, std::uint64_t input) {
+    accumulator += input * kPrime2;
+    accumulator = rotl(accumulator, 31);
+    return accumulator * kPrime1;
+}
+
+inline std::uint64_t merge_round(std::uint64_t accumulator, std::uint64_t value) {
+    accumulator ^= round(0, value);
+    return accumulator * kPrime1 + kPrime4;
+}
+
+// Consumes whole 32-byte stripes; returns the number of bytes used.
+inline std::size_t consume_stripes(std::uint64_t (&v)[4], const unsigned char* p, std::size_t size) {
+    const unsigned char* const start = p;
+    const unsigned char* const limit = p + (size & ~static_cast<std::size_t>(31));
+    std::uint64_t v1 = v[0];
+    std::uint64_t v2 = v[1];
+    std::uint64_t v3 = v[2];
+    std::uint64_t v4 = v[3];
+    while (p < limit) {
+        v1 = round(v1, read64(p));
+        v2 = round(v2, read64(p + 8));
+        v3 = round(v3, read64(p + 16));
+        v4 = round(v4, read64(p + 24));
+        p += 32;
+    }
+    v[0] = v1;
+    v[1] = v2;
+    v[2] = v3;
+    v[3] = v4;
+    return static_cast<std::size_t>(p - start);
+}
+
+std::uint64_t finish(std::uint64_t hash, const unsigned char* p, std::size_t size) {
+    while (size >= 8) {
+        hash ^= round(0, read64(p));
+        hash = rotl(hash, 27) * kPrime1 + kPrime4;
+        p += 8;
+        size -= 8;
+    }
+    if (size >= 4) {
+        hash ^= static_cast<std::uint64_t>(read32(p)) * kPrime1;
+        hash = rotl(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+        size -= 4;
+    }
+    while (size > 0) {
+        hash ^= (*p) * kPrime5;
+        hash = rotl(hash, 11) * kPrime1;
+        ++p;
+        --size;
+    }
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+std::uint64_t converge(const std::uint64_t (&v)[4]) {
+    std::uint64_t hash = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+    for (const std::uint64_t lane : v) {
+        hash = merge_round(hash, lane);
+    }
+    return hash;
+}
+
+}
+
+Xxh64::Xxh64(std::uint64_t seed)
+    : v_{seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1}, seed_(seed), buffer_{} {}
+
+void Xxh64::update(const void* data, std::size_t size) {
+    auto* p = static_cast<const unsigned char*>(data);
+    total_ += size;
+    if (buffered_ > 0) {
+        const std::size_t take = std::min(size, sizeof(buffer_) - buffered_);
+        std::memcpy(buffer_ + buffered_, p, take);
+        buffered_ += take;
+        p += take;
+        size -= take;
+        if (buffered_ < sizeof(buffer_)) {
+            return;
+        }
+        consume_stripes(v_, buffer_, sizeof(buffer_));
+        buffered_ = 0;
+    }
+    const std::size_t used = consume_stripes(v_, p, size);
+    std::memcpy(buffer_, p + used, size - used);
+    buffered_ = size - used;
+}
+
+std::uint64_t Xxh64::digest() const {
+    const std::uint64_t hash = total_ >= 32 ? converge(v_) : seed_ + kPrime5;
+    return finish(hash + total_, buffer_, buffered_);
+}
+
+std::uint64_t xxh64(const void* data, std::size_t size, std::uint64_t seed) {
+    auto* p = static_cast<const unsigned char*>(data);
+    std::uint64_t hash;
+    std::size_t used = 0;
+    if (size >= 32) {
+        std::uint64_t v[4] = {seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1};
+        used = consume_stripes(v, p, size);
+        hash = converge(v);
+    } else {
+        hash = seed + kPrime5;
+    }
+    return finish(hash + size, p + used, size - used);
+}
+
+namespace {
+
+constexpr std::uint32_t kSha256Initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                             0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+alignas(16) constexpr std::uint32_t kSha256Rounds[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline std::uint32_t rotr32(std::uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+inline std::uint32_t load_be32(const unsigned char* p) {
+    return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16) |
+           (static_cast<std::uint32_t>(p[2]) << 8) | static_cast<std::uint32_t>(p[3]);
+}
+
+void sha256_blocks_portable(std::uint32_t (&state)[8], const unsigned char* data, std::size_t blocks) {
+    std::uint32_t w[64];
+    while (blocks-- > 0) {
+        for (int i = 0; i < 16; ++i) {
+            w[i] = load_be32(data + 4 * i);
+        }
+        for (int i = 16; i < 64; ++i) {
+            const std::uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const std::uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        std::uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            const std::uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+            const std::uint32_t choice = (e & f) ^ (~e & g);
+            const std::uint32_t t1 = h + s1 + choice + kSha256Rounds[i] + w[i];
+            const std::uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+            const std::uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+            const std::uint32_t t2 = s0 + majority;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        data += 64;
+    }
+}
+
+#ifdef NANOOKJARO_SHA_NI
+// Four rounds per step with sha256rnds2; the message schedule for words
+// 16..63 comes from sha256msg1/msg2. The state is kept as ABEF/CDGH pairs,
+// the layout the instructions expect.
+__attribute__((target("sha,sse4.1"))) void sha256_blocks_shani(std::uint32_t (&state)[8], const unsigned char* data,
+                                                                 std::size_t blocks) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (blocks-- > 0) {
+        const __m128i abef = state0;
+        const __m128i cdgh = state1;
+        __m128i w[4];
+#pragma GCC unroll 16
+        for (int group = 0; group < 16; ++group) {
+            __m128i& current = w[group % 4];
+            if (group < 4) {
+                current = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * group)),
+                                           byte_swap);
+            } else {
+                const __m128i& previous = w[(group + 3) % 4];
+                current = _mm_sha256msg2_epu32(
+                    _mm_add_epi32(_mm_sha256msg1_epu32(current, w[(group + 1) % 4]),
+                                  _mm_alignr_epi8(previous, w[(group + 2) % 4], 4)),
+                    previous);
+            }
+            __m128i message = _mm_add_epi32(
+                current, _mm_load_si128(reinterpret_cast<const __m128i*>(&kSha256Rounds[4 * group])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+            message = _mm_shuffle_epi32(message, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, message);
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+        data += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+bool cpu_has_sha_extensions() {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0) {
+        return false;
+    }
+    const bool sha = (ebx & (1u << 29)) != 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+        return false;
+    }
+    const bool ssse3 = (ecx & (1u << 9)) != 0;
+    const bool sse41 = (ecx & (1u << 19)) != 0;
+    return sha && ssse3 && sse41;
+}
+#endif
+
+using Sha256Blocks = void (*)(std::uint32_t (&)[8], const unsigned char*, std::size_t);
+
+Sha256Blocks select_sha256_blocks() {
+#ifdef NANOOKJARO_SHA_NI
+    if (cpu_has_sha_extensions()) {
+        return sha256_blocks_shani;
+    }
+#endif
+    return sha256_blocks_portable;
+}
+
+const Sha256Blocks sha256_blocks = select_sha256_blocks();
+
+}
+
+Sha256::Sha256() : buffer_{} {
+    std::memcpy(state_, kSha256Initial, sizeof(state_));
+}
+
+void Sha256::update(const void* data, std::size_t size) {
+    auto* p = static_cast<const unsigned char*>(data);
+    total_ += size;
+    if (buffered_ > 0) {
+        const std::size_t take = std::min(size, sizeof(buffer_) - buffered_);
+        std::memcpy(buffer_ + buffered_, p, take);
+        buffered_ += take;
+        p += take;
+        size -= take;
+        if (buffered_ < sizeof(buffer_)) {
+            return;
+        }
+        sha256_blocks(state_, buffer_, 1);
+        buffered_ = 0;
+    }
+    const std::size_t blocks = size / 64;
+    sha256_blocks(state_, p, blocks);
+    std::memcpy(buffer_, p + blocks * 64, size - blocks * 64);
+    buffered_ = size - blocks * 64;
+}
+
+Sha256::Digest Sha256::digest() const {
+    std::uint32_t state[8];
+    std::memcpy(state, state_, sizeof(state));
+    unsigned char tail[128] = {};
+    std::memcpy(tail, buffer_, buffered_);
+    tail[buffered_] = 0x80;
+    const std::size_t length = buffered_ + 9 <= 64 ? 64 : 128;
+    const std::uint64_t bits = total_ * 8;
+    for (int i = 0; i < 8; ++i) {
+        tail[length - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+    }
+    sha256_blocks(state, tail, length / 64);
+
+    Digest digest{};
+    for (int i = 0; i < 8; ++i) {
+        digest[4 * i] = static_cast<unsigned char>(state[i] >> 24);
+        digest[4 * i + 1] = static_cast<unsigned char>(state[i] >> 16);
+        digest[4 * i + 2] = static_cast<unsigned char>(state[i] >> 8);
+        digest[4 * i + 3] = static_cast<unsigned char>(state[i]);
+    }
+    return digest;
+}
+
+std::string Sha256::to_hex(const Digest& digest) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    std::string hex(digest.size() * 2, '0');
+    for (std::size_t i = 0; i < digest.size(); ++i) {
+        hex[2 * i] = kHex[digest[i] >> 4];
+        hex[2 * i + 1] = kHex[digest[i] & 0x0f];
+    }
+    return hex;
+}
+
+Sha256::Digest sha256(const void* data, std::size_t size) {
+    Sha256 hash;
+    hash.update(data, size);
+    return hash.digest();
+}
+
+}
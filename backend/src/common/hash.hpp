@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace nanookjaro::common {
+
+// XXH64 from the xxHash family: a fast non-cryptographic 64-bit hash for
+// comparing file contents and building lookup keys. Output matches the
+// reference implementation. Not suitable where collisions could be forced.
+class Xxh64 {
+public:
+    explicit Xxh64(std::uint64_t seed = 0);
+
+    void update(const void* data, std::size_t size);
+    std::uint64_t digest() const;
+
+private:
+    std::uint64_t v_[4];
+    std::uint64_t seed_;
+    std::uint64_t total_ = 0;
+    unsigned char buffer_[32];
+    std::size_t buffered_ = 0;
+};
+
+std::uint64_t xxh64(const void* data, std::size_t size, std::uint64_t seed = 0);
+
+inline std::uint64_t xxh64(std::string_view text, std::uint64_t seed = 0) {
+    return xxh64(text.data(), text.size(), seed);
+}
+
+// SHA-256 (FIPS 180-4), for checking files against package metadata. Uses
+// the x86 SHA extensions when the CPU has them.
+class Sha256 {
+public:
+    using Digest = std::array<unsigned char, 32>;
+
+    Sha256();
+
+    void update(const void* data, std::size_t size);
+    Digest digest() const;
+
+    // Lower-case hex, the form mtree and sync databases store.
+    static std::string to_hex(const Digest& digest);
+
+private:
+    std::uint32_t state_[8];
+    std::uint64_t total_ = 0;
+    unsigned char buffer_[64];
+    std::size_t buffered_ = 0;
+};
+
+Sha256::Digest sha256(const void* data, std::size_t size);
+
+}
@@ -0,0 +1,41 @@
+#include "intern.hpp"
+
+#include <mutex>
+
+namespace nanookjaro::common {
+
+NameId InternTable::intern(std::string_view name) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (const auto found = ids_.find(name); found != ids_.end()) {
+            return found->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (const auto found = ids_.find(name); found != ids_.end()) {
+        return found->second;
+    }
+    const auto id = static_cast<NameId>(names_.size());
+    const std::string& stored = names_.emplace_back(name);
+    ids_.emplace(stored, id);
+    return id;
+}
+
+std::string_view InternTable::name(NameId id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return id < names_.size() ? std::string_view(names_[id]) : std::string_view{};
+}
+
+std::size_t InternTable::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return names_.size();
+}
+
+InternTable& interned_names() {
+    // Never destroyed: views handed out may be used by threads that outlive
+    // static destructors.
+    static InternTable* table = new InternTable();
+    return *table;
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace nanookjaro::common {
+
+using NameId = std::uint32_t;
+
+// Names that come back sample after sample (interfaces, mount points,
+// modules, packages), each stored once for the life of the process. An id
+// is a dense index, so state kept across samples can be keyed on it
+// instead of on the text. Views stay valid and are NUL-terminated.
+// Entries are never removed; the table grows with the number of distinct
+// names seen. Thread-safe: looking up a known name takes a shared lock and
+// does not allocate.
+class InternTable {
+public:
+    NameId intern(std::string_view name);
+    std::string_view name(NameId id) const;
+    std::size_t size() const;
+
+private:
+    mutable std::shared_mutex mutex_;
+    std::deque<std::string> names_;  // indexed by id; a deque never moves them
+    std::unordered_map<std::string_view, NameId> ids_;
+};
+
+// The process-wide table.
+InternTable& interned_names();
+
+}
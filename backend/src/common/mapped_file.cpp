@@ -0,0 +1,75 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanookjaro::common {
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        map_fd(fd);
+        close(fd);
+    }
+}
+
+MappedFile::MappedFile(int dirfd, const char* name) {
+    const int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        map_fd(fd);
+        close(fd);
+    }
+}
+
+MappedFile::~MappedFile() {
+    reset();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      valid_(std::exchange(other.valid_, false)) {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        reset();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        valid_ = std::exchange(other.valid_, false);
+    }
+    return *this;
+}
+
+void MappedFile::map_fd(int fd) {
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    valid_ = true;
+    if (st.st_size == 0) {
+        return;
+    }
+    void* address = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+        valid_ = false;
+        return;
+    }
+    data_ = static_cast<const char*>(address);
+    size_ = static_cast<std::size_t>(st.st_size);
+}
+
+void MappedFile::reset() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    valid_ = false;
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace nanookjaro::common {
+
+// Read-only private mapping of a whole file. Empty and unreadable files both
+// yield an empty view; use valid() to tell them apart.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    MappedFile(int dirfd, const char* name);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool valid() const { return valid_; }
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+
+private:
+    void map_fd(int fd);
+    void reset();
+
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool valid_ = false;
+};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace nanookjaro::common {
+
+// Runs fn(i) for every i in [0, count) on up to hardware_concurrency threads.
+// Indices are handed out in small batches, so uneven items balance out. Small
+// inputs run inline on the calling thread.
+template <typename Fn>
+void parallel_for(std::size_t count, Fn&& fn, std::size_t min_per_thread = 64) {
+    const std::size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t threads = std::min(hardware, count / std::max<std::size_t>(min_per_thread, 1));
+    if (threads <= 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    constexpr std::size_t kBatch = 16;
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]() {
+        while (true) {
+            const std::size_t begin = next.fetch_add(kBatch, std::memory_order_relaxed);
+            if (begin >= count) {
+                return;
+            }
+            const std::size_t end = std::min(begin + kBatch, count);
+            for (std::size_t i = begin; i < end; ++i) {
+                fn(i);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (std::size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+}
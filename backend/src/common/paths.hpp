@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace nanookjaro::common {
+
+// $XDG_CACHE_HOME/nanookjaro (or ~/.cache/nanookjaro), created on demand.
+// Returns an empty string when no writable location can be set up.
+std::string cache_directory();
+
+// Writes `contents` to a temporary file next to `path` and renames it into
+// place, so readers never observe a partially written cache file.
+bool write_file_atomically(const std::string& path, std::string_view contents);
+
+}
@@ -0,0 +1,152 @@
+#include "scratch.hpp"
+
+#include <charconv>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace nanookjaro::common {
+
+void* TickArena::Spill::do_allocate(std::size_t size, std::size_t alignment) {
+    bytes += size;
+    return std::pmr::new_delete_resource()->allocate(size, alignment);
+}
+
+void TickArena::Spill::do_deallocate(void* pointer, std::size_t size, std::size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(pointer, size, alignment);
+}
+
+bool TickArena::Spill::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+TickArena::TickArena(std::size_t capacity) : buffer_(capacity) {
+    arena_.emplace(buffer_.data(), buffer_.size(), &spill_);
+}
+
+void TickArena::reset() {
+    // Rebuilt rather than release()d: either way nothing is freed piecemeal,
+    // and a new arena also picks up an enlarged buffer.
+    arena_.reset();
+    if (spill_.bytes > 0) {
+        ++overflows_;
+        buffer_.resize(buffer_.size() + spill_.bytes);
+        spill_.bytes = 0;
+    }
+    arena_.emplace(buffer_.data(), buffer_.size(), &spill_);
+}
+
+void append_int(std::pmr::string& out, long long value) {
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+void append_uint(std::pmr::string& out, unsigned long long value) {
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+void append_fixed(std::pmr::string& out, double value, int precision) {
+    char digits[352];  // the longest fixed-notation double
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed, precision);
+    out.append(digits, result.ptr);
+}
+
+namespace {
+
+template <typename String>
+void append_escaped_to(String& out, std::string_view text) {
+    // Runs of characters that need no escaping are copied in one go.
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        const auto c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(text.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default: {
+                constexpr char kHex[] = "0123456789abcdef";
+                const char escaped[] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xf]};
+                out.append(escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+    out.append(text.data() + run, text.size() - run);
+}
+
+}
+
+void append_escaped(std::pmr::string& out, std::string_view text) {
+    append_escaped_to(out, text);
+}
+
+void append_escaped(std::string& out, std::string_view text) {
+    append_escaped_to(out, text);
+}
+
+std::string escape_json(std::string_view text) {
+    std::string out;
+    out.reserve(text.size());
+    append_escaped_to(out, text);
+    return out;
+}
+
+void assign_kept(std::string& out, std::string_view value) {
+    if (value.size() > out.capacity()) {
+        out.reserve(value.size() + value.size() / 4 + 16);
+    }
+    out.assign(value);
+}
+
+bool read_file(const char* path, std::pmr::string& out) {
+    out.clear();
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    // /proc files report a size of zero, so read until end of file.
+    constexpr std::size_t kChunk = 4096;
+    for (;;) {
+        const std::size_t used = out.size();
+        out.resize(used + kChunk);
+        const ssize_t got = read(fd, out.data() + used, kChunk);
+        if (got <= 0) {
+            out.resize(used);
+            break;
+        }
+        out.resize(used + static_cast<std::size_t>(got));
+    }
+    close(fd);
+    return true;
+}
+
+std::string_view trim_view(std::string_view text) {
+    const auto first = text.find_first_not_of(" \t\n\r");
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    const auto last = text.find_last_not_of(" \t\n\r");
+    return text.substr(first, last - first + 1);
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nanookjaro::common {
+
+// Scratch memory for one sampler tick: a monotonic arena over a buffer that
+// is kept from tick to tick. Allocating is a pointer bump, freeing is a
+// no-op, and reset() drops everything at once. A tick that outgrows the
+// buffer takes the rest from the heap, and the next reset() enlarges the
+// buffer to match, so after warm-up a tick never reaches the heap.
+class TickArena {
+public:
+    explicit TickArena(std::size_t capacity = 64 * 1024);
+    TickArena(const TickArena&) = delete;
+    TickArena& operator=(const TickArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &*arena_; }
+    void reset();
+
+    std::size_t capacity() const { return buffer_.size(); }
+    // Ticks that had to go to the heap.
+    std::uint64_t overflows() const { return overflows_; }
+
+private:
+    // Heap fallback that records how much the arena asked for.
+    class Spill : public std::pmr::memory_resource {
+    public:
+        std::size_t bytes = 0;
+
+    private:
+        void* do_allocate(std::size_t size, std::size_t alignment) override;
+        void do_deallocate(void* pointer, std::size_t size, std::size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    std::vector<std::byte> buffer_;
+    Spill spill_;
+    std::optional<std::pmr::monotonic_buffer_resource> arena_;
+    std::uint64_t overflows_ = 0;
+};
+
+// Building JSON text in scratch strings without iostreams, which allocate
+// on their own. Numbers are formatted like the streams elsewhere in the
+// library (std::fixed with two decimals for doubles).
+void append_int(std::pmr::string& out, long long value);
+void append_uint(std::pmr::string& out, unsigned long long value);
+void append_fixed(std::pmr::string& out, double value, int precision = 2);
+// `text` as the contents of a JSON string: quotes and backslashes escaped,
+// \n, \r and \t as such and other control characters as \u00XX.
+// This is the library's only JSON string escaper.
+void append_escaped(std::pmr::string& out, std::string_view text);
+void append_escaped(std::string& out, std::string_view text);
+// append_escaped() into a new string, for serializers built on streams.
+std::string escape_json(std::string_view text);
+
+// Copies `value` into a string that is kept from tick to tick. Growing
+// leaves headroom, so a value that gains a digit or two later on does not
+// reach the heap again.
+void assign_kept(std::string& out, std::string_view value);
+
+// Replaces `out` with the contents of a (typically /proc or /sys) file.
+// False when it cannot be opened.
+bool read_file(const char* path, std::pmr::string& out);
+
+// `text` without leading and trailing spaces, tabs and line breaks.
+std::string_view trim_view(std::string_view text);
+
+}
@@ -0,0 +1,210 @@
+#include "subprocess.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace nanookjaro::common {
+
+namespace {
+
+constexpr std::size_t kReadChunk = 64 * 1024;
+constexpr auto kKillGrace = std::chrono::seconds(1);
+
+// Reads whatever is available into the tail of `buffer`. Returns false once
+// the stream is finished (EOF or a hard error).
+bool drain_into(int fd, std::string& buffer, std::size_t limit) {
+    ssize_t length = 0;
+    if (buffer.size() < limit) {
+        const std::size_t used = buffer.size();
+        buffer.resize(used + kReadChunk);
+        length = read(fd, buffer.data() + used, kReadChunk);
+        buffer.resize(used + static_cast<std::size_t>(length > 0 ? length : 0));
+        if (buffer.size() > limit) {
+            buffer.resize(limit);
+        }
+    } else {
+        std::array<char, kReadChunk> discard{};
+        length = read(fd, discard.data(), discard.size());
+    }
+    if (length > 0) {
+        return true;
+    }
+    return length < 0 && (errno == EINTR || errno == EAGAIN);
+}
+
+double to_seconds(const timeval& value) {
+    return static_cast<double>(value.tv_sec) + static_cast<double>(value.tv_usec) / 1e6;
+}
+
+}
+
+int spawn_in_process_group(const std::vector<std::string>& argv, int stdout_fd, int stderr_fd, pid_t& pid) {
+    if (argv.empty()) {
+        return EINVAL;
+    }
+    std::vector<char*> args;
+    args.reserve(argv.size() + 1);
+    for (const auto& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, stdout_fd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, stderr_fd, STDERR_FILENO);
+
+    // Own process group so a timeout or cancellation reaches every helper
+    // the command starts, with default signal handling whatever the host
+    // application set up.
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t empty_mask;
+    sigset_t default_signals;
+    sigemptyset(&empty_mask);
+    sigemptyset(&default_signals);
+    for (int signal_number : {SIGINT, SIGTERM, SIGQUIT, SIGHUP, SIGPIPE, SIGCHLD}) {
+        sigaddset(&default_signals, signal_number);
+    }
+    posix_spawnattr_setsigmask(&attributes, &empty_mask);
+    posix_spawnattr_setsigdefault(&attributes, &default_signals);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    const int error = posix_spawnp(&pid, args[0], &actions, &attributes, args.data(), environ);
+
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    return error;
+}
+
+SubprocessResult run_subprocess(const std::vector<std::string>& argv, const SubprocessOptions& options) {
+    SubprocessResult result;
+    const auto start = std::chrono::steady_clock::now();
+
+    int out_pipe[2] = {-1, -1};
+    int err_pipe[2] = {-1, -1};
+    if (pipe2(out_pipe, O_CLOEXEC) != 0 || (!options.merge_stderr && pipe2(err_pipe, O_CLOEXEC) != 0)) {
+        result.spawn_error = errno;
+        result.exit_code = 127;
+        for (int fd : {out_pipe[0], out_pipe[1], err_pipe[0], err_pipe[1]}) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        return result;
+    }
+
+    pid_t pid = -1;
+    const int error = spawn_in_process_group(argv, out_pipe[1], options.merge_stderr ? out_pipe[1] : err_pipe[1], pid);
+    close(out_pipe[1]);
+    if (err_pipe[1] >= 0) {
+        close(err_pipe[1]);
+    }
+    if (error != 0) {
+        close(out_pipe[0]);
+        if (err_pipe[0] >= 0) {
+            close(err_pipe[0]);
+        }
+        result.spawn_error = error;
+        result.exit_code = 127;
+        return result;
+    }
+    result.started = true;
+
+    // SIGTERM at the deadline, SIGKILL one grace period later.
+    auto deadline = start + options.timeout;
+    int kill_stage = 0;
+    auto enforce_deadline = [&](std::chrono::steady_clock::time_point now) {
+        if (kill_stage >= 2 || now < deadline) {
+            return;
+        }
+        result.timed_out = true;
+        kill(-pid, kill_stage == 0 ? SIGTERM : SIGKILL);
+        ++kill_stage;
+        deadline = now + kKillGrace;
+    };
+
+    std::array<pollfd, 2> fds{pollfd{out_pipe[0], POLLIN, 0}, pollfd{err_pipe[0], POLLIN, 0}};
+    std::array<std::string*, 2> buffers{&result.out, &result.err};
+    while (fds[0].fd >= 0 || fds[1].fd >= 0) {
+        const auto now = std::chrono::steady_clock::now();
+        enforce_deadline(now);
+        if (kill_stage >= 2 && now >= deadline) {
+            break;  // something outside the process group still holds the pipe
+        }
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+        const int ready = poll(fds.data(), fds.size(), static_cast<int>(wait));
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        for (std::size_t i = 0; ready > 0 && i < fds.size(); ++i) {
+            if (fds[i].fd >= 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0 &&
+                !drain_into(fds[i].fd, *buffers[i], options.max_output_bytes)) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+            }
+        }
+    }
+    for (const auto& entry : fds) {
+        if (entry.fd >= 0) {
+            close(entry.fd);
+        }
+    }
+
+    // The pipes usually close as the child exits, so the first few polls
+    // are short; a child that closed its output early is still bounded by
+    // the deadline.
+    int status = 0;
+    bool reaped = false;
+    rusage usage {};
+    auto backoff = std::chrono::microseconds(50);
+    while (true) {
+        const pid_t waited = wait4(pid, &status, WNOHANG, &usage);
+        if (waited == pid) {
+            reaped = true;
+            break;
+        }
+        if (waited < 0 && errno != EINTR) {
+            break;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        enforce_deadline(now);
+        if (kill_stage >= 2 && now >= deadline) {
+            break;  // stuck in uninterruptible sleep; give up rather than block
+        }
+        std::this_thread::sleep_for(backoff);
+        backoff = std::min<std::chrono::microseconds>(backoff * 2, std::chrono::milliseconds(10));
+    }
+
+    // Without a reaped status the child may still be running; exit_code
+    // stays -1 rather than reading the untouched status as success.
+    if (!reaped) {
+        result.exit_code = -1;
+    } else if (WIFEXITED(status)) {
+        result.exit_code = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        result.term_signal = WTERMSIG(status);
+        result.exit_code = 128 + result.term_signal;
+    }
+    result.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    result.user_cpu_seconds = to_seconds(usage.ru_utime);
+    result.system_cpu_seconds = to_seconds(usage.ru_stime);
+    result.max_rss_kb = usage.ru_maxrss;
+    return result;
+}
+
+}
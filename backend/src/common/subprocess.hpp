@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace nanookjaro::common {
+
+struct SubprocessOptions {
+    // Wall-clock limit. The process group gets SIGTERM when it expires and
+    // SIGKILL if it is still around shortly after.
+    std::chrono::milliseconds timeout{std::chrono::seconds(10)};
+    // Send stderr to the same buffer as stdout (like `2>&1`).
+    bool merge_stderr = false;
+    // Output beyond this many bytes per stream is read and discarded.
+    std::size_t max_output_bytes = 16 * 1024 * 1024;
+};
+
+struct SubprocessResult {
+    bool started = false;
+    int spawn_error = 0;     // errno from posix_spawnp when !started
+    int exit_code = -1;      // 127 when the program could not be started, -1 when it was not reaped
+    int term_signal = 0;     // signal that ended the process, if any
+    bool timed_out = false;  // the deadline passed; the child may not have been reaped
+    std::string out;
+    std::string err;
+    std::chrono::milliseconds elapsed{0};
+    double user_cpu_seconds = 0.0;
+    double system_cpu_seconds = 0.0;
+    long max_rss_kb = 0;
+};
+
+// Starts argv (argv[0] looked up in PATH) without a shell, in a new process
+// group, with stdin on /dev/null and default signal dispositions. stdout and
+// stderr go to the given descriptors. Returns 0 or an errno value.
+int spawn_in_process_group(const std::vector<std::string>& argv, int stdout_fd, int stderr_fd, pid_t& pid);
+
+// Runs argv to completion, draining stdout/stderr with poll() and reaping it
+// with wait4() so the result carries the child's resource usage.
+SubprocessResult run_subprocess(const std::vector<std::string>& argv, const SubprocessOptions& options = {});
+
+}
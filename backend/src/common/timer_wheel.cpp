@@ -0,0 +1,145 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+
+namespace nanookjaro::common {
+
+void TimerWheel::schedule(std::uint32_t id, Tick deadline) {
+    if (id >= timers_.size()) {
+        timers_.resize(static_cast<std::size_t>(id) + 1);
+    }
+    if (timers_[id].level != kUnscheduled) {
+        unlink(id);
+    }
+    timers_[id].deadline = deadline;
+    insert(id);
+}
+
+void TimerWheel::cancel(std::uint32_t id) {
+    if (scheduled(id)) {
+        unlink(id);
+    }
+}
+
+void TimerWheel::insert(std::uint32_t id) {
+    Timer& timer = timers_[id];
+    // Overdue timers go into the slot processed next.
+    const Tick deadline = std::max(timer.deadline, current_ + 1);
+    const Tick delta = deadline - current_;
+    unsigned level = 0;
+    while (level + 1 < kLevels && delta >= (Tick{1} << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    Tick due = deadline;
+    if (level == kLevels - 1 && delta >= (Tick{1} << (kSlotBits * kLevels))) {
+        // Beyond the wheel: park in the farthest top-level slot; the timer
+        // is filed again when that slot comes around.
+        due = current_ + (Tick{1} << (kSlotBits * kLevels)) - 1;
+    }
+    timer.level = static_cast<std::uint8_t>(level);
+    timer.slot = static_cast<std::uint8_t>((due >> (kSlotBits * level)) & (kSlots - 1));
+    std::uint32_t& head = heads_[level][timer.slot];
+    timer.prev = kNone;
+    timer.next = head;
+    if (head != kNone) {
+        timers_[head].prev = id;
+    }
+    head = id;
+    ++pending_;
+}
+
+void TimerWheel::unlink(std::uint32_t id) {
+    Timer& timer = timers_[id];
+    if (timer.prev != kNone) {
+        timers_[timer.prev].next = timer.next;
+    } else {
+        heads_[timer.level][timer.slot] = timer.next;
+    }
+    if (timer.next != kNone) {
+        timers_[timer.next].prev = timer.prev;
+    }
+    timer.prev = timer.next = kNone;
+    timer.level = kUnscheduled;
+    --pending_;
+}
+
+void TimerWheel::process_tick(std::vector<std::uint32_t>& expired) {
+    // Re-file the higher-level slots that start at this tick, top down, so
+    // their timers land in lower levels (or fire below).
+    for (unsigned level = kLevels - 1; level > 0; --level) {
+        const unsigned shift = kSlotBits * level;
+        if ((current_ & ((Tick{1} << shift) - 1)) != 0) {
+            continue;
+        }
+        const auto slot = static_cast<std::uint8_t>((current_ >> shift) & (kSlots - 1));
+        std::uint32_t id = heads_[level][slot];
+        heads_[level][slot] = kNone;
+        while (id != kNone) {
+            const std::uint32_t next = timers_[id].next;
+            timers_[id].level = kUnscheduled;
+            --pending_;
+            if (timers_[id].deadline <= current_) {
+                expired.push_back(id);
+            } else {
+                insert(id);
+            }
+            id = next;
+        }
+    }
+
+    const auto slot = static_cast<std::uint8_t>(current_ & (kSlots - 1));
+    std::uint32_t id = heads_[0][slot];
+    heads_[0][slot] = kNone;
+    while (id != kNone) {
+        const std::uint32_t next = timers_[id].next;
+        timers_[id].level = kUnscheduled;
+        timers_[id].prev = timers_[id].next = kNone;
+        --pending_;
+        expired.push_back(id);
+        id = next;
+    }
+}
+
+void TimerWheel::advance(Tick now, std::vector<std::uint32_t>& expired) {
+    while (current_ < now) {
+        // Skip stretches without anything to fire or re-file.
+        const std::optional<Tick> next = next_event();
+        if (!next || *next > now) {
+            current_ = now;
+            return;
+        }
+        current_ = std::max(*next, current_ + 1);
+        process_tick(expired);
+    }
+}
+
+std::optional<TimerWheel::Tick> TimerWheel::next_event() const {
+    if (pending_ == 0) {
+        return std::nullopt;
+    }
+    std::optional<Tick> best;
+    for (Tick i = 1; i <= kSlots; ++i) {
+        if (heads_[0][(current_ + i) & (kSlots - 1)] != kNone) {
+            best = current_ + i;
+            break;
+        }
+    }
+    for (unsigned level = 1; level < kLevels; ++level) {
+        const unsigned shift = kSlotBits * level;
+        const Tick unit = Tick{1} << shift;
+        const Tick boundary = (current_ / unit + 1) * unit;
+        const Tick index = (boundary >> shift) & (kSlots - 1);
+        for (Tick slot = 0; slot < kSlots; ++slot) {
+            if (heads_[level][slot] == kNone) {
+                continue;
+            }
+            const Tick when = boundary + ((slot - index) & (kSlots - 1)) * unit;
+            if (!best || when < *best) {
+                best = when;
+            }
+        }
+    }
+    return best;
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace nanookjaro::common {
+
+// Hierarchical timer wheel over integer ticks: four levels of 64 slots, so
+// level 0 resolves single ticks and each higher level covers 64 times the
+// span of the one below (16.7M ticks in total; later deadlines wait in the
+// top level and are re-filed as time passes). Scheduling and cancelling are
+// O(1); a timer is moved down at most once per level before it fires.
+// Timers are identified by small integer ids chosen by the caller.
+class TimerWheel {
+public:
+    using Tick = std::uint64_t;
+
+    explicit TimerWheel(Tick now = 0) : current_(now) {}
+
+    Tick now() const { return current_; }
+    bool empty() const { return pending_ == 0; }
+    bool scheduled(std::uint32_t id) const { return id < timers_.size() && timers_[id].level != kUnscheduled; }
+
+    // (Re)schedules `id` to fire at `deadline`; past deadlines fire on the
+    // next advance().
+    void schedule(std::uint32_t id, Tick deadline);
+    void cancel(std::uint32_t id);
+
+    // Moves time forward to `now`, appending the ids of timers whose
+    // deadline passed to `expired` in deadline order.
+    void advance(Tick now, std::vector<std::uint32_t>& expired);
+
+    // Earliest tick at which advance() has work to do (a timer fires or a
+    // higher-level slot is re-filed), or nothing when no timer is pending.
+    std::optional<Tick> next_event() const;
+
+private:
+    static constexpr unsigned kLevels = 4;
+    static constexpr unsigned kSlotBits = 6;
+    static constexpr unsigned kSlots = 1u << kSlotBits;
+    static constexpr std::uint32_t kNone = 0xffffffffu;
+    static constexpr std::uint8_t kUnscheduled = 0xff;
+
+    struct Timer {
+        Tick deadline = 0;
+        std::uint32_t prev = kNone;
+        std::uint32_t next = kNone;
+        std::uint8_t level = kUnscheduled;
+        std::uint8_t slot = 0;
+    };
+
+    void insert(std::uint32_t id);
+    void unlink(std::uint32_t id);
+    void process_tick(std::vector<std::uint32_t>& expired);
+
+    Tick current_;
+    std::size_t pending_ = 0;
+    std::vector<Timer> timers_;
+    std::array<std::array<std::uint32_t, kSlots>, kLevels> heads_ = [] {
+        std::array<std::array<std::uint32_t, kSlots>, kLevels> heads{};
+        for (auto& level : heads) {
+            level.fill(kNone);
+        }
+        return heads;
+    }();
+};
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nanookjaro::common {
+
+// Runs fn(worker, task, push) until every task, including the ones pushed
+// while running, has been processed. Each worker owns a deque: it pushes and
+// pops at the back (depth-first, cache friendly) while idle workers steal
+// from the front of the others, which hands out the oldest, typically
+// largest, pieces of work.
+template <typename Task, typename Fn>
+void run_work_stealing(std::vector<Task> initial, std::size_t threads, Fn&& fn) {
+    threads = std::max<std::size_t>(threads, 1);
+
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    queues.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    // Number of tasks queued or running; zero means all work is done.
+    std::atomic<std::size_t> outstanding{initial.size()};
+    for (std::size_t i = 0; i < initial.size(); ++i) {
+        queues[i % threads]->tasks.push_back(std::move(initial[i]));
+    }
+
+    auto worker = [&](std::size_t self) {
+        auto push = [&](Task task) {
+            outstanding.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(queues[self]->mutex);
+            queues[self]->tasks.push_back(std::move(task));
+        };
+        auto take = [&](Task& task) {
+            {
+                std::lock_guard<std::mutex> lock(queues[self]->mutex);
+                if (!queues[self]->tasks.empty()) {
+                    task = std::move(queues[self]->tasks.back());
+                    queues[self]->tasks.pop_back();
+                    return true;
+                }
+            }
+            for (std::size_t offset = 1; offset < threads; ++offset) {
+                auto& victim = *queues[(self + offset) % threads];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        auto idle = std::chrono::microseconds(1);
+        Task task;
+        while (true) {
+            if (take(task)) {
+                fn(self, task, push);
+                outstanding.fetch_sub(1, std::memory_order_acq_rel);
+                idle = std::chrono::microseconds(1);
+                continue;
+            }
+            if (outstanding.load(std::memory_order_acquire) == 0) {
+                return;
+            }
+            std::this_thread::sleep_for(idle);
+            idle = std::min<std::chrono::microseconds>(idle * 2, std::chrono::microseconds(500));
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (std::size_t i = 1; i < threads; ++i) {
+        pool.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+}
@@ -1,98 +1,418 @@
 #include "driver_manager.hpp"
-#include <string>
-#include <array>
-#include <memory>
+#include "../common/decompress.hpp"
+#include "../common/intern.hpp"
+#include "../common/mapped_file.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
-#include <fstream>
-#include <algorithm>
-#include <filesystem>
+
+#include <dirent.h>
+#include <elf.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
 
 namespace nanookjaro::drivers {
 
 namespace {
-    
-std::string exec_command(const char* cmd) {
-    std::array<char, 256> buffer;
-    std::string result;
-    FILE* pipe = popen(cmd, "r");
-    if (!pipe) return "";
-    
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
-        result += buffer.data();
+
+std::string trim(const std::string& value) {
+    const auto first = value.find_first_not_of(" \t\n\r");
+    if (first == std::string::npos) {
+        return {};
     }
-    
-    pclose(pipe);
-    return result;
+    const auto last = value.find_last_not_of(" \t\n\r");
+    return value.substr(first, last - first + 1);
+}
+
+std::string read_sysfs_value(const std::string& path) {
+    std::ifstream file(path);
+    std::string value;
+    std::getline(file, value);
+    return trim(value);
+}
+
+// Module names use '_' in /proc/modules while file names may use '-'.
+std::string normalize_module_name(std::string_view file_name) {
+    for (std::string_view suffix : {".ko.zst", ".ko.xz", ".ko.gz", ".ko"}) {
+        if (file_name.size() > suffix.size() &&
+            file_name.compare(file_name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            file_name.remove_suffix(suffix.size());
+            break;
+        }
+    }
+    std::string name(file_name);
+    std::replace(name.begin(), name.end(), '-', '_');
+    return name;
+}
+
+std::string running_kernel_release() {
+    utsname info{};
+    if (uname(&info) != 0) {
+        return {};
+    }
+    return info.release;
+}
+
+struct ModuleMetadata {
+    std::string version;
+    std::string description;
+    std::string license;
+    std::string author;
+    std::string srcversion;
+    std::string filename;
+    std::vector<std::string_view> depends;  // interned
+    std::vector<std::string> firmware;
+};
+
+void apply_modinfo_field(ModuleMetadata& meta, std::string_view key, std::string_view value) {
+    if (key == "version") {
+        meta.version = value;
+    } else if (key == "description") {
+        meta.description = value;
+    } else if (key == "license") {
+        meta.license = value;
+    } else if (key == "author") {
+        if (!meta.author.empty()) {
+            meta.author += ", ";
+        }
+        meta.author += value;
+    } else if (key == "srcversion") {
+        meta.srcversion = value;
+    } else if (key == "firmware") {
+        meta.firmware.emplace_back(value);
+    } else if (key == "depends") {
+        std::size_t pos = 0;
+        while (pos < value.size()) {
+            const std::size_t end = std::min(value.find(',', pos), value.size());
+            if (end > pos) {
+                common::InternTable& names = common::interned_names();
+                meta.depends.push_back(names.name(names.intern(value.substr(pos, end - pos))));
+            }
+            pos = end + 1;
+        }
+    }
+}
+
+// Parses a NUL-separated "key=value" table such as an ELF .modinfo section.
+void parse_modinfo_table(std::string_view table, ModuleMetadata& meta) {
+    std::size_t pos = 0;
+    while (pos < table.size()) {
+        const std::size_t end = std::min(table.find('\0', pos), table.size());
+        const std::string_view record = table.substr(pos, end - pos);
+        const std::size_t equals = record.find('=');
+        if (equals != std::string_view::npos) {
+            apply_modinfo_field(meta, record.substr(0, equals), record.substr(equals + 1));
+        }
+        pos = end + 1;
+    }
+}
+
+template <typename Ehdr, typename Shdr>
+std::string_view find_elf_section(std::string_view elf, std::string_view wanted) {
+    if (elf.size() < sizeof(Ehdr)) {
+        return {};
+    }
+    Ehdr header{};
+    std::memcpy(&header, elf.data(), sizeof(header));
+    if (header.e_shoff == 0 || header.e_shentsize != sizeof(Shdr) || header.e_shstrndx >= header.e_shnum ||
+        header.e_shoff + static_cast<std::uint64_t>(header.e_shnum) * sizeof(Shdr) > elf.size()) {
+        return {};
+    }
+
+    auto section = [&](std::size_t index) {
+        Shdr entry{};
+        std::memcpy(&entry, elf.data() + header.e_shoff + index * sizeof(Shdr), sizeof(entry));
+        return entry;
+    };
+    const Shdr names = section(header.e_shstrndx);
+    if (names.sh_offset + names.sh_size > elf.size()) {
+        return {};
+    }
+    const std::string_view name_table = elf.substr(names.sh_offset, names.sh_size);
+
+    for (std::size_t i = 0; i < header.e_shnum; ++i) {
+        const Shdr entry = section(i);
+        if (entry.sh_name >= name_table.size()) {
+            continue;
+        }
+        const std::string_view name = name_table.substr(entry.sh_name);
+        if (name.substr(0, name.find('\0')) != wanted) {
+            continue;
+        }
+        if (entry.sh_offset + entry.sh_size > elf.size()) {
+            return {};
+        }
+        return elf.substr(entry.sh_offset, entry.sh_size);
+    }
+    return {};
+}
+
+std::string_view find_modinfo_section(std::string_view elf) {
+    if (elf.size() < EI_NIDENT || elf.compare(0, SELFMAG, ELFMAG) != 0 || elf[EI_DATA] != ELFDATA2LSB) {
+        return {};
+    }
+    if (elf[EI_CLASS] == ELFCLASS64) {
+        return find_elf_section<Elf64_Ehdr, Elf64_Shdr>(elf, ".modinfo");
+    }
+    if (elf[EI_CLASS] == ELFCLASS32) {
+        return find_elf_section<Elf32_Ehdr, Elf32_Shdr>(elf, ".modinfo");
+    }
+    return {};
+}
+
+// Module file locations and decoded .modinfo tables for one kernel release.
+// Everything is loaded lazily and dropped when the running release changes.
+class ModinfoCache {
+public:
+    ModuleMetadata lookup(common::NameId id) {
+        const std::string_view name = common::interned_names().name(id);
+        std::lock_guard<std::mutex> lock(mutex_);
+        const std::string release = running_kernel_release();
+        if (release != release_) {
+            reset(release);
+        }
+
+        // Module files can be replaced without a kernel change (DKMS rebuilds),
+        // so cached entries are keyed on the file's mtime as well.
+        const auto path = paths_.find(std::string(name));
+        std::string filename;
+        struct stat st {};
+        if (path != paths_.end()) {
+            filename = modules_dir_ + "/" + path->second;
+            if (stat(filename.c_str(), &st) != 0) {
+                st = {};
+            }
+        }
+
+        if (const auto cached = metadata_.find(id);
+            cached != metadata_.end() && cached->second.mtime_sec == st.st_mtim.tv_sec &&
+            cached->second.mtime_nsec == st.st_mtim.tv_nsec) {
+            return cached->second.meta;
+        }
+
+        CachedModule entry;
+        entry.mtime_sec = st.st_mtim.tv_sec;
+        entry.mtime_nsec = st.st_mtim.tv_nsec;
+        if (const auto builtin = builtin_.find(std::string(name)); builtin != builtin_.end()) {
+            entry.meta = builtin->second;
+        }
+        if (!filename.empty()) {
+            entry.meta.filename = filename;
+            read_module_file(filename, entry.meta);
+        }
+        metadata_[id] = entry;
+        return entry.meta;
+    }
+
+private:
+    struct CachedModule {
+        ModuleMetadata meta;
+        long long mtime_sec = 0;
+        long long mtime_nsec = 0;
+    };
+
+    void reset(const std::string& release) {
+        release_ = release;
+        modules_dir_ = "/lib/modules/" + release;
+        paths_.clear();
+        builtin_.clear();
+        metadata_.clear();
+        load_module_paths();
+        load_builtin_modinfo();
+    }
+
+    void load_module_paths() {
+        const common::MappedFile dep(modules_dir_ + "/modules.dep");
+        const std::string_view text = dep.view();
+        std::size_t pos = 0;
+        while (pos < text.size()) {
+            const std::size_t end = std::min(text.find('\n', pos), text.size());
+            const std::string_view line = text.substr(pos, end - pos);
+            const std::size_t colon = line.find(':');
+            if (colon != std::string_view::npos) {
+                const std::string_view path = line.substr(0, colon);
+                const std::size_t slash = path.rfind('/');
+                const std::string_view file = slash == std::string_view::npos ? path : path.substr(slash + 1);
+                paths_.emplace(normalize_module_name(file), std::string(path));
+            }
+            pos = end + 1;
+        }
+    }
+
+    void load_builtin_modinfo() {
+        const common::MappedFile modinfo(modules_dir_ + "/modules.builtin.modinfo");
+        const std::string_view text = modinfo.view();
+        std::size_t pos = 0;
+        while (pos < text.size()) {
+            const std::size_t end = std::min(text.find('\0', pos), text.size());
+            const std::string_view record = text.substr(pos, end - pos);
+            const std::size_t dot = record.find('.');
+            const std::size_t equals = record.find('=');
+            if (dot != std::string_view::npos && equals != std::string_view::npos && dot < equals) {
+                auto& meta = builtin_[normalize_module_name(record.substr(0, dot))];
+                apply_modinfo_field(meta, record.substr(dot + 1, equals - dot - 1), record.substr(equals + 1));
+            }
+            pos = end + 1;
+        }
+    }
+
+    static void read_module_file(const std::string& path, ModuleMetadata& meta) {
+        const common::MappedFile file(path);
+        if (common::detect_compression(file.view()) == common::Compression::none) {
+            parse_modinfo_table(find_modinfo_section(file.view()), meta);
+            return;
+        }
+        std::string elf;
+        if (common::decompress_to_string(file.view(), elf)) {
+            parse_modinfo_table(find_modinfo_section(elf), meta);
+        }
+    }
+
+    std::mutex mutex_;
+    std::string release_;
+    std::string modules_dir_;
+    std::unordered_map<std::string, std::string> paths_;
+    std::unordered_map<std::string, ModuleMetadata> builtin_;
+    std::unordered_map<common::NameId, CachedModule> metadata_;
+};
+
+ModinfoCache& modinfo_cache() {
+    static ModinfoCache cache;
+    return cache;
+}
+
+// Interned names of the entries of `path`.
+std::vector<std::string_view> list_directory(const std::string& path) {
+    std::vector<std::string_view> entries;
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return entries;
+    }
+    common::InternTable& names = common::interned_names();
+    while (const dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            entries.push_back(names.name(names.intern(entry->d_name)));
+        }
+    }
+    closedir(dir);
+    std::sort(entries.begin(), entries.end());
+    return entries;
 }
 
 }
 
 std::vector<DriverInfo> list_drivers() {
     std::vector<DriverInfo> drivers;
-    
-    std::string lsmod_output = exec_command("lsmod 2>/dev/null");
-    
-    if (!lsmod_output.empty()) {
-        std::istringstream iss(lsmod_output);
-        std::string line;
-
-        std::getline(iss, line);
-        
-        while (std::getline(iss, line)) {
-            if (line.empty()) continue;
-            
-            std::istringstream line_stream(line);
-            std::string module_name, size, used_by;
-            
-            line_stream >> module_name >> size >> used_by;
-            
-            DriverInfo driver;
-            driver.name = module_name;
-            driver.version = "Unknown";
-            driver.description = "Kernel module";
-            driver.is_outdated = false;
-            driver.update_available = "Unknown";
-            
-            drivers.push_back(driver);
+
+    // name size refcount used-by state address [taint]
+    std::ifstream modules("/proc/modules");
+    std::string line;
+    while (std::getline(modules, line)) {
+        std::istringstream line_stream(line);
+        std::string module_name, used_by, state;
+        long long size = 0;
+        int refcount = 0;
+        if (!(line_stream >> module_name >> size >> refcount >> used_by >> state)) {
+            continue;
         }
-    }
 
-    if (drivers.empty()) {
+        common::InternTable& names = common::interned_names();
+        const std::string sysfs = "/sys/module/" + module_name;
         DriverInfo driver;
-        driver.name = "No drivers detected";
-        driver.version = "Unknown";
-        driver.description = "Unable to retrieve driver information";
-        driver.is_outdated = false;
-        driver.update_available = "Unknown";
-        drivers.push_back(driver);
-    }
-    
+        driver.name_id = names.intern(module_name);
+        driver.name = names.name(driver.name_id);
+        const ModuleMetadata meta = modinfo_cache().lookup(driver.name_id);
+
+        driver.size_bytes = size;
+        driver.state = state;
+        driver.refcount = refcount;
+        const std::string sysfs_refcount = read_sysfs_value(sysfs + "/refcnt");
+        if (!sysfs_refcount.empty()) {
+            driver.refcount = std::atoi(sysfs_refcount.c_str());
+        }
+
+        driver.holders = list_directory(sysfs + "/holders");
+        if (driver.holders.empty() && used_by != "-") {
+            std::istringstream holders(used_by);
+            std::string holder;
+            while (std::getline(holders, holder, ',')) {
+                if (!holder.empty()) {
+                    driver.holders.push_back(names.name(names.intern(holder)));
+                }
+            }
+        }
+
+        // The loaded copy is authoritative for version/srcversion; the file on
+        // disk tells us whether a newer build is waiting to be loaded.
+        driver.version = read_sysfs_value(sysfs + "/version");
+        driver.srcversion = read_sysfs_value(sysfs + "/srcversion");
+        if (driver.version.empty()) {
+            driver.version = meta.version;
+        }
+        if (driver.srcversion.empty()) {
+            driver.srcversion = meta.srcversion;
+        }
+        driver.description = meta.description;
+        driver.license = meta.license;
+        driver.author = meta.author;
+        driver.filename = meta.filename;
+        driver.depends = meta.depends;
+        driver.firmware = meta.firmware;
+
+        driver.is_outdated = !meta.srcversion.empty() && !driver.srcversion.empty() &&
+                             meta.srcversion != driver.srcversion;
+        if (driver.is_outdated) {
+            driver.update_available = meta.version.empty() ? meta.srcversion : meta.version;
+        }
+
+        drivers.push_back(std::move(driver));
+    }
+
+    std::sort(drivers.begin(), drivers.end(),
+              [](const DriverInfo& lhs, const DriverInfo& rhs) { return lhs.name < rhs.name; });
     return drivers;
 }
 
 std::string drivers_to_json(const std::vector<DriverInfo>& drivers) {
-    std::ostringstream json;
-    json << "[";
-    for (size_t i = 0; i < drivers.size(); ++i) {
-        if (i > 0) json << ",";
-        const auto& driver = drivers[i];
-        json << "{";
-        json << "\"name\":\"" << driver.name << "\",";
-        json << "\"version\":\"" << driver.version << "\",";
-        json << "\"description\":\"" << driver.description << "\",";
-        json << "\"is_outdated\":" << (driver.is_outdated ? "true" : "false") << ",";
-        json << "\"update_available\":\"" << driver.update_available << "\"";
-        json << "}";
-    }
-    json << "]";
-    return json.str();
+    return common::to_json_array(drivers);
 }
 
 bool backup_drivers(const std::string& output_file) {
-    std::string command = "lsmod > " + output_file + " 2>/dev/null";
-    int result = system(command.c_str());
-    return result == 0;
+    const auto drivers = list_drivers();
+    if (drivers.empty()) {
+        return false;
+    }
+
+    // Same layout as lsmod so existing restore scripts keep working.
+    std::ofstream out(output_file, std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    out << "Module                  Size  Used by\n";
+    for (const auto& driver : drivers) {
+        std::string holders;
+        for (const auto& holder : driver.holders) {
+            if (!holders.empty()) holders += ',';
+            holders += holder;
+        }
+        out << std::left << std::setw(19) << driver.name << ' ' << std::right << std::setw(8)
+            << driver.size_bytes << "  " << driver.refcount;
+        if (!holders.empty()) {
+            out << ' ' << holders;
+        }
+        out << '\n';
+    }
+    return static_cast<bool>(out);
 }
 
 bool update_driver(const std::string& driver_name) {
@@ -1,18 +1,61 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include "../common/fields.hpp"
+#include "../common/intern.hpp"
+
 namespace nanookjaro::drivers {
 
+// Module names (the driver's own, holders and dependencies) are views into
+// common::interned_names().
 struct DriverInfo {
-    std::string name;
+    common::NameId name_id = 0;
+    std::string_view name;
     std::string version;
     std::string description;
     bool is_outdated;
     std::string update_available;
+    std::string license;
+    std::string author;
+    std::string srcversion;
+    std::string filename;
+    std::string state;
+    long long size_bytes;
+    int refcount;
+    std::vector<std::string_view> holders;
+    std::vector<std::string_view> depends;
+    std::vector<std::string> firmware;
 };
 
+constexpr auto metric_fields(std::type_identity<DriverInfo>) {
+    return std::tuple{
+        common::Field{"name", &DriverInfo::name},
+        common::Field{"version", &DriverInfo::version},
+        common::Field{"description", &DriverInfo::description},
+        common::Field{"is_outdated", &DriverInfo::is_outdated},
+        common::Field{"update_available", &DriverInfo::update_available},
+        common::Field{"license", &DriverInfo::license},
+        common::Field{"author", &DriverInfo::author},
+        common::Field{"srcversion", &DriverInfo::srcversion},
+        common::Field{"filename", &DriverInfo::filename},
+        common::Field{"state", &DriverInfo::state},
+        common::Field{"size_bytes", &DriverInfo::size_bytes, "B"},
+        common::Field{"refcount", &DriverInfo::refcount},
+        common::Field{"holders", &DriverInfo::holders},
+        common::Field{"depends", &DriverInfo::depends},
+        common::Field{"firmware", &DriverInfo::firmware},
+    };
+}
+
+// Loaded kernel modules from /proc/modules and /sys/module, with descriptions,
+// licenses and firmware taken from the module files of the running kernel.
+// A module is reported as outdated when the file on disk no longer matches the
+// loaded copy (e.g. a DKMS rebuild that has not been reloaded yet).
 std::vector<DriverInfo> list_drivers();
 std::string drivers_to_json(const std::vector<DriverInfo>& drivers);
 bool backup_drivers(const std::string& output_file);
@@ -0,0 +1,381 @@
+#include "modalias_index.hpp"
+#include "../common/mapped_file.hpp"
+#include "../common/paths.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+namespace nanookjaro::drivers {
+
+namespace {
+
+std::string running_kernel_release() {
+    utsname info{};
+    if (uname(&info) != 0) {
+        return {};
+    }
+    return info.release;
+}
+
+// On-disk layout (host byte order): header, sorted entries, string pool.
+// Patterns and module names are NUL-terminated inside the pool so they can be
+// handed to fnmatch() straight from the mapping.
+constexpr char kIndexMagic[8] = {'N', 'J', 'A', 'L', 'I', 'A', 'S', '1'};
+
+struct IndexHeader {
+    char magic[8];
+    std::uint64_t source_signature;
+    std::uint32_t entry_count;
+    std::uint32_t pool_size;
+};
+
+struct IndexEntry {
+    std::uint32_t pattern;
+    std::uint32_t prefix_length;
+    std::uint32_t module;
+    std::uint32_t order;
+};
+
+constexpr const char* kAliasFiles[] = {"modules.alias", "modules.builtin.alias"};
+
+std::uint64_t source_signature(const std::string& modules_dir) {
+    std::uint64_t signature = 1469598103934665603ULL;
+    for (const char* name : kAliasFiles) {
+        struct stat st {};
+        if (stat((modules_dir + "/" + name).c_str(), &st) != 0) {
+            continue;
+        }
+        for (std::uint64_t value : {static_cast<std::uint64_t>(st.st_mtim.tv_sec),
+                                    static_cast<std::uint64_t>(st.st_mtim.tv_nsec),
+                                    static_cast<std::uint64_t>(st.st_size)}) {
+            signature = (signature ^ value) * 1099511628211ULL;
+        }
+    }
+    return signature;
+}
+
+// Literal characters before the first glob metacharacter.
+std::uint32_t literal_prefix_length(std::string_view pattern) {
+    const std::size_t wildcard = pattern.find_first_of("*?[\\");
+    return static_cast<std::uint32_t>(wildcard == std::string_view::npos ? pattern.size() : wildcard);
+}
+
+std::string build_index(const std::string& modules_dir, std::uint64_t signature) {
+    std::string pool;
+    std::vector<IndexEntry> entries;
+    std::unordered_map<std::string, std::uint32_t> module_offsets;
+    std::uint32_t order = 0;
+
+    for (const char* name : kAliasFiles) {
+        const common::MappedFile file(modules_dir + "/" + name);
+        const std::string_view text = file.view();
+        std::size_t pos = 0;
+        while (pos < text.size()) {
+            const std::size_t end = std::min(text.find('\n', pos), text.size());
+            std::string_view line = text.substr(pos, end - pos);
+            pos = end + 1;
+
+            // alias <pattern> <module>
+            if (line.rfind("alias ", 0) != 0) {
+                continue;
+            }
+            line.remove_prefix(6);
+            const std::size_t space = line.find(' ');
+            if (space == std::string_view::npos || space == 0 || space + 1 >= line.size()) {
+                continue;
+            }
+            const std::string_view pattern = line.substr(0, space);
+            const std::string module(line.substr(space + 1));
+
+            auto [module_it, inserted] = module_offsets.try_emplace(module, static_cast<std::uint32_t>(pool.size()));
+            if (inserted) {
+                pool.append(module).push_back('\0');
+            }
+
+            IndexEntry entry{};
+            entry.pattern = static_cast<std::uint32_t>(pool.size());
+            entry.prefix_length = literal_prefix_length(pattern);
+            entry.module = module_it->second;
+            entry.order = order++;
+            pool.append(pattern).push_back('\0');
+            entries.push_back(entry);
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [&pool](const IndexEntry& lhs, const IndexEntry& rhs) {
+        const std::string_view left(pool.data() + lhs.pattern, lhs.prefix_length);
+        const std::string_view right(pool.data() + rhs.pattern, rhs.prefix_length);
+        if (left != right) {
+            return left < right;
+        }
+        return lhs.order < rhs.order;
+    });
+
+    IndexHeader header{};
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.source_signature = signature;
+    header.entry_count = static_cast<std::uint32_t>(entries.size());
+    header.pool_size = static_cast<std::uint32_t>(pool.size());
+
+    std::string blob;
+    blob.reserve(sizeof(header) + entries.size() * sizeof(IndexEntry) + pool.size());
+    blob.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    blob.append(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexEntry));
+    blob.append(pool);
+    return blob;
+}
+
+// Read-only view over a serialized index, either mapped from the cache file
+// or held in memory when the cache directory is not writable.
+class AliasIndex {
+public:
+    static std::unique_ptr<AliasIndex> open(const std::string& release) {
+        const std::string modules_dir = "/lib/modules/" + release;
+        const std::uint64_t signature = source_signature(modules_dir);
+        auto index = std::make_unique<AliasIndex>();
+
+        const std::string cache_dir = common::cache_directory();
+        const std::string cache_path = cache_dir.empty() ? std::string() : cache_dir + "/modalias-" + release + ".idx";
+        if (!cache_path.empty()) {
+            index->mapped_ = common::MappedFile(cache_path);
+            if (index->attach(index->mapped_.view(), signature)) {
+                return index;
+            }
+            index->mapped_ = common::MappedFile();
+        }
+
+        index->owned_ = build_index(modules_dir, signature);
+        if (!cache_path.empty() && common::write_file_atomically(cache_path, index->owned_)) {
+            index->mapped_ = common::MappedFile(cache_path);
+            if (index->attach(index->mapped_.view(), signature)) {
+                index->owned_.clear();
+                index->owned_.shrink_to_fit();
+                return index;
+            }
+        }
+        index->attach(index->owned_, signature);
+        return index;
+    }
+
+    std::vector<std::string> lookup(const std::string& modalias) const {
+        std::vector<std::pair<std::uint32_t, std::string_view>> matches;
+        const std::string_view query(modalias);
+
+        for (const std::uint32_t length : prefix_lengths_) {
+            if (length > query.size()) {
+                break;
+            }
+            const std::string_view key = query.substr(0, length);
+            std::size_t low = 0;
+            std::size_t high = entry_count_;
+            while (low < high) {
+                const std::size_t mid = low + (high - low) / 2;
+                if (prefix(entry(mid)) < key) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+            for (std::size_t i = low; i < entry_count_; ++i) {
+                const IndexEntry candidate = entry(i);
+                if (prefix(candidate) != key) {
+                    break;
+                }
+                if (fnmatch(pool_ + candidate.pattern, modalias.c_str(), 0) == 0) {
+                    matches.emplace_back(candidate.order, std::string_view(pool_ + candidate.module));
+                }
+            }
+        }
+
+        std::sort(matches.begin(), matches.end());
+        std::vector<std::string> modules;
+        for (const auto& [order, module] : matches) {
+            if (std::find(modules.begin(), modules.end(), module) == modules.end()) {
+                modules.emplace_back(module);
+            }
+        }
+        return modules;
+    }
+
+    bool empty() const { return entry_count_ == 0; }
+
+private:
+    bool attach(std::string_view data, std::uint64_t signature) {
+        IndexHeader header{};
+        if (data.size() < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        const std::size_t expected =
+            sizeof(header) + static_cast<std::size_t>(header.entry_count) * sizeof(IndexEntry) + header.pool_size;
+        if (std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+            header.source_signature != signature || data.size() != expected) {
+            return false;
+        }
+
+        entries_ = data.data() + sizeof(header);
+        entry_count_ = header.entry_count;
+        pool_ = entries_ + entry_count_ * sizeof(IndexEntry);
+
+        prefix_lengths_.clear();
+        for (std::size_t i = 0; i < entry_count_; ++i) {
+            prefix_lengths_.push_back(entry(i).prefix_length);
+        }
+        std::sort(prefix_lengths_.begin(), prefix_lengths_.end());
+        prefix_lengths_.erase(std::unique(prefix_lengths_.begin(), prefix_lengths_.end()), prefix_lengths_.end());
+        return true;
+    }
+
+    IndexEntry entry(std::size_t index) const {
+        IndexEntry value{};
+        std::memcpy(&value, entries_ + index * sizeof(IndexEntry), sizeof(value));
+        return value;
+    }
+
+    std::string_view prefix(const IndexEntry& value) const {
+        return {pool_ + value.pattern, value.prefix_length};
+    }
+
+    common::MappedFile mapped_;
+    std::string owned_;
+    const char* entries_ = nullptr;
+    const char* pool_ = nullptr;
+    std::size_t entry_count_ = 0;
+    std::vector<std::uint32_t> prefix_lengths_;
+};
+
+std::mutex index_mutex;
+std::string index_release;
+std::unique_ptr<AliasIndex> alias_index;
+
+const AliasIndex& current_index() {
+    const std::string release = running_kernel_release();
+    if (!alias_index || release != index_release) {
+        alias_index = AliasIndex::open(release);
+        index_release = release;
+    }
+    return *alias_index;
+}
+
+std::string read_first_line(const std::string& path) {
+    std::ifstream file(path);
+    std::string value;
+    std::getline(file, value);
+    return value;
+}
+
+std::string link_basename(const std::string& path) {
+    char buffer[4096];
+    const ssize_t length = readlink(path.c_str(), buffer, sizeof(buffer) - 1);
+    if (length <= 0) {
+        return {};
+    }
+    const std::string_view target(buffer, static_cast<std::size_t>(length));
+    const std::size_t slash = target.rfind('/');
+    return std::string(slash == std::string_view::npos ? target : target.substr(slash + 1));
+}
+
+std::vector<std::string> list_directory(const std::string& path) {
+    std::vector<std::string> entries;
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return entries;
+    }
+    while (const dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            entries.emplace_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(entries.begin(), entries.end());
+    return entries;
+}
+
+}
+
+std::vector<std::string> modules_for_alias(const std::string& modalias) {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    return current_index().lookup(modalias);
+}
+
+std::vector<DeviceDriverStatus> resolve_device_drivers() {
+    std::vector<DeviceDriverStatus> devices;
+    std::lock_guard<std::mutex> lock(index_mutex);
+    const AliasIndex& index = current_index();
+
+    for (const auto& bus : list_directory("/sys/bus")) {
+        const std::string devices_dir = "/sys/bus/" + bus + "/devices";
+        for (const auto& device : list_directory(devices_dir)) {
+            const std::string sysfs_path = devices_dir + "/" + device;
+            const std::string modalias = read_first_line(sysfs_path + "/modalias");
+            if (modalias.empty()) {
+                continue;
+            }
+
+            DeviceDriverStatus status;
+            status.sysfs_path = sysfs_path;
+            status.bus = bus;
+            status.modalias = modalias;
+            status.bound_driver = link_basename(sysfs_path + "/driver");
+            if (!status.bound_driver.empty()) {
+                status.bound_module = link_basename(sysfs_path + "/driver/module");
+            }
+            status.candidate_modules = index.lookup(modalias);
+
+            if (!status.bound_driver.empty()) {
+                status.status = "bound";
+            } else if (index.empty()) {
+                status.status = "unknown";
+            } else if (!status.candidate_modules.empty()) {
+                status.status = "unbound";
+            } else {
+                status.status = "missing";
+            }
+            devices.push_back(std::move(status));
+        }
+    }
+    return devices;
+}
+
+std::string device_drivers_to_json(const std::vector<DeviceDriverStatus>& devices) {
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (i > 0) json << ",";
+        const auto& device = devices[i];
+        json << "{";
+        json << "\"sysfs_path\":\"" << common::escape_json(device.sysfs_path) << "\",";
+        json << "\"bus\":\"" << common::escape_json(device.bus) << "\",";
+        json << "\"modalias\":\"" << common::escape_json(device.modalias) << "\",";
+        json << "\"bound_driver\":\"" << common::escape_json(device.bound_driver) << "\",";
+        json << "\"bound_module\":\"" << common::escape_json(device.bound_module) << "\",";
+        json << "\"candidate_modules\":[";
+        for (size_t j = 0; j < device.candidate_modules.size(); ++j) {
+            if (j > 0) json << ",";
+            json << "\"" << common::escape_json(device.candidate_modules[j]) << "\"";
+        }
+        json << "],";
+        json << "\"status\":\"" << device.status << "\"";
+        json << "}";
+    }
+    json << "]";
+    return json.str();
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace nanookjaro::drivers {
+
+struct DeviceDriverStatus {
+    std::string sysfs_path;
+    std::string bus;
+    std::string modalias;
+    std::string bound_driver;
+    std::string bound_module;
+    std::vector<std::string> candidate_modules;
+    // "bound", "unbound" (a module matches but no driver is attached) or
+    // "missing" (nothing in modules.alias matches the device). "unknown" when
+    // no alias database is available for the running kernel.
+    std::string status;
+};
+
+// Modules whose modules.alias patterns match `modalias`, in alias file order
+// without duplicates. The alias index is built once per kernel release and
+// persisted in the user cache directory.
+std::vector<std::string> modules_for_alias(const std::string& modalias);
+
+// Walks /sys/bus/*/devices/* and resolves every device exposing a modalias.
+std::vector<DeviceDriverStatus> resolve_device_drivers();
+std::string device_drivers_to_json(const std::vector<DeviceDriverStatus>& devices);
+
+}
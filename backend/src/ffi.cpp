@@ -1,11 +1,18 @@
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "nanookjaro/export.hpp"
 #include "./system/system_summary.hpp"
 #include "./hardware/disk_monitor.hpp"
 #include "./performance/performance_monitor.hpp"
 #include "./network/network_monitor.hpp"
+#include "./maintenance/package_manager.hpp"
+#include "./maintenance/job_manager.hpp"
+#include "./system/metrics_sampler.hpp"
+#include "./system/summary_delta.hpp"
 
 const char* duplicate_as_c_string(const std::string& source) {
     const size_t len = source.length();
@@ -22,6 +29,43 @@ const char* error_response() {
     return duplicate_as_c_string(R"({"error": "internal_error"})");
 }
 
+namespace {
+
+// Mirror of Dart_CObject from dart_native_api.h, limited to what is posted
+// here. The Dart side hands over NativeApi.postCObject, so no Dart SDK
+// headers are needed to build the library.
+struct DartCObject {
+    std::int32_t type;
+    union {
+        const char* as_string;
+        std::int64_t as_int64;
+        void* reserved[5];
+    } value;
+};
+constexpr std::int32_t kDartCObjectString = 5;
+using DartPostCObject = bool (*)(std::int64_t port, DartCObject* message);
+
+std::atomic<DartPostCObject> dart_post_cobject{nullptr};
+
+// Posting copies the message, so `json` may go away right after.
+void post_to_dart_port(std::int64_t, const char* json, void* user_data) {
+    const DartPostCObject post = dart_post_cobject.load();
+    if (post == nullptr) {
+        return;
+    }
+    DartCObject message{};
+    message.type = kDartCObjectString;
+    message.value.as_string = json;
+    post(static_cast<std::int64_t>(reinterpret_cast<std::intptr_t>(user_data)), &message);
+}
+
+// 0 selects refresh_interval from nanookjaro.conf.
+unsigned subscription_interval(int interval_ms) {
+    return interval_ms > 0 ? static_cast<unsigned>(interval_ms) : 0;
+}
+
+}
+
 extern "C" {
 
 NANOOKJARO_API const char* nj_get_system_summary() {
@@ -33,6 +77,15 @@ NANOOKJARO_API const char* nj_get_system_summary() {
     }
 }
 
+NANOOKJARO_API const char* nj_get_summary_since(unsigned long long seq) {
+    try {
+        std::string payload = nanookjaro::summary_since_json(seq);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
 NANOOKJARO_API void nj_free_string(const char* str) {
     free(const_cast<char*>(str));
 }
@@ -84,6 +137,47 @@ NANOOKJARO_API const char* nj_get_disk_info() {
     }
 }
 
+NANOOKJARO_API const char* nj_analyze_disk_usage(const char* path, int top_n) {
+    try {
+        std::string payload = nanookjaro::disk_usage_json(path ? path : "/", top_n > 0 ? static_cast<std::size_t>(top_n) : 0);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_disk_usage_owners(const char* path, int top_n) {
+    try {
+        std::string payload =
+            nanookjaro::disk_usage_owners_json(path ? path : "/", top_n > 0 ? static_cast<std::size_t>(top_n) : 0);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_disk_usage_index(const char* path, int top_n, int rebuild) {
+    try {
+        std::string payload = nanookjaro::disk_usage_index_json(path ? path : "/",
+                                                                top_n > 0 ? static_cast<std::size_t>(top_n) : 0,
+                                                                rebuild != 0);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_find_duplicates(const char* path, int max_groups, long long min_size) {
+    try {
+        std::string payload = nanookjaro::duplicates_json(path ? path : "/",
+                                                          max_groups > 0 ? static_cast<std::size_t>(max_groups) : 0,
+                                                          min_size > 0 ? static_cast<unsigned long long>(min_size) : 0);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
 NANOOKJARO_API const char* nj_get_network_info() {
     try {
         std::string payload = nanookjaro::network_info_json();
@@ -102,4 +196,225 @@ NANOOKJARO_API const char* nj_get_drivers_info() {
     }
 }
 
+NANOOKJARO_API const char* nj_get_device_drivers() {
+    try {
+        std::string payload = nanookjaro::device_drivers_json();
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_pacman_sync_upgrade(int assume_yes) {
+    try {
+        std::string payload = nanookjaro::package_manager::pacman_sync_upgrade_json(assume_yes != 0);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_pacman_install_packages_json(const char** packages, int count, int assume_yes) {
+    try {
+        std::vector<std::string> names;
+        for (int i = 0; packages != nullptr && i < count; ++i) {
+            if (packages[i] != nullptr) {
+                names.emplace_back(packages[i]);
+            }
+        }
+        std::string payload = nanookjaro::package_manager::pacman_install_packages_json(names, assume_yes != 0);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_pacman_list_updates() {
+    try {
+        std::string payload = nanookjaro::package_manager::pacman_list_updates_json();
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_pacman_local_packages() {
+    try {
+        std::string payload = nanookjaro::package_manager::pacman_local_packages_json();
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_pacman_package_cache(int keep_versions, int keep_uninstalled, int prune,
+                                                  int remove_partials) {
+    try {
+        std::string payload = nanookjaro::package_manager::pacman_package_cache_json(
+            keep_versions >= 0 ? static_cast<std::size_t>(keep_versions) : 3,
+            keep_uninstalled >= 0 ? static_cast<std::size_t>(keep_uninstalled) : 0, prune != 0, remove_partials != 0);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_pacman_dependency_graph(const char* package) {
+    try {
+        std::string payload = nanookjaro::package_manager::pacman_dependency_graph_json(package ? package : "");
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_pacman_file_owners(const char** paths, int count) {
+    try {
+        std::vector<std::string> queries;
+        for (int i = 0; paths != nullptr && i < count; ++i) {
+            if (paths[i] != nullptr) {
+                queries.emplace_back(paths[i]);
+            }
+        }
+        std::string payload = nanookjaro::package_manager::pacman_file_owners_json(queries);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_pacman_search(const char* query, int limit) {
+    try {
+        const std::size_t max_results = limit > 0 ? static_cast<std::size_t>(limit) : 50;
+        std::string payload = nanookjaro::package_manager::pacman_search_json(query ? query : "", max_results);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_pacman_history(const char* package, long long since, int limit) {
+    try {
+        const std::size_t max_entries = limit > 0 ? static_cast<std::size_t>(limit) : 20;
+        std::string payload =
+            nanookjaro::package_manager::pacman_history_json(package ? package : "", since, max_entries);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_pacman_verify(const char** packages, int count) {
+    try {
+        std::vector<std::string> names;
+        for (int i = 0; packages != nullptr && i < count; ++i) {
+            if (packages[i] != nullptr) {
+                names.emplace_back(packages[i]);
+            }
+        }
+        std::string payload = nanookjaro::package_manager::pacman_verify_json(names);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API const char* nj_get_cgroup_info(int limit) {
+    try {
+        std::string payload = nanookjaro::cgroups_info_json(limit > 0 ? static_cast<std::size_t>(limit) : 0);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API long long nj_job_start(const char* kind, const char** args, int count) {
+    try {
+        std::vector<std::string> arguments;
+        for (int i = 0; args != nullptr && i < count; ++i) {
+            if (args[i] != nullptr) {
+                arguments.emplace_back(args[i]);
+            }
+        }
+        std::string error;
+        return nanookjaro::package_manager::start_pacman_job(kind ? kind : "", arguments, error);
+    } catch (...) {
+        return -1;
+    }
+}
+
+NANOOKJARO_API const char* nj_job_poll(long long id, unsigned long long after_seq, int max_lines) {
+    try {
+        std::string payload = nanookjaro::jobs::poll_job_json(
+            id, after_seq, max_lines > 0 ? static_cast<std::size_t>(max_lines) : 0);
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
+NANOOKJARO_API int nj_job_set_callback(long long id, nanookjaro::jobs::LineCallback callback, void* user_data) {
+    return nanookjaro::jobs::set_line_callback(id, callback, user_data) ? 1 : 0;
+}
+
+NANOOKJARO_API int nj_job_cancel(long long id) {
+    return nanookjaro::jobs::cancel_job(id) ? 1 : 0;
+}
+
+NANOOKJARO_API int nj_job_release(long long id) {
+    return nanookjaro::jobs::release_job(id) ? 1 : 0;
+}
+
+NANOOKJARO_API long long nj_subscribe(unsigned int mask, int interval_ms, nanookjaro::metrics::MetricsCallback callback,
+                                     void* user_data) {
+    try {
+        return nanookjaro::metrics::subscribe(mask, subscription_interval(interval_ms), callback, user_data);
+    } catch (...) {
+        return -1;
+    }
+}
+
+NANOOKJARO_API void nj_set_dart_post_cobject(void* post_cobject) {
+    dart_post_cobject.store(reinterpret_cast<DartPostCObject>(post_cobject));
+}
+
+NANOOKJARO_API long long nj_subscribe_port(unsigned int mask, int interval_ms, long long port) {
+    if (dart_post_cobject.load() == nullptr) {
+        return -1;
+    }
+    try {
+        return nanookjaro::metrics::subscribe(mask, subscription_interval(interval_ms), post_to_dart_port,
+                                              reinterpret_cast<void*>(static_cast<std::intptr_t>(port)));
+    } catch (...) {
+        return -1;
+    }
+}
+
+NANOOKJARO_API int nj_unsubscribe(long long id) {
+    return nanookjaro::metrics::unsubscribe(id) ? 1 : 0;
+}
+
+NANOOKJARO_API void nj_set_sampler_stealth(int enabled) {
+    try {
+        nanookjaro::metrics::set_stealth_mode(enabled != 0);
+    } catch (...) {
+    }
+}
+
+NANOOKJARO_API void nj_set_visibility(int visible) {
+    try {
+        nanookjaro::metrics::set_visibility(visible != 0);
+    } catch (...) {
+    }
+}
+
+NANOOKJARO_API const char* nj_get_collectors() {
+    try {
+        std::string payload = nanookjaro::metrics::collectors_json();
+        return duplicate_as_c_string(payload);
+    } catch (...) {
+        return error_response();
+    }
+}
+
 }
@@ -2,7 +2,6 @@
 #include <fstream>
 #include <sstream>
 #include <string>
-#include <iomanip>
 #include <algorithm>
 #include <unistd.h>
 
@@ -142,30 +141,11 @@ CpuUsage get_cpu_usage() {
 }
 
 std::string cpu_info_to_json(const CpuInfo& info) {
-    std::ostringstream json;
-    json << "{";
-    json << "\"model\":\"" << info.model << "\",";
-    json << "\"cores\":" << info.cores << ",";
-    json << "\"threads\":" << info.threads << ",";
-    json << "\"base_frequency_ghz\":" << std::fixed << std::setprecision(2) << info.base_frequency_ghz << ",";
-    json << "\"current_frequency_ghz\":" << std::fixed << std::setprecision(2) << info.current_frequency_ghz << ",";
-    json << "\"temperature_celsius\":" << std::fixed << std::setprecision(2) << info.temperature_celsius << ",";
-    json << "\"cache_l1_kb\":" << info.cache_l1_kb << ",";
-    json << "\"cache_l2_kb\":" << info.cache_l2_kb << ",";
-    json << "\"cache_l3_kb\":" << info.cache_l3_kb;
-    json << "}";
-    return json.str();
+    return common::to_json(info);
 }
 
 std::string cpu_usage_to_json(const CpuUsage& usage) {
-    std::ostringstream json;
-    json << "{";
-    json << "\"user_percent\":" << std::fixed << std::setprecision(2) << usage.user_percent << ",";
-    json << "\"system_percent\":" << std::fixed << std::setprecision(2) << usage.system_percent << ",";
-    json << "\"idle_percent\":" << std::fixed << std::setprecision(2) << usage.idle_percent << ",";
-    json << "\"iowait_percent\":" << std::fixed << std::setprecision(2) << usage.iowait_percent;
-    json << "}";
-    return json.str();
+    return common::to_json(usage);
 }
 
 }
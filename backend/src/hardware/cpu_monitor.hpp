@@ -1,6 +1,10 @@
 #pragma once
 
 #include <string>
+#include <tuple>
+#include <type_traits>
+
+#include "../common/fields.hpp"
 
 namespace nanookjaro::hardware::cpu {
 
@@ -23,6 +27,29 @@ struct CpuUsage {
     double iowait_percent;
 };
 
+constexpr auto metric_fields(std::type_identity<CpuInfo>) {
+    return std::tuple{
+        common::Field{"model", &CpuInfo::model},
+        common::Field{"cores", &CpuInfo::cores},
+        common::Field{"threads", &CpuInfo::threads},
+        common::Field{"base_frequency_ghz", &CpuInfo::base_frequency_ghz, "GHz"},
+        common::Field{"current_frequency_ghz", &CpuInfo::current_frequency_ghz, "GHz"},
+        common::Field{"temperature_celsius", &CpuInfo::temperature_celsius, "°C"},
+        common::Field{"cache_l1_kb", &CpuInfo::cache_l1_kb, "KiB"},
+        common::Field{"cache_l2_kb", &CpuInfo::cache_l2_kb, "KiB"},
+        common::Field{"cache_l3_kb", &CpuInfo::cache_l3_kb, "KiB"},
+    };
+}
+
+constexpr auto metric_fields(std::type_identity<CpuUsage>) {
+    return std::tuple{
+        common::Field{"user_percent", &CpuUsage::user_percent, "%"},
+        common::Field{"system_percent", &CpuUsage::system_percent, "%"},
+        common::Field{"idle_percent", &CpuUsage::idle_percent, "%"},
+        common::Field{"iowait_percent", &CpuUsage::iowait_percent, "%"},
+    };
+}
+
 CpuInfo get_cpu_info();
 CpuUsage get_cpu_usage();
 std::string cpu_info_to_json(const CpuInfo& info);
@@ -1,7 +1,10 @@
 #include "disk_monitor.hpp"
+#include "../common/intern.hpp"
+#include "../common/scratch.hpp"
+#include "../common/subprocess.hpp"
 #include <vector>
 #include <string>
-#include <fstream>
+#include <string_view>
 #include <sstream>
 #include <iomanip>
 #include <sys/statvfs.h>
@@ -10,47 +13,97 @@
 #include <algorithm>
 #include <map>
 #include <queue>
+#include <cstdlib>
 #include <cstring>
 
 namespace nanookjaro::hardware::disk {
 
 namespace {
-    
-std::vector<std::string> get_mounted_filesystems() {
-    std::vector<std::string> mounts;
-    std::ifstream file("/proc/mounts");
-    std::string line;
-    
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string device, mount_point, fstype;
-        
-        if (iss >> device >> mount_point >> fstype) {
-            if (device.substr(0, 5) == "/dev/" && 
-                fstype != "tmpfs" && 
-                fstype != "devtmpfs" && 
-                fstype != "sysfs" && 
-                fstype != "proc" && 
-                fstype != "devpts") {
-                mounts.push_back(mount_point);
+
+// Value text following `"key":` after position `from` in smartctl's JSON.
+std::string json_value_after(const std::string& json, const std::string& key, std::size_t from = 0) {
+    const std::size_t at = json.find("\"" + key + "\":", from);
+    if (at == std::string::npos) {
+        return {};
+    }
+    std::size_t begin = at + key.size() + 3;
+    while (begin < json.size() && json[begin] == ' ') {
+        ++begin;
+    }
+    if (begin < json.size() && json[begin] == '"') {
+        const std::size_t end = json.find('"', begin + 1);
+        return end == std::string::npos ? std::string{} : json.substr(begin + 1, end - begin - 1);
+    }
+    const std::size_t end = json.find_first_of(",}\n", begin);
+    return json.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
+bool is_smart_candidate(const std::string& name) {
+    for (const char* prefix : {"loop", "ram", "zram", "dm-", "sr", "md", "nbd", "fd"}) {
+        if (name.rfind(prefix, 0) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Interned mount points of block-device filesystems, straight from
+// /proc/mounts (octal escapes such as \\040 left as they are).
+std::pmr::vector<common::NameId> get_mounted_filesystems(std::pmr::memory_resource* memory) {
+    std::pmr::vector<common::NameId> mounts(memory);
+    std::pmr::string contents(memory);
+    common::read_file("/proc/mounts", contents);
+
+    std::string_view rest = contents;
+    while (!rest.empty()) {
+        const std::size_t end = rest.find('\n');
+        std::string_view line = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+
+        std::string_view fields[3];
+        std::size_t count = 0;
+        std::size_t pos = 0;
+        while (count < 3) {
+            pos = line.find_first_not_of(" \t", pos);
+            if (pos == std::string_view::npos) {
+                break;
             }
+            const std::size_t field_end = std::min(line.find_first_of(" \t", pos), line.size());
+            fields[count++] = line.substr(pos, field_end - pos);
+            pos = field_end;
+        }
+        if (count < 3) {
+            continue;
+        }
+        const std::string_view device = fields[0];
+        const std::string_view fstype = fields[2];
+        if (device.substr(0, 5) == "/dev/" &&
+            fstype != "tmpfs" &&
+            fstype != "devtmpfs" &&
+            fstype != "sysfs" &&
+            fstype != "proc" &&
+            fstype != "devpts") {
+            mounts.push_back(common::interned_names().intern(fields[1]));
         }
     }
-    
+
     return mounts;
 }
 
 }
 
-std::vector<DiskInfo> get_disk_info() {
-    std::vector<DiskInfo> disks;
-    auto mount_points = get_mounted_filesystems();
+std::pmr::vector<DiskInfo> get_disk_info(std::pmr::memory_resource* memory) {
+    std::pmr::vector<DiskInfo> disks(memory);
+    auto mount_points = get_mounted_filesystems(memory);
     
-    for (const auto& mount_point : mount_points) {
+    for (const common::NameId mount_id : mount_points) {
+        const std::string_view mount_point = common::interned_names().name(mount_id);
         struct statvfs buf;
-        if (statvfs(mount_point.c_str(), &buf) == 0) {
-            DiskInfo disk;
+        // Interned names are NUL-terminated.
+        if (statvfs(mount_point.data(), &buf) == 0) {
+            DiskInfo disk(memory);
             disk.device = "Unknown";
+            disk.mount_id = mount_id;
             disk.mount_point = mount_point;
             const unsigned long long block_size = buf.f_frsize;
             const unsigned long long total_bytes = static_cast<unsigned long long>(buf.f_blocks) * block_size;
@@ -64,28 +117,75 @@ std::vector<DiskInfo> get_disk_info() {
             disk.write_rate_kbps = 0.0; // wait to implement rate calculation if needed
             disk.smart_status = "Unknown"; // wait to implement SMART status reading if needed
             
-            disks.push_back(disk);
+            disks.push_back(std::move(disk));
         }
     }
     
     return disks;
 }
 
-std::string disk_info_to_json(const std::vector<DiskInfo>& disks) {
+std::string disk_info_to_json(const std::pmr::vector<DiskInfo>& disks) {
+    return common::to_json_array(disks);
+}
+
+std::vector<DiskHealth> get_disk_health(bool& available) {
+    available = true;
+    std::vector<DiskHealth> disks;
+    DIR* dir = opendir("/sys/block");
+    if (dir == nullptr) {
+        return disks;
+    }
+    std::vector<std::string> names;
+    while (const dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name[0] != '.' && is_smart_candidate(name)) {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+
+    common::SubprocessOptions options;
+    options.timeout = std::chrono::seconds(15);
+    for (const auto& name : names) {
+        const auto result = common::run_subprocess({"smartctl", "--json", "-i", "-H", "-A", "/dev/" + name}, options);
+        if (!result.started || result.exit_code == 127) {
+            available = false;
+            return {};
+        }
+        const std::size_t status = result.out.find("\"smart_status\"");
+        if (status == std::string::npos) {
+            continue;
+        }
+        DiskHealth disk;
+        disk.device = name;
+        disk.model = json_value_after(result.out, "model_name");
+        disk.passed = json_value_after(result.out, "passed", status) == "true";
+        const std::size_t temperature = result.out.find("\"temperature\":");
+        if (temperature != std::string::npos) {
+            disk.temperature_c = std::atoi(json_value_after(result.out, "current", temperature).c_str());
+        }
+        const std::size_t power_on = result.out.find("\"power_on_time\":");
+        if (power_on != std::string::npos) {
+            disk.power_on_hours = std::atoll(json_value_after(result.out, "hours", power_on).c_str());
+        }
+        disks.push_back(std::move(disk));
+    }
+    return disks;
+}
+
+std::string disk_health_to_json(const std::vector<DiskHealth>& disks) {
     std::ostringstream json;
     json << "[";
     for (size_t i = 0; i < disks.size(); ++i) {
         if (i > 0) json << ",";
         const auto& disk = disks[i];
         json << "{";
-        json << "\"device\":\"" << disk.device << "\",";
-        json << "\"mount_point\":\"" << disk.mount_point << "\",";
-        json << "\"total_gb\":" << disk.total_gb << ",";
-        json << "\"used_gb\":" << disk.used_gb << ",";
-        json << "\"available_gb\":" << disk.available_gb << ",";
-        json << "\"read_rate_kbps\":" << std::fixed << std::setprecision(2) << disk.read_rate_kbps << ",";
-        json << "\"write_rate_kbps\":" << std::fixed << std::setprecision(2) << disk.write_rate_kbps << ",";
-        json << "\"smart_status\":\"" << disk.smart_status << "\"";
+        json << "\"device\":\"" << common::escape_json(disk.device) << "\",";
+        json << "\"model\":\"" << common::escape_json(disk.model) << "\",";
+        json << "\"passed\":" << (disk.passed ? "true" : "false") << ",";
+        json << "\"temperature_c\":" << disk.temperature_c << ",";
+        json << "\"power_on_hours\":" << disk.power_on_hours;
         json << "}";
     }
     json << "]";
@@ -1,22 +1,62 @@
 #pragma once
 
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include "../common/fields.hpp"
+#include "../common/intern.hpp"
+
 namespace nanookjaro::hardware::disk {
 
     struct DiskInfo {
-        std::string device;
-        std::string mount_point;
+        explicit DiskInfo(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+            : device(memory), smart_status(memory) {}
+
+        std::pmr::string device;
+        common::NameId mount_id = 0;
+        std::string_view mount_point;  // from common::interned_names()
         long long total_gb;
         long long used_gb;
         long long available_gb;
         double read_rate_kbps;
         double write_rate_kbps;
-        std::string smart_status;
+        std::pmr::string smart_status;
+    };
+
+    constexpr auto metric_fields(std::type_identity<DiskInfo>) {
+        return std::tuple{
+            common::Field{"device", &DiskInfo::device},
+            common::Field{"mount_point", &DiskInfo::mount_point},
+            common::Field{"total_gb", &DiskInfo::total_gb, "GiB"},
+            common::Field{"used_gb", &DiskInfo::used_gb, "GiB"},
+            common::Field{"available_gb", &DiskInfo::available_gb, "GiB"},
+            common::Field{"read_rate_kbps", &DiskInfo::read_rate_kbps, "kB/s"},
+            common::Field{"write_rate_kbps", &DiskInfo::write_rate_kbps, "kB/s"},
+            common::Field{"smart_status", &DiskInfo::smart_status},
+        };
+    }
+
+    // Usage of every mounted block-device filesystem. The vector, its
+    // strings and all temporaries come from `memory`.
+    std::pmr::vector<DiskInfo> get_disk_info(std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+    std::string disk_info_to_json(const std::pmr::vector<DiskInfo>& disks);
+
+    struct DiskHealth {
+        std::string device;
+        std::string model;
+        bool passed = false;
+        int temperature_c = -1;        // -1 when not reported
+        long long power_on_hours = -1;
     };
 
-    std::vector<DiskInfo> get_disk_info();
-    std::string disk_info_to_json(const std::vector<DiskInfo>& disks);
+    // SMART overall health of each whole disk, from `smartctl --json`.
+    // `available` is false when smartctl is not installed; disks it cannot
+    // query (virtual disks, missing permissions) are left out.
+    std::vector<DiskHealth> get_disk_health(bool& available);
+    std::string disk_health_to_json(const std::vector<DiskHealth>& disks);
 
 }
@@ -0,0 +1,463 @@
+#include "disk_usage.hpp"
+#include "../common/directory_entries.hpp"
+#include "../common/work_stealing.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanookjaro::hardware::disk {
+
+namespace {
+
+constexpr std::size_t kInodeShards = 64;
+
+struct DirNode {
+    DirNode* parent = nullptr;
+    std::string name;
+    std::uint32_t depth = 0;
+    std::uint32_t index = 0;  // position in the flattened tree
+    std::uint64_t inode = 0;
+    std::int64_t mtime_ns = 0;
+    unsigned long long own_bytes = 0;  // the directory itself plus files directly inside
+    unsigned long long total_bytes = 0;
+    unsigned long long apparent_bytes = 0;
+    unsigned long long files = 0;
+    unsigned long long largest_file_bytes = 0;
+    std::string largest_file_name;
+};
+
+// An open directory, closed once the last child task has opened itself
+// relative to it.
+struct DirHandle {
+    explicit DirHandle(int descriptor) : fd(descriptor) {}
+    DirHandle(const DirHandle&) = delete;
+    DirHandle& operator=(const DirHandle&) = delete;
+    ~DirHandle() { close(fd); }
+    int fd;
+};
+
+struct DirTask {
+    DirNode* node = nullptr;
+    std::shared_ptr<const DirHandle> parent;  // null for the root
+    std::string path;                         // for reporting only
+};
+
+using FileHeap = std::vector<std::pair<unsigned long long, std::string>>;
+
+// Per-thread state; merged once the walk is over, so the hot path takes no
+// locks apart from the hard-link set.
+struct WorkerState {
+    std::deque<DirNode> nodes;
+    FileHeap largest_files;  // min-heap on size
+    std::vector<char> buffer;
+    unsigned long long apparent_bytes = 0;
+    unsigned long long files = 0;
+    unsigned long long directories = 0;
+    unsigned long long inodes = 0;
+    unsigned long long hardlinks_skipped = 0;
+    unsigned long long other_devices_skipped = 0;
+    unsigned long long errors = 0;
+};
+
+// Inodes with more than one link seen so far, with the directory that
+// counted them. The walk never leaves the root device, so the inode number
+// alone identifies a file.
+class LinkedInodes {
+public:
+    bool first_sighting(ino_t inode, const DirNode* owner) {
+        Shard& shard = shards_[std::hash<ino_t>{}(inode) % kInodeShards];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.owners.emplace(inode, owner).second;
+    }
+
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for (const auto& shard : shards_) {
+            for (const auto& [inode, owner] : shard.owners) {
+                fn(inode, owner);
+            }
+        }
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<ino_t, const DirNode*> owners;
+    };
+    std::array<Shard, kInodeShards> shards_;
+};
+
+std::int64_t mtime_ns(const struct stat& st) {
+    return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+std::string join_path(const std::string& directory, std::string_view name) {
+    std::string path;
+    path.reserve(directory.size() + name.size() + 1);
+    path.append(directory);
+    if (path.empty() || path.back() != '/') {
+        path.push_back('/');
+    }
+    path.append(name);
+    return path;
+}
+
+bool heap_greater(const std::pair<unsigned long long, std::string>& lhs,
+                  const std::pair<unsigned long long, std::string>& rhs) {
+    return lhs.first > rhs.first;
+}
+
+void offer_file(FileHeap& heap, std::size_t limit, unsigned long long bytes, const std::string& dir_path,
+                const char* name) {
+    if (limit == 0 || (heap.size() >= limit && bytes <= heap.front().first)) {
+        return;
+    }
+    std::string path = join_path(dir_path, name);
+    if (heap.size() >= limit) {
+        std::pop_heap(heap.begin(), heap.end(), heap_greater);
+        heap.pop_back();
+    }
+    heap.emplace_back(bytes, std::move(path));
+    std::push_heap(heap.begin(), heap.end(), heap_greater);
+}
+
+// Subdirectories are opened relative to their parent's descriptor, so path
+// length does not matter and no component above the leaf is looked up again.
+void scan_directory(DirTask& task, WorkerState& state, dev_t device, LinkedInodes& links,
+                    const DiskUsageOptions& options, const std::function<void(DirTask)>& push) {
+    constexpr int kFlags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    DirNode& node = *task.node;
+    const int fd = task.parent ? openat(task.parent->fd, node.name.c_str(), kFlags) : open(task.path.c_str(), kFlags);
+    task.parent.reset();
+    if (fd < 0) {
+        ++state.errors;
+        return;
+    }
+    const auto self = std::make_shared<const DirHandle>(fd);
+    // Replaced since it was listed, e.g. by a mount or another directory.
+    struct stat opened {};
+    if (fstat(fd, &opened) != 0 || opened.st_dev != device || opened.st_ino != node.inode) {
+        ++state.errors;
+        return;
+    }
+
+    const bool listed = common::for_each_directory_entry(fd, state.buffer, [&](const char* name, unsigned char) {
+        struct stat st {};
+        if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            ++state.errors;
+            return;
+        }
+        ++state.inodes;
+        if (st.st_dev != device) {
+            ++state.other_devices_skipped;
+            return;
+        }
+
+        const unsigned long long bytes = static_cast<unsigned long long>(st.st_blocks) * 512ULL;
+        if (S_ISDIR(st.st_mode)) {
+            ++state.directories;
+            DirNode& child = state.nodes.emplace_back();
+            child.parent = &node;
+            child.name = name;
+            child.depth = node.depth + 1;
+            child.inode = st.st_ino;
+            child.mtime_ns = mtime_ns(st);
+            child.own_bytes = bytes;
+            child.apparent_bytes = static_cast<unsigned long long>(st.st_size);
+            state.apparent_bytes += static_cast<unsigned long long>(st.st_size);
+            push(DirTask{&child, self, join_path(task.path, child.name)});
+            return;
+        }
+
+        ++state.files;
+        ++node.files;
+        if (st.st_nlink > 1 && !links.first_sighting(st.st_ino, &node)) {
+            ++state.hardlinks_skipped;
+            return;
+        }
+        node.own_bytes += bytes;
+        node.apparent_bytes += static_cast<unsigned long long>(st.st_size);
+        state.apparent_bytes += static_cast<unsigned long long>(st.st_size);
+        if (bytes > node.largest_file_bytes) {
+            node.largest_file_bytes = bytes;
+            node.largest_file_name = name;
+        }
+        offer_file(state.largest_files, options.top_n, bytes, task.path, name);
+        if (options.on_file) {
+            options.on_file(join_path(task.path, name), bytes);
+        }
+    });
+    if (!listed) {
+        ++state.errors;
+    }
+}
+
+bool is_live(const std::vector<DirectoryRecord>& directories, std::uint32_t index) {
+    return index == 0 || directories[index].parent != kRemovedDirectory;
+}
+
+TreemapNode build_treemap(const std::vector<DirectoryRecord>& directories, std::uint32_t index,
+                          const std::string& name, const std::vector<std::vector<std::uint32_t>>& children,
+                          std::size_t depth_left, std::size_t max_children) {
+    const DirectoryRecord& node = directories[index];
+    TreemapNode tree;
+    tree.name = name;
+    tree.bytes = node.total_bytes;
+    if (depth_left == 0) {
+        return tree;
+    }
+
+    std::vector<std::uint32_t> kids = children[index];
+    std::sort(kids.begin(), kids.end(), [&](std::uint32_t lhs, std::uint32_t rhs) {
+        return directories[lhs].total_bytes > directories[rhs].total_bytes;
+    });
+
+    unsigned long long other = 0;
+    for (std::size_t i = 0; i < kids.size(); ++i) {
+        if (i < max_children) {
+            tree.children.push_back(build_treemap(directories, kids[i], directories[kids[i]].name, children,
+                                                  depth_left - 1, max_children));
+        } else {
+            other += directories[kids[i]].total_bytes;
+        }
+    }
+    if (other > 0) {
+        tree.children.push_back(TreemapNode{"<other>", other, {}});
+    }
+    if (node.own_bytes > 0 && !tree.children.empty()) {
+        tree.children.push_back(TreemapNode{"<files>", node.own_bytes, {}});
+    }
+    return tree;
+}
+
+void treemap_to_json(std::ostringstream& json, const TreemapNode& node) {
+    json << "{";
+    json << "\"name\":\"" << common::escape_json(node.name) << "\",";
+    json << "\"bytes\":" << node.bytes;
+    if (!node.children.empty()) {
+        json << ",\"children\":[";
+        for (size_t i = 0; i < node.children.size(); ++i) {
+            if (i > 0) json << ",";
+            treemap_to_json(json, node.children[i]);
+        }
+        json << "]";
+    }
+    json << "}";
+}
+
+void entries_to_json(std::ostringstream& json, const std::vector<UsageEntry>& entries) {
+    json << "[";
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "{\"path\":\"" << common::escape_json(entries[i].path) << "\",\"bytes\":" << entries[i].bytes << "}";
+    }
+    json << "]";
+}
+
+}
+
+std::string directory_path(const std::vector<DirectoryRecord>& directories, std::uint32_t index) {
+    std::vector<std::uint32_t> chain;
+    for (; index != 0; index = directories[index].parent) {
+        chain.push_back(index);
+    }
+    std::string path = directories[0].name;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        path = join_path(path, directories[*it].name);
+    }
+    return path;
+}
+
+void summarize_directories(const std::vector<DirectoryRecord>& directories, const DiskUsageOptions& options,
+                           DiskUsageReport& report) {
+    if (directories.empty()) {
+        return;
+    }
+    report.total_bytes = directories[0].total_bytes;
+
+    // Parents precede children, so depths resolve in one pass.
+    std::vector<std::uint32_t> depth(directories.size(), 0);
+    std::vector<std::vector<std::uint32_t>> children(directories.size());
+    std::vector<std::uint32_t> candidates;
+    candidates.reserve(directories.size());
+    for (std::uint32_t i = 1; i < directories.size(); ++i) {
+        if (!is_live(directories, i)) {
+            continue;
+        }
+        const std::uint32_t parent = directories[i].parent;
+        depth[i] = depth[parent] + 1;
+        if (depth[i] <= options.treemap_depth) {
+            children[parent].push_back(i);
+        }
+        candidates.push_back(i);
+    }
+
+    const std::size_t dir_count = std::min(options.top_n, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(dir_count),
+                      candidates.end(), [&](std::uint32_t lhs, std::uint32_t rhs) {
+                          return directories[lhs].total_bytes > directories[rhs].total_bytes;
+                      });
+    report.largest_directories.clear();
+    for (std::size_t i = 0; i < dir_count; ++i) {
+        report.largest_directories.push_back(
+            UsageEntry{directory_path(directories, candidates[i]), directories[candidates[i]].total_bytes});
+    }
+
+    report.treemap = build_treemap(directories, 0, directories[0].name, children, options.treemap_depth,
+                                   std::max<std::size_t>(options.treemap_children, 1));
+}
+
+DiskUsageReport analyze_disk_usage(const std::string& root, const DiskUsageOptions& options, DiskUsageTree* tree) {
+    DiskUsageReport report;
+    report.root = root.size() > 1 && root.back() == '/' ? root.substr(0, root.find_last_not_of('/') + 1) : root;
+    const auto start = std::chrono::steady_clock::now();
+
+    struct stat root_stat {};
+    if (report.root.empty() || lstat(report.root.c_str(), &root_stat) != 0 || !S_ISDIR(root_stat.st_mode)) {
+        return report;
+    }
+    report.valid = true;
+
+    // Directory scanning is dominated by metadata I/O, so more threads than
+    // cores still pays off on SSDs.
+    const std::size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    report.threads = options.threads > 0 ? options.threads : std::clamp<std::size_t>(hardware * 2, 4, 16);
+
+    DirNode root_node;
+    root_node.name = report.root;
+    root_node.inode = root_stat.st_ino;
+    root_node.mtime_ns = mtime_ns(root_stat);
+    root_node.own_bytes = static_cast<unsigned long long>(root_stat.st_blocks) * 512ULL;
+    root_node.apparent_bytes = static_cast<unsigned long long>(root_stat.st_size);
+
+    std::vector<WorkerState> states(report.threads);
+    LinkedInodes links;
+    common::run_work_stealing(
+        std::vector<DirTask>{DirTask{&root_node, nullptr, report.root}}, report.threads,
+        [&](std::size_t worker, DirTask& task, auto& push) {
+            scan_directory(task, states[worker], root_stat.st_dev, links, options,
+                           [&push](DirTask child) { push(std::move(child)); });
+        });
+
+    // Roll sizes up the tree, deepest directories first.
+    std::vector<std::vector<DirNode*>> by_depth(1);
+    by_depth[0].push_back(&root_node);
+    FileHeap files;
+    for (auto& state : states) {
+        for (auto& node : state.nodes) {
+            if (by_depth.size() <= node.depth) {
+                by_depth.resize(node.depth + 1);
+            }
+            by_depth[node.depth].push_back(&node);
+        }
+        files.insert(files.end(), std::make_move_iterator(state.largest_files.begin()),
+                     std::make_move_iterator(state.largest_files.end()));
+        report.apparent_bytes += state.apparent_bytes;
+        report.files += state.files;
+        report.directories += state.directories;
+        report.inodes += state.inodes;
+        report.hardlinks_skipped += state.hardlinks_skipped;
+        report.other_devices_skipped += state.other_devices_skipped;
+        report.errors += state.errors;
+    }
+    report.inodes += 1;
+    report.apparent_bytes += static_cast<unsigned long long>(root_stat.st_size);
+
+    for (std::size_t depth = by_depth.size(); depth-- > 0;) {
+        for (DirNode* node : by_depth[depth]) {
+            node->total_bytes += node->own_bytes;
+            if (node->parent != nullptr) {
+                node->parent->total_bytes += node->total_bytes;
+            }
+        }
+    }
+
+    // Flatten breadth-first so every parent precedes its children.
+    DiskUsageTree scanned;
+    scanned.directories.reserve(static_cast<std::size_t>(report.directories) + 1);
+    for (auto& level : by_depth) {
+        for (DirNode* node : level) {
+            node->index = static_cast<std::uint32_t>(scanned.directories.size());
+            DirectoryRecord record;
+            record.parent = node->parent != nullptr ? node->parent->index : 0;
+            record.name = std::move(node->name);
+            record.inode = node->inode;
+            record.mtime_ns = node->mtime_ns;
+            record.own_bytes = node->own_bytes;
+            record.total_bytes = node->total_bytes;
+            record.apparent_bytes = node->apparent_bytes;
+            record.files = node->files;
+            record.largest_file_bytes = node->largest_file_bytes;
+            record.largest_file_name = std::move(node->largest_file_name);
+            scanned.directories.push_back(std::move(record));
+        }
+    }
+    summarize_directories(scanned.directories, options, report);
+
+    std::sort(files.begin(), files.end(), heap_greater);
+    for (std::size_t i = 0; i < files.size() && i < options.top_n; ++i) {
+        report.largest_files.push_back(UsageEntry{std::move(files[i].second), files[i].first});
+    }
+
+    if (tree != nullptr) {
+        links.for_each([&](ino_t inode, const DirNode* owner) {
+            scanned.linked_inodes.emplace_back(inode, owner->index);
+        });
+        *tree = std::move(scanned);
+    }
+
+    report.elapsed_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (report.elapsed_ms > 0.0) {
+        report.inodes_per_second = static_cast<double>(report.inodes) * 1000.0 / report.elapsed_ms;
+    }
+    return report;
+}
+
+std::string disk_usage_to_json(const DiskUsageReport& report) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"root\":\"" << common::escape_json(report.root) << "\",";
+    json << "\"valid\":" << (report.valid ? "true" : "false") << ",";
+    json << "\"total_bytes\":" << report.total_bytes << ",";
+    json << "\"apparent_bytes\":" << report.apparent_bytes << ",";
+    json << "\"files\":" << report.files << ",";
+    json << "\"directories\":" << report.directories << ",";
+    json << "\"inodes\":" << report.inodes << ",";
+    json << "\"hardlinks_skipped\":" << report.hardlinks_skipped << ",";
+    json << "\"other_devices_skipped\":" << report.other_devices_skipped << ",";
+    json << "\"errors\":" << report.errors << ",";
+    json << "\"threads\":" << report.threads << ",";
+    json << "\"elapsed_ms\":" << std::fixed << std::setprecision(2) << report.elapsed_ms << ",";
+    json << "\"inodes_per_second\":" << std::fixed << std::setprecision(2) << report.inodes_per_second << ",";
+    json << "\"largest_directories\":";
+    entries_to_json(json, report.largest_directories);
+    json << ",\"largest_files\":";
+    entries_to_json(json, report.largest_files);
+    json << ",\"treemap\":";
+    treemap_to_json(json, report.treemap);
+    json << "}";
+    return json.str();
+}
+
+}
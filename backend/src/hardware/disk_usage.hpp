@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace nanookjaro::hardware::disk {
+
+struct DiskUsageOptions {
+    std::size_t top_n = 20;
+    std::size_t threads = 0;  // 0 picks a default suited to I/O-bound scans
+    std::size_t treemap_depth = 2;
+    std::size_t treemap_children = 16;
+    // Called for every file counted in the usage, from the scanning threads.
+    std::function<void(std::string_view path, unsigned long long bytes)> on_file;
+};
+
+struct UsageEntry {
+    std::string path;
+    unsigned long long bytes = 0;
+};
+
+// Directory sizes for a treemap. Each node's children add up to its size:
+// small subdirectories are folded into "<other>" and files directly inside the
+// directory appear as "<files>".
+struct TreemapNode {
+    std::string name;
+    unsigned long long bytes = 0;
+    std::vector<TreemapNode> children;
+};
+
+struct DiskUsageReport {
+    std::string root;
+    bool valid = false;
+    unsigned long long total_bytes = 0;     // allocated blocks, like du
+    unsigned long long apparent_bytes = 0;  // sum of st_size
+    unsigned long long files = 0;
+    unsigned long long directories = 0;
+    unsigned long long inodes = 0;
+    unsigned long long hardlinks_skipped = 0;
+    unsigned long long other_devices_skipped = 0;
+    unsigned long long errors = 0;
+    std::size_t threads = 0;
+    double elapsed_ms = 0.0;
+    double inodes_per_second = 0.0;
+    std::vector<UsageEntry> largest_directories;
+    std::vector<UsageEntry> largest_files;
+    TreemapNode treemap;
+};
+
+// Marks a DirectoryRecord that was dropped from a tree but not compacted yet.
+constexpr std::uint32_t kRemovedDirectory = 0xffffffffu;
+
+// One scanned directory, flattened so a tree can be persisted and updated in
+// place (see disk_usage_index.hpp).
+struct DirectoryRecord {
+    std::uint32_t parent = 0;  // index of the parent record; the root is its own parent
+    std::string name;          // the root record holds the full root path
+    std::uint64_t inode = 0;
+    std::int64_t mtime_ns = 0;
+    unsigned long long own_bytes = 0;  // the directory itself plus files directly inside
+    unsigned long long total_bytes = 0;
+    unsigned long long apparent_bytes = 0;
+    unsigned long long files = 0;
+    unsigned long long largest_file_bytes = 0;
+    std::string largest_file_name;
+};
+
+struct DiskUsageTree {
+    std::vector<DirectoryRecord> directories;  // [0] is the root; parents precede children
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> linked_inodes;  // hard-linked inode -> directory counting it
+};
+
+// Walks `root` like `du -x`: stays on the root's device, does not follow
+// symlinks and counts each hard-linked inode once. Directories are opened
+// with openat relative to their parent, listed with getdents64 and stat'ed
+// with fstatat on a work-stealing thread pool, so depth is not limited by
+// PATH_MAX.
+// When `tree` is given it receives every scanned directory.
+DiskUsageReport analyze_disk_usage(const std::string& root, const DiskUsageOptions& options = {},
+                                   DiskUsageTree* tree = nullptr);
+
+// Fills total_bytes, largest_directories and treemap of `report` from
+// directories whose total_bytes are rolled up. Removed records are skipped.
+void summarize_directories(const std::vector<DirectoryRecord>& directories, const DiskUsageOptions& options,
+                           DiskUsageReport& report);
+
+// Path of directories[index], built from the parent chain.
+std::string directory_path(const std::vector<DirectoryRecord>& directories, std::uint32_t index);
+std::string disk_usage_to_json(const DiskUsageReport& report);
+
+}
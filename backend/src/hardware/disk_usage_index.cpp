@@ -0,0 +1,1013 @@
+#include "disk_usage_index.hpp"
+#include "../common/directory_entries.hpp"
+#include "../common/mapped_file.hpp"
+#include "../common/paths.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanookjaro::hardware::disk {
+
+namespace {
+
+constexpr std::size_t kEventBufferSize = 64 * 1024;
+
+// Changes are applied once events stop for kQuietPeriod, or after
+// kMaxApplyDelay under a steady stream of writes.
+constexpr auto kQuietPeriod = std::chrono::milliseconds(250);
+constexpr auto kMaxApplyDelay = std::chrono::seconds(2);
+constexpr auto kSaveInterval = std::chrono::seconds(30);
+constexpr std::size_t kHandleCacheLimit = 4096;
+
+// Sizes are picked up when a writer closes the file rather than on every
+// write, which would wake the watcher for each block of a large copy.
+constexpr std::uint32_t kInotifyMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+                                       IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+// On-disk layout: header, then per directory the LEB128 fields below with the
+// parent stored as the distance back to it (parents precede children, so it
+// is small), then the hard-link owners. Names are length-prefixed.
+constexpr char kIndexMagic[8] = {'N', 'J', 'D', 'U', 'I', 'D', 'X', '1'};
+
+struct IndexHeader {
+    char magic[8];
+    std::uint64_t device;
+    std::uint64_t root_inode;
+    std::int64_t scanned_at;  // unix seconds of the last full scan
+    std::uint32_t directory_count;
+    std::uint32_t linked_count;
+};
+
+void put_varint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void put_string(std::string& out, const std::string& value) {
+    put_varint(out, value.size());
+    out.append(value);
+}
+
+class VarintReader {
+public:
+    explicit VarintReader(std::string_view data) : data_(data) {}
+
+    bool ok() const { return ok_; }
+
+    std::uint64_t number() {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos_ >= data_.size()) {
+                ok_ = false;
+                return 0;
+            }
+            const auto byte = static_cast<unsigned char>(data_[pos_++]);
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        ok_ = false;
+        return 0;
+    }
+
+    std::string text() {
+        const std::uint64_t length = number();
+        if (!ok_ || length > data_.size() - pos_) {
+            ok_ = false;
+            return {};
+        }
+        std::string value(data_.substr(pos_, length));
+        pos_ += length;
+        return value;
+    }
+
+private:
+    std::string_view data_;
+    std::size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+std::int64_t mtime_ns(const struct stat& st) {
+    return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+std::string join_path(const std::string& directory, std::string_view name) {
+    std::string path;
+    path.reserve(directory.size() + name.size() + 1);
+    path.append(directory);
+    if (path.empty() || path.back() != '/') {
+        path.push_back('/');
+    }
+    path.append(name);
+    return path;
+}
+
+std::string index_file_for(const std::string& root) {
+    const std::string directory = common::cache_directory();
+    if (directory.empty()) {
+        return {};
+    }
+    std::ostringstream name;
+    name << directory << "/du-" << std::hex << std::setw(16) << std::setfill('0') << std::hash<std::string>{}(root)
+         << ".idx";
+    return name.str();
+}
+
+class DiskUsageIndex {
+public:
+    explicit DiskUsageIndex(std::string root) : root_(std::move(root)), file_(index_file_for(root_)) {}
+
+    ~DiskUsageIndex() { close(); }
+
+    std::string json(const DiskUsageOptions& options, bool rebuild) {
+        const auto start = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex_);
+        rescanned_in_query_ = 0;
+
+        struct stat root_stat {};
+        if (lstat(root_.c_str(), &root_stat) != 0 || !S_ISDIR(root_stat.st_mode)) {
+            DiskUsageReport report;
+            report.root = root_;
+            return wrap(disk_usage_to_json(report));
+        }
+
+        if (rebuild || dirs_.empty() || root_stat.st_dev != device_ || root_stat.st_ino != dirs_[0].inode) {
+            stop_watching(lock);
+            if (!rebuild && load(root_stat)) {
+                source_ = "index";
+                start_watching();
+                needs_revalidate_ = true;  // catch up on changes made while nothing was watching
+            } else {
+                start_fanotify();
+                full_scan(options.threads);
+                source_ = "scan";
+                start_watching();
+                save();
+            }
+        } else {
+            source_ = "memory";
+        }
+
+        drain_events();
+        if (needs_revalidate_ || watch_mode_ == "none") {
+            revalidate(false);
+        } else if (watch_mode_ == "inotify" && unwatched_ > 0) {
+            revalidate(true);
+        }
+        apply_pending();
+        if (dirty_ && std::chrono::steady_clock::now() - last_save_ >= kSaveInterval) {
+            save();
+        }
+
+        DiskUsageReport report = build_report(options);
+        report.elapsed_ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return wrap(disk_usage_to_json(report));
+    }
+
+    void close() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_watching(lock);
+        if (dirty_) {
+            apply_pending();
+            save();
+        }
+    }
+
+private:
+    bool live(std::uint32_t index) const { return index == 0 || dirs_[index].parent != kRemovedDirectory; }
+
+    std::string path_of(std::uint32_t index) const { return directory_path(dirs_, index); }
+
+    // --- scanning ---------------------------------------------------------
+
+    void full_scan(std::size_t threads) {
+        DiskUsageOptions scan_options;
+        scan_options.top_n = 0;
+        scan_options.threads = threads;
+        DiskUsageTree tree;
+        const DiskUsageReport report = analyze_disk_usage(root_, scan_options, &tree);
+        errors_ = report.errors;
+        struct stat root_stat {};
+        lstat(root_.c_str(), &root_stat);
+        device_ = root_stat.st_dev;
+        scanned_at_ = std::time(nullptr);
+        adopt(std::move(tree));
+        dirty_ = true;
+        ++full_scans_;
+    }
+
+    void adopt(DiskUsageTree tree) {
+        dirs_ = std::move(tree.directories);
+        removed_ = 0;
+        children_.assign(dirs_.size(), {});
+        by_inode_.clear();
+        linked_.clear();
+        pending_.clear();
+        for (std::uint32_t i = 0; i < dirs_.size(); ++i) {
+            by_inode_[dirs_[i].inode] = i;
+            if (i > 0) {
+                children_[dirs_[i].parent].push_back(i);
+            }
+        }
+        for (const auto& [inode, owner] : tree.linked_inodes) {
+            linked_[inode] = owner;
+        }
+        wd_of_.assign(dirs_.size(), -1);
+    }
+
+    // Adds `delta` to the total of `index` and every ancestor.
+    void add_to_totals(std::uint32_t index, long long delta) {
+        if (delta == 0) {
+            return;
+        }
+        while (true) {
+            dirs_[index].total_bytes = static_cast<unsigned long long>(
+                static_cast<long long>(dirs_[index].total_bytes) + delta);
+            if (index == 0) {
+                break;
+            }
+            index = dirs_[index].parent;
+        }
+    }
+
+    // Re-reads one directory without descending: its own size, its files and
+    // which subdirectories appeared or disappeared.
+    void rescan_directory(std::uint32_t index) {
+        ++rescans_;
+        ++rescanned_in_query_;
+        const std::string path = path_of(index);
+        const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        struct stat self {};
+        if (fd < 0 || fstat(fd, &self) != 0 || self.st_dev != device_ || self.st_ino != dirs_[index].inode) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            // Gone or replaced; the parent's rescan drops or re-adds it.
+            if (index != 0) {
+                pending_.insert(dirs_[index].parent);
+            }
+            return;
+        }
+
+        DirectoryRecord fresh;
+        fresh.own_bytes = static_cast<unsigned long long>(self.st_blocks) * 512ULL;
+        fresh.apparent_bytes = static_cast<unsigned long long>(self.st_size);
+        fresh.mtime_ns = mtime_ns(self);
+        std::map<std::string, std::uint64_t> subdirectories;
+        std::unordered_set<std::uint64_t> linked_here;
+
+        common::for_each_directory_entry(fd, buffer_, [&](const char* name, unsigned char) {
+            struct stat st {};
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0 || st.st_dev != device_) {
+                return;
+            }
+            if (S_ISDIR(st.st_mode)) {
+                subdirectories.emplace(name, st.st_ino);
+                return;
+            }
+            ++fresh.files;
+            if (st.st_nlink > 1) {
+                auto [it, inserted] = linked_.try_emplace(st.st_ino, index);
+                if (!inserted && it->second != index && live(it->second)) {
+                    return;  // counted by another directory
+                }
+                it->second = index;
+                linked_here.insert(st.st_ino);
+            }
+            const unsigned long long bytes = static_cast<unsigned long long>(st.st_blocks) * 512ULL;
+            fresh.own_bytes += bytes;
+            fresh.apparent_bytes += static_cast<unsigned long long>(st.st_size);
+            if (bytes > fresh.largest_file_bytes) {
+                fresh.largest_file_bytes = bytes;
+                fresh.largest_file_name = name;
+            }
+        });
+        ::close(fd);
+
+        for (auto it = linked_.begin(); it != linked_.end();) {
+            if (it->second == index && linked_here.count(it->first) == 0) {
+                it = linked_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        const std::vector<std::uint32_t> known = children_[index];
+        for (const std::uint32_t child : known) {
+            const auto it = subdirectories.find(dirs_[child].name);
+            if (it != subdirectories.end() && it->second == dirs_[child].inode) {
+                subdirectories.erase(it);
+            } else {
+                remove_subtree(child);
+            }
+        }
+
+        DirectoryRecord& record = dirs_[index];
+        const long long delta =
+            static_cast<long long>(fresh.own_bytes) - static_cast<long long>(record.own_bytes);
+        record.own_bytes = fresh.own_bytes;
+        record.apparent_bytes = fresh.apparent_bytes;
+        record.files = fresh.files;
+        record.mtime_ns = fresh.mtime_ns;
+        record.largest_file_bytes = fresh.largest_file_bytes;
+        record.largest_file_name = std::move(fresh.largest_file_name);
+        add_to_totals(index, delta);
+
+        for (const auto& [name, inode] : subdirectories) {
+            graft(index, name);
+        }
+        dirty_ = true;
+    }
+
+    // Scans a new subdirectory completely and appends it below `parent`.
+    void graft(std::uint32_t parent, const std::string& name) {
+        DiskUsageOptions scan_options;
+        scan_options.top_n = 0;
+        scan_options.threads = 2;
+        DiskUsageTree tree;
+        const std::string path = join_path(path_of(parent), name);
+        if (!analyze_disk_usage(path, scan_options, &tree).valid || tree.directories.empty()) {
+            return;
+        }
+
+        const auto base = static_cast<std::uint32_t>(dirs_.size());
+        for (std::uint32_t i = 0; i < tree.directories.size(); ++i) {
+            DirectoryRecord& record = tree.directories[i];
+            if (i == 0) {
+                record.parent = parent;
+                record.name = name;
+            } else {
+                record.parent += base;
+            }
+            const auto index = static_cast<std::uint32_t>(dirs_.size());
+            by_inode_[record.inode] = index;
+            children_.emplace_back();
+            children_[record.parent].push_back(index);
+            wd_of_.push_back(-1);
+            dirs_.push_back(std::move(record));
+            watch_directory(index);
+        }
+        for (const auto& [inode, owner] : tree.linked_inodes) {
+            linked_.try_emplace(inode, owner + base);
+        }
+        add_to_totals(parent, static_cast<long long>(dirs_[base].total_bytes));
+    }
+
+    void remove_subtree(std::uint32_t index) {
+        const std::uint32_t parent = dirs_[index].parent;
+        add_to_totals(parent, -static_cast<long long>(dirs_[index].total_bytes));
+        auto& siblings = children_[parent];
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), index), siblings.end());
+
+        std::vector<std::uint32_t> stack{index};
+        while (!stack.empty()) {
+            const std::uint32_t current = stack.back();
+            stack.pop_back();
+            stack.insert(stack.end(), children_[current].begin(), children_[current].end());
+            children_[current].clear();
+            if (const auto it = by_inode_.find(dirs_[current].inode); it != by_inode_.end() && it->second == current) {
+                by_inode_.erase(it);
+            }
+            unwatch_directory(current);
+            pending_.erase(current);
+            dirs_[current] = DirectoryRecord{};
+            dirs_[current].parent = kRemovedDirectory;
+            ++removed_;
+        }
+        for (auto it = linked_.begin(); it != linked_.end();) {
+            it = live(it->second) ? std::next(it) : linked_.erase(it);
+        }
+    }
+
+    // Queues every directory whose mtime moved, and the parents of the ones
+    // that vanished. `unwatched_only` limits the check to directories without
+    // an inotify watch.
+    void revalidate(bool unwatched_only) {
+        needs_revalidate_ = false;
+        ++revalidations_;
+        std::vector<std::string> paths(dirs_.size());
+        for (std::uint32_t i = 0; i < dirs_.size(); ++i) {
+            if (!live(i)) {
+                continue;
+            }
+            paths[i] = i == 0 ? dirs_[0].name : join_path(paths[dirs_[i].parent], dirs_[i].name);
+            if (unwatched_only && wd_of_[i] >= 0) {
+                continue;
+            }
+            struct stat st {};
+            if (lstat(paths[i].c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_ino != dirs_[i].inode) {
+                if (i != 0) {
+                    pending_.insert(dirs_[i].parent);
+                }
+            } else if (mtime_ns(st) != dirs_[i].mtime_ns) {
+                pending_.insert(i);
+            }
+        }
+    }
+
+    void apply_pending() {
+        // Rescanning can queue parents of directories that vanished, so loop
+        // until nothing is left; shallow parents first keeps grafts minimal.
+        while (!pending_.empty()) {
+            std::vector<std::uint32_t> batch(pending_.begin(), pending_.end());
+            pending_.clear();
+            std::sort(batch.begin(), batch.end());
+            for (const std::uint32_t index : batch) {
+                if (index < dirs_.size() && live(index)) {
+                    rescan_directory(index);
+                }
+            }
+        }
+        // Indexes are stable while a batch runs; drop tombstones afterwards.
+        if (removed_ > 1024 && removed_ * 2 > dirs_.size()) {
+            compact();
+        }
+    }
+
+    void compact() {
+        std::vector<std::uint32_t> remap(dirs_.size(), kRemovedDirectory);
+        std::vector<DirectoryRecord> kept;
+        std::vector<int> kept_wd;
+        kept.reserve(dirs_.size() - removed_);
+        for (std::uint32_t i = 0; i < dirs_.size(); ++i) {
+            if (!live(i)) {
+                continue;
+            }
+            remap[i] = static_cast<std::uint32_t>(kept.size());
+            DirectoryRecord record = std::move(dirs_[i]);
+            record.parent = i == 0 ? 0 : remap[record.parent];
+            kept.push_back(std::move(record));
+            kept_wd.push_back(wd_of_[i]);
+        }
+        dirs_ = std::move(kept);
+        wd_of_ = std::move(kept_wd);
+        removed_ = 0;
+
+        children_.assign(dirs_.size(), {});
+        by_inode_.clear();
+        for (std::uint32_t i = 0; i < dirs_.size(); ++i) {
+            by_inode_[dirs_[i].inode] = i;
+            if (i > 0) {
+                children_[dirs_[i].parent].push_back(i);
+            }
+        }
+        for (auto& [inode, owner] : linked_) {
+            owner = remap[owner];
+        }
+        std::unordered_set<std::uint32_t> pending;
+        for (const std::uint32_t index : pending_) {
+            if (remap[index] != kRemovedDirectory) {
+                pending.insert(remap[index]);
+            }
+        }
+        pending_ = std::move(pending);
+        wd_to_dir_.clear();
+        for (std::uint32_t i = 0; i < wd_of_.size(); ++i) {
+            if (wd_of_[i] >= 0) {
+                wd_to_dir_[wd_of_[i]] = i;
+            }
+        }
+    }
+
+    // --- persistence ------------------------------------------------------
+
+    bool load(const struct stat& root_stat) {
+        if (file_.empty()) {
+            return false;
+        }
+        const common::MappedFile file(file_);
+        IndexHeader header{};
+        if (!file.valid() || file.size() < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+            header.device != static_cast<std::uint64_t>(root_stat.st_dev) ||
+            header.root_inode != static_cast<std::uint64_t>(root_stat.st_ino) || header.directory_count == 0) {
+            return false;
+        }
+
+        VarintReader reader(file.view().substr(sizeof(header)));
+        if (reader.text() != root_) {
+            return false;
+        }
+        DiskUsageTree tree;
+        tree.directories.resize(header.directory_count);
+        for (std::uint32_t i = 0; i < header.directory_count && reader.ok(); ++i) {
+            DirectoryRecord& record = tree.directories[i];
+            const std::uint64_t distance = reader.number();
+            if (i > 0 && (distance == 0 || distance > i)) {
+                return false;
+            }
+            record.parent = i - static_cast<std::uint32_t>(distance);
+            record.name = reader.text();
+            record.inode = reader.number();
+            record.mtime_ns = static_cast<std::int64_t>(reader.number());
+            record.own_bytes = reader.number();
+            record.apparent_bytes = reader.number();
+            record.files = reader.number();
+            record.largest_file_bytes = reader.number();
+            record.largest_file_name = reader.text();
+        }
+        for (std::uint32_t i = 0; i < header.linked_count && reader.ok(); ++i) {
+            const std::uint64_t inode = reader.number();
+            const std::uint64_t owner = reader.number();
+            if (owner < header.directory_count) {
+                tree.linked_inodes.emplace_back(inode, static_cast<std::uint32_t>(owner));
+            }
+        }
+        if (!reader.ok()) {
+            return false;
+        }
+
+        // Totals are not stored; roll them up again, children first.
+        for (std::size_t i = tree.directories.size(); i-- > 0;) {
+            DirectoryRecord& record = tree.directories[i];
+            record.total_bytes += record.own_bytes;
+            if (i > 0) {
+                tree.directories[record.parent].total_bytes += record.total_bytes;
+            }
+        }
+        device_ = root_stat.st_dev;
+        scanned_at_ = header.scanned_at;
+        saved_bytes_ = file.size();
+        adopt(std::move(tree));
+        dirty_ = false;
+        last_save_ = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    void save() {
+        if (file_.empty() || dirs_.empty()) {
+            return;
+        }
+        if (removed_ > 0) {
+            compact();
+        }
+        IndexHeader header{};
+        std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+        header.device = static_cast<std::uint64_t>(device_);
+        header.root_inode = dirs_[0].inode;
+        header.scanned_at = scanned_at_;
+        header.directory_count = static_cast<std::uint32_t>(dirs_.size());
+        header.linked_count = static_cast<std::uint32_t>(linked_.size());
+
+        std::string blob(reinterpret_cast<const char*>(&header), sizeof(header));
+        blob.reserve(sizeof(header) + dirs_.size() * 32);
+        put_string(blob, root_);
+        for (std::uint32_t i = 0; i < dirs_.size(); ++i) {
+            const DirectoryRecord& record = dirs_[i];
+            put_varint(blob, i - record.parent);
+            put_string(blob, record.name);
+            put_varint(blob, record.inode);
+            put_varint(blob, static_cast<std::uint64_t>(record.mtime_ns));
+            put_varint(blob, record.own_bytes);
+            put_varint(blob, record.apparent_bytes);
+            put_varint(blob, record.files);
+            put_varint(blob, record.largest_file_bytes);
+            put_string(blob, record.largest_file_name);
+        }
+        for (const auto& [inode, owner] : linked_) {
+            put_varint(blob, inode);
+            put_varint(blob, owner);
+        }
+        if (common::write_file_atomically(file_, blob)) {
+            dirty_ = false;
+            saved_bytes_ = blob.size();
+        }
+        last_save_ = std::chrono::steady_clock::now();
+    }
+
+    // --- watching ---------------------------------------------------------
+
+    // fanotify is armed before a full scan so changes made during the scan
+    // are queued rather than lost.
+    void start_fanotify() {
+        if (notify_fd_ >= 0) {
+            return;
+        }
+#if defined(FAN_REPORT_DFID_NAME) && defined(FAN_MARK_FILESYSTEM)
+        const int fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        // The mark covers the whole filesystem, so FAN_MODIFY would fire for
+        // every write anywhere on it.
+        constexpr std::uint64_t mask =
+            FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_CLOSE_WRITE | FAN_ONDIR;
+        const int mount_fd = open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (mount_fd < 0 || fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask, AT_FDCWD, root_.c_str()) != 0) {
+            if (mount_fd >= 0) {
+                ::close(mount_fd);
+            }
+            ::close(fd);
+            return;
+        }
+        notify_fd_ = fd;
+        mount_fd_ = mount_fd;
+        watch_mode_ = "fanotify";
+#endif
+    }
+
+    void start_watching() {
+        if (!watcher_.joinable()) {
+            start_fanotify();
+            if (notify_fd_ < 0) {
+                notify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+                watch_mode_ = notify_fd_ >= 0 ? "inotify" : "none";
+            }
+            if (notify_fd_ < 0) {
+                return;
+            }
+            wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            stop_ = false;
+        }
+        unwatched_ = 0;
+        for (std::uint32_t i = 0; i < dirs_.size(); ++i) {
+            if (live(i) && wd_of_[i] < 0) {
+                watch_directory(i);
+            }
+        }
+        if (!watcher_.joinable() && wake_fd_ >= 0) {
+            watcher_ = std::thread([this] { watch_loop(); });
+        }
+    }
+
+    // `lock` holds mutex_; it is released while the watcher thread exits.
+    void stop_watching(std::unique_lock<std::mutex>& lock) {
+        if (watcher_.joinable()) {
+            stop_ = true;
+            const std::uint64_t one = 1;
+            [[maybe_unused]] const ssize_t written = write(wake_fd_, &one, sizeof(one));
+            // The watcher takes mutex_ to apply changes, so let it finish.
+            lock.unlock();
+            watcher_.join();
+            lock.lock();
+        }
+        for (int* fd : {&notify_fd_, &mount_fd_, &wake_fd_}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+        wd_to_dir_.clear();
+        std::fill(wd_of_.begin(), wd_of_.end(), -1);
+        handle_cache_.clear();
+        watch_mode_ = "none";
+    }
+
+    void watch_directory(std::uint32_t index) {
+        if (watch_mode_ != "inotify" || notify_fd_ < 0) {
+            return;
+        }
+        if (unwatched_ > 0) {
+            ++unwatched_;  // the watch limit was hit; mtime checks cover the rest
+            return;
+        }
+        const int wd = inotify_add_watch(notify_fd_, path_of(index).c_str(), kInotifyMask);
+        if (wd < 0) {
+            ++unwatched_;
+            return;
+        }
+        wd_of_[index] = wd;
+        wd_to_dir_[wd] = index;
+    }
+
+    void unwatch_directory(std::uint32_t index) {
+        if (wd_of_[index] < 0) {
+            if (watch_mode_ == "inotify" && unwatched_ > 0) {
+                --unwatched_;
+            }
+            return;
+        }
+        inotify_rm_watch(notify_fd_, wd_of_[index]);
+        wd_to_dir_.erase(wd_of_[index]);
+        wd_of_[index] = -1;
+    }
+
+    void watch_loop() {
+        std::chrono::steady_clock::time_point first_pending{};
+        bool has_pending = false;
+        while (!stop_) {
+            pollfd fds[2] = {{notify_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+            const int timeout = has_pending ? static_cast<int>(kQuietPeriod.count()) : -1;
+            const int ready = poll(fds, 2, timeout);
+            if (stop_ || (ready > 0 && (fds[1].revents & POLLIN) != 0)) {
+                break;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (ready > 0 && (fds[0].revents & POLLIN) != 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                drain_events();
+                if (!has_pending && (!pending_.empty() || needs_revalidate_)) {
+                    has_pending = true;
+                    first_pending = now;
+                }
+                if (!has_pending || now - first_pending < kMaxApplyDelay) {
+                    continue;
+                }
+            } else if (ready < 0) {
+                continue;
+            }
+
+            // Quiet period elapsed (or the backlog is old enough): apply.
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (needs_revalidate_) {
+                revalidate(false);
+            }
+            apply_pending();
+            if (dirty_ && now - last_save_ >= kSaveInterval) {
+                save();
+            }
+            has_pending = false;
+        }
+    }
+
+    // Reads every queued event; the fd is non-blocking, so a query can call
+    // this to pick up changes the watcher thread has not seen yet.
+    void drain_events() {
+        if (notify_fd_ < 0) {
+            return;
+        }
+        while (true) {
+            const ssize_t length = read(notify_fd_, event_buffer_.data(), event_buffer_.size());
+            if (length <= 0) {
+                return;
+            }
+            if (watch_mode_ == "fanotify") {
+                handle_fanotify(event_buffer_.data(), static_cast<std::size_t>(length));
+            } else {
+                handle_inotify(event_buffer_.data(), static_cast<std::size_t>(length));
+            }
+        }
+    }
+
+    void handle_inotify(const char* data, std::size_t length) {
+        for (std::size_t offset = 0; offset + sizeof(inotify_event) <= length;) {
+            inotify_event event{};
+            std::memcpy(&event, data + offset, sizeof(event));
+            offset += sizeof(inotify_event) + event.len;
+            ++events_;
+            if ((event.mask & IN_Q_OVERFLOW) != 0) {
+                needs_revalidate_ = true;
+                ++overflows_;
+                continue;
+            }
+            const auto it = wd_to_dir_.find(event.wd);
+            if (it == wd_to_dir_.end()) {
+                continue;
+            }
+            if ((event.mask & IN_IGNORED) != 0) {
+                wd_of_[it->second] = -1;
+                wd_to_dir_.erase(it);
+                continue;
+            }
+            pending_.insert(it->second);
+        }
+    }
+
+    void handle_fanotify(const char* data, std::size_t length) {
+#if defined(FAN_REPORT_DFID_NAME)
+        for (std::size_t offset = 0; offset + sizeof(fanotify_event_metadata) <= length;) {
+            fanotify_event_metadata meta{};
+            std::memcpy(&meta, data + offset, sizeof(meta));
+            if (meta.event_len < sizeof(meta) || offset + meta.event_len > length) {
+                break;
+            }
+            const char* event = data + offset;
+            offset += meta.event_len;
+            ++events_;
+            if ((meta.mask & FAN_Q_OVERFLOW) != 0) {
+                needs_revalidate_ = true;
+                ++overflows_;
+                continue;
+            }
+            // The first info record carries the handle of the directory the
+            // change happened in.
+            std::size_t info_offset = meta.metadata_len;
+            if (info_offset + sizeof(fanotify_event_info_fid) + sizeof(file_handle) > meta.event_len) {
+                continue;
+            }
+            fanotify_event_info_fid info{};
+            std::memcpy(&info, event + info_offset, sizeof(info));
+            if (info.hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME && info.hdr.info_type != FAN_EVENT_INFO_TYPE_DFID) {
+                continue;
+            }
+            const char* handle_bytes = event + info_offset + sizeof(fanotify_event_info_fid);
+            file_handle handle_header{};
+            std::memcpy(&handle_header, handle_bytes, sizeof(handle_header));
+            if (info_offset + sizeof(info) + sizeof(file_handle) + handle_header.handle_bytes > meta.event_len) {
+                continue;
+            }
+            const std::string key(handle_bytes, sizeof(file_handle) + handle_header.handle_bytes);
+            const std::uint64_t inode = resolve_handle(key);
+            if (const auto it = by_inode_.find(inode); inode != 0 && it != by_inode_.end()) {
+                pending_.insert(it->second);
+            }
+        }
+#else
+        (void)data;
+        (void)length;
+#endif
+    }
+
+    // Directory file handle -> inode number, cached because every write in
+    // a busy directory reports the same handle.
+    std::uint64_t resolve_handle(const std::string& key) {
+        if (const auto it = handle_cache_.find(key); it != handle_cache_.end()) {
+            return it->second;
+        }
+        std::vector<char> storage(key.begin(), key.end());
+        const int fd = open_by_handle_at(mount_fd_, reinterpret_cast<file_handle*>(storage.data()), O_PATH | O_CLOEXEC);
+        std::uint64_t inode = 0;
+        struct stat st {};
+        if (fd >= 0) {
+            if (fstat(fd, &st) == 0 && st.st_dev == device_) {
+                inode = st.st_ino;
+            }
+            ::close(fd);
+        }
+        if (handle_cache_.size() >= kHandleCacheLimit) {
+            handle_cache_.clear();
+        }
+        if (inode != 0) {
+            handle_cache_.emplace(key, inode);
+        }
+        return inode;
+    }
+
+    // --- reporting --------------------------------------------------------
+
+    DiskUsageReport build_report(const DiskUsageOptions& options) {
+        DiskUsageReport report;
+        report.root = root_;
+        report.valid = !dirs_.empty();
+        report.errors = errors_;
+        std::vector<std::pair<unsigned long long, std::uint32_t>> files;
+        for (std::uint32_t i = 0; i < dirs_.size(); ++i) {
+            if (!live(i)) {
+                continue;
+            }
+            const DirectoryRecord& record = dirs_[i];
+            report.apparent_bytes += record.apparent_bytes;
+            report.files += record.files;
+            report.directories += i > 0 ? 1 : 0;
+            if (record.largest_file_bytes > 0) {
+                files.emplace_back(record.largest_file_bytes, i);
+            }
+        }
+        report.inodes = report.files + report.directories + 1;
+        summarize_directories(dirs_, options, report);
+
+        const std::size_t file_count = std::min(options.top_n, files.size());
+        std::partial_sort(files.begin(), files.begin() + static_cast<std::ptrdiff_t>(file_count), files.end(),
+                          [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first; });
+        for (std::size_t i = 0; i < file_count; ++i) {
+            const std::uint32_t index = files[i].second;
+            report.largest_files.push_back(
+                UsageEntry{join_path(path_of(index), dirs_[index].largest_file_name), files[i].first});
+        }
+        return report;
+    }
+
+    std::string wrap(const std::string& usage) const {
+        std::size_t watched = 0;
+        for (const int wd : wd_of_) {
+            watched += wd >= 0 ? 1 : 0;
+        }
+        std::ostringstream json;
+        json << "{";
+        json << "\"index\":{";
+        json << "\"source\":\"" << source_ << "\",";
+        json << "\"watch\":\"" << watch_mode_ << "\",";
+        json << "\"file\":\"" << common::escape_json(file_) << "\",";
+        json << "\"file_bytes\":" << saved_bytes_ << ",";
+        json << "\"indexed_directories\":" << (dirs_.size() - removed_) << ",";
+        json << "\"watched_directories\":" << (watch_mode_ == "fanotify" ? dirs_.size() - removed_ : watched) << ",";
+        json << "\"rescanned_directories\":" << rescanned_in_query_ << ",";
+        json << "\"total_rescans\":" << rescans_ << ",";
+        json << "\"full_scans\":" << full_scans_ << ",";
+        json << "\"revalidations\":" << revalidations_ << ",";
+        json << "\"events\":" << events_ << ",";
+        json << "\"overflows\":" << overflows_ << ",";
+        json << "\"scanned_at\":" << scanned_at_;
+        json << "},";
+        json << "\"usage\":" << usage;
+        json << "}";
+        return json.str();
+    }
+
+    std::mutex mutex_;
+    std::string root_;
+    std::string file_;
+    dev_t device_ = 0;
+    std::int64_t scanned_at_ = 0;
+    std::vector<DirectoryRecord> dirs_;
+    std::vector<std::vector<std::uint32_t>> children_;
+    std::unordered_map<std::uint64_t, std::uint32_t> by_inode_;
+    std::unordered_map<std::uint64_t, std::uint32_t> linked_;  // hard-linked inode -> directory counting it
+    std::unordered_set<std::uint32_t> pending_;
+    std::size_t removed_ = 0;
+    std::vector<char> buffer_;
+    std::vector<char> event_buffer_ = std::vector<char>(kEventBufferSize);
+    bool needs_revalidate_ = false;
+    bool dirty_ = false;
+    std::chrono::steady_clock::time_point last_save_{};
+
+    std::string source_ = "scan";
+    unsigned long long errors_ = 0;
+    std::size_t saved_bytes_ = 0;
+    std::size_t rescanned_in_query_ = 0;
+    unsigned long long rescans_ = 0;
+    unsigned long long full_scans_ = 0;
+    unsigned long long revalidations_ = 0;
+    unsigned long long events_ = 0;
+    unsigned long long overflows_ = 0;
+
+    std::string watch_mode_ = "none";
+    int notify_fd_ = -1;
+    int mount_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> stop_{false};
+    std::thread watcher_;
+    std::vector<int> wd_of_;  // inotify watch per directory, -1 if none
+    std::unordered_map<int, std::uint32_t> wd_to_dir_;
+    std::size_t unwatched_ = 0;
+    std::unordered_map<std::string, std::uint64_t> handle_cache_;
+};
+
+// Open indexes by root; torn down (and saved) at exit. Shared so a query
+// that is running keeps its index alive across close_disk_usage_indexes().
+struct IndexRegistry {
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<DiskUsageIndex>> indexes;
+
+    ~IndexRegistry() { indexes.clear(); }
+};
+
+IndexRegistry& registry() {
+    static IndexRegistry instance;
+    return instance;
+}
+
+}
+
+std::string disk_usage_index_json(const std::string& root, const DiskUsageOptions& options, bool rebuild) {
+    std::string normalized = root.empty() ? "/" : root;
+    while (normalized.size() > 1 && normalized.back() == '/') {
+        normalized.pop_back();
+    }
+
+    std::shared_ptr<DiskUsageIndex> index;
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        auto& slot = reg.indexes[normalized];
+        if (!slot) {
+            slot = std::make_shared<DiskUsageIndex>(normalized);
+        }
+        index = slot;
+    }
+    return index->json(options, rebuild);
+}
+
+void close_disk_usage_indexes() {
+    std::map<std::string, std::shared_ptr<DiskUsageIndex>> closing;
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        closing.swap(reg.indexes);
+    }
+    // Saved here, or by the last query still using an index when it returns.
+    closing.clear();
+}
+
+}
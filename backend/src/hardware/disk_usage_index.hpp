@@ -0,0 +1,30 @@
+#pragma once
+
+#include "disk_usage.hpp"
+
+#include <string>
+
+namespace nanookjaro::hardware::disk {
+
+// Disk usage of `root` served from a persisted, per-directory index instead
+// of a fresh walk. The first call scans the tree and saves it under the cache
+// directory; later calls, also from new processes, load it and rescan only
+// directories whose mtime changed. While the process runs the index is kept
+// current with fanotify (FAN_REPORT_DFID_NAME on the whole filesystem, needs
+// CAP_SYS_ADMIN) or a per-directory inotify watch, so a query only rescans the
+// directories that reported changes. `rebuild` forces a full scan.
+//
+// Revalidation on load compares directory mtimes only. A file that grew in
+// place while no process was watching leaves its directory's mtime alone,
+// so its size stays stale until a rebuild; while watching, a file's new size
+// is picked up when the writer closes it. The largest_files list holds the
+// largest file of each directory.
+std::string disk_usage_index_json(const std::string& root, const DiskUsageOptions& options, bool rebuild);
+
+// Stops every watcher and writes the indexes to disk; the next query starts
+// from the saved file. An index that a running query is using is closed
+// when that query returns. Open indexes are also closed when the library is
+// unloaded.
+void close_disk_usage_indexes();
+
+}
@@ -0,0 +1,447 @@
+#include "duplicate_finder.hpp"
+#include "../common/directory_entries.hpp"
+#include "../common/hash.hpp"
+#include "../common/work_stealing.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanookjaro::hardware::disk {
+
+namespace {
+
+constexpr std::size_t kReadChunk = 1024 * 1024;
+
+struct FileEntry {
+    std::string path;
+    unsigned long long size = 0;
+    unsigned long long allocated = 0;
+    std::uint64_t inode = 0;
+};
+
+// One inode among the candidates, with the hashes of the later stages.
+struct Unit {
+    unsigned long long size = 0;
+    unsigned long long allocated = 0;
+    std::uint64_t inode = 0;
+    std::size_t first_path = 0;  // range into the sorted file list
+    std::size_t path_count = 0;
+    std::uint64_t edge_hash = 0;
+    std::uint64_t full_hash = 0;
+    bool fully_hashed = false;
+    bool readable = true;
+};
+
+struct WalkState {
+    std::vector<FileEntry> files;
+    std::vector<char> buffer;
+    unsigned long long errors = 0;
+};
+
+std::string join_path(const std::string& directory, std::string_view name) {
+    std::string path;
+    path.reserve(directory.size() + name.size() + 1);
+    path.append(directory);
+    if (path.empty() || path.back() != '/') {
+        path.push_back('/');
+    }
+    path.append(name);
+    return path;
+}
+
+void list_directory(const std::string& path, WalkState& state, dev_t device, unsigned long long min_size,
+                    const std::function<void(std::string)>& push) {
+    const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        ++state.errors;
+        return;
+    }
+    const bool listed = common::for_each_directory_entry(fd, state.buffer, [&](const char* name, unsigned char type) {
+        // Symlinks, sockets and devices never hold duplicate data.
+        if (type != DT_REG && type != DT_DIR && type != DT_UNKNOWN) {
+            return;
+        }
+        struct stat st {};
+        if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            ++state.errors;
+            return;
+        }
+        if (st.st_dev != device) {
+            return;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            push(join_path(path, name));
+        } else if (S_ISREG(st.st_mode) && static_cast<unsigned long long>(st.st_size) >= min_size) {
+            state.files.push_back(FileEntry{join_path(path, name), static_cast<unsigned long long>(st.st_size),
+                                            static_cast<unsigned long long>(st.st_blocks) * 512ULL, st.st_ino});
+        }
+    });
+    if (!listed) {
+        ++state.errors;
+    }
+    close(fd);
+}
+
+int open_for_hashing(const std::string& path) {
+    // O_NOATIME keeps a scan from rewriting every inode, but is only allowed
+    // on files we own.
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+        fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    }
+    return fd;
+}
+
+bool read_exact(int fd, char* data, std::size_t size, off_t offset) {
+    std::size_t done = 0;
+    while (done < size) {
+        const ssize_t n = pread(fd, data + done, size - done, offset + static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+// Stage two: hash of the first and last edge bytes. Files no longer than
+// two edges are hashed whole here and skip stage three.
+void hash_edges(Unit& unit, const std::string& path, std::size_t edge, std::vector<char>& buffer,
+                std::atomic<unsigned long long>& hashed) {
+    const int fd = open_for_hashing(path);
+    if (fd < 0) {
+        unit.readable = false;
+        return;
+    }
+    if (unit.size <= 2 * edge) {
+        buffer.resize(std::max<std::size_t>(buffer.size(), unit.size));
+        unit.readable = read_exact(fd, buffer.data(), unit.size, 0);
+        unit.full_hash = unit.edge_hash = common::xxh64(buffer.data(), unit.size);
+        unit.fully_hashed = true;
+        hashed.fetch_add(unit.size, std::memory_order_relaxed);
+    } else {
+        buffer.resize(std::max(buffer.size(), 2 * edge));
+        unit.readable = read_exact(fd, buffer.data(), edge, 0) &&
+                        read_exact(fd, buffer.data() + edge, edge, static_cast<off_t>(unit.size - edge));
+        unit.edge_hash = common::xxh64(buffer.data(), 2 * edge, unit.size);
+        hashed.fetch_add(2 * edge, std::memory_order_relaxed);
+    }
+    close(fd);
+}
+
+// Stage three: the whole file in large sequential reads.
+void hash_contents(Unit& unit, const std::string& path, std::vector<char>& buffer,
+                   std::atomic<unsigned long long>& hashed) {
+    const int fd = open_for_hashing(path);
+    if (fd < 0) {
+        unit.readable = false;
+        return;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    buffer.resize(std::max(buffer.size(), kReadChunk));
+    common::Xxh64 hash;
+    unsigned long long offset = 0;
+    while (offset < unit.size) {
+        const std::size_t chunk = static_cast<std::size_t>(std::min<unsigned long long>(kReadChunk, unit.size - offset));
+        if (!read_exact(fd, buffer.data(), chunk, static_cast<off_t>(offset))) {
+            unit.readable = false;
+            break;
+        }
+        hash.update(buffer.data(), chunk);
+        offset += chunk;
+    }
+    hashed.fetch_add(offset, std::memory_order_relaxed);
+    unit.full_hash = hash.digest();
+    unit.fully_hashed = unit.readable;
+    // The data is not needed again; leave the page cache to the user's work.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// Physical address of the first extent when the filesystem reports it as
+// shared (reflinked or deduplicated), else 0.
+std::uint64_t shared_extent(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        return 0;
+    }
+    alignas(fiemap) unsigned char storage[sizeof(fiemap) + sizeof(fiemap_extent)] = {};
+    auto* map = reinterpret_cast<fiemap*>(storage);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    std::uint64_t physical = 0;
+    if (ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents > 0 &&
+        (map->fm_extents[0].fe_flags & FIEMAP_EXTENT_SHARED) != 0) {
+        physical = map->fm_extents[0].fe_physical;
+    }
+    close(fd);
+    return physical;
+}
+
+// Runs fn(worker, unit_index) for every index on the pool.
+template <typename Fn>
+void for_each_unit(const std::vector<std::size_t>& indices, std::size_t threads, Fn&& fn) {
+    common::run_work_stealing(std::vector<std::size_t>(indices), std::min(threads, std::max<std::size_t>(indices.size(), 1)),
+                              [&](std::size_t worker, std::size_t& index, auto&) { fn(worker, index); });
+}
+
+// Indices of units in runs of two or more that agree on `key`.
+template <typename Key>
+std::vector<std::size_t> matching_runs(std::vector<std::size_t> indices, Key key) {
+    std::sort(indices.begin(), indices.end(), [&](std::size_t lhs, std::size_t rhs) { return key(lhs) < key(rhs); });
+    std::vector<std::size_t> kept;
+    for (std::size_t begin = 0; begin < indices.size();) {
+        std::size_t end = begin + 1;
+        while (end < indices.size() && key(indices[end]) == key(indices[begin])) {
+            ++end;
+        }
+        if (end - begin >= 2) {
+            kept.insert(kept.end(), indices.begin() + static_cast<std::ptrdiff_t>(begin),
+                        indices.begin() + static_cast<std::ptrdiff_t>(end));
+        }
+        begin = end;
+    }
+    return kept;
+}
+
+}
+
+DuplicateReport find_duplicates(const std::string& root, const DuplicateOptions& options) {
+    DuplicateReport report;
+    report.root = root.size() > 1 && root.back() == '/' ? root.substr(0, root.find_last_not_of('/') + 1) : root;
+    const auto start = std::chrono::steady_clock::now();
+
+    struct stat root_stat {};
+    if (report.root.empty() || lstat(report.root.c_str(), &root_stat) != 0 || !S_ISDIR(root_stat.st_mode)) {
+        return report;
+    }
+    report.valid = true;
+    const std::size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    report.threads = options.threads > 0 ? options.threads : std::clamp<std::size_t>(hardware * 2, 4, 16);
+    const std::size_t edge = std::max<std::size_t>(options.edge_bytes, 1);
+
+    // Stage one: list every regular file and group by size.
+    std::vector<WalkState> walkers(report.threads);
+    common::run_work_stealing(std::vector<std::string>{report.root}, report.threads,
+                              [&](std::size_t worker, std::string& path, auto& push) {
+                                  list_directory(path, walkers[worker], root_stat.st_dev, options.min_size,
+                                                 [&push](std::string child) { push(std::move(child)); });
+                              });
+    std::vector<FileEntry> files;
+    for (auto& walker : walkers) {
+        report.errors += walker.errors;
+        files.insert(files.end(), std::make_move_iterator(walker.files.begin()),
+                     std::make_move_iterator(walker.files.end()));
+    }
+    report.files_scanned = files.size();
+    std::sort(files.begin(), files.end(), [](const FileEntry& lhs, const FileEntry& rhs) {
+        return lhs.size != rhs.size ? lhs.size > rhs.size : lhs.inode < rhs.inode;
+    });
+
+    std::vector<Unit> units;
+    for (std::size_t i = 0; i < files.size();) {
+        std::size_t end = i + 1;
+        while (end < files.size() && files[end].size == files[i].size && files[end].inode == files[i].inode) {
+            ++end;
+        }
+        report.bytes_scanned += files[i].allocated;
+        report.hardlinked_paths += end - i - 1;
+        Unit unit;
+        unit.size = files[i].size;
+        unit.allocated = files[i].allocated;
+        unit.inode = files[i].inode;
+        unit.first_path = i;
+        unit.path_count = end - i;
+        units.push_back(unit);
+        i = end;
+    }
+
+    std::vector<std::size_t> all(units.size());
+    for (std::size_t i = 0; i < units.size(); ++i) {
+        all[i] = i;
+    }
+    std::vector<std::size_t> candidates = matching_runs(all, [&](std::size_t i) { return units[i].size; });
+    report.size_candidates = candidates.size();
+
+    const auto hash_start = std::chrono::steady_clock::now();
+    std::atomic<unsigned long long> hashed{0};
+    std::vector<std::vector<char>> buffers(report.threads);
+
+    // Stage two: first and last edge bytes.
+    for_each_unit(candidates, report.threads, [&](std::size_t worker, std::size_t index) {
+        hash_edges(units[index], files[units[index].first_path].path, edge, buffers[worker], hashed);
+    });
+    auto drop_unreadable = [&](std::vector<std::size_t>& indices) {
+        const std::size_t before = indices.size();
+        indices.erase(std::remove_if(indices.begin(), indices.end(), [&](std::size_t i) { return !units[i].readable; }),
+                      indices.end());
+        report.errors += before - indices.size();
+    };
+    drop_unreadable(candidates);
+    candidates = matching_runs(candidates,
+                               [&](std::size_t i) { return std::make_pair(units[i].size, units[i].edge_hash); });
+    report.edge_candidates = candidates.size();
+
+    // Stage three: full contents of whatever still collides.
+    std::vector<std::size_t> pending;
+    for (const std::size_t index : candidates) {
+        if (!units[index].fully_hashed) {
+            pending.push_back(index);
+        }
+    }
+    report.full_hashed = pending.size();
+    for_each_unit(pending, report.threads, [&](std::size_t worker, std::size_t index) {
+        hash_contents(units[index], files[units[index].first_path].path, buffers[worker], hashed);
+    });
+    drop_unreadable(candidates);
+
+    report.bytes_hashed = hashed.load();
+    report.hash_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - hash_start).count();
+    if (report.hash_seconds > 0.0) {
+        report.hash_gb_per_second = static_cast<double>(report.bytes_hashed) / report.hash_seconds / 1e9;
+    }
+
+    // Final groups: equal size and full hash.
+    std::sort(candidates.begin(), candidates.end(), [&](std::size_t lhs, std::size_t rhs) {
+        return std::make_pair(units[lhs].size, units[lhs].full_hash) < std::make_pair(units[rhs].size, units[rhs].full_hash);
+    });
+    for (std::size_t begin = 0; begin < candidates.size();) {
+        std::size_t end = begin + 1;
+        const Unit& first = units[candidates[begin]];
+        while (end < candidates.size() && units[candidates[end]].size == first.size &&
+               units[candidates[end]].full_hash == first.full_hash) {
+            ++end;
+        }
+        if (end - begin < 2) {
+            begin = end;
+            continue;
+        }
+
+        DuplicateGroup group;
+        group.size = first.size;
+        group.hash = first.full_hash;
+        // Copies sharing their first extent are one piece of storage.
+        std::map<std::uint64_t, std::size_t> clones;  // shared extent -> copies on it
+        std::vector<std::uint64_t> extents;
+        for (std::size_t k = begin; k < end; ++k) {
+            const Unit& unit = units[candidates[k]];
+            DuplicateCopy copy;
+            copy.inode = unit.inode;
+            for (std::size_t p = 0; p < unit.path_count; ++p) {
+                copy.paths.push_back(files[unit.first_path + p].path);
+            }
+            extents.push_back(shared_extent(copy.paths.front()));
+            if (extents.back() != 0) {
+                ++clones[extents.back()];
+            }
+            group.copies.push_back(std::move(copy));
+        }
+        unsigned long long stored = 0;
+        unsigned long long largest = 0;
+        std::map<std::uint64_t, bool> counted;
+        for (std::size_t k = 0; k < group.copies.size(); ++k) {
+            const Unit& unit = units[candidates[begin + k]];
+            const bool cloned = extents[k] != 0 && clones[extents[k]] > 1;
+            group.copies[k].shares_extents = cloned;
+            if (cloned && !counted.emplace(extents[k], true).second) {
+                ++report.reflinked_copies;  // its storage is already counted
+                continue;
+            }
+            stored += unit.allocated;
+            largest = std::max(largest, unit.allocated);
+        }
+        // Keeping the largest stored copy, deleting the rest frees this much.
+        group.reclaimable_bytes = stored - largest;
+
+        ++report.duplicate_groups;
+        report.duplicate_files += group.copies.size() - 1;
+        report.reclaimable_bytes += group.reclaimable_bytes;
+        report.groups.push_back(std::move(group));
+        begin = end;
+    }
+
+    std::sort(report.groups.begin(), report.groups.end(), [](const DuplicateGroup& lhs, const DuplicateGroup& rhs) {
+        return lhs.reclaimable_bytes != rhs.reclaimable_bytes ? lhs.reclaimable_bytes > rhs.reclaimable_bytes
+                                                              : lhs.size > rhs.size;
+    });
+    if (report.groups.size() > options.max_groups) {
+        report.groups.resize(options.max_groups);
+    }
+
+    report.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+std::string duplicates_to_json(const DuplicateReport& report) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"root\":\"" << common::escape_json(report.root) << "\",";
+    json << "\"valid\":" << (report.valid ? "true" : "false") << ",";
+    json << "\"files_scanned\":" << report.files_scanned << ",";
+    json << "\"bytes_scanned\":" << report.bytes_scanned << ",";
+    json << "\"size_candidates\":" << report.size_candidates << ",";
+    json << "\"edge_candidates\":" << report.edge_candidates << ",";
+    json << "\"full_hashed\":" << report.full_hashed << ",";
+    json << "\"duplicate_groups\":" << report.duplicate_groups << ",";
+    json << "\"duplicate_files\":" << report.duplicate_files << ",";
+    json << "\"reclaimable_bytes\":" << report.reclaimable_bytes << ",";
+    json << "\"hardlinked_paths\":" << report.hardlinked_paths << ",";
+    json << "\"reflinked_copies\":" << report.reflinked_copies << ",";
+    json << "\"bytes_hashed\":" << report.bytes_hashed << ",";
+    json << "\"errors\":" << report.errors << ",";
+    json << "\"threads\":" << report.threads << ",";
+    json << "\"hash_seconds\":" << std::fixed << std::setprecision(3) << report.hash_seconds << ",";
+    json << "\"hash_gb_per_second\":" << std::fixed << std::setprecision(2) << report.hash_gb_per_second << ",";
+    json << "\"elapsed_ms\":" << std::fixed << std::setprecision(2) << report.elapsed_ms << ",";
+    json << "\"groups\":[";
+    for (size_t i = 0; i < report.groups.size(); ++i) {
+        if (i > 0) json << ",";
+        const auto& group = report.groups[i];
+        json << "{";
+        json << "\"size\":" << group.size << ",";
+        json << "\"hash\":\"" << std::hex << std::setw(16) << std::setfill('0') << group.hash << std::dec
+             << std::setfill(' ') << "\",";
+        json << "\"reclaimable_bytes\":" << group.reclaimable_bytes << ",";
+        json << "\"copies\":[";
+        for (size_t j = 0; j < group.copies.size(); ++j) {
+            if (j > 0) json << ",";
+            const auto& copy = group.copies[j];
+            json << "{\"inode\":" << copy.inode << ",";
+            json << "\"shares_extents\":" << (copy.shares_extents ? "true" : "false") << ",";
+            json << "\"paths\":[";
+            for (size_t k = 0; k < copy.paths.size(); ++k) {
+                if (k > 0) json << ",";
+                json << "\"" << common::escape_json(copy.paths[k]) << "\"";
+            }
+            json << "]}";
+        }
+        json << "]}";
+    }
+    json << "]";
+    json << "}";
+    return json.str();
+}
+
+}
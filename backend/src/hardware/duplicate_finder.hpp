@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nanookjaro::hardware::disk {
+
+struct DuplicateOptions {
+    std::size_t max_groups = 50;           // groups listed in the report; totals cover all of them
+    unsigned long long min_size = 1;       // smaller files are ignored (empty files by default)
+    std::size_t threads = 0;               // 0 picks a default suited to I/O-bound hashing
+    std::size_t edge_bytes = 4096;         // bytes hashed at each end in the second stage
+};
+
+// One stored copy of the content: an inode with every path that links to it.
+struct DuplicateCopy {
+    std::uint64_t inode = 0;
+    std::vector<std::string> paths;
+    bool shares_extents = false;  // reflinked with another copy in the group
+};
+
+struct DuplicateGroup {
+    unsigned long long size = 0;
+    unsigned long long reclaimable_bytes = 0;
+    std::uint64_t hash = 0;
+    std::vector<DuplicateCopy> copies;
+};
+
+struct DuplicateReport {
+    std::string root;
+    bool valid = false;
+    unsigned long long files_scanned = 0;
+    unsigned long long bytes_scanned = 0;
+    unsigned long long size_candidates = 0;   // files sharing their size with another inode
+    unsigned long long edge_candidates = 0;   // ... and their first/last edge_bytes
+    unsigned long long full_hashed = 0;
+    unsigned long long duplicate_groups = 0;
+    unsigned long long duplicate_files = 0;   // copies beyond the first in every group
+    unsigned long long reclaimable_bytes = 0;
+    unsigned long long hardlinked_paths = 0;  // extra names of an inode, never counted as duplicates
+    unsigned long long reflinked_copies = 0;  // copies whose extents are shared, so deleting them frees nothing
+    unsigned long long bytes_hashed = 0;
+    unsigned long long errors = 0;
+    double hash_seconds = 0.0;
+    double hash_gb_per_second = 0.0;
+    std::size_t threads = 0;
+    double elapsed_ms = 0.0;
+    std::vector<DuplicateGroup> groups;  // largest reclaimable first
+};
+
+// Finds files with identical content below `root`, staying on its
+// filesystem. Candidates are narrowed by size, then by an XXH64 of the first
+// and last edge_bytes, and only the survivors are hashed in full, reading
+// with pread on a work-stealing pool. Hard links are one copy; copies whose
+// first extent is shared (reflinks) are reported but not counted as
+// reclaimable.
+DuplicateReport find_duplicates(const std::string& root, const DuplicateOptions& options = {});
+std::string duplicates_to_json(const DuplicateReport& report);
+
+}
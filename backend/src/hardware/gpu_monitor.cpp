@@ -1,6 +1,5 @@
 #include "gpu_monitor.hpp"
-#include <array>
-#include <cstdio>
+#include "../common/subprocess.hpp"
 #include <cstdlib>
 #include <fstream>
 #include <iomanip>
@@ -8,50 +7,38 @@
 #include <sstream>
 #include <string>
 #include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <vector>
 
 namespace nanookjaro::hardware::gpu {
 
 namespace {
     
-std::string escape_json(const std::string& input) {
-    std::string output;
-    output.reserve(input.size());
-    for (char c : input) {
-        switch (c) {
-            case '"':
-                output += "\\\"";
-                break;
-            case '\\':
-                output += "\\\\";
-                break;
-            case '\n':
-                output += "\\n";
-                break;
-            case '\r':
-                output += "\\r";
-                break;
-            case '\t':
-                output += "\\t";
-                break;
-            default:
-                output += c;
-                break;
+std::string run_tool(const std::vector<std::string>& argv) {
+    common::SubprocessOptions options;
+    options.timeout = std::chrono::seconds(5);
+    common::SubprocessResult result = common::run_subprocess(argv, options);
+    return result.exit_code == 0 ? std::move(result.out) : std::string();
+}
+
+// Keeps the lines of `text` for which `keep` is true, newline-terminated.
+template <typename Predicate>
+std::string filter_lines(const std::string& text, Predicate keep) {
+    std::string filtered;
+    std::istringstream stream(text);
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (keep(line)) {
+            filtered.append(line).push_back('\n');
         }
     }
-    return output;
+    return filtered;
 }
 
-std::string exec_command(const char* cmd) {
-    std::array<char, 128> buffer{};
-    std::string result;
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd, "r"), pclose);
-    if (!pipe) {
-        return "";
-    }
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-        result += buffer.data();
-    }
-    return result;
+bool is_display_class(std::string_view line) {
+    return line.find("VGA") != std::string_view::npos || line.find("3D") != std::string_view::npos ||
+           line.find("Display") != std::string_view::npos;
 }
 
 }
@@ -59,7 +46,17 @@ std::string exec_command(const char* cmd) {
 std::vector<GpuInfo> get_gpu_info() {
     std::vector<GpuInfo> gpus;
     
-    std::string lspci_output = exec_command("lspci -mm -d '*:*' | grep -E '\"(VGA|3D|Display).*Controller\"' 2>/dev/null");
+    // Same selection as grep -E '"(VGA|3D|Display).*Controller"' on the
+    // machine-readable listing.
+    std::string lspci_output = filter_lines(run_tool({"lspci", "-mm", "-d", "*:*"}), [](const std::string& line) {
+        for (const char* kind : {"\"VGA", "\"3D", "\"Display"}) {
+            const auto start = line.find(kind);
+            if (start != std::string::npos && line.find("Controller\"", start) != std::string::npos) {
+                return true;
+            }
+        }
+        return false;
+    });
     
     if (!lspci_output.empty()) {
         std::istringstream iss(lspci_output);
@@ -107,7 +104,7 @@ std::vector<GpuInfo> get_gpu_info() {
     }
     
     if (gpus.empty()) {
-        std::string lspci_simple = exec_command("lspci | grep -E '(VGA|3D|Display)' 2>/dev/null");
+        std::string lspci_simple = filter_lines(run_tool({"lspci"}), is_display_class);
         if (!lspci_simple.empty()) {
             std::istringstream iss(lspci_simple);
             std::string line;
@@ -128,7 +125,7 @@ std::vector<GpuInfo> get_gpu_info() {
     }
     
     if (gpus.empty()) {
-        std::string nvidia_smi = exec_command("nvidia-smi --query-gpu=name --format=csv,noheader,nounits 2>/dev/null");
+        std::string nvidia_smi = run_tool({"nvidia-smi", "--query-gpu=name", "--format=csv,noheader,nounits"});
         if (!nvidia_smi.empty()) {
             std::istringstream iss(nvidia_smi);
             std::string line;
@@ -168,22 +165,7 @@ std::vector<GpuInfo> get_gpu_info() {
 }
 
 std::string gpu_info_to_json(const std::vector<GpuInfo>& gpus) {
-    std::ostringstream json;
-    json << "[";
-    for (size_t i = 0; i < gpus.size(); ++i) {
-        if (i > 0) json << ",";
-        const auto& gpu = gpus[i];
-        json << "{";
-        json << "\"name\":\"" << escape_json(gpu.name) << "\",";
-        json << "\"vendor\":\"" << escape_json(gpu.vendor) << "\",";
-        json << "\"driver_version\":\"" << escape_json(gpu.driver_version) << "\",";
-        json << "\"memory_mb\":" << gpu.memory_mb << ",";
-        json << "\"usage_percent\":" << std::fixed << std::setprecision(2) << gpu.usage_percent << ",";
-        json << "\"temperature_celsius\":" << std::fixed << std::setprecision(2) << gpu.temperature_celsius;
-        json << "}";
-    }
-    json << "]";
-    return json.str();
+    return common::to_json_array(gpus);
 }
 
 }
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include "../common/fields.hpp"
+
 namespace nanookjaro::hardware::gpu {
 
 struct GpuInfo {
@@ -14,6 +18,17 @@ struct GpuInfo {
     double temperature_celsius;
 };
 
+constexpr auto metric_fields(std::type_identity<GpuInfo>) {
+    return std::tuple{
+        common::Field{"name", &GpuInfo::name},
+        common::Field{"vendor", &GpuInfo::vendor},
+        common::Field{"driver_version", &GpuInfo::driver_version},
+        common::Field{"memory_mb", &GpuInfo::memory_mb, "MiB"},
+        common::Field{"usage_percent", &GpuInfo::usage_percent, "%"},
+        common::Field{"temperature_celsius", &GpuInfo::temperature_celsius, "°C"},
+    };
+}
+
 std::vector<GpuInfo> get_gpu_info();
 std::string gpu_info_to_json(const std::vector<GpuInfo>& gpus);
 
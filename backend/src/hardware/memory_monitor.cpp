@@ -1,7 +1,6 @@
 #include <string>
 #include <fstream>
 #include <sstream>
-#include <iomanip>
 
 #include "memory_monitor.hpp"
 
@@ -69,16 +68,7 @@ MemoryInfo get_memory_info() {
 }
 
 std::string memory_info_to_json(const MemoryInfo& info) {
-    std::ostringstream json;
-    json << "{";
-    json << "\"total_mb\":" << info.total_mb << ",";
-    json << "\"used_mb\":" << info.used_mb << ",";
-    json << "\"available_mb\":" << info.available_mb << ",";
-    json << "\"swap_total_mb\":" << info.swap_total_mb << ",";
-    json << "\"swap_used_mb\":" << info.swap_used_mb << ",";
-    json << "\"swap_available_mb\":" << info.swap_available_mb;
-    json << "}";
-    return json.str();
+    return common::to_json(info);
 }
 
 }
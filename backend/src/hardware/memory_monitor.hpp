@@ -1,6 +1,10 @@
 #pragma once
 
 #include <string>
+#include <tuple>
+#include <type_traits>
+
+#include "../common/fields.hpp"
 
 namespace nanookjaro::hardware::memory {
 
@@ -13,6 +17,17 @@ struct MemoryInfo {
     long long swap_available_mb;
 };
 
+constexpr auto metric_fields(std::type_identity<MemoryInfo>) {
+    return std::tuple{
+        common::Field{"total_mb", &MemoryInfo::total_mb, "MiB"},
+        common::Field{"used_mb", &MemoryInfo::used_mb, "MiB"},
+        common::Field{"available_mb", &MemoryInfo::available_mb, "MiB"},
+        common::Field{"swap_total_mb", &MemoryInfo::swap_total_mb, "MiB"},
+        common::Field{"swap_used_mb", &MemoryInfo::swap_used_mb, "MiB"},
+        common::Field{"swap_available_mb", &MemoryInfo::swap_available_mb, "MiB"},
+    };
+}
+
 MemoryInfo get_memory_info();
 std::string memory_info_to_json(const MemoryInfo& info);
 
@@ -0,0 +1,336 @@
+#include "dependency_graph.hpp"
+#include "vercmp.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+namespace nanookjaro::package_manager {
+
+namespace {
+
+// Parsed depends/provides of one database entry ("name-version"). Entries
+// are immutable once installed, so these survive across graph rebuilds.
+struct ParsedEntry {
+    std::vector<DependencySpec> depends;
+    std::vector<DependencySpec> provides;
+};
+
+struct GraphCache {
+    std::mutex mutex;
+    std::shared_ptr<const DependencyGraph> graph;
+    std::unordered_map<std::string, std::shared_ptr<const ParsedEntry>> entries;
+};
+
+GraphCache& graph_cache_for(const std::string& db_path) {
+    static std::mutex registry_mutex;
+    static std::map<std::string, std::unique_ptr<GraphCache>> registry;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& slot = registry[db_path];
+    if (!slot) {
+        slot = std::make_unique<GraphCache>();
+    }
+    return *slot;
+}
+
+std::shared_ptr<const ParsedEntry> parse_entry(const PackageInfo& package) {
+    auto entry = std::make_shared<ParsedEntry>();
+    entry->depends.reserve(package.depends.size());
+    for (const auto& depend : package.depends) {
+        entry->depends.push_back(parse_dependency(depend));
+    }
+    entry->provides.reserve(package.provides.size());
+    for (const auto& provide : package.provides) {
+        entry->provides.push_back(parse_dependency(provide));
+    }
+    return entry;
+}
+
+// Turns per-row target lists into offsets + one flat array.
+void to_csr(const std::vector<std::vector<std::uint32_t>>& rows, std::vector<std::uint32_t>& offsets,
+            std::vector<std::uint32_t>& targets) {
+    offsets.assign(rows.size() + 1, 0);
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        offsets[i + 1] = offsets[i] + static_cast<std::uint32_t>(rows[i].size());
+    }
+    targets.clear();
+    targets.reserve(offsets.back());
+    for (const auto& row : rows) {
+        targets.insert(targets.end(), row.begin(), row.end());
+    }
+}
+
+void append_names(std::ostringstream& json, const DependencyGraph& graph, const std::vector<std::uint32_t>& ids) {
+    json << "[";
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "\"" << common::escape_json(graph.name(ids[i])) << "\"";
+    }
+    json << "]";
+}
+
+void append_names(std::ostringstream& json, const DependencyGraph& graph, std::span<const std::uint32_t> ids) {
+    append_names(json, graph, std::vector<std::uint32_t>(ids.begin(), ids.end()));
+}
+
+}
+
+DependencySpec parse_dependency(std::string_view text) {
+    text = text.substr(0, text.find(": "));
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    DependencySpec spec;
+    const std::size_t op = text.find_first_of("<>=");
+    if (op == std::string_view::npos) {
+        spec.name = std::string(text);
+        return spec;
+    }
+    spec.name = std::string(text.substr(0, op));
+    const std::size_t version = (op + 1 < text.size() && text[op + 1] == '=') ? op + 2 : op + 1;
+    spec.op = std::string(text.substr(op, version - op));
+    spec.version = std::string(text.substr(version));
+    return spec;
+}
+
+bool version_satisfies(const DependencySpec& spec, std::string_view version) {
+    if (spec.op.empty()) {
+        return true;
+    }
+    const int order = vercmp(version, spec.version);
+    if (spec.op == "=") return order == 0;
+    if (spec.op == ">=") return order >= 0;
+    if (spec.op == "<=") return order <= 0;
+    if (spec.op == ">") return order > 0;
+    if (spec.op == "<") return order < 0;
+    return false;
+}
+
+std::uint32_t DependencyGraph::find(std::string_view name) const {
+    if (const auto it = ids_.find(name); it != ids_.end()) {
+        return it->second;
+    }
+    if (const auto it = providers_.find(name); it != providers_.end() && !it->second.empty()) {
+        return it->second.front();
+    }
+    return kNotFound;
+}
+
+std::span<const std::uint32_t> DependencyGraph::depends(std::uint32_t id) const {
+    return {depends_targets_.data() + depends_offsets_[id], depends_offsets_[id + 1] - depends_offsets_[id]};
+}
+
+std::span<const std::uint32_t> DependencyGraph::required_by(std::uint32_t id) const {
+    return {required_targets_.data() + required_offsets_[id], required_offsets_[id + 1] - required_offsets_[id]};
+}
+
+std::vector<std::uint32_t> DependencyGraph::orphans() const {
+    std::vector<std::uint32_t> result;
+    for (std::uint32_t id = 0; id < size(); ++id) {
+        if (!package(id).explicitly_installed && required_offsets_[id] == required_offsets_[id + 1]) {
+            result.push_back(id);
+        }
+    }
+    return result;
+}
+
+std::vector<std::uint32_t> DependencyGraph::reverse_closure(std::uint32_t id) const {
+    std::vector<std::uint32_t> result;
+    if (id >= size()) {
+        return result;
+    }
+    std::vector<char> seen(size(), 0);
+    seen[id] = 1;
+    std::vector<std::uint32_t> work{id};
+    while (!work.empty()) {
+        const std::uint32_t current = work.back();
+        work.pop_back();
+        for (const std::uint32_t requirer : required_by(current)) {
+            if (!seen[requirer]) {
+                seen[requirer] = 1;
+                result.push_back(requirer);
+                work.push_back(requirer);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<std::uint32_t> DependencyGraph::removable_with(std::uint32_t id) const {
+    std::vector<std::uint32_t> result;
+    if (id >= size()) {
+        return result;
+    }
+    std::vector<char> removed(size(), 0);
+    removed[id] = 1;
+    result.push_back(id);
+    // A dependency still needed by a survivor is revisited once that
+    // survivor is removed, because its own depends are scanned then.
+    std::vector<std::uint32_t> work{id};
+    while (!work.empty()) {
+        const std::uint32_t current = work.back();
+        work.pop_back();
+        for (const std::uint32_t dependency : depends(current)) {
+            if (removed[dependency] || package(dependency).explicitly_installed) {
+                continue;
+            }
+            const auto requirers = required_by(dependency);
+            const bool needed = std::any_of(requirers.begin(), requirers.end(),
+                                            [&](std::uint32_t requirer) { return !removed[requirer]; });
+            if (!needed) {
+                removed[dependency] = 1;
+                result.push_back(dependency);
+                work.push_back(dependency);
+            }
+        }
+    }
+    std::sort(result.begin() + 1, result.end());
+    return result;
+}
+
+std::shared_ptr<const DependencyGraph> local_dependency_graph(const std::string& db_path) {
+    const auto database = read_local_database(db_path);
+    GraphCache& cache = graph_cache_for(db_path);
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.graph && cache.graph->database_ == database) {
+        return cache.graph;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto graph = std::make_shared<DependencyGraph>();
+    graph->database_ = database;
+    graph->generation_ = database->generation;
+    const auto& packages = database->packages;
+    const std::size_t count = packages.size();
+
+    std::unordered_map<std::string, std::shared_ptr<const ParsedEntry>> entries;
+    entries.reserve(count);
+    std::vector<const ParsedEntry*> parsed(count);
+    graph->names_.reserve(count);
+    graph->ids_.reserve(count);
+    for (std::uint32_t id = 0; id < count; ++id) {
+        const PackageInfo& package = packages[id];
+        auto it = cache.entries.find(package.db_entry);
+        auto entry = it != cache.entries.end() ? it->second : parse_entry(package);
+        parsed[id] = entry.get();
+        entries.emplace(package.db_entry, std::move(entry));
+        graph->names_.push_back(package.name);
+        graph->ids_.emplace(package.name, id);
+    }
+    // Keys view the raw "name=version" strings of the snapshot, whose prefix
+    // is the parsed name.
+    for (std::uint32_t id = 0; id < count; ++id) {
+        for (std::size_t i = 0; i < parsed[id]->provides.size(); ++i) {
+            const std::string_view raw = packages[id].provides[i];
+            graph->providers_[raw.substr(0, parsed[id]->provides[i].name.size())].push_back(id);
+        }
+    }
+
+    std::vector<std::vector<std::uint32_t>> depends(count);
+    std::vector<std::vector<std::uint32_t>> required(count);
+    for (std::uint32_t id = 0; id < count; ++id) {
+        for (const DependencySpec& spec : parsed[id]->depends) {
+            std::uint32_t target = DependencyGraph::kNotFound;
+            if (const auto it = graph->ids_.find(spec.name);
+                it != graph->ids_.end() && version_satisfies(spec, packages[it->second].version)) {
+                target = it->second;
+            } else if (const auto providers = graph->providers_.find(spec.name); providers != graph->providers_.end()) {
+                // A versioned dependency is only met by a versioned provide.
+                for (const std::uint32_t provider : providers->second) {
+                    const bool satisfied =
+                        std::any_of(parsed[provider]->provides.begin(), parsed[provider]->provides.end(),
+                                    [&](const DependencySpec& provide) {
+                                        return provide.name == spec.name &&
+                                               (spec.op.empty() ||
+                                                (provide.op == "=" && version_satisfies(spec, provide.version)));
+                                    });
+                    if (satisfied) {
+                        target = provider;
+                        break;
+                    }
+                }
+            }
+            if (target == DependencyGraph::kNotFound) {
+                ++graph->unresolved_;
+            } else {
+                depends[id].push_back(target);
+            }
+        }
+        auto& row = depends[id];
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+        for (const std::uint32_t target : row) {
+            required[target].push_back(id);
+        }
+    }
+    to_csr(depends, graph->depends_offsets_, graph->depends_targets_);
+    to_csr(required, graph->required_offsets_, graph->required_targets_);
+
+    graph->build_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    cache.entries = std::move(entries);
+    cache.graph = graph;
+    return graph;
+}
+
+std::string dependency_graph_to_json(const DependencyGraph& graph, const std::string& package) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"valid\":" << (graph.database()->valid ? "true" : "false") << ",";
+    json << "\"generation\":" << graph.generation() << ",";
+    json << "\"packages\":" << graph.size() << ",";
+    json << "\"edges\":" << graph.edge_count() << ",";
+    json << "\"virtual_names\":" << graph.virtual_count() << ",";
+    json << "\"unresolved\":" << graph.unresolved_count() << ",";
+    json << "\"build_ms\":" << std::fixed << std::setprecision(2) << graph.build_ms() << ",";
+
+    const auto orphans = graph.orphans();
+    long long orphan_bytes = 0;
+    for (const std::uint32_t id : orphans) {
+        orphan_bytes += graph.package(id).installed_size;
+    }
+    json << "\"orphan_bytes\":" << orphan_bytes << ",";
+    json << "\"orphans\":";
+    append_names(json, graph, orphans);
+
+    if (!package.empty()) {
+        const std::uint32_t id = graph.find(package);
+        json << ",\"query\":{";
+        json << "\"name\":\"" << common::escape_json(package) << "\",";
+        json << "\"found\":" << (id != DependencyGraph::kNotFound ? "true" : "false");
+        if (id != DependencyGraph::kNotFound) {
+            const auto start = std::chrono::steady_clock::now();
+            const auto closure = graph.reverse_closure(id);
+            const auto removable = graph.removable_with(id);
+            const double query_us =
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            long long removable_bytes = 0;
+            for (const std::uint32_t member : removable) {
+                removable_bytes += graph.package(member).installed_size;
+            }
+            const PackageInfo& info = graph.package(id);
+            json << ",\"package\":\"" << common::escape_json(info.name) << "\",";
+            json << "\"version\":\"" << common::escape_json(info.version) << "\",";
+            json << "\"reason\":\"" << (info.explicitly_installed ? "explicit" : "dependency") << "\",";
+            json << "\"depends\":";
+            append_names(json, graph, graph.depends(id));
+            json << ",\"required_by\":";
+            append_names(json, graph, graph.required_by(id));
+            json << ",\"reverse_closure\":";
+            append_names(json, graph, closure);
+            json << ",\"removable_with\":";
+            append_names(json, graph, removable);
+            json << ",\"removable_bytes\":" << removable_bytes << ",";
+            json << "\"query_us\":" << query_us;
+        }
+        json << "}";
+    }
+    json << "}";
+    return json.str();
+}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "pacman_db.hpp"
+
+namespace nanookjaro::package_manager {
+
+// A "depends"/"provides" entry split into name, comparison and version:
+// "glibc>=2.38" -> {"glibc", ">=", "2.38"}. Optional-dependency descriptions
+// after ": " are dropped.
+struct DependencySpec {
+    std::string name;
+    std::string op;  // empty, "=", "<", "<=", ">" or ">="
+    std::string version;
+};
+
+DependencySpec parse_dependency(std::string_view text);
+
+// Whether `version` satisfies `spec`'s comparison (always true without one).
+bool version_satisfies(const DependencySpec& spec, std::string_view version);
+
+// Immutable dependency graph of the installed packages. Package ids are
+// indices into the database snapshot (sorted by name); edges are stored in
+// compressed sparse rows in both directions, so every query is a walk over
+// flat arrays.
+class DependencyGraph {
+public:
+    static constexpr std::uint32_t kNotFound = 0xffffffff;
+
+    std::size_t size() const { return names_.size(); }
+    std::size_t edge_count() const { return depends_targets_.size(); }
+    std::size_t virtual_count() const { return providers_.size(); }
+    std::size_t unresolved_count() const { return unresolved_; }
+    std::uint64_t generation() const { return generation_; }
+    double build_ms() const { return build_ms_; }
+
+    const std::shared_ptr<const LocalDatabase>& database() const { return database_; }
+    const PackageInfo& package(std::uint32_t id) const { return database_->packages[id]; }
+    std::string_view name(std::uint32_t id) const { return names_[id]; }
+
+    // Package id for a package name, or the first installed provider of a
+    // virtual name; kNotFound otherwise.
+    std::uint32_t find(std::string_view name) const;
+
+    std::span<const std::uint32_t> depends(std::uint32_t id) const;
+    std::span<const std::uint32_t> required_by(std::uint32_t id) const;
+
+    // Installed as a dependency and required by nothing; optional dependencies
+    // do not count (pacman -Qdtt).
+    std::vector<std::uint32_t> orphans() const;
+
+    // Every package that transitively requires `id`, not including `id`.
+    std::vector<std::uint32_t> reverse_closure(std::uint32_t id) const;
+
+    // `id` plus the dependencies that nothing else would need once it is
+    // gone, skipping explicitly installed ones (pacman -Rs).
+    std::vector<std::uint32_t> removable_with(std::uint32_t id) const;
+
+private:
+    friend std::shared_ptr<const DependencyGraph> local_dependency_graph(const std::string& db_path);
+
+    std::shared_ptr<const LocalDatabase> database_;
+    std::vector<std::string_view> names_;  // views into database_
+    std::unordered_map<std::string_view, std::uint32_t> ids_;
+    std::unordered_map<std::string_view, std::vector<std::uint32_t>> providers_;
+    std::vector<std::uint32_t> depends_offsets_;
+    std::vector<std::uint32_t> depends_targets_;
+    std::vector<std::uint32_t> required_offsets_;
+    std::vector<std::uint32_t> required_targets_;
+    std::size_t unresolved_ = 0;
+    std::uint64_t generation_ = 0;
+    double build_ms_ = 0.0;
+};
+
+// Graph of the local database at `db_path`. The graph is cached and rebuilt
+// only when read_local_database() returns a new generation; parsed dependency
+// entries of unchanged packages are carried over, so a rebuild is a single
+// linking pass.
+std::shared_ptr<const DependencyGraph> local_dependency_graph(const std::string& db_path = kDefaultDbPath);
+
+// Graph statistics and orphans; with a non-empty `package`, also its direct
+// and reverse dependencies, the reverse closure and the removable-with set.
+std::string dependency_graph_to_json(const DependencyGraph& graph, const std::string& package);
+
+}
@@ -0,0 +1,495 @@
+#include "file_ownership.hpp"
+#include "../common/hash.hpp"
+#include "../common/mapped_file.hpp"
+#include "../common/parallel.hpp"
+#include "../common/paths.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanookjaro::package_manager {
+
+namespace {
+
+// On-disk layout (host byte order): header, then the u32 arrays
+//   package_names[package_count]  pool offsets of NUL-terminated names
+//   blocks[block_count]           pool offsets of each block of kBlockSize paths
+//   owners[path_count]            package id, or kMultipleOwners | offset into shared[]
+//   shared[shared_count]          runs of {count, id...} for paths with several owners
+// and the string pool. Paths are stored sorted, relative to / and without a
+// trailing slash. Inside a block every path is <varint shared prefix>
+// <varint suffix length><suffix>; the first one shares nothing, so block
+// heads can be compared straight from the pool.
+constexpr char kIndexMagic[8] = {'N', 'J', 'O', 'W', 'N', 'E', 'R', '1'};
+constexpr std::uint32_t kBlockSize = 16;
+constexpr std::uint32_t kMultipleOwners = 0x80000000u;
+
+struct IndexHeader {
+    char magic[8];
+    std::uint64_t source_signature;
+    std::uint32_t package_count;
+    std::uint32_t path_count;
+    std::uint32_t block_count;
+    std::uint32_t shared_count;
+    std::uint32_t pool_size;
+    std::uint32_t reserved;
+};
+
+std::uint64_t source_signature(const std::string& db_path, std::size_t package_count) {
+    struct stat st {};
+    if (stat((db_path + "/local").c_str(), &st) != 0) {
+        return 0;
+    }
+    std::uint64_t signature = 1469598103934665603ULL;
+    for (std::uint64_t value : {static_cast<std::uint64_t>(st.st_mtim.tv_sec),
+                                static_cast<std::uint64_t>(st.st_mtim.tv_nsec),
+                                static_cast<std::uint64_t>(package_count)}) {
+        signature = (signature ^ value) * 1099511628211ULL;
+    }
+    return signature;
+}
+
+void put_varint(std::string& out, std::uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+std::uint32_t get_varint(const char*& p) {
+    std::uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const auto byte = static_cast<unsigned char>(*p++);
+        value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
+
+void put_u32s(std::string& out, const std::vector<std::uint32_t>& values) {
+    out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(std::uint32_t));
+}
+
+// "/usr/bin/" -> "usr/bin"; the form paths are stored in.
+std::string_view normalize(std::string_view path) {
+    while (!path.empty() && path.front() == '/') {
+        path.remove_prefix(1);
+    }
+    while (!path.empty() && path.back() == '/') {
+        path.remove_suffix(1);
+    }
+    return path;
+}
+
+// Lines of the %FILES% section of a local/<entry>/files list.
+void collect_files(std::string_view text, std::uint32_t package, std::vector<std::pair<std::string_view, std::uint32_t>>& out) {
+    const std::size_t section = text.find("%FILES%\n");
+    if (section == std::string_view::npos) {
+        return;
+    }
+    std::size_t pos = section + 8;
+    while (pos < text.size()) {
+        const std::size_t end = std::min(text.find('\n', pos), text.size());
+        const std::string_view line = text.substr(pos, end - pos);
+        if (line.empty()) {
+            break;
+        }
+        if (const std::string_view path = normalize(line); !path.empty()) {
+            out.emplace_back(path, package);
+        }
+        pos = end + 1;
+    }
+}
+
+std::string build_index(const std::string& db_path, const LocalDatabase& database, std::uint64_t signature) {
+    const auto& packages = database.packages;
+    const std::string local_path = db_path + "/local";
+    const int dirfd = open(local_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    std::vector<common::MappedFile> lists(packages.size());
+    std::vector<std::vector<std::pair<std::string_view, std::uint32_t>>> per_package(packages.size());
+    if (dirfd >= 0) {
+        common::parallel_for(packages.size(), [&](std::size_t i) {
+            lists[i] = common::MappedFile(dirfd, (packages[i].db_entry + "/files").c_str());
+            collect_files(lists[i].view(), static_cast<std::uint32_t>(i), per_package[i]);
+        });
+        close(dirfd);
+    }
+
+    std::vector<std::pair<std::string_view, std::uint32_t>> entries;
+    std::size_t total = 0;
+    for (const auto& files : per_package) {
+        total += files.size();
+    }
+    entries.reserve(total);
+    for (auto& files : per_package) {
+        entries.insert(entries.end(), files.begin(), files.end());
+        std::vector<std::pair<std::string_view, std::uint32_t>>().swap(files);
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    std::string pool;
+    std::vector<std::uint32_t> names;
+    names.reserve(packages.size());
+    for (const auto& package : packages) {
+        names.push_back(static_cast<std::uint32_t>(pool.size()));
+        pool.append(package.name).push_back('\0');
+    }
+
+    std::vector<std::uint32_t> blocks;
+    std::vector<std::uint32_t> owners;
+    std::vector<std::uint32_t> shared;
+    std::string_view previous;
+    for (std::size_t i = 0; i < entries.size();) {
+        const std::string_view path = entries[i].first;
+        std::size_t last = i + 1;
+        while (last < entries.size() && entries[last].first == path) {
+            ++last;
+        }
+        if (last - i == 1) {
+            owners.push_back(entries[i].second);
+        } else {
+            owners.push_back(kMultipleOwners | static_cast<std::uint32_t>(shared.size()));
+            shared.push_back(static_cast<std::uint32_t>(last - i));
+            for (std::size_t j = i; j < last; ++j) {
+                shared.push_back(entries[j].second);
+            }
+        }
+
+        std::size_t common_prefix = 0;
+        if ((owners.size() - 1) % kBlockSize == 0) {
+            blocks.push_back(static_cast<std::uint32_t>(pool.size()));
+        } else {
+            const std::size_t limit = std::min(previous.size(), path.size());
+            while (common_prefix < limit && previous[common_prefix] == path[common_prefix]) {
+                ++common_prefix;
+            }
+        }
+        put_varint(pool, static_cast<std::uint32_t>(common_prefix));
+        put_varint(pool, static_cast<std::uint32_t>(path.size() - common_prefix));
+        pool.append(path.substr(common_prefix));
+        previous = path;
+        i = last;
+    }
+
+    IndexHeader header{};
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.source_signature = signature;
+    header.package_count = static_cast<std::uint32_t>(names.size());
+    header.path_count = static_cast<std::uint32_t>(owners.size());
+    header.block_count = static_cast<std::uint32_t>(blocks.size());
+    header.shared_count = static_cast<std::uint32_t>(shared.size());
+    header.pool_size = static_cast<std::uint32_t>(pool.size());
+
+    std::string blob;
+    blob.reserve(sizeof(header) + (names.size() + blocks.size() + owners.size() + shared.size()) * 4 + pool.size());
+    blob.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    put_u32s(blob, names);
+    put_u32s(blob, blocks);
+    put_u32s(blob, owners);
+    put_u32s(blob, shared);
+    blob.append(pool);
+    return blob;
+}
+
+}
+
+// Read-only view over a serialized index, either mapped from the cache file
+// or held in memory when the cache directory is not writable.
+class OwnershipIndex {
+public:
+    static std::unique_ptr<OwnershipIndex> open(const std::string& db_path) {
+        const auto database = read_local_database(db_path);
+        const std::uint64_t signature = source_signature(db_path, database->packages.size());
+        auto index = std::make_unique<OwnershipIndex>();
+        index->signature_ = signature;
+        if (!database->valid) {
+            index->source_ = "unavailable";
+            return index;
+        }
+
+        const std::string cache_dir = common::cache_directory();
+        std::ostringstream name;
+        name << "files-" << std::hex << std::setw(16) << std::setfill('0')
+             << common::xxh64(db_path.data(), db_path.size(), 0) << ".idx";
+        const std::string cache_path = cache_dir.empty() ? std::string() : cache_dir + "/" + name.str();
+        if (!cache_path.empty()) {
+            index->mapped_ = common::MappedFile(cache_path);
+            if (index->attach(index->mapped_.view(), signature)) {
+                index->source_ = "cache";
+                index->file_ = cache_path;
+                return index;
+            }
+            index->mapped_ = common::MappedFile();
+        }
+
+        index->source_ = "built";
+        index->owned_ = build_index(db_path, *database, signature);
+        if (!cache_path.empty() && common::write_file_atomically(cache_path, index->owned_)) {
+            index->mapped_ = common::MappedFile(cache_path);
+            if (index->attach(index->mapped_.view(), signature)) {
+                index->file_ = cache_path;
+                index->owned_.clear();
+                index->owned_.shrink_to_fit();
+                return index;
+            }
+        }
+        index->attach(index->owned_, signature);
+        return index;
+    }
+
+    // Index of `path` in the sorted table, or path_count_ when absent.
+    std::uint32_t find(std::string_view path) const {
+        path = normalize(path);
+        if (block_count_ == 0 || path.empty()) {
+            return path_count_;
+        }
+        // Last block whose head is <= path.
+        std::uint32_t low = 0;
+        std::uint32_t high = block_count_;
+        while (low < high) {
+            const std::uint32_t mid = low + (high - low) / 2;
+            if (block_head(mid) <= path) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        if (low == 0) {
+            return path_count_;
+        }
+        const std::uint32_t block = low - 1;
+        const std::uint32_t first = block * kBlockSize;
+        const std::uint32_t end = std::min(first + kBlockSize, path_count_);
+
+        std::string current;
+        const char* p = pool_ + u32(blocks_, block);
+        for (std::uint32_t i = first; i < end; ++i) {
+            const std::uint32_t shared = get_varint(p);
+            const std::uint32_t suffix = get_varint(p);
+            current.resize(shared);
+            current.append(p, suffix);
+            p += suffix;
+            if (current == path) {
+                return i;
+            }
+            if (std::string_view(current) > path) {
+                break;
+            }
+        }
+        return path_count_;
+    }
+
+    std::vector<std::string> owners(std::uint32_t path_index) const {
+        std::vector<std::string> result;
+        if (path_index >= path_count_) {
+            return result;
+        }
+        const std::uint32_t owner = u32(owners_, path_index);
+        if ((owner & kMultipleOwners) == 0) {
+            result.emplace_back(package_name(owner));
+            return result;
+        }
+        const std::uint32_t offset = owner & ~kMultipleOwners;
+        const std::uint32_t count = u32(shared_, offset);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            result.emplace_back(package_name(u32(shared_, offset + 1 + i)));
+        }
+        return result;
+    }
+
+    // Package id of the first owner, or FileOwnershipLookup::kUnowned.
+    std::uint32_t first_owner(std::uint32_t path_index) const {
+        if (path_index >= path_count_) {
+            return FileOwnershipLookup::kUnowned;
+        }
+        const std::uint32_t owner = u32(owners_, path_index);
+        return (owner & kMultipleOwners) == 0 ? owner : u32(shared_, (owner & ~kMultipleOwners) + 1);
+    }
+
+    std::string_view package_name(std::uint32_t id) const {
+        return id < package_count_ ? std::string_view(pool_ + u32(names_, id)) : std::string_view();
+    }
+
+    bool valid() const { return attached_; }
+    std::uint64_t signature() const { return signature_; }
+    const std::string& source() const { return source_; }
+    const std::string& file() const { return file_; }
+    std::size_t bytes() const { return bytes_; }
+    std::uint32_t package_count() const { return package_count_; }
+    std::uint32_t path_count() const { return path_count_; }
+
+private:
+    bool attach(std::string_view data, std::uint64_t signature) {
+        IndexHeader header{};
+        if (data.size() < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        const std::size_t words = static_cast<std::size_t>(header.package_count) + header.block_count +
+                                  header.path_count + header.shared_count;
+        const std::size_t expected = sizeof(header) + words * sizeof(std::uint32_t) + header.pool_size;
+        if (std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+            header.source_signature != signature || data.size() != expected) {
+            return false;
+        }
+
+        names_ = data.data() + sizeof(header);
+        blocks_ = names_ + header.package_count * sizeof(std::uint32_t);
+        owners_ = blocks_ + header.block_count * sizeof(std::uint32_t);
+        shared_ = owners_ + header.path_count * sizeof(std::uint32_t);
+        pool_ = shared_ + header.shared_count * sizeof(std::uint32_t);
+        package_count_ = header.package_count;
+        path_count_ = header.path_count;
+        block_count_ = header.block_count;
+        bytes_ = data.size();
+        attached_ = true;
+        return true;
+    }
+
+    static std::uint32_t u32(const char* array, std::size_t index) {
+        std::uint32_t value;
+        std::memcpy(&value, array + index * sizeof(value), sizeof(value));
+        return value;
+    }
+
+    std::string_view block_head(std::uint32_t block) const {
+        const char* p = pool_ + u32(blocks_, block);
+        get_varint(p);  // always 0
+        const std::uint32_t length = get_varint(p);
+        return {p, length};
+    }
+
+    common::MappedFile mapped_;
+    std::string owned_;
+    std::string source_;
+    std::string file_;
+    std::uint64_t signature_ = 0;
+    bool attached_ = false;
+    std::size_t bytes_ = 0;
+    const char* names_ = nullptr;
+    const char* blocks_ = nullptr;
+    const char* owners_ = nullptr;
+    const char* shared_ = nullptr;
+    const char* pool_ = nullptr;
+    std::uint32_t package_count_ = 0;
+    std::uint32_t path_count_ = 0;
+    std::uint32_t block_count_ = 0;
+};
+
+namespace {
+
+std::mutex index_mutex;
+std::string index_db_path;
+// Shared so a FileOwnershipLookup keeps its index after a reopen.
+std::shared_ptr<const OwnershipIndex> ownership_index;
+
+// Reopens the index when the database path or its contents changed.
+const std::shared_ptr<const OwnershipIndex>& current_index(const std::string& db_path, bool& reopened) {
+    reopened = false;
+    if (ownership_index && db_path == index_db_path) {
+        const auto database = read_local_database(db_path);
+        if (source_signature(db_path, database->packages.size()) == ownership_index->signature()) {
+            return ownership_index;
+        }
+    }
+    ownership_index = OwnershipIndex::open(db_path);
+    index_db_path = db_path;
+    reopened = true;
+    return ownership_index;
+}
+
+}
+
+FileOwnershipReport find_file_owners(const std::vector<std::string>& paths, const std::string& db_path) {
+    FileOwnershipReport report;
+    std::lock_guard<std::mutex> lock(index_mutex);
+
+    const auto open_start = std::chrono::steady_clock::now();
+    bool reopened = false;
+    const OwnershipIndex& index = *current_index(db_path, reopened);
+    const auto lookup_start = std::chrono::steady_clock::now();
+
+    report.owners.reserve(paths.size());
+    for (const auto& path : paths) {
+        report.owners.push_back(FileOwner{path, index.owners(index.find(path))});
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    report.valid = index.valid();
+    report.source = reopened ? index.source() : "memory";
+    report.file = index.file();
+    report.index_bytes = index.bytes();
+    report.packages = index.package_count();
+    report.paths = index.path_count();
+    report.open_ms = std::chrono::duration<double, std::milli>(lookup_start - open_start).count();
+    report.lookup_ms = std::chrono::duration<double, std::milli>(end - lookup_start).count();
+    return report;
+}
+
+std::string file_owners_to_json(const FileOwnershipReport& report) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"valid\":" << (report.valid ? "true" : "false") << ",";
+    json << "\"source\":\"" << report.source << "\",";
+    json << "\"file\":\"" << common::escape_json(report.file) << "\",";
+    json << "\"index_bytes\":" << report.index_bytes << ",";
+    json << "\"packages\":" << report.packages << ",";
+    json << "\"paths\":" << report.paths << ",";
+    json << "\"open_ms\":" << std::fixed << std::setprecision(2) << report.open_ms << ",";
+    json << "\"lookup_ms\":" << std::fixed << std::setprecision(3) << report.lookup_ms << ",";
+    json << "\"owners\":[";
+    for (size_t i = 0; i < report.owners.size(); ++i) {
+        if (i > 0) json << ",";
+        const auto& owner = report.owners[i];
+        json << "{\"path\":\"" << common::escape_json(owner.path) << "\",\"packages\":[";
+        for (size_t j = 0; j < owner.packages.size(); ++j) {
+            if (j > 0) json << ",";
+            json << "\"" << common::escape_json(owner.packages[j]) << "\"";
+        }
+        json << "]}";
+    }
+    json << "]";
+    json << "}";
+    return json.str();
+}
+
+FileOwnershipLookup::FileOwnershipLookup(const std::string& db_path) {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    bool reopened = false;
+    index_ = current_index(db_path, reopened);
+}
+
+bool FileOwnershipLookup::valid() const {
+    return index_->valid();
+}
+
+std::size_t FileOwnershipLookup::package_count() const {
+    return index_->package_count();
+}
+
+std::uint32_t FileOwnershipLookup::first_owner(std::string_view path) const {
+    return index_->first_owner(index_->find(path));
+}
+
+std::string FileOwnershipLookup::package_name(std::uint32_t id) const {
+    return std::string(index_->package_name(id));
+}
+
+}
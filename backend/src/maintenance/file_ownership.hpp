@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pacman_db.hpp"
+
+namespace nanookjaro::package_manager {
+
+struct FileOwner {
+    std::string path;
+    std::vector<std::string> packages;  // several for shared directories
+};
+
+struct FileOwnershipReport {
+    bool valid = false;
+    std::string source;  // "cache" when the persisted index was mapped, "built" otherwise
+    std::string file;
+    unsigned long long index_bytes = 0;
+    unsigned long long packages = 0;
+    unsigned long long paths = 0;
+    double open_ms = 0.0;
+    double lookup_ms = 0.0;
+    std::vector<FileOwner> owners;  // same order as the queried paths
+};
+
+// Owning packages of absolute `paths`, like `pacman -Qo` for many files at
+// once. The index is built from every local/*/files list into a sorted path
+// table with front-coded blocks, persisted in the user cache directory and
+// mapped on later runs; it is rebuilt when the local database changes. Each
+// lookup is one binary search over the block heads plus a short block scan.
+// Symlinks are not resolved: a path is owned only under the name pacman
+// installed it as.
+FileOwnershipReport find_file_owners(const std::vector<std::string>& paths,
+                                     const std::string& db_path = kDefaultDbPath);
+std::string file_owners_to_json(const FileOwnershipReport& report);
+
+class OwnershipIndex;
+
+// The current ownership index held open for many lookups, such as one per
+// file of a disk walk. Lookups take no lock and may run on several threads.
+class FileOwnershipLookup {
+public:
+    static constexpr std::uint32_t kUnowned = 0xffffffffu;
+
+    explicit FileOwnershipLookup(const std::string& db_path = kDefaultDbPath);
+
+    bool valid() const;
+    std::size_t package_count() const;
+    // Id (below package_count()) of the first package owning `path`, or
+    // kUnowned.
+    std::uint32_t first_owner(std::string_view path) const;
+    std::string package_name(std::uint32_t id) const;
+
+private:
+    std::shared_ptr<const OwnershipIndex> index_;
+};
+
+}
@@ -0,0 +1,404 @@
+#include "job_manager.hpp"
+#include "../common/subprocess.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace nanookjaro::jobs {
+
+namespace {
+
+constexpr std::size_t kBufferedLines = 4096;
+constexpr std::size_t kRetainedFinishedJobs = 32;
+constexpr int kPollIntervalMs = 250;
+
+// `sudo -n` refuses instead of prompting; these are its messages.
+bool contains_password_prompt(std::string_view output) {
+    return output.find("password is required") != std::string_view::npos ||
+           output.find("a password is required") != std::string_view::npos ||
+           output.find("password for") != std::string_view::npos;
+}
+
+std::string join_command(const std::vector<std::string>& argv) {
+    std::string command;
+    for (const auto& arg : argv) {
+        if (!command.empty()) {
+            command += ' ';
+        }
+        command += arg;
+    }
+    return command;
+}
+
+struct Job {
+    std::int64_t id = 0;
+    std::string kind;
+    std::string command;
+    std::string interactive_command;
+    bool retain_output = false;
+    pid_t pid = -1;
+    int output_fd = -1;
+    bool in_process = false;
+    std::atomic<bool> cancel_flag{false};
+
+    std::mutex mutex;
+    std::condition_variable finished_cv;
+    std::deque<std::string> lines;
+    std::uint64_t next_seq = 1;  // sequence number of the next line appended
+    std::string partial;
+    std::string retained;
+    bool finished = false;
+    std::string state = "running";
+    int exit_code = -1;
+    bool requires_password = false;
+
+    bool cancel_requested = false;
+
+    LineCallback callback = nullptr;
+    void* user_data = nullptr;
+};
+
+std::mutex registry_mutex;
+std::map<std::int64_t, std::shared_ptr<Job>> registry;
+std::atomic<std::int64_t> next_job_id{1};
+
+std::shared_ptr<Job> find_job(std::int64_t id) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    const auto it = registry.find(id);
+    return it == registry.end() ? nullptr : it->second;
+}
+
+// Appends one line; the callback runs outside the job lock so it may call
+// back into the job API.
+void append_line(Job& job, std::string line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    LineCallback callback = nullptr;
+    void* user_data = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (contains_password_prompt(line)) {
+            job.requires_password = true;
+        }
+        if (job.retain_output) {
+            job.retained.append(line).push_back('\n');
+        }
+        job.lines.push_back(line);
+        ++job.next_seq;
+        if (job.lines.size() > kBufferedLines) {
+            job.lines.pop_front();
+        }
+        callback = job.callback;
+        user_data = job.user_data;
+    }
+    if (callback) {
+        callback(job.id, line.c_str(), user_data);
+    }
+}
+
+void consume_output(Job& job, std::string_view chunk) {
+    job.partial.append(chunk);
+    std::size_t start = 0;
+    while (true) {
+        const std::size_t newline = job.partial.find('\n', start);
+        if (newline == std::string::npos) {
+            break;
+        }
+        append_line(job, job.partial.substr(start, newline - start));
+        start = newline + 1;
+    }
+    job.partial.erase(0, start);
+}
+
+void finish_job(Job& job, int status) {
+    if (!job.partial.empty()) {
+        append_line(job, std::move(job.partial));
+        job.partial.clear();
+    }
+
+    LineCallback callback = nullptr;
+    void* user_data = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (WIFEXITED(status)) {
+            job.exit_code = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            job.exit_code = 128 + WTERMSIG(status);
+        }
+        if (job.cancel_requested) {
+            job.state = "cancelled";
+        } else {
+            job.state = job.exit_code == 0 ? "succeeded" : "failed";
+        }
+        job.finished = true;
+        callback = job.callback;
+        user_data = job.user_data;
+    }
+    job.finished_cv.notify_all();
+    if (callback) {
+        callback(job.id, nullptr, user_data);
+    }
+}
+
+void run_job(std::shared_ptr<Job> job) {
+    std::array<char, 64 * 1024> buffer{};
+    int status = 0;
+    bool reaped = false;
+
+    while (true) {
+        pollfd pfd{job->output_fd, POLLIN, 0};
+        const int ready = poll(&pfd, 1, kPollIntervalMs);
+        if (ready > 0) {
+            const ssize_t length = read(job->output_fd, buffer.data(), buffer.size());
+            if (length > 0) {
+                consume_output(*job, std::string_view(buffer.data(), static_cast<std::size_t>(length)));
+                continue;
+            }
+            if (length < 0 && errno == EINTR) {
+                continue;
+            }
+            break;  // EOF: every writer has exited or closed the pipe
+        }
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        // A detached grandchild may keep the pipe open after the job exits.
+        if (waitpid(job->pid, &status, WNOHANG) == job->pid) {
+            reaped = true;
+            const int flags = fcntl(job->output_fd, F_GETFL);
+            fcntl(job->output_fd, F_SETFL, flags | O_NONBLOCK);
+            ssize_t length = 0;
+            while ((length = read(job->output_fd, buffer.data(), buffer.size())) > 0) {
+                consume_output(*job, std::string_view(buffer.data(), static_cast<std::size_t>(length)));
+            }
+            break;
+        }
+    }
+    close(job->output_fd);
+
+    while (!reaped) {
+        const pid_t result = waitpid(job->pid, &status, WNOHANG);
+        if (result == job->pid || (result < 0 && errno != EINTR)) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(kPollIntervalMs));
+    }
+    finish_job(*job, status);
+}
+
+void prune_finished_jobs() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::size_t finished = 0;
+    for (const auto& [id, job] : registry) {
+        std::lock_guard<std::mutex> job_lock(job->mutex);
+        finished += job->finished ? 1 : 0;
+    }
+    for (auto it = registry.begin(); it != registry.end() && finished > kRetainedFinishedJobs;) {
+        bool done = false;
+        {
+            std::lock_guard<std::mutex> job_lock(it->second->mutex);
+            done = it->second->finished;
+        }
+        if (done) {
+            it = registry.erase(it);
+            --finished;
+        } else {
+            ++it;
+        }
+    }
+}
+
+}
+
+std::int64_t start_job(const JobSpec& spec) {
+    prune_finished_jobs();
+
+    auto job = std::make_shared<Job>();
+    job->id = next_job_id.fetch_add(1);
+    job->kind = spec.kind;
+    job->command = join_command(spec.argv);
+    job->interactive_command = spec.interactive_command;
+    job->retain_output = spec.retain_output;
+
+    int pipe_fds[2] = {-1, -1};
+    int spawn_error = 0;
+    if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+        spawn_error = errno;
+    } else {
+        spawn_error = common::spawn_in_process_group(spec.argv, pipe_fds[1], pipe_fds[1], job->pid);
+        close(pipe_fds[1]);
+        if (spawn_error != 0) {
+            close(pipe_fds[0]);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.emplace(job->id, job);
+    }
+
+    if (spawn_error != 0) {
+        append_line(*job, "failed to start " + job->command + ": " + std::strerror(spawn_error));
+        finish_job(*job, 127 << 8);
+        return job->id;
+    }
+
+    job->output_fd = pipe_fds[0];
+    std::thread(run_job, job).detach();
+    return job->id;
+}
+
+std::int64_t start_task_job(const std::string& kind, const std::string& command, TaskFunction task) {
+    prune_finished_jobs();
+
+    auto job = std::make_shared<Job>();
+    job->id = next_job_id.fetch_add(1);
+    job->kind = kind;
+    job->command = command;
+    job->in_process = true;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.emplace(job->id, job);
+    }
+
+    std::thread([job, task = std::move(task)]() {
+        int exit_code = 1;
+        try {
+            exit_code = task([&job](std::string line) { append_line(*job, std::move(line)); }, job->cancel_flag);
+        } catch (const std::exception& ex) {
+            append_line(*job, std::string("error: ") + ex.what());
+        } catch (...) {
+            append_line(*job, "error: unknown failure");
+        }
+        finish_job(*job, (exit_code & 0xff) << 8);
+    }).detach();
+    return job->id;
+}
+
+std::string poll_job_json(std::int64_t id, std::uint64_t after_seq, std::size_t max_lines) {
+    const auto job = find_job(id);
+    if (!job) {
+        return "{\"error\":\"unknown_job\"}";
+    }
+
+    std::lock_guard<std::mutex> lock(job->mutex);
+    const std::uint64_t first_seq = job->next_seq - job->lines.size();
+    const std::uint64_t start_seq = std::max(after_seq + 1, first_seq);
+    std::uint64_t end_seq = job->next_seq;
+    if (max_lines > 0 && end_seq - start_seq > max_lines) {
+        end_seq = start_seq + max_lines;
+    }
+
+    std::ostringstream json;
+    json << '{';
+    json << "\"id\":" << job->id << ',';
+    json << "\"kind\":\"" << common::escape_json(job->kind) << "\",";
+    json << "\"state\":\"" << job->state << "\",";
+    json << "\"command\":\"" << common::escape_json(job->command) << "\",";
+    json << "\"interactive_command\":\"" << common::escape_json(job->interactive_command) << "\",";
+    json << "\"exit_code\":" << job->exit_code << ',';
+    json << "\"cancel_pending\":" << (job->cancel_requested && !job->finished ? "true" : "false") << ',';
+    json << "\"requires_password\":" << (job->requires_password ? "true" : "false") << ',';
+    json << "\"dropped\":" << (start_seq > after_seq + 1 ? start_seq - after_seq - 1 : 0) << ',';
+    json << "\"last_seq\":" << (end_seq - 1) << ',';
+    json << "\"lines\":[";
+    for (std::uint64_t seq = start_seq; seq < end_seq; ++seq) {
+        if (seq > start_seq) {
+            json << ',';
+        }
+        json << '"' << common::escape_json(job->lines[seq - first_seq]) << '"';
+    }
+    json << "]";
+    json << '}';
+    return json.str();
+}
+
+bool set_line_callback(std::int64_t id, LineCallback callback, void* user_data) {
+    const auto job = find_job(id);
+    if (!job) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(job->mutex);
+    job->callback = callback;
+    job->user_data = user_data;
+    return true;
+}
+
+bool cancel_job(std::int64_t id) {
+    const auto job = find_job(id);
+    if (!job) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(job->mutex);
+    if (job->finished) {
+        return false;
+    }
+    if (job->cancel_requested) {
+        return false;
+    }
+    job->cancel_requested = true;
+    if (job->in_process) {
+        job->cancel_flag = true;
+    } else {
+        kill(-job->pid, SIGINT);
+    }
+    return true;
+}
+
+bool release_job(std::int64_t id) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    const auto it = registry.find(id);
+    if (it == registry.end()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> job_lock(it->second->mutex);
+        if (!it->second->finished) {
+            return false;
+        }
+    }
+    registry.erase(it);
+    return true;
+}
+
+JobResult wait_for_job(std::int64_t id) {
+    JobResult result;
+    const auto job = find_job(id);
+    if (!job) {
+        result.state = "failed";
+        return result;
+    }
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished_cv.wait(lock, [&job] { return job->finished; });
+    result.kind = job->kind;
+    result.command = job->command;
+    result.interactive_command = job->interactive_command;
+    result.state = job->state;
+    result.exit_code = job->exit_code;
+    result.requires_password = job->requires_password;
+    result.output = job->retained;
+    return result;
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace nanookjaro::jobs {
+
+// Invoked on the job's reader thread for every complete output line, and once
+// more with `line == nullptr` when the job has finished.
+using LineCallback = void (*)(std::int64_t job_id, const char* line, void* user_data);
+
+struct JobSpec {
+    std::string kind;
+    std::vector<std::string> argv;       // argv[0] is looked up in PATH
+    std::string interactive_command;     // what to run in a terminal instead
+    bool retain_output = false;          // keep the full output for wait_for_job()
+};
+
+struct JobResult {
+    std::string kind;
+    std::string command;
+    std::string interactive_command;
+    std::string state;  // "succeeded", "failed" or "cancelled"
+    int exit_code = -1;
+    bool requires_password = false;
+    std::string output;  // only populated when JobSpec::retain_output is set
+};
+
+// Spawns argv in its own process group with stdout/stderr captured through a
+// pipe and returns the job id. A spawn failure still yields a job, finished
+// with exit code 127 and the error as its only output line.
+std::int64_t start_job(const JobSpec& spec);
+
+// Body of an in-process job: `emit` appends one output line and `cancelled`
+// turns true once cancel_job() is called. Returns the job's exit code.
+using TaskFunction =
+    std::function<int(const std::function<void(std::string)>& emit, const std::atomic<bool>& cancelled)>;
+
+// Runs `task` on its own thread as a job, so long-running library work is
+// polled, streamed and cancelled through the same API as spawned commands.
+// `command` is only used for display.
+std::int64_t start_task_job(const std::string& kind, const std::string& command, TaskFunction task);
+
+// Lines with a sequence number greater than `after_seq` (at most `max_lines`,
+// 0 for all buffered), plus the job's state. Only the most recent lines are
+// buffered; "dropped" reports how many the caller missed. Returns an
+// {"error":"unknown_job"} object for ids that do not exist.
+std::string poll_job_json(std::int64_t id, std::uint64_t after_seq, std::size_t max_lines);
+
+bool set_line_callback(std::int64_t id, LineCallback callback, void* user_data);
+
+// Sends SIGINT to the job's process group once; it is never escalated, and
+// the job reports "cancel_pending" until it exits. In-process jobs are asked
+// to stop through their `cancelled` flag. Returns false when the job is
+// unknown, already finished or already being cancelled.
+bool cancel_job(std::int64_t id);
+
+// Forgets a finished job. Running jobs cannot be released.
+bool release_job(std::int64_t id);
+
+// Blocks until the job finishes.
+JobResult wait_for_job(std::int64_t id);
+
+}
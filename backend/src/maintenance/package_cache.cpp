@@ -0,0 +1,434 @@
+#include "package_cache.hpp"
+#include "vercmp.hpp"
+#include "../common/directory_entries.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanookjaro::package_manager {
+
+namespace {
+
+std::string trim(const std::string& value) {
+    const auto begin = value.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return {};
+    }
+    const auto end = value.find_last_not_of(" \t\r\n");
+    return value.substr(begin, end - begin + 1);
+}
+
+bool ends_with(std::string_view text, std::string_view suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+struct ScannedFile {
+    std::size_t directory = 0;
+    std::string filename;
+    unsigned long long bytes = 0;
+    bool has_signature = false;
+    PackageFileName parsed;
+};
+
+struct Scan {
+    std::vector<ScannedFile> packages;
+    std::vector<ScannedFile> partials;  // interrupted downloads and signatures without an archive
+    unsigned long long errors = 0;
+};
+
+// Bytes of the regular files below the directory `name` that can be read.
+// Symlinks are not followed.
+unsigned long long tree_bytes(int dirfd, const char* name) {
+    const int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    unsigned long long bytes = 0;
+    std::vector<char> buffer;
+    common::for_each_directory_entry(fd, buffer, [&](const char* entry, unsigned char) {
+        struct stat st {};
+        if (fstatat(fd, entry, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            return;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            bytes += tree_bytes(fd, entry);
+        } else if (S_ISREG(st.st_mode)) {
+            bytes += static_cast<unsigned long long>(st.st_size);
+        }
+    });
+    close(fd);
+    return bytes;
+}
+
+// Removes the directory `name` and everything below it. Names are collected
+// before anything is unlinked, so the listing is not disturbed.
+bool remove_tree(int dirfd, const char* name) {
+    const int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    std::vector<std::pair<std::string, bool>> entries;  // name, is a directory
+    std::vector<char> buffer;
+    bool removed = common::for_each_directory_entry(fd, buffer, [&](const char* entry, unsigned char) {
+        struct stat st {};
+        const bool is_directory = fstatat(fd, entry, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+        entries.emplace_back(entry, is_directory);
+    });
+    for (const auto& [entry, is_directory] : entries) {
+        removed = (is_directory ? remove_tree(fd, entry.c_str()) : unlinkat(fd, entry.c_str(), 0) == 0) && removed;
+    }
+    close(fd);
+    return removed && unlinkat(dirfd, name, AT_REMOVEDIR) == 0;
+}
+
+// One pass over each directory: archives, their signatures and leftovers.
+// pacman downloads into download-XXXXXX directories, which count as partial
+// downloads with the size of their contents.
+Scan scan_directories(const std::vector<std::string>& directories) {
+    Scan scan;
+    std::vector<char> buffer;
+    for (std::size_t d = 0; d < directories.size(); ++d) {
+        const int fd = open(directories[d].c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            ++scan.errors;
+            continue;
+        }
+        std::unordered_map<std::string, unsigned long long> signatures;
+        const std::size_t first_package = scan.packages.size();
+        common::for_each_directory_entry(fd, buffer, [&](const char* name, unsigned char type) {
+            const std::string_view filename{name};
+            const bool download = filename.starts_with("download-");
+            if (type != DT_REG && type != DT_UNKNOWN && !(download && type == DT_DIR)) {
+                return;
+            }
+            struct stat st {};
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                return;
+            }
+            if (download && S_ISDIR(st.st_mode)) {
+                scan.partials.push_back(ScannedFile{d, name, tree_bytes(fd, name), false, {}});
+                return;
+            }
+            if (!S_ISREG(st.st_mode)) {
+                return;
+            }
+            const auto bytes = static_cast<unsigned long long>(st.st_size);
+            if (ends_with(filename, ".sig")) {
+                signatures.emplace(filename.substr(0, filename.size() - 4), bytes);
+                return;
+            }
+            ScannedFile file;
+            file.directory = d;
+            file.filename = name;
+            file.bytes = bytes;
+            if (ends_with(filename, ".part") || download) {
+                scan.partials.push_back(std::move(file));
+            } else if (parse_package_filename(filename, file.parsed)) {
+                scan.packages.push_back(std::move(file));
+            }
+        });
+        close(fd);
+
+        for (std::size_t i = first_package; i < scan.packages.size(); ++i) {
+            if (const auto it = signatures.find(scan.packages[i].filename); it != signatures.end()) {
+                scan.packages[i].bytes += it->second;
+                scan.packages[i].has_signature = true;
+                signatures.erase(it);
+            }
+        }
+        for (auto& [archive, bytes] : signatures) {
+            scan.partials.push_back(ScannedFile{d, archive + ".sig", bytes, false, {}});
+        }
+    }
+    return scan;
+}
+
+// pacman holds db.lck for a whole transaction, downloads included.
+bool database_locked(const std::string& db_path) {
+    struct stat st {};
+    return lstat((db_path + "/db.lck").c_str(), &st) == 0;
+}
+
+bool is_partial(const CachedPackageFile& file) {
+    return file.reason == "partial" || file.reason == "orphan-signature";
+}
+
+void add_candidate(PackageCacheReport& report, CachedPackageFile file) {
+    ++report.reclaimable_files;
+    report.reclaimable_bytes += file.bytes;
+    report.candidates.push_back(std::move(file));
+}
+
+// Removes `filename` (and `filename.sig` when present) from `dirfd`. Only
+// regular files and download-* directories are touched.
+bool remove_cached(int dirfd, const std::string& filename, bool with_signature) {
+    struct stat st {};
+    if (fstatat(dirfd, filename.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        return false;
+    }
+    if (S_ISDIR(st.st_mode) && filename.starts_with("download-")) {
+        return remove_tree(dirfd, filename.c_str());
+    }
+    if (!S_ISREG(st.st_mode) || unlinkat(dirfd, filename.c_str(), 0) != 0) {
+        return false;
+    }
+    if (with_signature) {
+        const std::string signature = filename + ".sig";
+        if (fstatat(dirfd, signature.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISREG(st.st_mode)) {
+            unlinkat(dirfd, signature.c_str(), 0);
+        }
+    }
+    return true;
+}
+
+}
+
+bool parse_package_filename(std::string_view filename, PackageFileName& out) {
+    const std::size_t extension = filename.rfind(".pkg.tar");
+    if (extension == std::string_view::npos || extension == 0) {
+        return false;
+    }
+    // Anything after .pkg.tar must be a single compression suffix.
+    const std::string_view suffix = filename.substr(extension + 8);
+    if (!suffix.empty() && (suffix[0] != '.' || suffix.find('.', 1) != std::string_view::npos)) {
+        return false;
+    }
+
+    std::string_view stem = filename.substr(0, extension);
+    std::string_view parts[3];  // arch, pkgrel, pkgver
+    for (auto& part : parts) {
+        const std::size_t dash = stem.rfind('-');
+        if (dash == std::string_view::npos || dash == 0 || dash + 1 == stem.size()) {
+            return false;
+        }
+        part = stem.substr(dash + 1);
+        stem = stem.substr(0, dash);
+    }
+    out.name = std::string(stem);
+    out.version = std::string(parts[2]) + "-" + std::string(parts[1]);
+    out.arch = std::string(parts[0]);
+    return true;
+}
+
+std::vector<std::string> configured_cache_directories(const std::string& config_path) {
+    std::vector<std::string> directories;
+    std::ifstream config(config_path);
+    std::string line;
+    bool in_options = false;
+    while (std::getline(config, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.size() > 2 && line.front() == '[' && line.back() == ']') {
+            in_options = line == "[options]";
+            continue;
+        }
+        const std::size_t equals = line.find('=');
+        if (!in_options || equals == std::string::npos || trim(line.substr(0, equals)) != "CacheDir") {
+            continue;
+        }
+        std::istringstream values(line.substr(equals + 1));
+        std::string directory;
+        while (values >> directory) {
+            while (directory.size() > 1 && directory.back() == '/') {
+                directory.pop_back();
+            }
+            if (std::find(directories.begin(), directories.end(), directory) == directories.end()) {
+                directories.push_back(directory);
+            }
+        }
+    }
+    if (directories.empty()) {
+        directories.emplace_back(kDefaultCacheDir);
+    }
+    return directories;
+}
+
+PackageCacheReport analyze_package_cache(const PackageCacheOptions& options) {
+    const auto start = std::chrono::steady_clock::now();
+    PackageCacheReport report;
+    report.directories = options.directories.empty() ? configured_cache_directories(options.config_path)
+                                                     : options.directories;
+    report.keep_versions = options.keep_versions;
+    report.keep_uninstalled = options.keep_uninstalled;
+    report.remove_partials = options.remove_partials;
+    report.database_locked = database_locked(options.db_path);
+
+    Scan scan = scan_directories(report.directories);
+    report.errors = scan.errors;
+    report.valid = scan.errors < report.directories.size();
+
+    std::unordered_map<std::string, std::string> installed;
+    if (const auto database = read_local_database(options.db_path); database->valid) {
+        installed.reserve(database->packages.size());
+        for (const auto& package : database->packages) {
+            installed.emplace(package.name, package.version);
+        }
+    }
+
+    // Group by name and architecture, newest first.
+    std::map<std::pair<std::string, std::string>, std::vector<std::size_t>> groups;
+    for (std::size_t i = 0; i < scan.packages.size(); ++i) {
+        const ScannedFile& file = scan.packages[i];
+        ++report.files;
+        report.bytes += file.bytes;
+        groups[{file.parsed.name, file.parsed.arch}].push_back(i);
+    }
+    report.packages = groups.size();
+
+    for (auto& [key, members] : groups) {
+        std::sort(members.begin(), members.end(), [&](std::size_t lhs, std::size_t rhs) {
+            const int order = vercmp(scan.packages[lhs].parsed.version, scan.packages[rhs].parsed.version);
+            return order != 0 ? order > 0 : scan.packages[lhs].filename < scan.packages[rhs].filename;
+        });
+        const auto it = installed.find(key.first);
+        const bool is_installed = it != installed.end();
+        const std::size_t keep = is_installed ? options.keep_versions : options.keep_uninstalled;
+
+        for (std::size_t rank = 0; rank < members.size(); ++rank) {
+            ScannedFile& file = scan.packages[members[rank]];
+            const bool current = is_installed && vercmp(file.parsed.version, it->second) == 0;
+            if (rank < keep || current) {
+                continue;
+            }
+            CachedPackageFile candidate;
+            candidate.name = file.parsed.name;
+            candidate.version = file.parsed.version;
+            candidate.arch = file.parsed.arch;
+            candidate.directory = report.directories[file.directory];
+            candidate.filename = file.filename;
+            candidate.bytes = file.bytes;
+            candidate.has_signature = file.has_signature;
+            candidate.reason = is_installed ? "old-version" : "uninstalled";
+            if (is_installed) {
+                ++report.old_version_files;
+                report.old_version_bytes += file.bytes;
+            } else {
+                ++report.uninstalled_files;
+                report.uninstalled_bytes += file.bytes;
+            }
+            add_candidate(report, std::move(candidate));
+        }
+    }
+
+    for (auto& file : scan.partials) {
+        ++report.files;
+        report.bytes += file.bytes;
+        ++report.partial_files;
+        report.partial_bytes += file.bytes;
+        if (!options.remove_partials || report.database_locked) {
+            continue;
+        }
+        CachedPackageFile candidate;
+        candidate.directory = report.directories[file.directory];
+        candidate.filename = std::move(file.filename);
+        candidate.bytes = file.bytes;
+        candidate.reason = ends_with(candidate.filename, ".sig") ? "orphan-signature" : "partial";
+        add_candidate(report, std::move(candidate));
+    }
+
+    std::sort(report.candidates.begin(), report.candidates.end(),
+              [](const CachedPackageFile& lhs, const CachedPackageFile& rhs) { return lhs.bytes > rhs.bytes; });
+    report.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+PackageCacheReport prune_package_cache(const PackageCacheOptions& options) {
+    const auto start = std::chrono::steady_clock::now();
+    PackageCacheReport report = analyze_package_cache(options);
+    report.pruned = true;
+
+    // One directory descriptor per cache directory; every unlink is relative
+    // to it, in name order so the directory blocks are walked once.
+    // A download may have started since the scan.
+    const bool locked = database_locked(options.db_path);
+    report.database_locked = report.database_locked || locked;
+    std::map<std::string, std::vector<const CachedPackageFile*>> by_directory;
+    for (const auto& candidate : report.candidates) {
+        if (locked && is_partial(candidate)) {
+            continue;
+        }
+        by_directory[candidate.directory].push_back(&candidate);
+    }
+    for (auto& [directory, files] : by_directory) {
+        const int dirfd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirfd < 0) {
+            report.errors += files.size();
+            continue;
+        }
+        std::sort(files.begin(), files.end(), [](const CachedPackageFile* lhs, const CachedPackageFile* rhs) {
+            return lhs->filename < rhs->filename;
+        });
+        for (const CachedPackageFile* file : files) {
+            if (remove_cached(dirfd, file->filename, file->has_signature)) {
+                ++report.removed_files;
+                report.removed_bytes += file->bytes;
+            } else {
+                ++report.errors;
+            }
+        }
+        close(dirfd);
+    }
+    report.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+std::string package_cache_to_json(const PackageCacheReport& report) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"valid\":" << (report.valid ? "true" : "false") << ",";
+    json << "\"directories\":[";
+    for (size_t i = 0; i < report.directories.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "\"" << common::escape_json(report.directories[i]) << "\"";
+    }
+    json << "],";
+    json << "\"keep_versions\":" << report.keep_versions << ",";
+    json << "\"keep_uninstalled\":" << report.keep_uninstalled << ",";
+    json << "\"remove_partials\":" << (report.remove_partials ? "true" : "false") << ",";
+    json << "\"database_locked\":" << (report.database_locked ? "true" : "false") << ",";
+    json << "\"files\":" << report.files << ",";
+    json << "\"bytes\":" << report.bytes << ",";
+    json << "\"packages\":" << report.packages << ",";
+    json << "\"old_version_files\":" << report.old_version_files << ",";
+    json << "\"old_version_bytes\":" << report.old_version_bytes << ",";
+    json << "\"uninstalled_files\":" << report.uninstalled_files << ",";
+    json << "\"uninstalled_bytes\":" << report.uninstalled_bytes << ",";
+    json << "\"partial_files\":" << report.partial_files << ",";
+    json << "\"partial_bytes\":" << report.partial_bytes << ",";
+    json << "\"reclaimable_files\":" << report.reclaimable_files << ",";
+    json << "\"reclaimable_bytes\":" << report.reclaimable_bytes << ",";
+    json << "\"pruned\":" << (report.pruned ? "true" : "false") << ",";
+    json << "\"removed_files\":" << report.removed_files << ",";
+    json << "\"removed_bytes\":" << report.removed_bytes << ",";
+    json << "\"errors\":" << report.errors << ",";
+    json << "\"elapsed_ms\":" << std::fixed << std::setprecision(2) << report.elapsed_ms << ",";
+    json << "\"candidates\":[";
+    for (size_t i = 0; i < report.candidates.size(); ++i) {
+        if (i > 0) json << ",";
+        const auto& file = report.candidates[i];
+        json << "{";
+        json << "\"name\":\"" << common::escape_json(file.name) << "\",";
+        json << "\"version\":\"" << common::escape_json(file.version) << "\",";
+        json << "\"arch\":\"" << common::escape_json(file.arch) << "\",";
+        json << "\"file\":\"" << common::escape_json(file.directory + "/" + file.filename) << "\",";
+        json << "\"bytes\":" << file.bytes << ",";
+        json << "\"signature\":" << (file.has_signature ? "true" : "false") << ",";
+        json << "\"reason\":\"" << file.reason << "\"";
+        json << "}";
+    }
+    json << "]";
+    json << "}";
+    return json.str();
+}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pacman_db.hpp"
+#include "pacman_sync.hpp"
+
+namespace nanookjaro::package_manager {
+
+inline constexpr const char* kDefaultCacheDir = "/var/cache/pacman/pkg";
+
+struct PackageFileName {
+    std::string name;
+    std::string version;  // [epoch:]pkgver-pkgrel
+    std::string arch;
+};
+
+// Splits "name-pkgver-pkgrel-arch.pkg.tar[.ext]" from the right, the way
+// paccache does. Returns false for anything that is not a package archive.
+bool parse_package_filename(std::string_view filename, PackageFileName& out);
+
+// CacheDir entries of pacman.conf's [options] section, or the default.
+std::vector<std::string> configured_cache_directories(const std::string& config_path = kDefaultPacmanConfig);
+
+struct PackageCacheOptions {
+    std::vector<std::string> directories;  // empty: configured_cache_directories()
+    std::size_t keep_versions = 3;         // per installed package, like paccache -k
+    std::size_t keep_uninstalled = 0;      // per package that is no longer installed
+    bool remove_partials = false;          // also offer partial downloads; never while db.lck exists
+    std::string db_path = kDefaultDbPath;
+    std::string config_path = kDefaultPacmanConfig;
+};
+
+struct CachedPackageFile {
+    std::string name;
+    std::string version;
+    std::string arch;
+    std::string directory;
+    std::string filename;
+    unsigned long long bytes = 0;            // archive plus its .sig
+    bool has_signature = false;
+    std::string reason;                      // why it can go: old-version, uninstalled, partial, orphan-signature
+};
+
+struct PackageCacheReport {
+    std::vector<std::string> directories;
+    bool valid = false;
+    bool pruned = false;
+    std::size_t keep_versions = 0;
+    std::size_t keep_uninstalled = 0;
+    bool remove_partials = false;
+    bool database_locked = false;  // db.lck held: pacman may be downloading into the cache
+    unsigned long long files = 0;
+    unsigned long long bytes = 0;
+    unsigned long long packages = 0;  // distinct name/arch pairs
+    unsigned long long old_version_files = 0;
+    unsigned long long old_version_bytes = 0;
+    unsigned long long uninstalled_files = 0;
+    unsigned long long uninstalled_bytes = 0;
+    unsigned long long partial_files = 0;  // partial downloads and orphaned signatures, candidates or not
+    unsigned long long partial_bytes = 0;
+    unsigned long long reclaimable_files = 0;
+    unsigned long long reclaimable_bytes = 0;
+    unsigned long long removed_files = 0;
+    unsigned long long removed_bytes = 0;
+    unsigned long long errors = 0;
+    double elapsed_ms = 0.0;
+    std::vector<CachedPackageFile> candidates;  // removable files, largest first
+};
+
+// Lists the cache directories, groups archives by name and architecture,
+// orders each group with vercmp and marks what the keep policy would remove.
+// The installed version of a package is always kept. Partial downloads and
+// signatures without an archive are only counted, unless `remove_partials`
+// is set and pacman's database lock is not held: they may belong to a
+// download in progress.
+PackageCacheReport analyze_package_cache(const PackageCacheOptions& options = {});
+
+// analyze_package_cache() followed by removing every candidate (and its
+// signature) with unlinkat() relative to the directory. The lock is checked
+// again before partials are removed.
+PackageCacheReport prune_package_cache(const PackageCacheOptions& options = {});
+
+std::string package_cache_to_json(const PackageCacheReport& report);
+
+}
@@ -1,4 +1,5 @@
 #include <array>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
@@ -13,6 +14,17 @@
 #include <iostream>
 
 #include "package_manager.hpp"
+#include "job_manager.hpp"
+#include "../common/subprocess.hpp"
+#include "pacman_db.hpp"
+#include "pacman_sync.hpp"
+#include "package_cache.hpp"
+#include "dependency_graph.hpp"
+#include "file_ownership.hpp"
+#include "package_verify.hpp"
+#include "package_search.hpp"
+#include "pacman_log.hpp"
+#include "../common/scratch.hpp"
 
 namespace nanookjaro::package_manager {
 
@@ -23,108 +35,121 @@ struct CommandResult {
     std::string combined_output;
 };
 
-CommandResult run_command_capture(std::string command) {
-    command.append(" 2>&1");
-    std::array<char, 4096> buffer{};
-    std::string output;
-
-    FILE* stream = popen(command.c_str(), "r");
-    if (!stream) {
-        throw std::runtime_error("Failed to invoke shell command");
+// Runs argv with stderr folded into stdout. A timeout is reported as exit
+// code -1, like a command that could not be run at all.
+CommandResult run_command_capture(const std::vector<std::string>& argv, std::chrono::seconds timeout) {
+    common::SubprocessOptions options;
+    options.merge_stderr = true;
+    options.timeout = timeout;
+    common::SubprocessResult result = common::run_subprocess(argv, options);
+    if (result.timed_out) {
+        result.out += argv.front() + " timed out after " + std::to_string(timeout.count()) + "s\n";
+        return CommandResult{-1, std::move(result.out)};
     }
+    return CommandResult{result.exit_code, std::move(result.out)};
+}
 
-    while (std::fgets(buffer.data(), static_cast<int>(buffer.size()), stream)) {
-        output.append(buffer.data());
+// pacman invocation for a job. Without root it goes through `sudo -n`, which
+// fails fast instead of prompting; interactive_command is the variant the
+// user can run in a terminal. pacman defers SIGINT until the transaction
+// reaches a safe point, and anything harsher could kill it mid-commit and
+// leave db.lck behind, so jobs::cancel_job() only ever sends SIGINT (sudo
+// forwards it).
+jobs::JobSpec pacman_job_spec(const std::string& kind, const char* operation,
+                              const std::vector<std::string>& packages, bool assume_yes,
+                              bool retain_output) {
+    const bool is_root = (geteuid() == 0);
+    jobs::JobSpec spec;
+    spec.kind = kind;
+    spec.retain_output = retain_output;
+    if (!is_root) {
+        spec.argv = {"sudo", "-n"};
     }
-
-    const int status = pclose(stream);
-    int exit_code = -1;
-    if (WIFEXITED(status)) {
-        exit_code = WEXITSTATUS(status);
+    spec.argv.push_back("pacman");
+    spec.argv.push_back(operation);
+    if (assume_yes) {
+        spec.argv.push_back("--noconfirm");
     }
+    spec.argv.insert(spec.argv.end(), packages.begin(), packages.end());
 
-    return CommandResult{exit_code, output};
+    std::ostringstream interactive;
+    interactive << (is_root ? "pacman " : "sudo pacman ") << operation;
+    if (assume_yes) {
+        interactive << " --noconfirm";
+    }
+    for (const auto& pkg : packages) {
+        interactive << ' ' << pkg;
+    }
+    spec.interactive_command = interactive.str();
+    return spec;
 }
 
-bool contains_password_prompt(std::string_view output) {
-    return output.find("password is required") != std::string_view::npos ||
-           output.find("a password is required") != std::string_view::npos ||
-           output.find("password for") != std::string_view::npos;
 }
 
-std::string escape_json(const std::string& input) {
-    std::string output;
-    output.reserve(input.size());
-    for (char c : input) {
-        switch (c) {
-            case '"':
-                output += "\\\"";
-                break;
-            case '\\':
-                output += "\\\\";
-                break;
-            case '\n':
-                output += "\\n";
-                break;
-            case '\r':
-                output += "\\r";
-                break;
-            case '\t':
-                output += "\\t";
-                break;
-            default:
-                output += c;
-                break;
+std::int64_t start_pacman_job(const std::string& kind, const std::vector<std::string>& args,
+                              std::string& error) {
+    bool assume_yes = false;
+    std::vector<std::string> packages;
+    for (const auto& arg : args) {
+        if (arg == "--noconfirm") {
+            assume_yes = true;
+        } else if (arg.empty() || arg.front() == '-') {
+            error = "invalid_argument";
+            return -1;
+        } else {
+            packages.push_back(arg);
         }
     }
-    return output;
-}
 
-}
-
-std::string pacman_sync_upgrade_json(bool assume_yes) {
-    const bool is_root = (geteuid() == 0);
-    std::ostringstream command_builder;
-    if (!is_root) {
-        command_builder << "sudo -n ";
+    if (kind == "pacman-upgrade") {
+        if (!packages.empty()) {
+            error = "invalid_argument";
+            return -1;
+        }
+        return jobs::start_job(pacman_job_spec(kind, "-Syu", packages, assume_yes, false));
     }
-    command_builder << "pacman -Syu";
-    if (assume_yes) {
-        command_builder << " --noconfirm";
+    if (kind == "pacman-verify") {
+        if (assume_yes) {
+            error = "invalid_argument";
+            return -1;
+        }
+        std::string command = "verify";
+        for (const auto& pkg : packages) {
+            command += ' ' + pkg;
+        }
+        return jobs::start_task_job(kind, command, [packages](const auto& emit, const std::atomic<bool>& cancelled) {
+            VerifyOptions options;
+            options.packages = packages;
+            const VerifyReport report = verify_installed_files(
+                options, [&emit](const VerifyIssue& issue) { emit(verify_issue_to_json(issue)); }, &cancelled);
+            emit(verify_report_to_json(report, false));
+            return report.valid && report.issues.empty() && report.unknown_packages.empty() ? 0 : 1;
+        });
     }
-
-    const std::string non_interactive_command = command_builder.str();
-
-    bool requires_password = false;
-    CommandResult result{0, {}};
-
-    try {
-        result = run_command_capture(non_interactive_command);
-        if (result.exit_code != 0 && contains_password_prompt(result.combined_output)) {
-            requires_password = true;
+    if (kind == "pacman-install") {
+        if (packages.empty()) {
+            error = "no_packages";
+            return -1;
         }
-    } catch (const std::exception& ex) {
-        result.exit_code = -1;
-        result.combined_output = ex.what();
+        return jobs::start_job(pacman_job_spec(kind, "-S", packages, assume_yes, false));
     }
+    error = "unknown_kind";
+    return -1;
+}
 
-    std::ostringstream interactive_command;
-    if (is_root) {
-        interactive_command << "pacman -Syu";
-    } else {
-        interactive_command << "sudo pacman -Syu";
-    }
-    if (assume_yes) {
-        interactive_command << " --noconfirm";
-    }
+std::string pacman_sync_upgrade_json(bool assume_yes) {
+    const auto spec = pacman_job_spec("pacman-upgrade", "-Syu", {}, assume_yes, true);
+    const std::int64_t id = jobs::start_job(spec);
+    const jobs::JobResult result = jobs::wait_for_job(id);
+    jobs::release_job(id);
 
     std::ostringstream json;
     json << '{';
-    json << "\"command\":\"" << escape_json(non_interactive_command) << "\",";
-    json << "\"interactive_command\":\"" << escape_json(interactive_command.str()) << "\",";
+    json << "\"command\":\"" << common::escape_json(result.command) << "\",";
+    json << "\"interactive_command\":\"" << common::escape_json(result.interactive_command) << "\",";
     json << "\"exit_code\":" << result.exit_code << ',';
-    json << "\"requires_password\":" << (requires_password ? "true" : "false") << ',';
-    json << "\"output\":\"" << escape_json(result.combined_output) << "\"";
+    json << "\"requires_password\":" << (result.requires_password && result.exit_code != 0 ? "true" : "false") << ',';
+    json << "\"output\":\"" << common::escape_json(result.output) << "\"";
     json << '}';
 
     return json.str();
@@ -137,13 +162,43 @@ std::string pacman_list_updates_json() {
         return "{\"command\":\"none\",\"exit_code\":0,\"fallback_used\":false,\"updates\":[],\"output\":\"Not an Arch-based system\"}";
     }
     
+    // Reading the sync databases directly avoids spawning pacman at all; the
+    // subprocess path only remains for systems whose databases we cannot parse.
+    bool native_ok = false;
+    const std::vector<PendingUpdate> pending = find_pending_updates(native_ok);
+    if (native_ok) {
+        std::ostringstream json;
+        json << '{';
+        json << "\"command\":\"sync-db\",";
+        json << "\"exit_code\":0,";
+        json << "\"fallback_used\":false,";
+        json << "\"updates\":[";
+        for (std::size_t i = 0; i < pending.size(); ++i) {
+            const auto& entry = pending[i];
+            if (i > 0) {
+                json << ',';
+            }
+            json << '{';
+            json << "\"name\":\"" << common::escape_json(entry.name) << "\",";
+            json << "\"current\":\"" << common::escape_json(entry.current_version) << "\",";
+            json << "\"available\":\"" << common::escape_json(entry.new_version) << "\",";
+            json << "\"repository\":\"" << common::escape_json(entry.repository) << "\"";
+            json << '}';
+        }
+        json << "],";
+        json << "\"output\":\"\"";
+        json << '}';
+        return json.str();
+    }
+
     const char* first_command = "checkupdates";
     
     CommandResult result{0, {}};
     bool fallback_used = false;
     
     try {
-        result = run_command_capture(first_command);
+        // checkupdates syncs a private copy of the databases over the network.
+        result = run_command_capture({first_command}, std::chrono::seconds(120));
         if (result.exit_code == 127 || result.exit_code == -1) {
             fallback_used = true;
         }
@@ -156,7 +211,7 @@ std::string pacman_list_updates_json() {
     CommandResult fallback_result{0, {}};
     if (fallback_used) {
         try {
-            fallback_result = run_command_capture("pacman -Qu");
+            fallback_result = run_command_capture({"pacman", "-Qu"}, std::chrono::seconds(30));
             result = fallback_result;
         } catch (const std::exception& ex) {
             result.exit_code = -1;
@@ -191,7 +246,7 @@ std::string pacman_list_updates_json() {
 
     std::ostringstream json;
     json << '{';
-    json << "\"command\":\"" << escape_json(fallback_used ? "pacman -Qu" : first_command)
+    json << "\"command\":\"" << common::escape_json(fallback_used ? "pacman -Qu" : first_command)
          << "\",";
     json << "\"exit_code\":" << result.exit_code << ',';
     json << "\"fallback_used\":" << (fallback_used ? "true" : "false") << ',';
@@ -202,13 +257,13 @@ std::string pacman_list_updates_json() {
             json << ',';
         }
         json << '{';
-        json << "\"name\":\"" << escape_json(entry.name) << "\",";
-        json << "\"current\":\"" << escape_json(entry.current_version) << "\",";
-        json << "\"available\":\"" << escape_json(entry.new_version) << "\"";
+        json << "\"name\":\"" << common::escape_json(entry.name) << "\",";
+        json << "\"current\":\"" << common::escape_json(entry.current_version) << "\",";
+        json << "\"available\":\"" << common::escape_json(entry.new_version) << "\"";
         json << '}';
     }
     json << "],";
-    json << "\"output\":\"" << escape_json(result.combined_output) << "\"";
+    json << "\"output\":\"" << common::escape_json(result.combined_output) << "\"";
     json << '}';
 
     return json.str();
@@ -219,39 +274,16 @@ std::string pacman_install_packages_json(const std::vector<std::string>& package
     if (packages.empty()) {
         return "{\"error\":\"no_packages\"}";
     }
-
-    const bool is_root = (geteuid() == 0);
-
-    auto build_command = [&](bool non_interactive) {
-        std::ostringstream builder;
-        if (!is_root) {
-            builder << (non_interactive ? "sudo -n " : "sudo ");
-        }
-        builder << "pacman -S";
-        if (assume_yes) {
-            builder << " --noconfirm";
-        }
-        for (const auto& pkg : packages) {
-            builder << ' ' << pkg;
+    for (const auto& pkg : packages) {
+        if (pkg.empty() || pkg.front() == '-') {
+            return "{\"error\":\"invalid_argument\"}";
         }
-        return builder.str();
-    };
-
-    const std::string non_interactive_command = build_command(true);
-    bool requires_password = false;
-    CommandResult result{0, {}};
-
-    try {
-        result = run_command_capture(non_interactive_command);
-        if (result.exit_code != 0 && contains_password_prompt(result.combined_output)) {
-            requires_password = true;
-        }
-    } catch (const std::exception& ex) {
-        result.exit_code = -1;
-        result.combined_output = ex.what();
     }
 
-    const std::string interactive_command = build_command(false);
+    const auto spec = pacman_job_spec("pacman-install", "-S", packages, assume_yes, true);
+    const std::int64_t id = jobs::start_job(spec);
+    const jobs::JobResult result = jobs::wait_for_job(id);
+    jobs::release_job(id);
 
     std::ostringstream packages_json;
     packages_json << '[';
@@ -259,21 +291,63 @@ std::string pacman_install_packages_json(const std::vector<std::string>& package
         if (i > 0) {
             packages_json << ',';
         }
-        packages_json << "\"" << escape_json(packages[i]) << "\"";
+        packages_json << "\"" << common::escape_json(packages[i]) << "\"";
     }
     packages_json << ']';
 
     std::ostringstream json;
     json << '{';
-    json << "\"command\":\"" << escape_json(non_interactive_command) << "\",";
-    json << "\"interactive_command\":\"" << escape_json(interactive_command) << "\",";
+    json << "\"command\":\"" << common::escape_json(result.command) << "\",";
+    json << "\"interactive_command\":\"" << common::escape_json(result.interactive_command) << "\",";
     json << "\"packages\":" << packages_json.str() << ',';
     json << "\"exit_code\":" << result.exit_code << ',';
-    json << "\"requires_password\":" << (requires_password ? "true" : "false") << ',';
-    json << "\"output\":\"" << escape_json(result.combined_output) << "\"";
+    json << "\"requires_password\":" << (result.requires_password && result.exit_code != 0 ? "true" : "false") << ',';
+    json << "\"output\":\"" << common::escape_json(result.output) << "\"";
     json << '}';
 
     return json.str();
 }
 
+std::string pacman_local_packages_json() {
+    const auto database = read_local_database();
+    std::ostringstream json;
+    json << '{';
+    json << "\"available\":" << (database->valid ? "true" : "false") << ',';
+    json << "\"count\":" << database->packages.size() << ',';
+    json << "\"packages\":" << local_packages_to_json(*database);
+    json << '}';
+    return json.str();
+}
+
+std::string pacman_package_cache_json(std::size_t keep_versions, std::size_t keep_uninstalled, bool prune,
+                                      bool remove_partials) {
+    PackageCacheOptions options;
+    options.remove_partials = remove_partials;
+    options.keep_versions = keep_versions;
+    options.keep_uninstalled = keep_uninstalled;
+    return package_cache_to_json(prune ? prune_package_cache(options) : analyze_package_cache(options));
+}
+
+std::string pacman_dependency_graph_json(const std::string& package) {
+    return dependency_graph_to_json(*local_dependency_graph(), package);
+}
+
+std::string pacman_file_owners_json(const std::vector<std::string>& paths) {
+    return file_owners_to_json(find_file_owners(paths));
+}
+
+std::string pacman_verify_json(const std::vector<std::string>& packages) {
+    VerifyOptions options;
+    options.packages = packages;
+    return verify_report_to_json(verify_installed_files(options), true);
+}
+
+std::string pacman_search_json(const std::string& query, std::size_t limit) {
+    return package_search_to_json(*package_search_index(), query, limit);
+}
+
+std::string pacman_history_json(const std::string& package, std::int64_t since, std::size_t limit) {
+    return pacman_log_history_to_json(*pacman_log_index(configured_log_file()), package, since, limit);
+}
+
 }
@@ -1,12 +1,47 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace nanookjaro::package_manager {
 
+// Starts a background pacman job (see job_manager.hpp). `kind` is
+// "pacman-upgrade", "pacman-install" or "pacman-verify" (an in-process file
+// check that emits one JSON line per issue and a summary line); `args` are
+// package names plus an optional "--noconfirm". Returns -1 and sets `error` for invalid requests.
+std::int64_t start_pacman_job(const std::string& kind, const std::vector<std::string>& args,
+                              std::string& error);
+
 std::string pacman_sync_upgrade_json(bool assume_yes);
 std::string pacman_list_updates_json();
 std::string pacman_install_packages_json(const std::vector<std::string>& packages,
 										 bool assume_yes);
+std::string pacman_local_packages_json();
+
+// Cached package archives and what a keep-N policy would reclaim; with
+// `prune` the candidates are deleted as well.
+std::string pacman_package_cache_json(std::size_t keep_versions, std::size_t keep_uninstalled, bool prune,
+                                      bool remove_partials = false);
+
+// Orphans and graph statistics of the installed packages; with a package
+// name, also what requires it and what would be removed along with it.
+std::string pacman_dependency_graph_json(const std::string& package);
+
+// Owning packages of each path, from the persisted file ownership index.
+std::string pacman_file_owners_json(const std::vector<std::string>& paths);
+
+// Installed files checked against the packages' mtree metadata, like
+// `pacman -Qkk`; every installed package when `packages` is empty.
+std::string pacman_verify_json(const std::vector<std::string>& packages);
+
+// Ranked name/description matches for `query` from the cached trigram index
+// over the sync and local databases, plus index statistics.
+std::string pacman_search_json(const std::string& query, std::size_t limit);
+
+// Upgrade history from the incrementally indexed pacman.log: the last
+// `limit` transactions, or the last `limit` changes of `package`, not older
+// than `since` (Unix seconds, 0 for all).
+std::string pacman_history_json(const std::string& package, std::int64_t since, std::size_t limit);
 }
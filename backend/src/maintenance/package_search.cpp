@@ -0,0 +1,384 @@
+#include "package_search.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+
+namespace nanookjaro::package_manager {
+
+namespace {
+
+// ASCII-only folding; multi-byte UTF-8 sequences are matched byte for byte.
+char fold(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+void append_folded(std::string& out, std::string_view text) {
+    for (const char c : text) {
+        out.push_back(fold(c));
+    }
+}
+
+// Bigrams share the key space with bit 24 set, so two-byte terms get
+// posting lists too.
+constexpr std::uint32_t kBigram = 1u << 24;
+
+std::uint32_t bigram(const char* p) {
+    return kBigram | (static_cast<std::uint32_t>(static_cast<unsigned char>(p[0])) << 8) |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(p[1]));
+}
+
+std::uint32_t trigram(const char* p) {
+    return (static_cast<std::uint32_t>(static_cast<unsigned char>(p[0])) << 16) |
+           (static_cast<std::uint32_t>(static_cast<unsigned char>(p[1])) << 8) |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(p[2]));
+}
+
+bool is_word_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || static_cast<unsigned char>(c) >= 0x80;
+}
+
+// Stable LSD radix sort of (key << 32 | document) pairs on the 25 key bits.
+// Pairs are generated in document order, so each posting list comes out
+// sorted without comparing document ids.
+void radix_sort_pairs(std::vector<std::uint64_t>& pairs) {
+    std::vector<std::uint64_t> scratch(pairs.size());
+    for (int shift = 32; shift < 64; shift += 8) {
+        std::array<std::size_t, 257> counts{};
+        for (const std::uint64_t pair : pairs) {
+            ++counts[((pair >> shift) & 0xff) + 1];
+        }
+        for (std::size_t i = 1; i < counts.size(); ++i) {
+            counts[i] += counts[i - 1];
+        }
+        for (const std::uint64_t pair : pairs) {
+            scratch[counts[(pair >> shift) & 0xff]++] = pair;
+        }
+        pairs.swap(scratch);
+    }
+}
+
+const PackageInfo* find_local(const LocalDatabase& database, std::string_view name) {
+    const auto it = std::lower_bound(database.packages.begin(), database.packages.end(), name,
+                                     [](const PackageInfo& package, std::string_view key) { return package.name < key; });
+    return it != database.packages.end() && it->name == name ? &*it : nullptr;
+}
+
+std::vector<std::string> split_terms(std::string_view query) {
+    std::vector<std::string> terms;
+    std::size_t i = 0;
+    while (i < query.size()) {
+        while (i < query.size() && (query[i] == ' ' || query[i] == '\t' || query[i] == '\n')) {
+            ++i;
+        }
+        std::string term;
+        while (i < query.size() && query[i] != ' ' && query[i] != '\t' && query[i] != '\n') {
+            term.push_back(fold(query[i++]));
+        }
+        if (!term.empty() && std::find(terms.begin(), terms.end(), term) == terms.end()) {
+            terms.push_back(std::move(term));
+        }
+    }
+    return terms;
+}
+
+struct SearchCache {
+    std::mutex mutex;
+    std::shared_ptr<const PackageSearchIndex> index;
+};
+
+SearchCache& search_cache_for(const std::string& key) {
+    static std::mutex registry_mutex;
+    static std::map<std::string, std::unique_ptr<SearchCache>> registry;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& slot = registry[key];
+    if (!slot) {
+        slot = std::make_unique<SearchCache>();
+    }
+    return *slot;
+}
+
+}
+
+std::size_t PackageSearchIndex::memory_bytes() const {
+    std::size_t bytes = sizeof(*this) + documents_.capacity() * sizeof(Document) + text_.capacity() +
+                        (keys_.capacity() + offsets_.capacity() + postings_.capacity()) * sizeof(std::uint32_t);
+    for (const auto& repository : repositories_) {
+        bytes += sizeof(repository) + repository.capacity();
+    }
+    return bytes;
+}
+
+std::span<const std::uint32_t> PackageSearchIndex::postings(std::uint32_t key) const {
+    const auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (it == keys_.end() || *it != key) {
+        return {};
+    }
+    const auto slot = static_cast<std::size_t>(it - keys_.begin());
+    return {postings_.data() + offsets_[slot], postings_.data() + offsets_[slot + 1]};
+}
+
+int PackageSearchIndex::score(const Document& document, const std::vector<std::string>& terms) const {
+    // Terms never contain the '\n' separator, so one scan over the text
+    // finds the first match in the name, or failing that the description.
+    const std::string_view text(text_.data() + document.text_offset, document.text_length);
+    int total = 0;
+    for (const auto& term : terms) {
+        const auto pos = text.find(term);
+        if (pos == std::string_view::npos) {
+            return 0;
+        }
+        if (pos < document.name_length) {
+            if (document.name_length == term.size()) {
+                total += 1000;
+            } else if (pos == 0) {
+                total += 400;
+            } else {
+                total += is_word_char(text[pos - 1]) ? 100 : 200;
+            }
+        } else {
+            total += pos == document.name_length + 1 || !is_word_char(text[pos - 1]) ? 20 : 10;
+        }
+    }
+    return total;
+}
+
+std::vector<SearchResult> PackageSearchIndex::search(std::string_view query, std::size_t limit,
+                                                     std::size_t* total) const {
+    std::vector<SearchResult> results;
+    if (total != nullptr) {
+        *total = 0;
+    }
+    const auto terms = split_terms(query);
+    if (terms.empty() || documents_.empty()) {
+        return results;
+    }
+
+    // Candidates come from intersecting the posting lists of every trigram
+    // in the terms (the bigram for two-byte terms), shortest list first;
+    // single-byte terms only filter.
+    std::vector<std::span<const std::uint32_t>> lists;
+    for (const auto& term : terms) {
+        for (std::size_t i = 0; i + 2 <= term.size(); ++i) {
+            if (term.size() > 2 && i + 3 > term.size()) {
+                break;
+            }
+            const auto list = postings(term.size() == 2 ? bigram(term.data()) : trigram(term.data() + i));
+            if (list.empty()) {
+                return results;
+            }
+            lists.push_back(list);
+        }
+    }
+    std::vector<std::uint32_t> candidates;
+    if (lists.empty()) {
+        candidates.resize(documents_.size());
+        std::iota(candidates.begin(), candidates.end(), 0u);
+    } else {
+        std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.size() < b.size(); });
+        candidates.assign(lists.front().begin(), lists.front().end());
+        for (std::size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+            const auto list = lists[i];
+            auto cursor = list.begin();
+            std::size_t kept = 0;
+            for (const std::uint32_t id : candidates) {
+                cursor = std::lower_bound(cursor, list.end(), id);
+                if (cursor == list.end()) {
+                    break;
+                }
+                if (*cursor == id) {
+                    candidates[kept++] = id;
+                }
+            }
+            candidates.resize(kept);
+        }
+    }
+
+    for (const std::uint32_t id : candidates) {
+        if (const int value = score(documents_[id], terms); value > 0) {
+            results.push_back(SearchResult{id, value});
+        }
+    }
+    if (total != nullptr) {
+        *total = results.size();
+    }
+
+    const auto better = [this](const SearchResult& a, const SearchResult& b) {
+        return a.score != b.score ? a.score > b.score : documents_[a.document].rank < documents_[b.document].rank;
+    };
+    const std::size_t keep = std::min(limit, results.size());
+    std::partial_sort(results.begin(), results.begin() + static_cast<std::ptrdiff_t>(keep), results.end(), better);
+    results.resize(keep);
+    return results;
+}
+
+std::shared_ptr<const PackageSearchIndex> package_search_index(const std::string& db_path,
+                                                               const std::string& config_path) {
+    auto sync = read_sync_databases(db_path, config_path);
+    const auto local = read_local_database(db_path);
+    SearchCache& cache = search_cache_for(db_path + '\n' + config_path);
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.index && cache.index->local_ == local && cache.index->sync_ == sync) {
+        return cache.index;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto index = std::make_shared<PackageSearchIndex>();
+    index->local_ = local;
+    index->sync_ = std::move(sync);
+    index->valid_ = local->valid;
+
+    std::size_t document_count = 0;
+    std::size_t text_bytes = 0;
+    const auto count_text = [&](const PackageInfo& package) {
+        ++document_count;
+        text_bytes += package.name.size() + 1 + package.description.size();
+    };
+    for (const auto& repository : index->sync_) {
+        index->valid_ = index->valid_ || repository->valid;
+        std::for_each(repository->packages.begin(), repository->packages.end(), count_text);
+    }
+    std::for_each(local->packages.begin(), local->packages.end(), count_text);
+    index->documents_.reserve(document_count);
+    index->text_.reserve(text_bytes);
+
+    const auto add_document = [&](const PackageInfo& package, const PackageInfo* installed, std::uint32_t repository) {
+        PackageSearchIndex::Document document;
+        document.package = &package;
+        document.installed = installed;
+        document.repository = repository;
+        document.text_offset = static_cast<std::uint32_t>(index->text_.size());
+        document.name_length = static_cast<std::uint32_t>(package.name.size());
+        append_folded(index->text_, package.name);
+        index->text_.push_back('\n');
+        append_folded(index->text_, package.description);
+        document.text_length = static_cast<std::uint32_t>(index->text_.size() - document.text_offset);
+        index->documents_.push_back(document);
+    };
+    for (std::uint32_t r = 0; r < index->sync_.size(); ++r) {
+        const SyncRepository& repository = *index->sync_[r];
+        index->repositories_.push_back(repository.name);
+        for (const PackageInfo& package : repository.packages) {
+            add_document(package, find_local(*local, package.name), r);
+        }
+    }
+    // Installed packages no repository carries (foreign or locally built).
+    const auto local_repository = static_cast<std::uint32_t>(index->repositories_.size());
+    index->repositories_.emplace_back("local");
+    for (const PackageInfo& package : local->packages) {
+        const bool in_sync = std::any_of(index->sync_.begin(), index->sync_.end(), [&](const auto& repository) {
+            return repository->by_name.count(package.name) != 0;
+        });
+        if (!in_sync) {
+            add_document(package, &package, local_repository);
+        }
+    }
+
+    // Ties in the ranking go to shorter names, then alphabetical order, then
+    // repository priority; precomputing that order keeps the comparison
+    // during a search to two integers.
+    std::vector<std::uint32_t> order(index->documents_.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+        const auto& da = index->documents_[a];
+        const auto& db = index->documents_[b];
+        if (da.name_length != db.name_length) {
+            return da.name_length < db.name_length;
+        }
+        const int compare = index->text_.compare(da.text_offset, da.name_length, index->text_, db.text_offset,
+                                                 db.name_length);
+        return compare != 0 ? compare < 0 : a < b;
+    });
+    for (std::uint32_t rank = 0; rank < order.size(); ++rank) {
+        index->documents_[order[rank]].rank = rank;
+    }
+
+    std::vector<std::uint64_t> pairs;
+    pairs.reserve(index->text_.size());
+    std::vector<std::uint32_t> seen;
+    for (std::uint32_t id = 0; id < index->documents_.size(); ++id) {
+        const auto& document = index->documents_[id];
+        const char* text = index->text_.data() + document.text_offset;
+        seen.clear();
+        for (std::uint32_t i = 0; i + 2 <= document.text_length; ++i) {
+            seen.push_back(bigram(text + i));
+            if (i + 3 <= document.text_length) {
+                seen.push_back(trigram(text + i));
+            }
+        }
+        std::sort(seen.begin(), seen.end());
+        seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+        for (const std::uint32_t key : seen) {
+            pairs.push_back((static_cast<std::uint64_t>(key) << 32) | id);
+        }
+    }
+    radix_sort_pairs(pairs);
+
+    index->postings_.reserve(pairs.size());
+    for (std::size_t i = 0; i < pairs.size(); ++i) {
+        const auto key = static_cast<std::uint32_t>(pairs[i] >> 32);
+        if (index->keys_.empty() || index->keys_.back() != key) {
+            index->keys_.push_back(key);
+            index->offsets_.push_back(static_cast<std::uint32_t>(i));
+        }
+        index->postings_.push_back(static_cast<std::uint32_t>(pairs[i]));
+    }
+    index->offsets_.push_back(static_cast<std::uint32_t>(index->postings_.size()));
+    index->keys_.shrink_to_fit();
+    index->offsets_.shrink_to_fit();
+
+    index->build_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    cache.index = index;
+    return index;
+}
+
+std::string package_search_to_json(const PackageSearchIndex& index, const std::string& query, std::size_t limit) {
+    const auto start = std::chrono::steady_clock::now();
+    std::size_t total = 0;
+    const auto results = index.search(query, limit, &total);
+    const double query_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    std::ostringstream json;
+    json << "{";
+    json << "\"valid\":" << (index.valid() ? "true" : "false") << ",";
+    json << "\"query\":\"" << common::escape_json(query) << "\",";
+    json << "\"index\":{";
+    json << "\"documents\":" << index.size() << ",";
+    json << "\"repositories\":[";
+    for (std::size_t i = 0; i < index.repositories().size(); ++i) {
+        if (i > 0) json << ",";
+        json << "\"" << common::escape_json(index.repositories()[i]) << "\"";
+    }
+    json << "],";
+    json << "\"ngrams\":" << index.ngram_count() << ",";
+    json << "\"postings\":" << index.posting_count() << ",";
+    json << "\"memory_bytes\":" << index.memory_bytes() << ",";
+    json << "\"build_ms\":" << std::fixed << std::setprecision(2) << index.build_ms() << "},";
+    json << "\"query_us\":" << query_us << ",";
+    json << "\"total\":" << total << ",";
+    json << "\"results\":[";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        if (i > 0) json << ",";
+        const auto& document = index.document(results[i].document);
+        json << "{";
+        json << "\"name\":\"" << common::escape_json(document.package->name) << "\",";
+        json << "\"version\":\"" << common::escape_json(document.package->version) << "\",";
+        json << "\"repository\":\"" << common::escape_json(index.repositories()[document.repository]) << "\",";
+        json << "\"description\":\"" << common::escape_json(document.package->description) << "\",";
+        json << "\"installed\":" << (document.installed != nullptr ? "true" : "false") << ",";
+        json << "\"installed_version\":\""
+             << (document.installed != nullptr ? common::escape_json(document.installed->version) : std::string()) << "\",";
+        json << "\"score\":" << results[i].score;
+        json << "}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pacman_db.hpp"
+#include "pacman_sync.hpp"
+
+namespace nanookjaro::package_manager {
+
+struct SearchResult {
+    std::uint32_t document = 0;
+    int score = 0;
+};
+
+// Immutable trigram index over the names and descriptions of every sync
+// package plus installed packages that no repository carries. Documents are
+// lowercased into one text buffer; each distinct byte trigram (and bigram,
+// for two-byte queries) maps to a sorted posting list of document ids, all
+// stored as flat arrays.
+class PackageSearchIndex {
+public:
+    struct Document {
+        const PackageInfo* package = nullptr;
+        const PackageInfo* installed = nullptr;  // local package of the same name, if any
+        std::uint32_t repository = 0;            // index into repositories(); "local" for foreign packages
+        std::uint32_t text_offset = 0;
+        std::uint32_t name_length = 0;
+        std::uint32_t text_length = 0;  // lowercased "name\ndescription"
+        std::uint32_t rank = 0;         // tie-break order among equal scores
+    };
+
+    std::size_t size() const { return documents_.size(); }
+    const Document& document(std::uint32_t id) const { return documents_[id]; }
+    const std::vector<std::string>& repositories() const { return repositories_; }
+    std::size_t ngram_count() const { return keys_.size(); }
+    std::size_t posting_count() const { return postings_.size(); }
+    std::size_t memory_bytes() const;
+    double build_ms() const { return build_ms_; }
+    bool valid() const { return valid_; }
+
+    // Documents containing every whitespace-separated term of `query`
+    // (case-insensitive substring match in the name or description, like
+    // `pacman -Ss` without regular expressions), best first. Name matches
+    // outrank description matches, and exact and prefix name matches rank
+    // highest. `total` receives the number of matches before truncation.
+    std::vector<SearchResult> search(std::string_view query, std::size_t limit, std::size_t* total = nullptr) const;
+
+private:
+    friend std::shared_ptr<const PackageSearchIndex> package_search_index(const std::string& db_path,
+                                                                          const std::string& config_path);
+
+    std::span<const std::uint32_t> postings(std::uint32_t key) const;
+    int score(const Document& document, const std::vector<std::string>& terms) const;
+
+    std::shared_ptr<const LocalDatabase> local_;
+    std::vector<std::shared_ptr<const SyncRepository>> sync_;
+    std::vector<std::string> repositories_;
+    std::vector<Document> documents_;
+    std::string text_;
+    std::vector<std::uint32_t> keys_;     // sorted trigram and bigram keys
+    std::vector<std::uint32_t> offsets_;  // keys_.size() + 1 entries into postings_
+    std::vector<std::uint32_t> postings_;
+    double build_ms_ = 0.0;
+    bool valid_ = false;
+};
+
+// Index of the databases at `db_path`. It is cached and rebuilt only when
+// the local database or one of the sync databases changes, so repeated
+// search-as-you-type queries pay for a few stat() calls plus the lookup.
+std::shared_ptr<const PackageSearchIndex> package_search_index(const std::string& db_path = kDefaultDbPath,
+                                                               const std::string& config_path = kDefaultPacmanConfig);
+
+// Index statistics plus the ranked matches for `query`.
+std::string package_search_to_json(const PackageSearchIndex& index, const std::string& query, std::size_t limit);
+
+}
@@ -0,0 +1,468 @@
+#include "package_verify.hpp"
+#include "../common/decompress.hpp"
+#include "../common/hash.hpp"
+#include "../common/mapped_file.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanookjaro::package_manager {
+
+namespace {
+
+constexpr std::size_t kReadChunk = 1 << 20;
+
+// One mtree line, with /set defaults applied.
+struct ExpectedFile {
+    std::uint32_t package = 0;
+    std::string path;  // relative to the root, no leading "./"
+    char type = 'f';   // 'f'ile, 'd'irectory or 'l'ink
+    mode_t mode = 0644;
+    uid_t uid = 0;
+    gid_t gid = 0;
+    long long size = -1;
+    long long mtime = -1;
+    std::string link;
+    std::string sha256;
+    bool backup = false;
+};
+
+// Fixed-capacity FIFO between the mtree reader and the workers; push()
+// blocks while it is full so decoding never runs far ahead of the disks.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_(std::max<std::size_t>(capacity, 1)) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    std::size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+bool is_octal(char c) { return c >= '0' && c <= '7'; }
+
+// mtree names are vis(3)-encoded: "\ooo" octal escapes and "\\".
+std::string unvis(std::string_view name) {
+    std::string out;
+    out.reserve(name.size());
+    for (std::size_t i = 0; i < name.size(); ++i) {
+        if (name[i] == '\\' && i + 3 < name.size() && is_octal(name[i + 1]) && is_octal(name[i + 2]) &&
+            is_octal(name[i + 3])) {
+            const int value = ((name[i + 1] - '0') << 6) | ((name[i + 2] - '0') << 3) | (name[i + 3] - '0');
+            out.push_back(static_cast<char>(value));
+            i += 3;
+        } else if (name[i] == '\\' && i + 1 < name.size() && name[i + 1] == '\\') {
+            out.push_back('\\');
+            ++i;
+        } else {
+            out.push_back(name[i]);
+        }
+    }
+    return out;
+}
+
+void apply_keyword(ExpectedFile& file, std::string_view keyword) {
+    const std::size_t equals = keyword.find('=');
+    if (equals == std::string_view::npos) {
+        return;
+    }
+    const std::string_view key = keyword.substr(0, equals);
+    const std::string value(keyword.substr(equals + 1));
+    if (key == "type") {
+        file.type = value == "dir" ? 'd' : value == "link" ? 'l' : 'f';
+    } else if (key == "mode") {
+        file.mode = static_cast<mode_t>(std::strtoul(value.c_str(), nullptr, 8));
+    } else if (key == "uid") {
+        file.uid = static_cast<uid_t>(std::strtoul(value.c_str(), nullptr, 10));
+    } else if (key == "gid") {
+        file.gid = static_cast<gid_t>(std::strtoul(value.c_str(), nullptr, 10));
+    } else if (key == "size") {
+        file.size = std::strtoll(value.c_str(), nullptr, 10);
+    } else if (key == "time") {
+        file.mtime = std::strtoll(value.c_str(), nullptr, 10);
+    } else if (key == "link") {
+        file.link = unvis(value);
+    } else if (key == "sha256digest") {
+        file.sha256 = value;
+    }
+}
+
+// Calls `fn` for every entry of a decoded mtree except the package's own
+// metadata (.PKGINFO, .BUILDINFO, .MTREE, .INSTALL, .CHANGELOG).
+template <typename Fn>
+void parse_mtree(std::string_view text, std::uint32_t package, Fn&& fn) {
+    ExpectedFile defaults;
+    defaults.package = package;
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        const std::size_t end = std::min(text.find('\n', pos), text.size());
+        std::string_view line = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+
+        const std::size_t space = line.find(' ');
+        const std::string_view name = line.substr(0, space);
+        std::string_view rest = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+        auto for_each_keyword = [&rest](auto&& apply) {
+            while (!rest.empty()) {
+                const std::size_t next = rest.find(' ');
+                apply(rest.substr(0, next));
+                rest = next == std::string_view::npos ? std::string_view() : rest.substr(next + 1);
+            }
+        };
+
+        if (name == "/set") {
+            for_each_keyword([&](std::string_view keyword) { apply_keyword(defaults, keyword); });
+            continue;
+        }
+        if (name == "/unset") {
+            defaults = ExpectedFile{};
+            defaults.package = package;
+            continue;
+        }
+        if (name.size() < 3 || name.substr(0, 2) != "./" || name[2] == '.') {
+            continue;
+        }
+        ExpectedFile file = defaults;
+        file.path = unvis(name.substr(2));
+        for_each_keyword([&](std::string_view keyword) { apply_keyword(file, keyword); });
+        fn(std::move(file));
+    }
+}
+
+// Paths listed in the %BACKUP% section of local/<entry>/files.
+std::unordered_set<std::string> backup_paths(int dbfd, const std::string& entry) {
+    std::unordered_set<std::string> paths;
+    const common::MappedFile files(dbfd, (entry + "/files").c_str());
+    const std::string_view text = files.view();
+    const std::size_t section = text.find("%BACKUP%\n");
+    if (section == std::string_view::npos) {
+        return paths;
+    }
+    std::size_t pos = section + 9;
+    while (pos < text.size()) {
+        const std::size_t end = std::min(text.find('\n', pos), text.size());
+        const std::string_view line = text.substr(pos, end - pos);
+        if (line.empty()) {
+            break;
+        }
+        paths.emplace(line.substr(0, line.find('\t')));
+        pos = end + 1;
+    }
+    return paths;
+}
+
+int open_for_hashing(int rootfd, const char* path) {
+    // O_NOATIME keeps verification from rewriting every inode, but is only
+    // allowed on files we own.
+    int fd = openat(rootfd, path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+        fd = openat(rootfd, path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    }
+    return fd;
+}
+
+// SHA-256 of the whole file in large sequential reads; false when it could
+// not be read to the end.
+bool hash_file(int fd, std::vector<char>& buffer, common::Sha256& hash, unsigned long long& hashed) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    buffer.resize(kReadChunk);
+    off_t offset = 0;
+    while (true) {
+        const ssize_t n = pread(fd, buffer.data(), buffer.size(), offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        hash.update(buffer.data(), static_cast<std::size_t>(n));
+        offset += n;
+    }
+    hashed += static_cast<unsigned long long>(offset);
+    // The data is not needed again; leave the page cache to the user's work.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    return true;
+}
+
+char file_type(mode_t mode) {
+    if (S_ISDIR(mode)) return 'd';
+    if (S_ISLNK(mode)) return 'l';
+    if (S_ISREG(mode)) return 'f';
+    return '?';
+}
+
+void check_file(int rootfd, const ExpectedFile& expected, bool checksums, std::vector<char>& buffer,
+                std::vector<const char*>& problems, unsigned long long& hashed) {
+    struct stat st {};
+    if (fstatat(rootfd, expected.path.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        problems.push_back(errno == ENOENT || errno == ENOTDIR ? "missing" : "unreadable");
+        return;
+    }
+    if (file_type(st.st_mode) != expected.type) {
+        problems.push_back("type");
+        return;
+    }
+    if (expected.type != 'l' && (st.st_mode & 07777) != (expected.mode & 07777)) {
+        problems.push_back("permissions");
+    }
+    if (st.st_uid != expected.uid || st.st_gid != expected.gid) {
+        problems.push_back("ownership");
+    }
+    if (expected.type == 'l') {
+        char target[4096];
+        const ssize_t length = readlinkat(rootfd, expected.path.c_str(), target, sizeof(target));
+        if (length < 0 || std::string_view(target, static_cast<std::size_t>(length)) != expected.link) {
+            problems.push_back("link");
+        }
+        return;
+    }
+    if (expected.type != 'f' || expected.backup) {
+        return;
+    }
+    if (expected.mtime >= 0 && st.st_mtim.tv_sec != expected.mtime) {
+        problems.push_back("mtime");
+    }
+    if (expected.size >= 0 && st.st_size != expected.size) {
+        problems.push_back("size");
+        return;
+    }
+    if (!checksums || expected.sha256.empty()) {
+        return;
+    }
+    const int fd = open_for_hashing(rootfd, expected.path.c_str());
+    common::Sha256 hash;
+    const bool read = fd >= 0 && hash_file(fd, buffer, hash, hashed);
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!read) {
+        problems.push_back("unreadable");
+    } else if (common::Sha256::to_hex(hash.digest()) != expected.sha256) {
+        problems.push_back("checksum");
+    }
+}
+
+}
+
+VerifyReport verify_installed_files(const VerifyOptions& options, const VerifyIssueCallback& on_issue,
+                                    const std::atomic<bool>* cancel) {
+    const auto start = std::chrono::steady_clock::now();
+    VerifyReport report;
+    const std::size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    report.threads = options.threads > 0 ? options.threads : std::clamp<std::size_t>(hardware * 2, 4, 16);
+
+    const auto database = read_local_database(options.db_path);
+    const int dbfd = open((options.db_path + "/local").c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    const int rootfd = open(options.root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (!database->valid || dbfd < 0 || rootfd < 0) {
+        if (dbfd >= 0) close(dbfd);
+        if (rootfd >= 0) close(rootfd);
+        return report;
+    }
+    report.valid = true;
+
+    std::vector<std::uint32_t> selected;
+    if (options.packages.empty()) {
+        for (std::uint32_t id = 0; id < database->packages.size(); ++id) {
+            selected.push_back(id);
+        }
+    } else {
+        for (const auto& name : options.packages) {
+            const auto it = std::lower_bound(database->packages.begin(), database->packages.end(), name,
+                                             [](const PackageInfo& package, const std::string& key) {
+                                                 return package.name < key;
+                                             });
+            if (it == database->packages.end() || it->name != name) {
+                report.unknown_packages.push_back(name);
+            } else {
+                selected.push_back(static_cast<std::uint32_t>(it - database->packages.begin()));
+            }
+        }
+    }
+    report.packages = selected.size();
+    auto cancelled = [cancel] { return cancel != nullptr && cancel->load(std::memory_order_relaxed); };
+
+    BoundedQueue<ExpectedFile> queue(options.queue_depth);
+    std::mutex issue_mutex;
+    std::unordered_set<std::uint32_t> packages_with_issues;
+    std::atomic<unsigned long long> files{0};
+    std::atomic<unsigned long long> missing{0};
+    std::atomic<unsigned long long> modified{0};
+    std::atomic<unsigned long long> hashed{0};
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < report.threads; ++i) {
+        workers.emplace_back([&]() {
+            std::vector<char> buffer;
+            std::vector<const char*> problems;
+            unsigned long long worker_hashed = 0;
+            ExpectedFile expected;
+            while (queue.pop(expected)) {
+                if (cancelled()) {
+                    continue;  // drain so the reader is never left blocked
+                }
+                problems.clear();
+                check_file(rootfd, expected, options.checksums, buffer, problems, worker_hashed);
+                files.fetch_add(1, std::memory_order_relaxed);
+                if (problems.empty()) {
+                    continue;
+                }
+                (problems.front() == std::string_view("missing") ? missing : modified)
+                    .fetch_add(1, std::memory_order_relaxed);
+                VerifyIssue issue{database->packages[expected.package].name, "/" + expected.path, problems};
+                std::lock_guard<std::mutex> lock(issue_mutex);
+                packages_with_issues.insert(expected.package);
+                if (on_issue) {
+                    on_issue(issue);
+                }
+                report.issues.push_back(std::move(issue));
+            }
+            hashed.fetch_add(worker_hashed, std::memory_order_relaxed);
+        });
+    }
+
+    std::string mtree;
+    for (const std::uint32_t id : selected) {
+        if (cancelled()) {
+            break;
+        }
+        const PackageInfo& package = database->packages[id];
+        const common::MappedFile compressed(dbfd, (package.db_entry + "/mtree").c_str());
+        mtree.clear();
+        if (!compressed.valid() || !common::decompress_to_string(compressed.view(), mtree)) {
+            ++report.packages_without_mtree;
+            continue;
+        }
+        const auto backups = backup_paths(dbfd, package.db_entry);
+        parse_mtree(mtree, id, [&](ExpectedFile file) {
+            if (!backups.empty() && backups.count(file.path) > 0) {
+                file.backup = true;
+                ++report.backup_files;
+            }
+            queue.push(std::move(file));
+        });
+    }
+    queue.close();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    close(dbfd);
+    close(rootfd);
+
+    std::sort(report.issues.begin(), report.issues.end(), [](const VerifyIssue& lhs, const VerifyIssue& rhs) {
+        return lhs.package != rhs.package ? lhs.package < rhs.package : lhs.path < rhs.path;
+    });
+    report.cancelled = cancelled();
+    report.packages_with_issues = packages_with_issues.size();
+    report.files = files.load();
+    report.missing = missing.load();
+    report.modified = modified.load();
+    report.bytes_hashed = hashed.load();
+    report.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (report.elapsed_ms > 0.0) {
+        report.mb_per_second = static_cast<double>(report.bytes_hashed) / (1024.0 * 1024.0) / (report.elapsed_ms / 1000.0);
+    }
+    return report;
+}
+
+std::string verify_issue_to_json(const VerifyIssue& issue) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"package\":\"" << common::escape_json(issue.package) << "\",";
+    json << "\"path\":\"" << common::escape_json(issue.path) << "\",";
+    json << "\"problems\":[";
+    for (size_t i = 0; i < issue.problems.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "\"" << issue.problems[i] << "\"";
+    }
+    json << "]";
+    json << "}";
+    return json.str();
+}
+
+std::string verify_report_to_json(const VerifyReport& report, bool include_issues) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"valid\":" << (report.valid ? "true" : "false") << ",";
+    json << "\"cancelled\":" << (report.cancelled ? "true" : "false") << ",";
+    json << "\"threads\":" << report.threads << ",";
+    json << "\"packages\":" << report.packages << ",";
+    json << "\"packages_with_issues\":" << report.packages_with_issues << ",";
+    json << "\"packages_without_mtree\":" << report.packages_without_mtree << ",";
+    json << "\"files\":" << report.files << ",";
+    json << "\"missing\":" << report.missing << ",";
+    json << "\"modified\":" << report.modified << ",";
+    json << "\"backup_files\":" << report.backup_files << ",";
+    json << "\"bytes_hashed\":" << report.bytes_hashed << ",";
+    json << "\"elapsed_ms\":" << std::fixed << std::setprecision(2) << report.elapsed_ms << ",";
+    json << "\"mb_per_second\":" << std::fixed << std::setprecision(2) << report.mb_per_second << ",";
+    json << "\"unknown_packages\":[";
+    for (size_t i = 0; i < report.unknown_packages.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "\"" << common::escape_json(report.unknown_packages[i]) << "\"";
+    }
+    json << "]";
+    if (include_issues) {
+        json << ",\"issues\":[";
+        for (size_t i = 0; i < report.issues.size(); ++i) {
+            if (i > 0) json << ",";
+            json << verify_issue_to_json(report.issues[i]);
+        }
+        json << "]";
+    }
+    json << "}";
+    return json.str();
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "pacman_db.hpp"
+
+namespace nanookjaro::package_manager {
+
+struct VerifyOptions {
+    std::vector<std::string> packages;  // empty: every installed package
+    std::string db_path = kDefaultDbPath;
+    std::string root = "/";
+    std::size_t threads = 0;         // 0 picks a default suited to I/O-bound hashing
+    std::size_t queue_depth = 4096;  // files parsed ahead of the workers
+    bool checksums = true;           // hash contents, like pacman -Qkk; false is closer to -Qk
+};
+
+// One installed file that does not match its package's mtree entry.
+// Problems are any of: missing, type, permissions, ownership, size, mtime,
+// link, checksum, unreadable.
+struct VerifyIssue {
+    std::string package;
+    std::string path;
+    std::vector<const char*> problems;
+};
+
+struct VerifyReport {
+    bool valid = false;
+    bool cancelled = false;
+    std::size_t threads = 0;
+    unsigned long long packages = 0;
+    unsigned long long packages_with_issues = 0;
+    unsigned long long packages_without_mtree = 0;
+    unsigned long long files = 0;         // mtree entries checked
+    unsigned long long missing = 0;
+    unsigned long long modified = 0;      // present but differing
+    unsigned long long backup_files = 0;  // configuration files, only type/permissions/ownership checked
+    unsigned long long bytes_hashed = 0;
+    double elapsed_ms = 0.0;
+    double mb_per_second = 0.0;
+    std::vector<std::string> unknown_packages;
+    std::vector<VerifyIssue> issues;
+};
+
+using VerifyIssueCallback = std::function<void(const VerifyIssue&)>;
+
+// Checks installed files against each package's local/<entry>/mtree. The
+// gzip mtree files are decoded on the calling thread and their entries fed
+// through a bounded queue to worker threads, which fstatat() every path and
+// SHA-256 hash regular files whose size matches. `on_issue` is called as
+// soon as a mismatch is found, from a worker thread but never concurrently.
+// Setting `cancel` stops the run early.
+VerifyReport verify_installed_files(const VerifyOptions& options = {}, const VerifyIssueCallback& on_issue = {},
+                                    const std::atomic<bool>* cancel = nullptr);
+
+std::string verify_issue_to_json(const VerifyIssue& issue);
+// Summary counters; with `include_issues` also every issue.
+std::string verify_report_to_json(const VerifyReport& report, bool include_issues);
+
+}
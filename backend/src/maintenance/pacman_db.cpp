@@ -0,0 +1,240 @@
+#include "pacman_db.hpp"
+#include "../common/directory_entries.hpp"
+#include "../common/mapped_file.hpp"
+#include "../common/parallel.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanookjaro::package_manager {
+
+namespace {
+
+// Sub-directories of `dirfd`, one per installed package.
+std::vector<std::string> list_subdirectories(int dirfd) {
+    std::vector<std::string> names;
+    const int fd = openat(dirfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return names;
+    }
+    std::vector<char> buffer;
+    common::for_each_directory_entry(fd, buffer, [&names](const char* name, unsigned char type) {
+        if (name[0] != '.' && (type == DT_DIR || type == DT_UNKNOWN)) {
+            names.emplace_back(name);
+        }
+    });
+    close(fd);
+    return names;
+}
+
+void split_lines_into(std::string_view block, std::vector<std::string>& out) {
+    std::size_t pos = 0;
+    while (pos < block.size()) {
+        const std::size_t end = std::min(block.find('\n', pos), block.size());
+        if (end > pos) {
+            out.emplace_back(block.substr(pos, end - pos));
+        }
+        pos = end + 1;
+    }
+}
+
+long long to_number(std::string_view value) {
+    return std::strtoll(std::string(value).c_str(), nullptr, 10);
+}
+
+struct DatabaseCache {
+    std::mutex mutex;
+    bool have_mtime = false;
+    struct timespec mtime {};
+    std::unordered_map<std::string, std::shared_ptr<const PackageInfo>> entries;
+    std::shared_ptr<const LocalDatabase> snapshot;
+    std::uint64_t generation = 0;
+};
+
+DatabaseCache& cache_for(const std::string& db_path) {
+    static std::mutex registry_mutex;
+    static std::map<std::string, std::unique_ptr<DatabaseCache>> registry;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& slot = registry[db_path];
+    if (!slot) {
+        slot = std::make_unique<DatabaseCache>();
+    }
+    return *slot;
+}
+
+}
+
+void parse_package_desc(std::string_view text, PackageInfo& package) {
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        const std::size_t header_end = std::min(text.find('\n', pos), text.size());
+        const std::string_view header = text.substr(pos, header_end - pos);
+        pos = header_end + 1;
+        if (header.size() < 3 || header.front() != '%' || header.back() != '%') {
+            continue;
+        }
+
+        // A section's values run until the next blank line.
+        std::size_t block_end = text.find("\n\n", header_end);
+        block_end = block_end == std::string_view::npos ? text.size() : block_end;
+        const std::string_view block = pos < block_end ? text.substr(pos, block_end - pos) : std::string_view();
+        pos = block_end;
+
+        const std::string_view key = header.substr(1, header.size() - 2);
+        const std::string_view first = block.substr(0, block.find('\n'));
+        if (key == "NAME") {
+            package.name = first;
+        } else if (key == "VERSION") {
+            package.version = first;
+        } else if (key == "DESC") {
+            package.description = first;
+        } else if (key == "ARCH") {
+            package.arch = first;
+        } else if (key == "URL") {
+            package.url = first;
+        } else if (key == "PACKAGER") {
+            package.packager = first;
+        } else if (key == "FILENAME") {
+            package.filename = first;
+        } else if (key == "SIZE" || key == "ISIZE") {
+            package.installed_size = to_number(first);
+        } else if (key == "CSIZE") {
+            package.download_size = to_number(first);
+        } else if (key == "BUILDDATE") {
+            package.build_date = to_number(first);
+        } else if (key == "INSTALLDATE") {
+            package.install_date = to_number(first);
+        } else if (key == "REASON") {
+            package.explicitly_installed = to_number(first) == 0;
+        } else if (key == "LICENSE") {
+            split_lines_into(block, package.licenses);
+        } else if (key == "GROUPS") {
+            split_lines_into(block, package.groups);
+        } else if (key == "DEPENDS") {
+            split_lines_into(block, package.depends);
+        } else if (key == "OPTDEPENDS") {
+            split_lines_into(block, package.optdepends);
+        } else if (key == "PROVIDES") {
+            split_lines_into(block, package.provides);
+        } else if (key == "CONFLICTS") {
+            split_lines_into(block, package.conflicts);
+        } else if (key == "REPLACES") {
+            split_lines_into(block, package.replaces);
+        }
+    }
+}
+
+std::shared_ptr<const LocalDatabase> read_local_database(const std::string& db_path) {
+    DatabaseCache& cache = cache_for(db_path);
+    std::lock_guard<std::mutex> lock(cache.mutex);
+
+    const std::string local_path = db_path + "/local";
+    struct stat st {};
+    if (stat(local_path.c_str(), &st) == 0 && cache.snapshot && cache.have_mtime &&
+        st.st_mtim.tv_sec == cache.mtime.tv_sec && st.st_mtim.tv_nsec == cache.mtime.tv_nsec) {
+        return cache.snapshot;
+    }
+
+    const int dirfd = open(local_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        cache.entries.clear();
+        cache.have_mtime = false;
+        cache.snapshot = std::make_shared<LocalDatabase>();
+        return cache.snapshot;
+    }
+    fstat(dirfd, &st);
+
+    // Entry names embed the version, so an upgrade shows up as a new entry and
+    // unchanged packages can be reused from the previous snapshot.
+    const std::vector<std::string> names = list_subdirectories(dirfd);
+    std::unordered_map<std::string, std::shared_ptr<const PackageInfo>> entries;
+    std::vector<std::string> fresh;
+    for (const auto& name : names) {
+        if (auto it = cache.entries.find(name); it != cache.entries.end()) {
+            entries.emplace(name, std::move(it->second));
+        } else {
+            fresh.push_back(name);
+        }
+    }
+
+    std::vector<std::shared_ptr<PackageInfo>> parsed(fresh.size());
+    common::parallel_for(fresh.size(), [&](std::size_t i) {
+        const common::MappedFile desc(dirfd, (fresh[i] + "/desc").c_str());
+        if (!desc.valid()) {
+            return;
+        }
+        auto package = std::make_shared<PackageInfo>();
+        parse_package_desc(desc.view(), *package);
+        package->db_entry = fresh[i];
+        if (!package->name.empty()) {
+            parsed[i] = std::move(package);
+        }
+    });
+    close(dirfd);
+
+    for (std::size_t i = 0; i < fresh.size(); ++i) {
+        if (parsed[i]) {
+            entries.emplace(fresh[i], std::move(parsed[i]));
+        }
+    }
+
+    auto snapshot = std::make_shared<LocalDatabase>();
+    snapshot->packages.reserve(entries.size());
+    for (const auto& [name, package] : entries) {
+        snapshot->packages.push_back(*package);
+    }
+    std::sort(snapshot->packages.begin(), snapshot->packages.end(),
+              [](const PackageInfo& lhs, const PackageInfo& rhs) { return lhs.name < rhs.name; });
+    snapshot->generation = ++cache.generation;
+    snapshot->valid = true;
+
+    cache.entries = std::move(entries);
+    cache.mtime = st.st_mtim;
+    cache.have_mtime = true;
+    cache.snapshot = snapshot;
+    return snapshot;
+}
+
+long long installed_package_count() {
+    const auto database = read_local_database();
+    if (!database->valid) {
+        return -1;
+    }
+    return static_cast<long long>(database->packages.size());
+}
+
+std::string local_packages_to_json(const LocalDatabase& database) {
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < database.packages.size(); ++i) {
+        if (i > 0) json << ",";
+        const auto& package = database.packages[i];
+        json << "{";
+        json << "\"name\":\"" << common::escape_json(package.name) << "\",";
+        json << "\"version\":\"" << common::escape_json(package.version) << "\",";
+        json << "\"description\":\"" << common::escape_json(package.description) << "\",";
+        json << "\"arch\":\"" << common::escape_json(package.arch) << "\",";
+        json << "\"installed_size\":" << package.installed_size << ",";
+        json << "\"build_date\":" << package.build_date << ",";
+        json << "\"install_date\":" << package.install_date << ",";
+        json << "\"reason\":\"" << (package.explicitly_installed ? "explicit" : "dependency") << "\"";
+        json << "}";
+    }
+    json << "]";
+    return json.str();
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nanookjaro::package_manager {
+
+inline constexpr const char* kDefaultDbPath = "/var/lib/pacman";
+
+struct PackageInfo {
+    std::string name;
+    std::string version;
+    std::string description;
+    std::string arch;
+    std::string url;
+    std::string packager;
+    std::string filename;
+    std::string db_entry;
+    long long installed_size = 0;
+    long long download_size = 0;
+    long long build_date = 0;
+    long long install_date = 0;
+    bool explicitly_installed = true;
+    std::vector<std::string> licenses;
+    std::vector<std::string> groups;
+    std::vector<std::string> depends;
+    std::vector<std::string> optdepends;
+    std::vector<std::string> provides;
+    std::vector<std::string> conflicts;
+    std::vector<std::string> replaces;
+};
+
+struct LocalDatabase {
+    std::vector<PackageInfo> packages;  // sorted by name
+    // Incremented every time the set of installed packages changes, so
+    // consumers can cheaply tell whether derived data needs rebuilding.
+    std::uint64_t generation = 0;
+    bool valid = false;
+};
+
+// Parses a libalpm "desc" file (%SECTION% headers followed by value lines) into
+// `package`. Shared by the local and sync database readers.
+void parse_package_desc(std::string_view text, PackageInfo& package);
+
+// Snapshot of <db_path>/local. Repeat calls return the cached snapshot while the
+// directory mtime is unchanged; otherwise only entries that appeared since the
+// previous read are parsed. Note that `pacman -D --asdeps/--asexplicit`
+// rewrites desc files in place and is only picked up on the next change to the
+// package set.
+std::shared_ptr<const LocalDatabase> read_local_database(const std::string& db_path = kDefaultDbPath);
+
+// Number of installed packages, or -1 when the local database is unreadable.
+long long installed_package_count();
+
+std::string local_packages_to_json(const LocalDatabase& database);
+
+}
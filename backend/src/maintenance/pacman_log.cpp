@@ -0,0 +1,501 @@
+#include "pacman_log.hpp"
+#include "../common/hash.hpp"
+#include "../common/mapped_file.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include <sys/stat.h>
+
+namespace nanookjaro::package_manager {
+
+namespace {
+
+std::string trim(const std::string& value) {
+    const auto first = value.find_first_not_of(" \t\n\r");
+    if (first == std::string::npos) {
+        return {};
+    }
+    const auto last = value.find_last_not_of(" \t\n\r");
+    return value.substr(first, last - first + 1);
+}
+
+std::string_view trim_left(std::string_view text) {
+    while (!text.empty() && text.front() == ' ') {
+        text.remove_prefix(1);
+    }
+    return text;
+}
+
+bool read_digits(std::string_view text, std::size_t pos, std::size_t count, int& value) {
+    if (pos + count > text.size()) {
+        return false;
+    }
+    value = 0;
+    for (std::size_t i = pos; i < pos + count; ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date.
+std::int64_t days_from_civil(int year, int month, int day) {
+    year -= month <= 2 ? 1 : 0;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int year_of_era = year - era * 400;
+    const int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return static_cast<std::int64_t>(era) * 146097 + day_of_era - 719468;
+}
+
+// "2024-01-15T10:23:45+0100" (pacman >= 5.1) or "2019-01-01 10:00" (older
+// releases, local time without an offset, taken as UTC).
+bool parse_timestamp(std::string_view stamp, std::int64_t& seconds) {
+    int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+    if (stamp.size() < 16 || !read_digits(stamp, 0, 4, year) || stamp[4] != '-' ||
+        !read_digits(stamp, 5, 2, month) || stamp[7] != '-' || !read_digits(stamp, 8, 2, day) ||
+        (stamp[10] != 'T' && stamp[10] != ' ') ||
+        !read_digits(stamp, 11, 2, hour) || stamp[13] != ':' || !read_digits(stamp, 14, 2, minute)) {
+        return false;
+    }
+    std::size_t pos = 16;
+    if (pos < stamp.size() && stamp[pos] == ':' && read_digits(stamp, pos + 1, 2, second)) {
+        pos += 3;
+    }
+    int offset = 0;
+    if (pos < stamp.size() && (stamp[pos] == '+' || stamp[pos] == '-')) {
+        int offset_hours = 0, offset_minutes = 0;
+        const std::size_t minutes_at = pos + 3 < stamp.size() && stamp[pos + 3] == ':' ? pos + 4 : pos + 3;
+        if (read_digits(stamp, pos + 1, 2, offset_hours) && read_digits(stamp, minutes_at, 2, offset_minutes)) {
+            offset = (offset_hours * 3600 + offset_minutes * 60) * (stamp[pos] == '-' ? -1 : 1);
+        }
+    }
+    seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+    return true;
+}
+
+bool parse_action(std::string_view verb, LogAction& action) {
+    if (verb == "upgraded") {
+        action = LogAction::upgraded;
+    } else if (verb == "installed") {
+        action = LogAction::installed;
+    } else if (verb == "removed") {
+        action = LogAction::removed;
+    } else if (verb == "downgraded") {
+        action = LogAction::downgraded;
+    } else if (verb == "reinstalled") {
+        action = LogAction::reinstalled;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool starts_with(std::string_view text, std::string_view prefix) {
+    return text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0;
+}
+
+std::uint64_t head_hash(std::string_view data) {
+    const std::size_t end = data.find('\n');
+    return common::xxh64(data.substr(0, end == std::string_view::npos ? data.size() : end));
+}
+
+struct LogCache {
+    std::mutex mutex;
+    std::shared_ptr<PacmanLogIndex> index;
+};
+
+LogCache& log_cache_for(const std::string& path) {
+    static std::mutex registry_mutex;
+    static std::map<std::string, std::unique_ptr<LogCache>> registry;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& slot = registry[path];
+    if (!slot) {
+        slot = std::make_unique<LogCache>();
+    }
+    return *slot;
+}
+
+}
+
+const char* log_action_name(LogAction action) {
+    switch (action) {
+        case LogAction::installed:
+            return "installed";
+        case LogAction::upgraded:
+            return "upgraded";
+        case LogAction::downgraded:
+            return "downgraded";
+        case LogAction::reinstalled:
+            return "reinstalled";
+        case LogAction::removed:
+            return "removed";
+    }
+    return "unknown";
+}
+
+std::span<const std::uint32_t> PacmanLogIndex::package_records(std::string_view name) const {
+    const auto it = name_ids_.find(name);
+    if (it == name_ids_.end()) {
+        return {};
+    }
+    return package_records_[it->second];
+}
+
+std::uint32_t PacmanLogIndex::transaction(std::uint32_t record) const {
+    // Every record belongs to a transaction and transactions cover records in
+    // order, so the owner is the last one starting at or before `record`.
+    const auto it = std::upper_bound(transactions_.begin(), transactions_.end(), record,
+                                     [](std::uint32_t value, const LogTransaction& transaction) {
+                                         return value < transaction.first_record;
+                                     });
+    return static_cast<std::uint32_t>(it - transactions_.begin()) - 1;
+}
+
+std::uint32_t PacmanLogIndex::first_transaction_since(std::int64_t time) const {
+    if (monotonic_) {
+        const auto it = std::lower_bound(transactions_.begin(), transactions_.end(), time,
+                                         [](const LogTransaction& transaction, std::int64_t value) {
+                                             return transaction.started < value;
+                                         });
+        return static_cast<std::uint32_t>(it - transactions_.begin());
+    }
+    for (std::uint32_t i = 0; i < transactions_.size(); ++i) {
+        if (transactions_[i].started >= time) {
+            return i;
+        }
+    }
+    return static_cast<std::uint32_t>(transactions_.size());
+}
+
+std::size_t PacmanLogIndex::memory_bytes() const {
+    std::size_t bytes = sizeof(*this) + times_.capacity() * sizeof(std::int64_t) +
+                        actions_.capacity() * sizeof(LogAction) +
+                        (packages_.capacity() + old_versions_.capacity() + new_versions_.capacity()) *
+                            sizeof(std::uint32_t) +
+                        versions_.capacity() + transactions_.capacity() * sizeof(LogTransaction);
+    for (std::size_t i = 0; i < names_.size(); ++i) {
+        // Each name is held twice: in names_ and as a name_ids_ key.
+        bytes += 2 * (sizeof(std::string) + names_[i].capacity()) +
+                 (package_records_[i].capacity() + 1) * sizeof(std::uint32_t);
+    }
+    return bytes;
+}
+
+std::uint32_t PacmanLogIndex::intern_version(std::string_view version) {
+    if (version.empty()) {
+        return 0;
+    }
+    const auto offset = static_cast<std::uint32_t>(versions_.size());
+    versions_.append(version);
+    versions_.push_back('\0');
+    return offset;
+}
+
+void PacmanLogIndex::parse(std::string_view text) {
+    if (versions_.empty()) {
+        versions_.push_back('\0');  // offset 0 is the empty string
+    }
+    const char* cursor = text.data();
+    const char* const end = text.data() + text.size();
+    while (cursor < end) {
+        const auto* newline = static_cast<const char*>(std::memchr(cursor, '\n', static_cast<std::size_t>(end - cursor)));
+        const char* line_end = newline != nullptr ? newline : end;
+        parse_line(std::string_view(cursor, static_cast<std::size_t>(line_end - cursor)));
+        ++lines_;
+        cursor = line_end + 1;
+    }
+}
+
+void PacmanLogIndex::parse_line(std::string_view line) {
+    const bool previous_was_record = last_line_record_;
+    last_line_record_ = false;
+    if (line.size() < 3 || line.front() != '[') {
+        return;
+    }
+    const std::size_t close = line.find(']');
+    std::int64_t time = 0;
+    if (close == std::string_view::npos || !parse_timestamp(line.substr(1, close - 1), time)) {
+        return;
+    }
+    std::string_view rest = trim_left(line.substr(close + 1));
+    std::string_view tag;
+    if (!rest.empty() && rest.front() == '[') {
+        const std::size_t tag_end = rest.find(']');
+        if (tag_end == std::string_view::npos) {
+            return;
+        }
+        tag = rest.substr(1, tag_end - 1);
+        rest = trim_left(rest.substr(tag_end + 1));
+    }
+
+    if (tag == "PACMAN") {
+        constexpr std::string_view kRunning = "Running '";
+        if (starts_with(rest, kRunning)) {
+            rest.remove_prefix(kRunning.size());
+            if (!rest.empty() && rest.back() == '\'') {
+                rest.remove_suffix(1);
+            }
+            pending_command_.assign(rest);
+        }
+        return;
+    }
+    if (!tag.empty() && tag != "ALPM") {
+        return;
+    }
+
+    if (starts_with(rest, "transaction ")) {
+        const std::string_view event = rest.substr(12);
+        if (event == "started") {
+            if (!transactions_.empty() && time < transactions_.back().started) {
+                monotonic_ = false;
+            }
+            LogTransaction transaction;
+            transaction.started = time;
+            transaction.command = std::move(pending_command_);
+            transaction.state = "open";
+            transaction.first_record = static_cast<std::uint32_t>(times_.size());
+            transactions_.push_back(std::move(transaction));
+            pending_command_.clear();
+            transaction_open_ = true;
+        } else if (transaction_open_ && (event == "completed" || event == "failed" || event == "interrupted")) {
+            transactions_.back().finished = time;
+            transactions_.back().state = std::string(event);
+            transaction_open_ = false;
+        }
+        return;
+    }
+
+    // "<verb> <name> (<version>)" or "<verb> <name> (<old> -> <new>)".
+    const std::size_t verb_end = rest.find(' ');
+    LogAction action{};
+    if (verb_end == std::string_view::npos || !parse_action(rest.substr(0, verb_end), action)) {
+        return;
+    }
+    rest.remove_prefix(verb_end + 1);
+    const std::size_t name_end = rest.find(' ');
+    if (name_end == std::string_view::npos || name_end == 0 || rest.size() < name_end + 3 ||
+        rest[name_end + 1] != '(' || rest.back() != ')') {
+        return;
+    }
+    const std::string_view name = rest.substr(0, name_end);
+    const std::string_view versions = rest.substr(name_end + 2, rest.size() - name_end - 3);
+    std::string_view old_version;
+    std::string_view new_version = versions;
+    if (const std::size_t arrow = versions.find(" -> "); arrow != std::string_view::npos) {
+        old_version = versions.substr(0, arrow);
+        new_version = versions.substr(arrow + 4);
+    } else if (action == LogAction::removed) {
+        old_version = versions;
+        new_version = {};
+    }
+
+    // Logs from before pacman 4.1 have no transaction markers; consecutive
+    // records form one implicit transaction.
+    if (!transaction_open_ && (!previous_was_record || transactions_.empty() ||
+                               transactions_.back().state != "implicit")) {
+        if (!transactions_.empty() && time < transactions_.back().started) {
+            monotonic_ = false;
+        }
+        LogTransaction transaction;
+        transaction.started = time;
+        transaction.finished = time;
+        transaction.command = std::move(pending_command_);
+        transaction.state = "implicit";
+        transaction.first_record = static_cast<std::uint32_t>(times_.size());
+        transactions_.push_back(std::move(transaction));
+        pending_command_.clear();
+    }
+    LogTransaction& transaction = transactions_.back();
+    if (!transaction_open_) {
+        transaction.finished = time;
+    }
+    ++transaction.record_count;
+
+    auto it = name_ids_.find(name);
+    if (it == name_ids_.end()) {
+        it = name_ids_.emplace(std::string(name), static_cast<std::uint32_t>(names_.size())).first;
+        names_.emplace_back(name);
+        package_records_.emplace_back();
+        last_versions_.push_back(0);
+    }
+    const std::uint32_t package = it->second;
+    // A package's old version is almost always the new version of its
+    // previous record, so that string is stored once.
+    const auto version_offset = [&](std::string_view version) {
+        const std::uint32_t last = last_versions_[package];
+        return last != 0 && version == versions_.data() + last ? last : intern_version(version);
+    };
+    const std::uint32_t old_offset = version_offset(old_version);
+    const std::uint32_t new_offset = version_offset(new_version);
+    if (new_offset != 0) {
+        last_versions_[package] = new_offset;
+    }
+
+    const auto record = static_cast<std::uint32_t>(times_.size());
+    times_.push_back(time);
+    actions_.push_back(action);
+    packages_.push_back(package);
+    old_versions_.push_back(old_offset);
+    new_versions_.push_back(new_offset);
+    package_records_[package].push_back(record);
+    last_line_record_ = true;
+}
+
+std::string configured_log_file(const std::string& config_path) {
+    std::ifstream config(config_path);
+    std::string line;
+    bool in_options = false;
+    while (std::getline(config, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.size() > 2 && line.front() == '[' && line.back() == ']') {
+            in_options = line == "[options]";
+            continue;
+        }
+        const std::size_t equals = line.find('=');
+        if (in_options && equals != std::string::npos && trim(line.substr(0, equals)) == "LogFile") {
+            const std::string value = trim(line.substr(equals + 1));
+            if (!value.empty()) {
+                return value;
+            }
+        }
+    }
+    return kDefaultPacmanLog;
+}
+
+std::shared_ptr<const PacmanLogIndex> pacman_log_index(const std::string& path) {
+    LogCache& cache = log_cache_for(path);
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    // Taken out of the cache so use_count() tells whether callers still hold it.
+    std::shared_ptr<PacmanLogIndex> index = std::move(cache.index);
+
+    struct stat st {};
+    common::MappedFile file;
+    if (stat(path.c_str(), &st) == 0) {
+        if (index && index->valid_ && index->device_ == st.st_dev && index->inode_ == st.st_ino &&
+            static_cast<std::uint64_t>(st.st_size) == index->offset_) {
+            cache.index = index;
+            return index;
+        }
+        file = common::MappedFile(path);
+    }
+    if (!file.valid()) {
+        index = std::make_shared<PacmanLogIndex>();
+        index->path_ = path;
+        cache.index = index;
+        return index;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::string_view data = file.view();
+    const std::uint64_t head = head_hash(data);
+    const bool resume = index && index->valid_ && index->device_ == st.st_dev && index->inode_ == st.st_ino &&
+                        index->head_hash_ == head && data.size() >= index->offset_;
+    // Only complete lines; a partially written last line is picked up next time.
+    const std::string_view pending = data.substr(resume ? index->offset_ : 0);
+    const std::size_t last_newline = pending.rfind('\n');
+    const std::size_t length = last_newline == std::string_view::npos ? 0 : last_newline + 1;
+    if (resume && length == 0) {
+        cache.index = index;
+        return index;
+    }
+    if (!resume) {
+        index = std::make_shared<PacmanLogIndex>();
+        index->path_ = path;
+        index->valid_ = true;
+        index->device_ = st.st_dev;
+        index->inode_ = st.st_ino;
+        index->head_hash_ = head;
+    } else if (index.use_count() > 1) {
+        // Readers keep their snapshot; extend a copy.
+        index = std::make_shared<PacmanLogIndex>(*index);
+    }
+
+    index->parse(pending.substr(0, length));
+    index->offset_ += length;
+    index->last_parsed_bytes_ = length;
+    index->last_parse_ms_ =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    cache.index = index;
+    return index;
+}
+
+std::string pacman_log_history_to_json(const PacmanLogIndex& index, const std::string& package, std::int64_t since,
+                                       std::size_t limit) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"valid\":" << (index.valid() ? "true" : "false") << ",";
+    json << "\"file\":\"" << common::escape_json(index.path()) << "\",";
+    json << "\"bytes_indexed\":" << index.bytes_indexed() << ",";
+    json << "\"lines\":" << index.lines() << ",";
+    json << "\"records\":" << index.size() << ",";
+    json << "\"transactions\":" << index.transactions().size() << ",";
+    json << "\"packages\":" << index.package_count() << ",";
+    json << "\"memory_bytes\":" << index.memory_bytes() << ",";
+    json << "\"parsed_bytes\":" << index.last_parsed_bytes() << ",";
+    json << "\"parse_ms\":" << std::fixed << std::setprecision(2) << index.last_parse_ms() << ",";
+
+    const auto append_change = [&](std::uint32_t record) {
+        json << "\"action\":\"" << log_action_name(index.action(record)) << "\",";
+        json << "\"old_version\":\"" << common::escape_json(index.old_version(record)) << "\",";
+        json << "\"new_version\":\"" << common::escape_json(index.new_version(record)) << "\"";
+    };
+
+    std::size_t listed = 0;
+    if (!package.empty()) {
+        json << "\"package\":\"" << common::escape_json(package) << "\",";
+        json << "\"history\":[";
+        const auto records = index.package_records(package);
+        for (auto it = records.rbegin(); it != records.rend() && listed < limit; ++it) {
+            if (index.time(*it) < since) {
+                continue;
+            }
+            if (listed++ > 0) json << ",";
+            json << "{\"time\":" << index.time(*it) << ",";
+            json << "\"transaction\":" << index.transaction(*it) << ",";
+            append_change(*it);
+            json << "}";
+        }
+        json << "]}";
+        return json.str();
+    }
+
+    json << "\"history\":[";
+    const auto& transactions = index.transactions();
+    const std::uint32_t first = since > 0 ? index.first_transaction_since(since) : 0;
+    for (std::uint32_t id = static_cast<std::uint32_t>(transactions.size()); id > first && listed < limit; --id) {
+        const LogTransaction& transaction = transactions[id - 1];
+        if (transaction.started < since || transaction.record_count == 0) {
+            continue;
+        }
+        if (listed++ > 0) json << ",";
+        json << "{\"id\":" << id - 1 << ",";
+        json << "\"started\":" << transaction.started << ",";
+        json << "\"finished\":" << transaction.finished << ",";
+        json << "\"state\":\"" << transaction.state << "\",";
+        json << "\"command\":\"" << common::escape_json(transaction.command) << "\",";
+        json << "\"changes\":[";
+        for (std::uint32_t i = 0; i < transaction.record_count; ++i) {
+            const std::uint32_t record = transaction.first_record + i;
+            if (i > 0) json << ",";
+            json << "{\"package\":\"" << common::escape_json(index.package(record)) << "\",";
+            append_change(record);
+            json << "}";
+        }
+        json << "]}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "pacman_sync.hpp"
+
+namespace nanookjaro::package_manager {
+
+inline constexpr const char* kDefaultPacmanLog = "/var/log/pacman.log";
+
+enum class LogAction : std::uint8_t { installed, upgraded, downgraded, reinstalled, removed };
+
+const char* log_action_name(LogAction action);
+
+struct LogTransaction {
+    std::int64_t started = 0;   // Unix seconds
+    std::int64_t finished = 0;  // 0 while open or when the log has no end marker
+    std::string command;        // the preceding "[PACMAN] Running '...'" line, if any
+    std::string state;          // "completed", "failed", "interrupted", "open" or "implicit"
+    std::uint32_t first_record = 0;
+    std::uint32_t record_count = 0;
+};
+
+// Package changes parsed from pacman.log, stored column by column: record i
+// is times()[i], actions()[i], package(i), old_version(i), new_version(i)
+// and transaction(i). Records keep file order; per-package record lists make
+// "what happened to X" a direct lookup.
+class PacmanLogIndex {
+public:
+    std::size_t size() const { return times_.size(); }
+    std::int64_t time(std::uint32_t record) const { return times_[record]; }
+    LogAction action(std::uint32_t record) const { return actions_[record]; }
+    std::string_view package(std::uint32_t record) const { return names_[packages_[record]]; }
+    std::string_view old_version(std::uint32_t record) const { return versions_.data() + old_versions_[record]; }
+    std::string_view new_version(std::uint32_t record) const { return versions_.data() + new_versions_[record]; }
+    std::uint32_t transaction(std::uint32_t record) const;
+
+    const std::vector<LogTransaction>& transactions() const { return transactions_; }
+    std::size_t package_count() const { return names_.size(); }
+    // Records of `name` in file order; empty for packages the log never mentions.
+    std::span<const std::uint32_t> package_records(std::string_view name) const;
+    // First transaction started at or after `time` (transactions().size() if none).
+    std::uint32_t first_transaction_since(std::int64_t time) const;
+
+    const std::string& path() const { return path_; }
+    bool valid() const { return valid_; }
+    std::uint64_t bytes_indexed() const { return offset_; }
+    std::uint64_t lines() const { return lines_; }
+    std::uint64_t last_parsed_bytes() const { return last_parsed_bytes_; }
+    double last_parse_ms() const { return last_parse_ms_; }
+    std::size_t memory_bytes() const;
+
+private:
+    friend std::shared_ptr<const PacmanLogIndex> pacman_log_index(const std::string& path);
+
+    void parse(std::string_view text);
+    void parse_line(std::string_view line);
+    std::uint32_t intern_version(std::string_view version);
+
+    std::string path_;
+    bool valid_ = false;
+    std::uint64_t device_ = 0;
+    std::uint64_t inode_ = 0;
+    std::uint64_t head_hash_ = 0;  // first line, to notice a rotated or rewritten log
+    std::uint64_t offset_ = 0;     // end of the last complete line indexed
+    std::uint64_t lines_ = 0;
+    std::uint64_t last_parsed_bytes_ = 0;
+    double last_parse_ms_ = 0.0;
+    bool monotonic_ = true;
+
+    std::vector<std::int64_t> times_;
+    std::vector<LogAction> actions_;
+    std::vector<std::uint32_t> packages_;
+    std::vector<std::uint32_t> old_versions_;  // offsets of NUL-terminated strings in versions_
+    std::vector<std::uint32_t> new_versions_;
+    std::string versions_;
+
+    // Transparent hash so lookups by string_view do not allocate.
+    struct NameHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, std::uint32_t, NameHash, std::equal_to<>> name_ids_;
+    std::vector<std::vector<std::uint32_t>> package_records_;
+    std::vector<std::uint32_t> last_versions_;  // newest version offset per package
+
+    std::vector<LogTransaction> transactions_;
+    bool transaction_open_ = false;
+    bool last_line_record_ = false;
+    std::string pending_command_;
+};
+
+// LogFile from the [options] section of pacman.conf, or kDefaultPacmanLog.
+std::string configured_log_file(const std::string& config_path = kDefaultPacmanConfig);
+
+// Index of the log at `path`. The file is memory-mapped and split into lines
+// with memchr(). The index is cached per path: when the file has only grown,
+// parsing resumes at the last indexed byte offset; a rotated or truncated
+// log is indexed again from the start.
+std::shared_ptr<const PacmanLogIndex> pacman_log_index(const std::string& path);
+
+// Index statistics plus history, newest first: with a `package`, its last
+// `limit` changes; otherwise the last `limit` transactions with their
+// changes. `since` (Unix seconds, 0 for no bound) drops older entries.
+std::string pacman_log_history_to_json(const PacmanLogIndex& index, const std::string& package, std::int64_t since,
+                                       std::size_t limit);
+
+}
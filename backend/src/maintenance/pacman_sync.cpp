@@ -0,0 +1,310 @@
+#include "pacman_sync.hpp"
+#include "vercmp.hpp"
+#include "../common/decompress.hpp"
+#include "../common/mapped_file.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace nanookjaro::package_manager {
+
+namespace {
+
+std::string trim(const std::string& value) {
+    const auto first = value.find_first_not_of(" \t\n\r");
+    if (first == std::string::npos) {
+        return {};
+    }
+    const auto last = value.find_last_not_of(" \t\n\r");
+    return value.substr(first, last - first + 1);
+}
+
+std::uint64_t parse_tar_number(std::string_view field) {
+    // GNU base-256 encoding for values that do not fit in octal.
+    if (!field.empty() && (static_cast<unsigned char>(field[0]) & 0x80) != 0) {
+        std::uint64_t value = static_cast<unsigned char>(field[0]) & 0x7f;
+        for (std::size_t i = 1; i < field.size(); ++i) {
+            value = (value << 8) | static_cast<unsigned char>(field[i]);
+        }
+        return value;
+    }
+    std::uint64_t value = 0;
+    std::size_t i = field.find_first_not_of(' ');
+    for (; i < field.size() && field[i] >= '0' && field[i] <= '7'; ++i) {
+        value = value * 8 + static_cast<std::uint64_t>(field[i] - '0');
+    }
+    return value;
+}
+
+std::string_view c_field(const char* data, std::size_t size) {
+    const std::string_view field(data, size);
+    return field.substr(0, field.find('\0'));
+}
+
+// Incremental ustar/pax/GNU reader fed with decompressed chunks. Only regular
+// files accepted by `wanted` are buffered; everything else is skipped without
+// copying.
+class TarStream {
+public:
+    using Wanted = std::function<bool(std::string_view path)>;
+    using Handler = std::function<void(std::string_view path, std::string_view contents)>;
+
+    TarStream(Wanted wanted, Handler handler) : wanted_(std::move(wanted)), handler_(std::move(handler)) {}
+
+    bool feed(std::string_view chunk) {
+        while (!chunk.empty() && !finished_) {
+            if (remaining_ == 0 && padding_ == 0) {
+                const std::size_t take = std::min(chunk.size(), kBlock - header_.size());
+                header_.append(chunk.substr(0, take));
+                chunk.remove_prefix(take);
+                if (header_.size() == kBlock) {
+                    start_entry();
+                    header_.clear();
+                }
+                continue;
+            }
+            if (remaining_ > 0) {
+                const std::size_t take = static_cast<std::size_t>(std::min<std::uint64_t>(chunk.size(), remaining_));
+                if (capture_) {
+                    data_.append(chunk.substr(0, take));
+                }
+                chunk.remove_prefix(take);
+                remaining_ -= take;
+                if (remaining_ == 0) {
+                    finish_entry();
+                }
+                continue;
+            }
+            const std::size_t skip = static_cast<std::size_t>(std::min<std::uint64_t>(chunk.size(), padding_));
+            chunk.remove_prefix(skip);
+            padding_ -= skip;
+        }
+        return !finished_;
+    }
+
+private:
+    static constexpr std::size_t kBlock = 512;
+
+    void start_entry() {
+        if (header_.find_first_not_of('\0') == std::string::npos) {
+            if (++zero_blocks_ >= 2) {
+                finished_ = true;
+            }
+            return;
+        }
+        zero_blocks_ = 0;
+
+        const char* h = header_.data();
+        type_ = h[156];
+        const std::uint64_t size = parse_tar_number(std::string_view(h + 124, 12));
+        std::string path(c_field(h, 100));
+        if (std::string_view(h + 257, 5) == "ustar") {
+            const std::string_view prefix = c_field(h + 345, 155);
+            if (!prefix.empty()) {
+                path = std::string(prefix) + "/" + path;
+            }
+        }
+        if (!next_path_.empty()) {
+            path = std::move(next_path_);
+            next_path_.clear();
+        }
+
+        path_ = std::move(path);
+        capture_ = type_ == 'L' || type_ == 'x' ||
+                   ((type_ == '0' || type_ == '\0') && wanted_(path_));
+        data_.clear();
+        remaining_ = size;
+        padding_ = (kBlock - size % kBlock) % kBlock;
+        if (remaining_ == 0) {
+            finish_entry();
+        }
+    }
+
+    void finish_entry() {
+        if (!capture_) {
+            return;
+        }
+        if (type_ == 'L') {
+            next_path_ = std::string(c_field(data_.data(), data_.size()));
+        } else if (type_ == 'x') {
+            // "<length> <key>=<value>\n" records; only the path matters here.
+            std::size_t pos = 0;
+            while (pos < data_.size()) {
+                const std::size_t space = data_.find(' ', pos);
+                if (space == std::string::npos) {
+                    break;
+                }
+                const std::size_t length = std::strtoull(data_.c_str() + pos, nullptr, 10);
+                if (length == 0 || pos + length > data_.size()) {
+                    break;
+                }
+                const std::string_view record(data_.data() + space + 1, pos + length - space - 2);
+                if (record.rfind("path=", 0) == 0) {
+                    next_path_ = std::string(record.substr(5));
+                }
+                pos += length;
+            }
+        } else {
+            handler_(path_, data_);
+        }
+        data_.clear();
+    }
+
+    Wanted wanted_;
+    Handler handler_;
+    std::string header_;
+    std::string data_;
+    std::string path_;
+    std::string next_path_;
+    std::uint64_t remaining_ = 0;
+    std::uint64_t padding_ = 0;
+    char type_ = '\0';
+    bool capture_ = false;
+    bool finished_ = false;
+    int zero_blocks_ = 0;
+};
+
+std::shared_ptr<SyncRepository> parse_sync_database(const std::string& name, const std::string& path) {
+    auto repository = std::make_shared<SyncRepository>();
+    repository->name = name;
+
+    const common::MappedFile file(path);
+    if (!file.valid()) {
+        return repository;
+    }
+
+    TarStream tar(
+        [](std::string_view entry) {
+            return entry.size() > 5 && entry.compare(entry.size() - 5, 5, "/desc") == 0;
+        },
+        [&repository](std::string_view, std::string_view contents) {
+            PackageInfo package;
+            parse_package_desc(contents, package);
+            if (!package.name.empty()) {
+                repository->packages.push_back(std::move(package));
+            }
+        });
+
+    const bool ok = common::decompress(file.view(), [&tar](std::string_view chunk) { return tar.feed(chunk); });
+    if (!ok) {
+        repository->packages.clear();
+        return repository;
+    }
+
+    repository->by_name.reserve(repository->packages.size());
+    for (std::size_t i = 0; i < repository->packages.size(); ++i) {
+        repository->by_name.emplace(repository->packages[i].name, i);
+    }
+    repository->valid = true;
+    return repository;
+}
+
+struct CachedRepository {
+    long long mtime_sec = 0;
+    long long mtime_nsec = 0;
+    long long size = 0;
+    std::shared_ptr<const SyncRepository> repository;
+};
+
+std::mutex sync_cache_mutex;
+std::map<std::string, CachedRepository> sync_cache;
+
+}
+
+std::vector<std::string> configured_repositories(const std::string& db_path, const std::string& config_path) {
+    std::vector<std::string> repositories;
+    std::ifstream config(config_path);
+    std::string line;
+    while (std::getline(config, line)) {
+        line = trim(line);
+        if (line.size() > 2 && line.front() == '[' && line.back() == ']') {
+            const std::string section = line.substr(1, line.size() - 2);
+            if (section != "options" &&
+                std::find(repositories.begin(), repositories.end(), section) == repositories.end()) {
+                repositories.push_back(section);
+            }
+        }
+    }
+    if (!repositories.empty()) {
+        return repositories;
+    }
+
+    const std::string sync_dir = db_path + "/sync";
+    if (DIR* dir = opendir(sync_dir.c_str())) {
+        while (const dirent* entry = readdir(dir)) {
+            const std::string_view file = entry->d_name;
+            if (file.size() > 3 && file.compare(file.size() - 3, 3, ".db") == 0) {
+                repositories.emplace_back(file.substr(0, file.size() - 3));
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(repositories.begin(), repositories.end());
+    return repositories;
+}
+
+std::vector<std::shared_ptr<const SyncRepository>> read_sync_databases(const std::string& db_path,
+                                                                       const std::string& config_path) {
+    std::vector<std::shared_ptr<const SyncRepository>> repositories;
+    std::lock_guard<std::mutex> lock(sync_cache_mutex);
+
+    for (const auto& name : configured_repositories(db_path, config_path)) {
+        const std::string path = db_path + "/sync/" + name + ".db";
+        struct stat st {};
+        if (stat(path.c_str(), &st) != 0) {
+            continue;
+        }
+
+        CachedRepository& cached = sync_cache[path];
+        if (!cached.repository || cached.mtime_sec != st.st_mtim.tv_sec ||
+            cached.mtime_nsec != st.st_mtim.tv_nsec || cached.size != st.st_size) {
+            cached.repository = parse_sync_database(name, path);
+            cached.mtime_sec = st.st_mtim.tv_sec;
+            cached.mtime_nsec = st.st_mtim.tv_nsec;
+            cached.size = st.st_size;
+        }
+        repositories.push_back(cached.repository);
+    }
+    return repositories;
+}
+
+std::vector<PendingUpdate> find_pending_updates(bool& ok, const std::string& db_path, const std::string& config_path) {
+    std::vector<PendingUpdate> updates;
+    const auto repositories = read_sync_databases(db_path, config_path);
+    const auto local = read_local_database(db_path);
+
+    ok = local->valid && std::any_of(repositories.begin(), repositories.end(),
+                                     [](const auto& repository) { return repository->valid; });
+    if (!ok) {
+        return updates;
+    }
+
+    for (const auto& installed : local->packages) {
+        // Like pacman, the first repository carrying the package wins.
+        for (const auto& repository : repositories) {
+            const auto it = repository->by_name.find(installed.name);
+            if (it == repository->by_name.end()) {
+                continue;
+            }
+            const PackageInfo& candidate = repository->packages[it->second];
+            if (vercmp(candidate.version, installed.version) > 0) {
+                updates.push_back(PendingUpdate{installed.name, installed.version, candidate.version, repository->name});
+            }
+            break;
+        }
+    }
+    return updates;
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pacman_db.hpp"
+
+namespace nanookjaro::package_manager {
+
+inline constexpr const char* kDefaultPacmanConfig = "/etc/pacman.conf";
+
+struct SyncRepository {
+    std::string name;
+    std::vector<PackageInfo> packages;
+    std::unordered_map<std::string, std::size_t> by_name;
+    bool valid = false;
+};
+
+struct PendingUpdate {
+    std::string name;
+    std::string current_version;
+    std::string new_version;
+    std::string repository;
+};
+
+// Repository sections of pacman.conf in priority order. Falls back to every
+// *.db file in <db_path>/sync (alphabetically) when the config is unreadable.
+std::vector<std::string> configured_repositories(const std::string& db_path = kDefaultDbPath,
+                                                 const std::string& config_path = kDefaultPacmanConfig);
+
+// Parsed <db_path>/sync/<repo>.db archives in priority order. Each archive is
+// decompressed and untarred in a single streaming pass; the result is cached
+// per repository until the file's mtime or size changes.
+std::vector<std::shared_ptr<const SyncRepository>> read_sync_databases(
+    const std::string& db_path = kDefaultDbPath, const std::string& config_path = kDefaultPacmanConfig);
+
+// Equivalent of `pacman -Qu` against the sync databases currently on disk (it
+// does not refresh them). `ok` is false when no sync database could be read.
+std::vector<PendingUpdate> find_pending_updates(bool& ok, const std::string& db_path = kDefaultDbPath,
+                                                const std::string& config_path = kDefaultPacmanConfig);
+
+}
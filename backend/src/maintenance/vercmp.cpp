@@ -0,0 +1,146 @@
+#include "vercmp.hpp"
+
+#include <cctype>
+
+namespace nanookjaro::package_manager {
+
+namespace {
+
+bool is_digit(char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }
+bool is_alpha(char c) { return std::isalpha(static_cast<unsigned char>(c)) != 0; }
+bool is_alnum(char c) { return std::isalnum(static_cast<unsigned char>(c)) != 0; }
+
+// rpmvercmp() from libalpm/version.c, operating on views instead of
+// temporarily NUL-terminated copies.
+int rpmvercmp(std::string_view a, std::string_view b) {
+    if (a == b) {
+        return 0;
+    }
+
+    std::size_t one = 0;
+    std::size_t two = 0;
+    std::size_t ptr1 = 0;
+    std::size_t ptr2 = 0;
+
+    while (one < a.size() && two < b.size()) {
+        while (one < a.size() && !is_alnum(a[one])) one++;
+        while (two < b.size() && !is_alnum(b[two])) two++;
+
+        if (!(one < a.size() && two < b.size())) {
+            break;
+        }
+
+        // Differently sized separators decide on their own.
+        if ((one - ptr1) != (two - ptr2)) {
+            return (one - ptr1) < (two - ptr2) ? -1 : 1;
+        }
+
+        ptr1 = one;
+        ptr2 = two;
+
+        bool is_number;
+        if (is_digit(a[ptr1])) {
+            while (ptr1 < a.size() && is_digit(a[ptr1])) ptr1++;
+            while (ptr2 < b.size() && is_digit(b[ptr2])) ptr2++;
+            is_number = true;
+        } else {
+            while (ptr1 < a.size() && is_alpha(a[ptr1])) ptr1++;
+            while (ptr2 < b.size() && is_alpha(b[ptr2])) ptr2++;
+            is_number = false;
+        }
+
+        if (one == ptr1) {
+            return -1;
+        }
+        // Numeric segments are always newer than alpha segments.
+        if (two == ptr2) {
+            return is_number ? 1 : -1;
+        }
+
+        std::string_view segment1 = a.substr(one, ptr1 - one);
+        std::string_view segment2 = b.substr(two, ptr2 - two);
+        if (is_number) {
+            while (!segment1.empty() && segment1.front() == '0') segment1.remove_prefix(1);
+            while (!segment2.empty() && segment2.front() == '0') segment2.remove_prefix(1);
+            if (segment1.size() != segment2.size()) {
+                return segment1.size() > segment2.size() ? 1 : -1;
+            }
+        }
+
+        const int rc = segment1.compare(segment2);
+        if (rc != 0) {
+            return rc < 0 ? -1 : 1;
+        }
+
+        one = ptr1;
+        two = ptr2;
+    }
+
+    const bool end1 = one >= a.size();
+    const bool end2 = two >= b.size();
+    if (end1 && end2) {
+        return 0;
+    }
+
+    // A remaining alpha segment never beats an empty string: "1.0" > "1.0rc1"
+    // but "1.0" < "1.0.1".
+    if ((end1 && !is_alpha(b[two])) || (!end1 && is_alpha(a[one]))) {
+        return -1;
+    }
+    return 1;
+}
+
+struct Evr {
+    std::string_view epoch;
+    std::string_view version;
+    std::string_view release;
+    bool has_release = false;
+};
+
+Evr parse_evr(std::string_view evr) {
+    Evr result;
+    std::size_t s = 0;
+    while (s < evr.size() && is_digit(evr[s])) {
+        s++;
+    }
+    const std::size_t dash = evr.rfind('-');
+    const bool has_dash = dash != std::string_view::npos && dash >= s;
+
+    std::size_t version_begin = 0;
+    if (s < evr.size() && evr[s] == ':') {
+        result.epoch = s == 0 ? std::string_view("0") : evr.substr(0, s);
+        version_begin = s + 1;
+    } else {
+        result.epoch = "0";
+    }
+
+    const std::size_t version_end = has_dash ? dash : evr.size();
+    result.version = evr.substr(version_begin, version_end - version_begin);
+    if (has_dash) {
+        result.release = evr.substr(dash + 1);
+        result.has_release = true;
+    }
+    return result;
+}
+
+}
+
+int vercmp(std::string_view a, std::string_view b) {
+    if (a == b) {
+        return 0;
+    }
+
+    const Evr left = parse_evr(a);
+    const Evr right = parse_evr(b);
+
+    int ret = rpmvercmp(left.epoch, right.epoch);
+    if (ret == 0) {
+        ret = rpmvercmp(left.version, right.version);
+        if (ret == 0 && left.has_release && right.has_release) {
+            ret = rpmvercmp(left.release, right.release);
+        }
+    }
+    return ret;
+}
+
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string_view>
+
+namespace nanookjaro::package_manager {
+
+// Port of libalpm's alpm_pkg_vercmp(): compares "[epoch:]version[-release]"
+// strings segment by segment. Returns <0, 0 or >0 like strcmp.
+int vercmp(std::string_view a, std::string_view b);
+
+}
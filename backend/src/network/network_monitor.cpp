@@ -1,193 +1,212 @@
+#include <algorithm>
 #include <array>
-#include <fstream>
-#include <iomanip>
-#include <sstream>
+#include <charconv>
+#include <chrono>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
-#include <map>
-#include <chrono>
-#include <thread>
-#include <algorithm>
-#include <iostream>
 
 #include "network_monitor.hpp"
+#include "../common/scratch.hpp"
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
 
 namespace nanookjaro::network {
 
 namespace {
 
-std::map<std::string, std::pair<unsigned long long, unsigned long long>> previous_stats;
-std::map<std::string, std::chrono::steady_clock::time_point> previous_times;
-
-std::string exec_command(const char* cmd) {
-    std::array<char, 128> buffer;
-    std::string result;
-    FILE* pipe = popen(cmd, "r");
-    if (!pipe) return "";
-    
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
-        result += buffer.data();
+struct Baseline {
+    unsigned long long rx_bytes = 0;
+    unsigned long long tx_bytes = 0;
+    std::chrono::steady_clock::time_point time;
+};
+
+// Rate baselines by interned interface name, shared by every caller (the
+// metrics sampler thread and direct FFI calls), hence the mutex.
+std::mutex previous_mutex;
+std::unordered_map<common::NameId, Baseline> previous_stats;
+
+// First line of a sysfs attribute of `interface`, or an empty string.
+std::string_view read_sysfs_value(std::string_view interface, const char* attribute, std::pmr::string& buffer) {
+    std::pmr::string path("/sys/class/net/", buffer.get_allocator());
+    path.append(interface).append("/").append(attribute);
+    if (!common::read_file(path.c_str(), buffer)) {
+        return {};
     }
-    
-    pclose(pipe);
-    return result;
+    const std::string_view value = buffer;
+    return value.substr(0, value.find('\n'));
 }
 
-std::pair<unsigned long long, unsigned long long> read_network_stats(const std::string& interface_name) {
-    std::ifstream file("/proc/net/dev");
-    std::string line;
-    
-    std::getline(file, line);
-    std::getline(file, line);
-    
-    while (std::getline(file, line)) {
-        size_t colon_pos = line.find(':');
-        if (colon_pos != std::string::npos) {
-            std::string name = line.substr(0, colon_pos);
-            name.erase(0, name.find_first_not_of(" \t"));
-            name.erase(name.find_last_not_of(" \t") + 1);
-            
-            if (name == interface_name) {
-                std::istringstream iss(line.substr(colon_pos + 1));
-                std::vector<std::string> stats;
-                std::string stat;
-                
-                while (iss >> stat) {
-                    stats.push_back(stat);
-                }
-                
-                if (stats.size() >= 9) {
-                    unsigned long long rx_bytes = std::stoull(stats[0]);
-                    unsigned long long tx_bytes = std::stoull(stats[8]);
-                    return std::make_pair(rx_bytes, tx_bytes);
-                }
+struct InterfaceAddresses {
+    explicit InterfaceAddresses(std::pmr::memory_resource* memory) : name(memory), ipv4(memory), ipv6(memory) {}
+
+    std::pmr::string name;
+    std::pmr::string ipv4;
+    std::pmr::string ipv6;
+};
+
+// First IPv4 and IPv6 address of every interface, in the order the kernel
+// reports them (the same order `ip addr show` prints).
+std::pmr::vector<InterfaceAddresses> read_interface_addresses(std::pmr::memory_resource* memory) {
+    std::pmr::vector<InterfaceAddresses> addresses(memory);
+    ifaddrs* list = nullptr;
+    if (getifaddrs(&list) != 0) {
+        return addresses;
+    }
+    for (const ifaddrs* entry = list; entry != nullptr; entry = entry->ifa_next) {
+        if (entry->ifa_addr == nullptr) {
+            continue;
+        }
+        std::array<char, INET6_ADDRSTRLEN> text{};
+        const std::string_view name = entry->ifa_name;
+        auto slot = std::find_if(addresses.begin(), addresses.end(), [&](const auto& a) { return a.name == name; });
+        if (slot == addresses.end()) {
+            slot = addresses.emplace(addresses.end(), memory);
+            slot->name = name;
+        }
+        if (entry->ifa_addr->sa_family == AF_INET && slot->ipv4.empty()) {
+            const auto* address = reinterpret_cast<const sockaddr_in*>(entry->ifa_addr);
+            if (inet_ntop(AF_INET, &address->sin_addr, text.data(), text.size()) != nullptr) {
+                slot->ipv4 = text.data();
+            }
+        } else if (entry->ifa_addr->sa_family == AF_INET6 && slot->ipv6.empty()) {
+            const auto* address = reinterpret_cast<const sockaddr_in6*>(entry->ifa_addr);
+            if (inet_ntop(AF_INET6, &address->sin6_addr, text.data(), text.size()) != nullptr) {
+                slot->ipv6 = text.data();
             }
         }
     }
-    
+    freeifaddrs(list);
+    return addresses;
+}
+
+// rx and tx byte counters from the part of a /proc/net/dev line after the
+// interface name.
+std::pair<unsigned long long, unsigned long long> parse_network_counters(std::string_view fields) {
+    unsigned long long values[9] = {};
+    std::size_t count = 0;
+    std::size_t pos = 0;
+    while (count < 9) {
+        pos = fields.find_first_not_of(" \t", pos);
+        if (pos == std::string_view::npos) {
+            break;
+        }
+        const std::size_t end = std::min(fields.find_first_of(" \t", pos), fields.size());
+        std::from_chars(fields.data() + pos, fields.data() + end, values[count]);
+        ++count;
+        pos = end;
+    }
+    if (count >= 9) {
+        return std::make_pair(values[0], values[8]);
+    }
     return std::make_pair(0, 0);
 }
 
 }
 
-std::vector<NetworkInterface> get_network_interfaces() {
-    std::vector<NetworkInterface> interfaces;
-    
-    std::ifstream file("/proc/net/dev");
-    std::string line;
-    
-    std::getline(file, line);
-    std::getline(file, line);
-    
-    while (std::getline(file, line)) {
-        size_t colon_pos = line.find(':');
-        if (colon_pos != std::string::npos) {
-            std::string interface_name = line.substr(0, colon_pos);
-            interface_name.erase(0, interface_name.find_first_not_of(" \t"));
-            interface_name.erase(interface_name.find_last_not_of(" \t") + 1);
-            
-            if (interface_name == "lo") {
+std::pmr::vector<NetworkInterface> get_network_interfaces(std::pmr::memory_resource* memory) {
+    std::pmr::vector<NetworkInterface> interfaces(memory);
+    const auto addresses = read_interface_addresses(memory);
+
+    // All counters come from one read of /proc/net/dev, and the rate uses the
+    // time of that read rather than when the sample was scheduled or when
+    // this interface's line is reached.
+    std::pmr::string contents(memory);
+    common::read_file("/proc/net/dev", contents);
+    const auto capture_time = std::chrono::steady_clock::now();
+    std::pmr::string sysfs(memory);
+
+    std::string_view rest = contents;
+    // Two header lines.
+    for (int skipped = 0; skipped < 2 && !rest.empty(); ++skipped) {
+        const std::size_t end = rest.find('\n');
+        rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+    }
+    while (!rest.empty()) {
+        const std::size_t end = rest.find('\n');
+        const std::string_view line = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+        const std::size_t colon_pos = line.find(':');
+        if (colon_pos == std::string_view::npos) {
+            continue;
+        }
+        const std::string_view interface_name = common::trim_view(line.substr(0, colon_pos));
+        if (interface_name == "lo") {
+            continue;
+        }
+
+        common::InternTable& names = common::interned_names();
+        NetworkInterface netif(memory);
+        netif.name_id = names.intern(interface_name);
+        netif.name = names.name(netif.name_id);
+        netif.mac_address = "N/A";
+        netif.ipv4_address = "N/A";
+        netif.ipv6_address = "N/A";
+        netif.is_up = true;
+
+        const std::string_view mac_result = read_sysfs_value(interface_name, "address", sysfs);
+        if (!mac_result.empty()) {
+            netif.mac_address = mac_result;
+        }
+
+        for (const auto& entry : addresses) {
+            if (entry.name != interface_name) {
                 continue;
             }
-            
-            NetworkInterface netif;
-            netif.name = interface_name;
-            netif.mac_address = "N/A";
-            netif.ipv4_address = "N/A";
-            netif.ipv6_address = "N/A";
-            netif.rx_rate_kbps = 0.0;
-            netif.tx_rate_kbps = 0.0;
-            netif.is_up = true;
-            
-            std::string mac_cmd = "cat /sys/class/net/" + interface_name + "/address 2>/dev/null";
-            std::string mac_result = exec_command(mac_cmd.c_str());
-            if (!mac_result.empty()) {
-                if (!mac_result.empty() && mac_result.back() == '\n') {
-                    mac_result.pop_back();
-                }
-                if (!mac_result.empty()) {
-                    netif.mac_address = mac_result;
-                }
+            if (!entry.ipv4.empty()) {
+                netif.ipv4_address = entry.ipv4;
             }
-            
-            std::string ip_cmd = "ip -4 addr show " + interface_name + " 2>/dev/null | grep inet | head -1 | awk '{print $2}' | cut -d'/' -f1";
-            std::string ipv4_result = exec_command(ip_cmd.c_str());
-            if (!ipv4_result.empty()) {
-                if (!ipv4_result.empty() && ipv4_result.back() == '\n') {
-                    ipv4_result.pop_back();
-                }
-                if (!ipv4_result.empty()) {
-                    netif.ipv4_address = ipv4_result;
-                }
-            }
-            
-            std::string ipv6_cmd = "ip -6 addr show " + interface_name + " 2>/dev/null | grep inet6 | head -1 | awk '{print $2}' | cut -d'/' -f1";
-            std::string ipv6_result = exec_command(ipv6_cmd.c_str());
-            if (!ipv6_result.empty()) {
-                if (!ipv6_result.empty() && ipv6_result.back() == '\n') {
-                    ipv6_result.pop_back();
-                }
-                if (!ipv6_result.empty()) {
-                    netif.ipv6_address = ipv6_result;
-                }
+            if (!entry.ipv6.empty()) {
+                netif.ipv6_address = entry.ipv6;
             }
+        }
 
-            std::string operstate_cmd = "cat /sys/class/net/" + interface_name + "/operstate 2>/dev/null";
-            std::string operstate_result = exec_command(operstate_cmd.c_str());
-            if (!operstate_result.empty()) {
-                if (!operstate_result.empty() && operstate_result.back() == '\n') {
-                    operstate_result.pop_back();
-                }
-                netif.is_up = (operstate_result == "up");
-            }
-            
-            auto current_stats = read_network_stats(interface_name);
-            auto current_time = std::chrono::steady_clock::now();
-            
-            if (previous_stats.find(interface_name) != previous_stats.end()) {
-                auto previous_stat = previous_stats[interface_name];
-                auto previous_time = previous_times[interface_name];
-                
-                auto time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    current_time - previous_time).count();
-                
-                if (time_diff > 0) {
-                    unsigned long long rx_diff = current_stats.first - previous_stat.first;
-                    unsigned long long tx_diff = current_stats.second - previous_stat.second;
-
-                    netif.rx_rate_kbps = (rx_diff * 1.0) / time_diff;  
-                    netif.tx_rate_kbps = (tx_diff * 1.0) / time_diff;  
-                }
-            }
+        const std::string_view operstate_result = read_sysfs_value(interface_name, "operstate", sysfs);
+        if (!operstate_result.empty()) {
+            netif.is_up = (operstate_result == "up");
+        }
 
-            previous_stats[interface_name] = current_stats;
-            previous_times[interface_name] = current_time;
-            
-            interfaces.push_back(netif);
+        const auto current_stats = parse_network_counters(line.substr(colon_pos + 1));
+        std::lock_guard<std::mutex> lock(previous_mutex);
+
+        auto previous = previous_stats.find(netif.name_id);
+        if (previous != previous_stats.end()) {
+            const Baseline& previous_stat = previous->second;
+
+            // Bytes per millisecond (kB/s), over the exact interval between reads.
+            const double time_diff_ms =
+                std::chrono::duration<double, std::milli>(capture_time - previous_stat.time).count();
+
+            // A counter that went backwards was reset (interface re-created).
+            if (time_diff_ms > 0.0 && current_stats.first >= previous_stat.rx_bytes &&
+                current_stats.second >= previous_stat.tx_bytes) {
+                unsigned long long rx_diff = current_stats.first - previous_stat.rx_bytes;
+                unsigned long long tx_diff = current_stats.second - previous_stat.tx_bytes;
+
+                netif.rx_rate_kbps = (rx_diff * 1.0) / time_diff_ms;
+                netif.tx_rate_kbps = (tx_diff * 1.0) / time_diff_ms;
+            }
+        } else {
+            previous = previous_stats.emplace(netif.name_id, Baseline{}).first;
         }
+        previous->second = Baseline{current_stats.first, current_stats.second, capture_time};
+
+        interfaces.push_back(std::move(netif));
     }
-    
+
     return interfaces;
 }
 
-std::string network_interfaces_to_json(const std::vector<NetworkInterface>& interfaces) {
-    std::ostringstream json;
-    json << "[";
-    for (size_t i = 0; i < interfaces.size(); ++i) {
-        if (i > 0) json << ",";
-        const auto& interface = interfaces[i];
-        json << "{";
-        json << "\"name\":\"" << interface.name << "\",";
-        json << "\"mac_address\":\"" << interface.mac_address << "\",";
-        json << "\"ipv4_address\":\"" << interface.ipv4_address << "\",";
-        json << "\"ipv6_address\":\"" << interface.ipv6_address << "\",";
-        json << "\"rx_rate_kbps\":" << std::fixed << std::setprecision(2) << interface.rx_rate_kbps << ",";
-        json << "\"tx_rate_kbps\":" << std::fixed << std::setprecision(2) << interface.tx_rate_kbps << ",";
-        json << "\"is_up\":" << (interface.is_up ? "true" : "false");
-        json << "}";
-    }
-    json << "]";
-    return json.str();
+void append_network_interfaces_json(const std::pmr::vector<NetworkInterface>& interfaces, std::pmr::string& out) {
+    common::append_json_array(interfaces, out);
+}
+
+std::string network_interfaces_to_json(const std::pmr::vector<NetworkInterface>& interfaces) {
+    return common::to_json_array(interfaces);
 }
 
 }
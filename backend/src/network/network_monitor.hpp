@@ -1,21 +1,50 @@
 #pragma once
 
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include "../common/fields.hpp"
+#include "../common/intern.hpp"
+
 namespace nanookjaro::network {
 
 struct NetworkInterface {
-    std::string name;
-    std::string mac_address;
-    std::string ipv4_address;
-    std::string ipv6_address;
-    double rx_rate_kbps;
-    double tx_rate_kbps;
-    bool is_up;
+    explicit NetworkInterface(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : mac_address(memory), ipv4_address(memory), ipv6_address(memory) {}
+
+    common::NameId name_id = 0;
+    std::string_view name;  // from common::interned_names()
+    std::pmr::string mac_address;
+    std::pmr::string ipv4_address;
+    std::pmr::string ipv6_address;
+    double rx_rate_kbps = 0.0;
+    double tx_rate_kbps = 0.0;
+    bool is_up = false;
 };
 
-std::vector<NetworkInterface> get_network_interfaces();
-std::string network_interfaces_to_json(const std::vector<NetworkInterface>& interfaces);
+constexpr auto metric_fields(std::type_identity<NetworkInterface>) {
+    return std::tuple{
+        common::Field{"name", &NetworkInterface::name},
+        common::Field{"mac_address", &NetworkInterface::mac_address},
+        common::Field{"ipv4_address", &NetworkInterface::ipv4_address},
+        common::Field{"ipv6_address", &NetworkInterface::ipv6_address},
+        common::Field{"rx_rate_kbps", &NetworkInterface::rx_rate_kbps, "kB/s"},
+        common::Field{"tx_rate_kbps", &NetworkInterface::tx_rate_kbps, "kB/s"},
+        common::Field{"is_up", &NetworkInterface::is_up},
+    };
+}
+
+// Every interface but lo, with rates since the previous call. The vector,
+// its strings and all temporaries come from `memory`, so a per-tick arena
+// keeps the collector off the heap (getifaddrs() still uses malloc inside
+// libc).
+std::pmr::vector<NetworkInterface> get_network_interfaces(
+    std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+std::string network_interfaces_to_json(const std::pmr::vector<NetworkInterface>& interfaces);
+void append_network_interfaces_json(const std::pmr::vector<NetworkInterface>& interfaces, std::pmr::string& out);
 
-}
\ No newline at end of file
+}
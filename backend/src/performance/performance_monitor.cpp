@@ -26,7 +26,12 @@ void PerformanceMonitor::stop_monitoring() {
 }
 
 std::vector<PerformanceSample> PerformanceMonitor::get_history() const {
-    return history_;
+    std::vector<PerformanceSample> samples;
+    samples.reserve(history_.size());
+    for (std::size_t i = 0; i < history_.size(); ++i) {
+        samples.push_back(history_.row(i));
+    }
+    return samples;
 }
 
 void PerformanceMonitor::set_sampling_interval(int seconds) {
@@ -35,23 +40,7 @@ void PerformanceMonitor::set_sampling_interval(int seconds) {
 }
 
 std::string performance_history_to_json(const std::vector<PerformanceSample>& samples) {
-    std::ostringstream json;
-    json << "[";
-    for (size_t i = 0; i < samples.size(); ++i) {
-        if (i > 0) json << ",";
-        const auto& sample = samples[i];
-        json << "{";
-        json << "\"timestamp\":" << sample.timestamp << ",";
-        json << "\"cpu_usage_percent\":" << sample.cpu_usage_percent << ",";
-        json << "\"memory_usage_percent\":" << sample.memory_usage_percent << ",";
-        json << "\"disk_read_kbps\":" << sample.disk_read_kbps << ",";
-        json << "\"disk_write_kbps\":" << sample.disk_write_kbps << ",";
-        json << "\"network_rx_kbps\":" << sample.network_rx_kbps << ",";
-        json << "\"network_tx_kbps\":" << sample.network_tx_kbps;
-        json << "}";
-    }
-    json << "]";
-    return json.str();
+    return common::to_json_array(samples);
 }
 
 }
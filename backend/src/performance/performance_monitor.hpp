@@ -1,8 +1,12 @@
 #pragma once
 
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include "../common/fields.hpp"
+
 namespace nanookjaro::performance {
 
 struct PerformanceSample {
@@ -15,6 +19,18 @@ struct PerformanceSample {
     double network_tx_kbps;
 };
 
+constexpr auto metric_fields(std::type_identity<PerformanceSample>) {
+    return std::tuple{
+        common::Field{"timestamp", &PerformanceSample::timestamp, "s", 3},
+        common::Field{"cpu_usage_percent", &PerformanceSample::cpu_usage_percent, "%"},
+        common::Field{"memory_usage_percent", &PerformanceSample::memory_usage_percent, "%"},
+        common::Field{"disk_read_kbps", &PerformanceSample::disk_read_kbps, "kB/s"},
+        common::Field{"disk_write_kbps", &PerformanceSample::disk_write_kbps, "kB/s"},
+        common::Field{"network_rx_kbps", &PerformanceSample::network_rx_kbps, "kB/s"},
+        common::Field{"network_tx_kbps", &PerformanceSample::network_tx_kbps, "kB/s"},
+    };
+}
+
 class PerformanceMonitor {
 public:
     PerformanceMonitor();
@@ -23,12 +39,14 @@ public:
     void start_monitoring();
     void stop_monitoring();
     std::vector<PerformanceSample> get_history() const;
+    // The same history, one series per field of PerformanceSample.
+    const common::Columns<PerformanceSample>& history_columns() const { return history_; }
     void set_sampling_interval(int seconds);
     
 private:
     bool monitoring_;
     int sampling_interval_;
-    std::vector<PerformanceSample> history_;
+    common::Columns<PerformanceSample> history_;
 };
 
 std::string performance_history_to_json(const std::vector<PerformanceSample>& samples);
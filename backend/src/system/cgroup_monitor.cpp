@@ -0,0 +1,496 @@
+#include "cgroup_monitor.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nanookjaro::cgroup {
+
+namespace {
+
+// Orders paths depth-first ("/a", "/a/b", "/a.slice") by treating '/' as the
+// smallest character, so iterating the node map yields a tree walk and every
+// subtree occupies one contiguous range.
+struct TreeOrder {
+    bool operator()(const std::string& lhs, const std::string& rhs) const {
+        const std::size_t count = std::min(lhs.size(), rhs.size());
+        for (std::size_t i = 0; i < count; ++i) {
+            if (lhs[i] == rhs[i]) {
+                continue;
+            }
+            if (lhs[i] == '/') {
+                return true;
+            }
+            if (rhs[i] == '/') {
+                return false;
+            }
+            return static_cast<unsigned char>(lhs[i]) < static_cast<unsigned char>(rhs[i]);
+        }
+        return lhs.size() < rhs.size();
+    }
+};
+
+std::string join_path(const std::string& parent, const std::string& name) {
+    return parent == "/" ? "/" + name : parent + "/" + name;
+}
+
+bool is_within(const std::string& path, const std::string& ancestor) {
+    if (ancestor == "/") {
+        return true;
+    }
+    return path.size() >= ancestor.size() && path.compare(0, ancestor.size(), ancestor) == 0 &&
+           (path.size() == ancestor.size() || path[ancestor.size()] == '/');
+}
+
+bool ends_with(std::string_view value, std::string_view suffix) {
+    return value.size() >= suffix.size() &&
+           value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string classify(const std::string& path, const std::string& name) {
+    if (path == "/") {
+        return "root";
+    }
+    if (name.rfind("docker-", 0) == 0 || name.rfind("libpod-", 0) == 0 || name.rfind("crio-", 0) == 0 ||
+        name.rfind("cri-containerd-", 0) == 0 || name.rfind("lxc.payload", 0) == 0 ||
+        (is_within(path, "/machine.slice") && ends_with(name, ".scope"))) {
+        return "container";
+    }
+    if (ends_with(name, ".slice")) {
+        return "slice";
+    }
+    if (ends_with(name, ".service")) {
+        return "service";
+    }
+    if (ends_with(name, ".scope")) {
+        return "scope";
+    }
+    return "other";
+}
+
+std::string find_cgroup2_root() {
+    std::ifstream file("/proc/mounts");
+    std::string line;
+    std::string fallback;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string device, mount_point, fstype;
+        if (!(iss >> device >> mount_point >> fstype) || fstype != "cgroup2") {
+            continue;
+        }
+        if (mount_point == "/sys/fs/cgroup") {
+            return mount_point;
+        }
+        if (fallback.empty()) {
+            fallback = mount_point;
+        }
+    }
+    return fallback;
+}
+
+bool read_file_at(int dirfd, const char* name, std::string& out) {
+    out.clear();
+    const int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    std::array<char, 4096> buffer{};
+    while (true) {
+        const ssize_t n = read(fd, buffer.data(), buffer.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        out.append(buffer.data(), static_cast<std::size_t>(n));
+    }
+    close(fd);
+    return true;
+}
+
+// Returns the value following `key` at the start of a line in "key value" files
+// such as cpu.stat and memory.stat.
+unsigned long long keyed_value(std::string_view text, std::string_view key) {
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        const std::size_t end = std::min(text.find('\n', pos), text.size());
+        const std::string_view line = text.substr(pos, end - pos);
+        if (line.size() > key.size() && line.compare(0, key.size(), key) == 0 && line[key.size()] == ' ') {
+            return std::strtoull(std::string(line.substr(key.size() + 1)).c_str(), nullptr, 10);
+        }
+        pos = end + 1;
+    }
+    return 0;
+}
+
+void sum_io_stat(std::string_view text, unsigned long long& read_bytes, unsigned long long& write_bytes) {
+    read_bytes = 0;
+    write_bytes = 0;
+    std::istringstream iss{std::string(text)};
+    std::string token;
+    while (iss >> token) {
+        if (token.rfind("rbytes=", 0) == 0) {
+            read_bytes += std::strtoull(token.c_str() + 7, nullptr, 10);
+        } else if (token.rfind("wbytes=", 0) == 0) {
+            write_bytes += std::strtoull(token.c_str() + 7, nullptr, 10);
+        }
+    }
+}
+
+void parse_pressure(std::string_view text, double& some_avg10, double& full_avg10) {
+    some_avg10 = 0.0;
+    full_avg10 = 0.0;
+    std::istringstream iss{std::string(text)};
+    std::string line;
+    while (std::getline(iss, line)) {
+        const auto avg = line.find("avg10=");
+        if (avg == std::string::npos) {
+            continue;
+        }
+        const double value = std::strtod(line.c_str() + avg + 6, nullptr);
+        if (line.rfind("some", 0) == 0) {
+            some_avg10 = value;
+        } else if (line.rfind("full", 0) == 0) {
+            full_avg10 = value;
+        }
+    }
+}
+
+struct CgroupNode {
+    int dirfd = -1;
+    int watch = -1;
+    bool have_baseline = false;
+    unsigned long long previous_cpu_usec = 0;
+    unsigned long long previous_read_bytes = 0;
+    unsigned long long previous_write_bytes = 0;
+    std::chrono::steady_clock::time_point previous_time;
+};
+
+// Keeps one directory fd per cgroup so sampling only costs an openat/read per
+// controller file, and follows mkdir/rmdir in the hierarchy through inotify
+// instead of re-walking it on every call.
+class CgroupTracker {
+public:
+    ~CgroupTracker() {
+        for (auto& [path, node] : nodes_) {
+            close(node.dirfd);
+        }
+        if (inotify_fd_ >= 0) {
+            close(inotify_fd_);
+        }
+    }
+
+    std::vector<CgroupUsage> sample() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<CgroupUsage> result;
+        if (!ensure_root()) {
+            return result;
+        }
+
+        drain_events();
+        if (needs_rescan_) {
+            rescan();
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        std::string cpu_stat, memory_current, memory_stat, io_stat, memory_pressure;
+        result.reserve(nodes_.size());
+
+        for (auto& [path, node] : nodes_) {
+            CgroupUsage usage{};
+            usage.path = path;
+            usage.name = path == "/" ? "/" : path.substr(path.rfind('/') + 1);
+            usage.kind = classify(path, usage.name);
+            usage.depth = path == "/" ? 0 : static_cast<int>(std::count(path.begin(), path.end(), '/'));
+
+            if (read_file_at(node.dirfd, "cpu.stat", cpu_stat)) {
+                usage.cpu_usage_usec = keyed_value(cpu_stat, "usage_usec");
+            }
+            if (read_file_at(node.dirfd, "memory.current", memory_current)) {
+                usage.memory_current_bytes = std::strtoull(memory_current.c_str(), nullptr, 10);
+            }
+            if (read_file_at(node.dirfd, "memory.stat", memory_stat)) {
+                usage.memory_anon_bytes = keyed_value(memory_stat, "anon");
+                usage.memory_file_bytes = keyed_value(memory_stat, "file");
+            }
+            if (read_file_at(node.dirfd, "io.stat", io_stat)) {
+                sum_io_stat(io_stat, usage.io_read_bytes, usage.io_write_bytes);
+            }
+            if (read_file_at(node.dirfd, "memory.pressure", memory_pressure)) {
+                parse_pressure(memory_pressure, usage.memory_pressure_some_avg10,
+                               usage.memory_pressure_full_avg10);
+            }
+
+            if (node.have_baseline) {
+                const auto elapsed_us =
+                    std::chrono::duration_cast<std::chrono::microseconds>(now - node.previous_time).count();
+                if (elapsed_us > 0) {
+                    if (usage.cpu_usage_usec >= node.previous_cpu_usec) {
+                        usage.cpu_percent = static_cast<double>(usage.cpu_usage_usec - node.previous_cpu_usec) *
+                                            100.0 / static_cast<double>(elapsed_us);
+                    }
+                    const double elapsed_ms = static_cast<double>(elapsed_us) / 1000.0;
+                    if (usage.io_read_bytes >= node.previous_read_bytes) {
+                        usage.io_read_rate_kbps =
+                            static_cast<double>(usage.io_read_bytes - node.previous_read_bytes) / elapsed_ms;
+                    }
+                    if (usage.io_write_bytes >= node.previous_write_bytes) {
+                        usage.io_write_rate_kbps =
+                            static_cast<double>(usage.io_write_bytes - node.previous_write_bytes) / elapsed_ms;
+                    }
+                }
+            }
+
+            node.previous_cpu_usec = usage.cpu_usage_usec;
+            node.previous_read_bytes = usage.io_read_bytes;
+            node.previous_write_bytes = usage.io_write_bytes;
+            node.previous_time = now;
+            node.have_baseline = true;
+
+            result.push_back(std::move(usage));
+        }
+
+        return result;
+    }
+
+private:
+    bool ensure_root() {
+        if (!root_.empty()) {
+            return true;
+        }
+        const std::string root = find_cgroup2_root();
+        if (root.empty()) {
+            return false;
+        }
+        const int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        root_ = root;
+        inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        add_subtree("/", fd);
+        needs_rescan_ = inotify_fd_ < 0;
+        return true;
+    }
+
+    void watch(const std::string& path, CgroupNode& node) {
+        if (inotify_fd_ < 0) {
+            return;
+        }
+        const std::string full_path = path == "/" ? root_ : root_ + path;
+        node.watch = inotify_add_watch(inotify_fd_, full_path.c_str(),
+                                       IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+        if (node.watch >= 0) {
+            watches_[node.watch] = path;
+        } else {
+            // Out of watches: fall back to walking the hierarchy on every sample.
+            needs_rescan_ = true;
+        }
+    }
+
+    // Takes ownership of `dirfd`.
+    void add_subtree(const std::string& path, int dirfd) {
+        auto [it, inserted] = nodes_.try_emplace(path);
+        if (inserted) {
+            it->second.dirfd = dirfd;
+            watch(path, it->second);
+        } else {
+            close(dirfd);
+            dirfd = it->second.dirfd;
+        }
+
+        const int listing_fd = dup(dirfd);
+        if (listing_fd < 0) {
+            return;
+        }
+        DIR* dir = fdopendir(listing_fd);
+        if (dir == nullptr) {
+            close(listing_fd);
+            return;
+        }
+
+        std::vector<std::string> children;
+        while (const dirent* entry = readdir(dir)) {
+            if (entry->d_type != DT_DIR || entry->d_name[0] == '.') {
+                continue;
+            }
+            children.emplace_back(entry->d_name);
+        }
+        closedir(dir);
+
+        for (const auto& child : children) {
+            const int child_fd = openat(dirfd, child.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (child_fd >= 0) {
+                add_subtree(join_path(path, child), child_fd);
+            }
+        }
+    }
+
+    void remove_subtree(const std::string& path) {
+        auto it = nodes_.lower_bound(path);
+        while (it != nodes_.end() && is_within(it->first, path)) {
+            if (it->second.watch >= 0) {
+                inotify_rm_watch(inotify_fd_, it->second.watch);
+                watches_.erase(it->second.watch);
+            }
+            close(it->second.dirfd);
+            it = nodes_.erase(it);
+        }
+    }
+
+    void drain_events() {
+        if (inotify_fd_ < 0) {
+            return;
+        }
+        alignas(inotify_event) std::array<char, 16 * 1024> buffer{};
+        while (true) {
+            const ssize_t length = read(inotify_fd_, buffer.data(), buffer.size());
+            if (length <= 0) {
+                break;
+            }
+            for (ssize_t offset = 0; offset < length;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    needs_rescan_ = true;
+                    continue;
+                }
+                const auto parent = watches_.find(event->wd);
+                if (parent == watches_.end()) {
+                    continue;
+                }
+                if (event->mask & IN_IGNORED) {
+                    watches_.erase(parent);
+                    continue;
+                }
+                if (!(event->mask & IN_ISDIR) || event->len == 0) {
+                    continue;
+                }
+
+                const std::string parent_path = parent->second;
+                const std::string path = join_path(parent_path, event->name);
+                if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    remove_subtree(path);
+                } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    const auto parent_node = nodes_.find(parent_path);
+                    if (parent_node == nodes_.end()) {
+                        continue;
+                    }
+                    const int fd = openat(parent_node->second.dirfd, event->name,
+                                          O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                    if (fd >= 0) {
+                        add_subtree(path, fd);
+                    }
+                }
+            }
+        }
+    }
+
+    void rescan() {
+        std::vector<std::string> stale;
+        for (const auto& [path, node] : nodes_) {
+            struct stat st {};
+            if (path != "/" && fstatat(nodes_.at("/").dirfd, path.c_str() + 1, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                stale.push_back(path);
+            }
+        }
+        for (const auto& path : stale) {
+            remove_subtree(path);
+        }
+        const int root_fd = dup(nodes_.at("/").dirfd);
+        if (root_fd >= 0) {
+            add_subtree("/", root_fd);
+        }
+        needs_rescan_ = inotify_fd_ < 0 || watches_.size() < nodes_.size();
+    }
+
+    std::mutex mutex_;
+    std::string root_;
+    int inotify_fd_ = -1;
+    bool needs_rescan_ = false;
+    std::map<std::string, CgroupNode, TreeOrder> nodes_;
+    std::unordered_map<int, std::string> watches_;
+};
+
+CgroupTracker& tracker() {
+    static CgroupTracker instance;
+    return instance;
+}
+
+}
+
+std::vector<CgroupUsage> get_cgroup_usage() {
+    return tracker().sample();
+}
+
+std::vector<CgroupUsage> get_top_cgroups(std::size_t limit) {
+    std::vector<CgroupUsage> cgroups = tracker().sample();
+    cgroups.erase(std::remove_if(cgroups.begin(), cgroups.end(),
+                                 [](const CgroupUsage& usage) {
+                                     return usage.kind == "root" || usage.kind == "other";
+                                 }),
+                  cgroups.end());
+    std::sort(cgroups.begin(), cgroups.end(), [](const CgroupUsage& lhs, const CgroupUsage& rhs) {
+        if (lhs.cpu_percent != rhs.cpu_percent) {
+            return lhs.cpu_percent > rhs.cpu_percent;
+        }
+        return lhs.memory_current_bytes > rhs.memory_current_bytes;
+    });
+    if (cgroups.size() > limit) {
+        cgroups.resize(limit);
+    }
+    return cgroups;
+}
+
+std::string cgroups_to_json(const std::vector<CgroupUsage>& cgroups) {
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < cgroups.size(); ++i) {
+        if (i > 0) json << ",";
+        const auto& cgroup = cgroups[i];
+        json << "{";
+        json << "\"path\":\"" << common::escape_json(cgroup.path) << "\",";
+        json << "\"name\":\"" << common::escape_json(cgroup.name) << "\",";
+        json << "\"kind\":\"" << cgroup.kind << "\",";
+        json << "\"depth\":" << cgroup.depth << ",";
+        json << "\"cpu_usage_usec\":" << cgroup.cpu_usage_usec << ",";
+        json << "\"cpu_percent\":" << std::fixed << std::setprecision(2) << cgroup.cpu_percent << ",";
+        json << "\"memory_current_bytes\":" << cgroup.memory_current_bytes << ",";
+        json << "\"memory_anon_bytes\":" << cgroup.memory_anon_bytes << ",";
+        json << "\"memory_file_bytes\":" << cgroup.memory_file_bytes << ",";
+        json << "\"io_read_bytes\":" << cgroup.io_read_bytes << ",";
+        json << "\"io_write_bytes\":" << cgroup.io_write_bytes << ",";
+        json << "\"io_read_rate_kbps\":" << std::fixed << std::setprecision(2) << cgroup.io_read_rate_kbps << ",";
+        json << "\"io_write_rate_kbps\":" << std::fixed << std::setprecision(2) << cgroup.io_write_rate_kbps << ",";
+        json << "\"memory_pressure_some_avg10\":" << std::fixed << std::setprecision(2)
+             << cgroup.memory_pressure_some_avg10 << ",";
+        json << "\"memory_pressure_full_avg10\":" << std::fixed << std::setprecision(2)
+             << cgroup.memory_pressure_full_avg10;
+        json << "}";
+    }
+    json << "]";
+    return json.str();
+}
+
+}
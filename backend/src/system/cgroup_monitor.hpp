@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace nanookjaro::cgroup {
+
+struct CgroupUsage {
+    std::string path;
+    std::string name;
+    std::string kind;
+    int depth;
+    unsigned long long cpu_usage_usec;
+    double cpu_percent;
+    unsigned long long memory_current_bytes;
+    unsigned long long memory_anon_bytes;
+    unsigned long long memory_file_bytes;
+    unsigned long long io_read_bytes;
+    unsigned long long io_write_bytes;
+    double io_read_rate_kbps;
+    double io_write_rate_kbps;
+    double memory_pressure_some_avg10;
+    double memory_pressure_full_avg10;
+};
+
+// Samples every cgroup below the cgroup v2 root. Rates are computed against the
+// previous call, so the first call after start-up reports zero rates.
+std::vector<CgroupUsage> get_cgroup_usage();
+
+// Same as get_cgroup_usage() but keeps only slices, services, scopes and
+// containers, ordered by CPU usage (then memory) and truncated to `limit`.
+std::vector<CgroupUsage> get_top_cgroups(std::size_t limit);
+
+std::string cgroups_to_json(const std::vector<CgroupUsage>& cgroups);
+
+}
@@ -0,0 +1,356 @@
+#include "collectors.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+namespace nanookjaro::metrics {
+
+namespace {
+
+constexpr std::chrono::milliseconds kTick{10};
+// Weight of the newest change in a collector's variance.
+constexpr double kVarianceWeight = 0.3;
+
+struct BuiltinCollector {
+    const char* name;
+    unsigned group;
+    std::chrono::milliseconds period;
+    const char* enable_section;  // optional on/off switch in the config
+    const char* enable_key;
+};
+
+constexpr BuiltinCollector kBuiltinCollectors[] = {
+    {"cpu", kSummaryCpu, std::chrono::milliseconds(250), nullptr, nullptr},
+    {"memory", kSummaryMemory, std::chrono::seconds(1), nullptr, nullptr},
+    {"load", kSummaryLoad, std::chrono::seconds(1), nullptr, nullptr},
+    {"mounts", kSummaryFilesystems, std::chrono::seconds(30), "general", "enable_disk_monitoring"},
+    {"gpu", kSummaryGpu, std::chrono::seconds(30), "general", "enable_gpu_monitoring"},
+    {"packages", kSummaryPackages, std::chrono::minutes(1), nullptr, nullptr},
+    {"network", kSummaryNetwork, std::chrono::seconds(1), "general", "enable_network_monitoring"},
+    {"proxy", kSummaryProxy, std::chrono::seconds(30), nullptr, nullptr},
+    {"smart", kSummarySmart, std::chrono::hours(1), "general", "enable_disk_monitoring"},
+    {"updates", kSummaryUpdates, std::chrono::hours(24), "package_manager", "auto_check_updates"},
+};
+
+bool is_number_start(char c) {
+    return c == '-' || (c >= '0' && c <= '9');
+}
+
+// Offset from the monotonic to the wall clock, read as one pair.
+std::chrono::nanoseconds wall_offset() {
+    const auto wall = std::chrono::system_clock::now().time_since_epoch();
+    const auto mono = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(wall - mono);
+}
+
+}
+
+std::chrono::steady_clock::time_point aligned_after(std::chrono::steady_clock::time_point after,
+                                                    std::chrono::milliseconds period) {
+    if (period.count() <= 0) {
+        return after;
+    }
+    const auto offset = wall_offset();
+    const auto wall = after.time_since_epoch() + offset;
+    const auto step = std::chrono::duration_cast<std::chrono::nanoseconds>(period);
+    const auto next = (wall / step + 1) * step;
+    return std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(next - offset));
+}
+
+std::int64_t wall_time_ms(std::chrono::steady_clock::time_point time) {
+    // Rounded: the offset is read afresh and may differ by a few microseconds
+    // from the one an aligned deadline was computed with.
+    return std::chrono::round<std::chrono::milliseconds>(time.time_since_epoch() + wall_offset()).count();
+}
+
+AdaptiveSettings adaptive_settings(const common::Config& config) {
+    AdaptiveSettings adaptive;
+    adaptive.enabled = config.get_bool("sampler", "adaptive", true);
+    adaptive.calm = static_cast<double>(config.get_int("sampler", "adaptive_calm_percent", 2)) / 100.0;
+    adaptive.sharp = static_cast<double>(config.get_int("sampler", "adaptive_sharp_percent", 25)) / 100.0;
+    adaptive.max_factor = static_cast<unsigned>(std::clamp<long long>(config.get_int("sampler", "adaptive_max_factor", 8), 1, 64));
+    adaptive.hidden_factor = static_cast<unsigned>(std::clamp<long long>(config.get_int("sampler", "hidden_factor", 8), 1, 64));
+    return adaptive;
+}
+
+double relative_change(std::string_view before, std::string_view after) {
+    std::size_t i = 0;
+    std::size_t j = 0;
+    bool in_string = false;
+    double largest = 0.0;
+    while (i < before.size() && j < after.size()) {
+        const char a = before[i];
+        const char b = after[j];
+        if (!in_string && is_number_start(a) && is_number_start(b)) {
+            double x = 0.0;
+            double y = 0.0;
+            const auto parsed_a = std::from_chars(before.data() + i, before.data() + before.size(), x);
+            const auto parsed_b = std::from_chars(after.data() + j, after.data() + after.size(), y);
+            if (parsed_a.ec != std::errc{} || parsed_b.ec != std::errc{}) {
+                return 1.0;
+            }
+            largest = std::max(largest, std::fabs(x - y) / (std::max(std::fabs(x), std::fabs(y)) + 1.0));
+            i = static_cast<std::size_t>(parsed_a.ptr - before.data());
+            j = static_cast<std::size_t>(parsed_b.ptr - after.data());
+            continue;
+        }
+        if (a != b) {
+            return 1.0;
+        }
+        if (in_string && a == '\\') {
+            ++i;
+            ++j;
+            if (i >= before.size() || j >= after.size() || before[i] != after[j]) {
+                return 1.0;
+            }
+        } else if (a == '"') {
+            in_string = !in_string;
+        }
+        ++i;
+        ++j;
+    }
+    return i == before.size() && j == after.size() ? largest : 1.0;
+}
+
+std::vector<CollectorSettings> collector_settings(const common::Config& config) {
+    std::vector<CollectorSettings> settings;
+    for (const auto& builtin : kBuiltinCollectors) {
+        CollectorSettings collector;
+        collector.name = builtin.name;
+        collector.group = builtin.group;
+        long long period_ms = builtin.period.count();
+        if (builtin.group == kSummaryUpdates) {
+            const long long hours = config.get_int("package_manager", "update_check_interval", 0);
+            if (hours > 0) {
+                period_ms = hours * 3600 * 1000;
+            }
+        }
+        period_ms = config.get_int("collectors", std::string(builtin.name) + "_period_ms", period_ms);
+        if (builtin.enable_key != nullptr && !config.get_bool(builtin.enable_section, builtin.enable_key, true)) {
+            period_ms = 0;
+        }
+        // Finer than the wheel's tick is not meaningful.
+        collector.period = std::chrono::milliseconds(period_ms > 0 ? std::max<long long>(period_ms, kTick.count()) : 0);
+        settings.push_back(collector);
+    }
+    return settings;
+}
+
+// Ticks start on a wall-clock multiple of the tick, so aligned deadlines
+// fall exactly on tick boundaries.
+CollectorRegistry::CollectorRegistry(std::vector<CollectorSettings> settings, Clock::time_point now,
+                                     AdaptiveSettings adaptive)
+    : epoch_(aligned_after(now, kTick) - kTick), adaptive_(adaptive), wheel_(0) {
+    entries_.reserve(settings.size());
+    for (const auto& collector : settings) {
+        Entry entry;
+        entry.settings = collector;
+        entries_.push_back(entry);
+    }
+    latest_.groups = 0;
+}
+
+common::TimerWheel::Tick CollectorRegistry::tick_at(Clock::time_point time, bool round_up) const {
+    if (time <= epoch_) {
+        return 0;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(time - epoch_).count();
+    return static_cast<common::TimerWheel::Tick>(round_up ? (elapsed + kTick.count() - 1) / kTick.count()
+                                                          : elapsed / kTick.count());
+}
+
+void CollectorRegistry::set_wanted(unsigned groups, std::chrono::milliseconds min_period) {
+    for (std::uint32_t id = 0; id < entries_.size(); ++id) {
+        Entry& entry = entries_[id];
+        const bool wanted = entry.settings.period.count() > 0 && (groups & entry.settings.group) != 0;
+        const auto period = std::max(entry.settings.period, min_period);
+        if (wanted && (!entry.wanted || period != entry.period)) {
+            // Runs now and then on multiples of the new period.
+            entry.run_now = true;
+        } else if (!wanted && entry.wanted) {
+            wheel_.cancel(id);
+            entry.run_now = false;
+            entry.last_slot = {};
+            entry.factor = 1;
+            entry.stretch = 1;
+            latest_.groups &= ~entry.settings.group;
+        }
+        entry.wanted = wanted;
+        entry.period = period;
+    }
+}
+
+unsigned CollectorRegistry::stretch(const Entry& entry) const {
+    return (adaptive_.enabled ? entry.factor : 1) * (visible_ ? 1 : adaptive_.hidden_factor);
+}
+
+void CollectorRegistry::run(std::uint32_t id, Clock::time_point now, SummaryState& state,
+                            std::pmr::memory_resource* scratch) {
+    Entry& entry = entries_[id];
+    const auto started = Clock::now();
+    std::pmr::string value(scratch);
+    append_summary_group(entry.settings.group, state, value);
+    const auto elapsed = Clock::now() - started;
+    entry.last_ms = std::chrono::duration<double, std::milli>(elapsed).count();
+    entry.total_ms += entry.last_ms;
+    ++entry.runs;
+
+    std::size_t bit = 0;
+    while ((1u << bit) != entry.settings.group) {
+        ++bit;
+    }
+    const Clock::time_point slot = entry.run_now ? now : entry.next_run;
+    if (entry.last_slot != Clock::time_point{}) {
+        // Base-period slots passed over since the previous run.
+        const auto periods = (slot - entry.last_slot) / entry.period;
+        entry.runs_saved += periods > 1 ? static_cast<std::uint64_t>(periods - 1) : 0;
+    }
+    entry.last_slot = slot;
+    if (adaptive_.enabled && (latest_.groups & entry.settings.group) != 0 && !latest_.values[bit].empty() &&
+        !value.empty()) {
+        const double change = relative_change(latest_.values[bit], value);
+        entry.variance = kVarianceWeight * change * change + (1.0 - kVarianceWeight) * entry.variance;
+        if (change >= adaptive_.sharp) {
+            entry.factor = 1;
+        } else if (std::sqrt(entry.variance) < adaptive_.calm) {
+            entry.factor = std::min(entry.factor * 2, adaptive_.max_factor);
+        }
+    }
+    // Assigning into the kept strings reuses their capacity.
+    common::assign_kept(latest_.values[bit], value);
+    latest_.latency_us[bit] =
+        static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    latest_.time_ms = wall_time_ms(entry.run_now ? now : entry.next_run);
+    summary_timestamp(latest_.time_ms, latest_.timestamp);
+    latest_.groups |= entry.settings.group;
+
+    // Keep to the aligned cadence; a late run does not shift later ones,
+    // but missed periods are skipped rather than run back to back. A new
+    // stretch moves to the multiples of the new period.
+    const unsigned next_stretch = stretch(entry);
+    const auto period = entry.period * next_stretch;
+    entry.next_run = entry.run_now || next_stretch != entry.stretch ? aligned_after(now, period)
+                                                                    : entry.next_run + period;
+    if (entry.next_run <= now) {
+        entry.next_run = aligned_after(now, period);
+    }
+    entry.stretch = next_stretch;
+    entry.run_now = false;
+    wheel_.schedule(id, tick_at(entry.next_run, true));
+}
+
+unsigned CollectorRegistry::run_due(Clock::time_point now, SummaryState& state, std::pmr::memory_resource* scratch) {
+    expired_.clear();
+    for (std::uint32_t id = 0; id < entries_.size(); ++id) {
+        if (entries_[id].run_now) {
+            wheel_.cancel(id);
+            expired_.push_back(id);
+        }
+    }
+    wheel_.advance(tick_at(now, false), expired_);
+    unsigned refreshed = 0;
+    for (const std::uint32_t id : expired_) {
+        if (entries_[id].wanted) {
+            run(id, now, state, scratch);
+            refreshed |= entries_[id].settings.group;
+        }
+    }
+    return refreshed;
+}
+
+CollectorRegistry::Clock::time_point CollectorRegistry::next_due() const {
+    if (std::any_of(entries_.begin(), entries_.end(), [](const Entry& entry) { return entry.run_now; })) {
+        return epoch_;
+    }
+    const auto next = wheel_.next_event();
+    if (!next) {
+        return Clock::time_point::max();
+    }
+    return epoch_ + kTick * static_cast<long long>(*next);
+}
+
+void CollectorRegistry::set_visible(bool visible) {
+    if (visible == visible_) {
+        return;
+    }
+    visible_ = visible;
+    if (visible) {
+        snap(kSummaryAllGroups);
+    }
+}
+
+void CollectorRegistry::snap(unsigned groups) {
+    for (auto& entry : entries_) {
+        if (entry.wanted && (groups & entry.settings.group) != 0 && (entry.factor > 1 || entry.stretch > 1)) {
+            entry.factor = 1;
+            entry.run_now = true;
+        }
+    }
+}
+
+std::chrono::milliseconds CollectorRegistry::shortest_period() const {
+    std::chrono::milliseconds shortest{0};
+    for (const auto& entry : entries_) {
+        if (entry.wanted && (shortest.count() == 0 || entry.period < shortest)) {
+            shortest = entry.period;
+        }
+    }
+    return shortest;
+}
+
+std::uint64_t CollectorRegistry::runs_saved() const {
+    std::uint64_t saved = 0;
+    for (const auto& entry : entries_) {
+        saved += entry.runs_saved;
+    }
+    return saved;
+}
+
+double CollectorRegistry::cpu_ms_saved() const {
+    double saved = 0.0;
+    for (const auto& entry : entries_) {
+        if (entry.runs > 0) {
+            saved += static_cast<double>(entry.runs_saved) * entry.total_ms / static_cast<double>(entry.runs);
+        }
+    }
+    return saved;
+}
+
+std::string CollectorRegistry::status_json() const {
+    std::pmr::string json;
+    append_status_json(json);
+    return std::string(json);
+}
+
+void CollectorRegistry::append_status_json(std::pmr::string& out) const {
+    out += '[';
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+        if (i > 0) out += ',';
+        const Entry& entry = entries_[i];
+        out += "{\"name\":\"";
+        out += entry.settings.name;
+        out += "\",\"group\":\"";
+        out += summary_group_key(entry.settings.group);
+        out += "\",\"period_ms\":";
+        common::append_int(out, (entry.wanted ? entry.period : entry.settings.period).count());
+        out += entry.settings.period.count() > 0 ? ",\"enabled\":true" : ",\"enabled\":false";
+        out += entry.wanted ? ",\"active\":true" : ",\"active\":false";
+        out += ",\"stretch\":";
+        common::append_uint(out, entry.wanted ? entry.stretch : 1);
+        out += ",\"volatility_percent\":";
+        common::append_fixed(out, std::sqrt(entry.variance) * 100.0);
+        out += ",\"runs\":";
+        common::append_uint(out, entry.runs);
+        out += ",\"runs_saved\":";
+        common::append_uint(out, entry.runs_saved);
+        out += ",\"last_ms\":";
+        common::append_fixed(out, entry.last_ms);
+        out += '}';
+    }
+    out += ']';
+}
+
+}
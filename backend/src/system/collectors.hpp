@@ -0,0 +1,139 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../common/config.hpp"
+#include "../common/timer_wheel.hpp"
+#include "system_summary.hpp"
+
+namespace nanookjaro::metrics {
+
+// One summary group refreshed on its own period. A zero period disables the
+// collector: it is never scheduled and never runs.
+struct CollectorSettings {
+    const char* name = "";  // "<name>_period_ms" in the [collectors] config section
+    unsigned group = 0;     // the SummaryGroup it produces
+    std::chrono::milliseconds period{0};
+};
+
+// The built-in collectors (cpu 250 ms, memory/load/network 1 s, mounts,
+// gpu and proxy 30 s, packages 1 min, smart 1 h, updates 24 h) with periods
+// and enable flags from `config`:
+//   [collectors] <name>_period_ms = N     (0 disables)
+//   [general] enable_gpu_monitoring, enable_disk_monitoring (mounts, smart),
+//             enable_network_monitoring
+//   [package_manager] auto_check_updates, update_check_interval (hours)
+std::vector<CollectorSettings> collector_settings(const common::Config& config);
+
+// How collectors stretch their periods while values are flat or no client
+// is looking. Each run compares the new value with the previous one; an
+// exponentially weighted moving average of the squared relative change is
+// the collector's variance. Below `calm` (as a deviation) the period
+// doubles, up to `max_factor` times the base period; a single change of
+// `sharp` or more snaps it back to the base period.
+struct AdaptiveSettings {
+    bool enabled = false;
+    double calm = 0.02;
+    double sharp = 0.25;
+    unsigned max_factor = 8;
+    unsigned hidden_factor = 8;  // applied on top while no client is visible
+};
+
+//   [sampler] adaptive, adaptive_calm_percent, adaptive_sharp_percent,
+//             adaptive_max_factor, hidden_factor
+AdaptiveSettings adaptive_settings(const common::Config& config);
+
+// Largest relative change |a - b| / (max(|a|, |b|) + 1) between the numbers
+// of two values of a group, compared in order; the +1 keeps values near
+// zero from counting as large swings. 1 when anything but a number differs
+// (a string, a flag, the number of elements), as that is a change of state.
+double relative_change(std::string_view before, std::string_view after);
+
+// First instant after `after` that falls on a wall-clock multiple of
+// `period` (:00, :01, ... for one second), on the monotonic clock.
+std::chrono::steady_clock::time_point aligned_after(std::chrono::steady_clock::time_point after,
+                                                    std::chrono::milliseconds period);
+// Unix milliseconds corresponding to a monotonic instant.
+std::int64_t wall_time_ms(std::chrono::steady_clock::time_point time);
+
+// Runs collectors when they are due, driven by a hierarchical timer wheel
+// with 10 ms ticks, and keeps the latest value of every group. Runs fall on
+// wall-clock multiples of each period, and a value is stamped with the
+// time of its slot rather than with whenever the thread got to run it. Only the
+// collectors of wanted groups are scheduled, so the cost scales with what
+// subscribers ask for, and with AdaptiveSettings periods stretch while values
+// are flat or nobody is looking. Not thread-safe: owned by the sampler thread.
+class CollectorRegistry {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CollectorRegistry(std::vector<CollectorSettings> settings, Clock::time_point now, AdaptiveSettings adaptive = {});
+
+    // Schedules the enabled collectors of `groups` (newly wanted ones run on
+    // the next run_due()) and stops the others. Periods shorter than
+    // `min_period` are raised to it, so that collectors can share the
+    // wakeups of subscribers that do not need fresher values anyway.
+    void set_wanted(unsigned groups, std::chrono::milliseconds min_period = {});
+    // Runs the collectors due at `now`, taking their temporaries from
+    // `scratch`. Returns the groups refreshed.
+    unsigned run_due(Clock::time_point now, SummaryState& state,
+                     std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+    // When the next collector is due; Clock::time_point::max() if none is.
+    Clock::time_point next_due() const;
+
+    // Stretches every period by the hidden factor while not visible; on
+    // becoming visible all collectors snap back and run right away.
+    void set_visible(bool visible);
+    // Returns the collectors of `groups` to their base period, running them
+    // on the next run_due(): a client just started looking at them.
+    void snap(unsigned groups);
+    // Shortest period (before stretching) of the wanted collectors; zero if
+    // none is wanted.
+    std::chrono::milliseconds shortest_period() const;
+    // Runs skipped by stretched periods, and the collection time they would
+    // have taken at each collector's mean run time.
+    std::uint64_t runs_saved() const;
+    double cpu_ms_saved() const;
+
+    // Latest values; `groups` holds the wanted groups collected so far.
+    const SummarySnapshot& latest() const { return latest_; }
+    std::string status_json() const;
+    void append_status_json(std::pmr::string& out) const;
+
+private:
+    struct Entry {
+        CollectorSettings settings;
+        std::chrono::milliseconds period{0};  // settings.period, raised to the floor
+        Clock::time_point next_run{};
+        Clock::time_point last_slot{};  // of the previous run; unset after a pause
+        bool wanted = false;
+        bool run_now = false;
+        unsigned factor = 1;   // adaptive stretch
+        unsigned stretch = 1;  // factor and hidden factor, as last scheduled
+        double variance = 0.0;
+        std::uint64_t runs = 0;
+        std::uint64_t runs_saved = 0;
+        double last_ms = 0.0;
+        double total_ms = 0.0;
+    };
+
+    unsigned stretch(const Entry& entry) const;
+
+    common::TimerWheel::Tick tick_at(Clock::time_point time, bool round_up) const;
+    void run(std::uint32_t id, Clock::time_point now, SummaryState& state, std::pmr::memory_resource* scratch);
+
+    Clock::time_point epoch_;
+    AdaptiveSettings adaptive_;
+    bool visible_ = true;
+    common::TimerWheel wheel_;
+    std::vector<Entry> entries_;
+    SummarySnapshot latest_;
+    std::vector<std::uint32_t> expired_;
+};
+
+}
@@ -0,0 +1,637 @@
+#include "metrics_sampler.hpp"
+#include "collectors.hpp"
+#include "summary_delta.hpp"
+#include "system_summary.hpp"
+#include "../common/scratch.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace nanookjaro::metrics {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Subscription {
+    unsigned mask = 0;
+    bool delta = false;
+    std::uint64_t delivered_seq = 0;  // delta subscriptions: what the subscriber holds
+    std::chrono::milliseconds interval{0};
+    Clock::time_point next_due;
+    bool aligned = false;    // next_due is on the interval's wall-clock multiples
+    bool delivered = false;  // has had its first payload
+    bool held = false;       // adaptive: waits for a collector to refresh its groups
+    unsigned fresh = 0;      // groups refreshed since the last delivery
+    MetricsCallback callback = nullptr;
+    void* user_data = nullptr;
+};
+
+struct Due {
+    std::int64_t id = 0;
+    unsigned mask = 0;
+    bool delta = false;
+    bool first = false;
+    unsigned fresh = 0;
+    bool skip = false;
+    std::uint64_t since = 0;
+    std::size_t payload = 0;  // index into the tick's payload texts
+};
+
+struct Sampler {
+    std::mutex mutex;
+    std::condition_variable wake;       // subscriptions changed
+    std::condition_variable delivered;  // a callback returned
+    std::map<std::int64_t, Subscription> subscriptions;
+    std::int64_t next_id = 1;
+    std::int64_t delivering = 0;
+    std::thread::id thread_id;
+    bool running = false;
+    bool masks_changed = false;
+    bool stealth = false;  // requested; applied by the sampler thread
+    bool visible = true;   // requested; applied by the sampler thread
+    unsigned snap_groups = 0;  // groups of new subscriptions
+    std::string status;  // collectors_json() as of the last tick
+    int timer_fd = -1;   // CLOCK_MONOTONIC timerfd armed with absolute deadlines
+    int wake_fd = -1;    // eventfd signalled when subscriptions change
+    // Only used by the sampler thread.
+    Clock::time_point armed{};  // deadline of the last timed sleep
+    std::uint64_t wakeups = 0;
+    std::int64_t jitter_last_us = 0;
+    std::int64_t jitter_max_us = 0;
+    std::int64_t jitter_total_us = 0;
+    bool stealth_applied = false;
+    bool visible_applied = true;
+    AdaptiveSettings adaptive;
+    std::uint64_t deliveries_saved = 0;
+    // Wakeups the sampler would have had without adaptation: one per
+    // shortest base period while serving subscribers.
+    double baseline_wakeups = 0.0;
+    Clock::time_point accounted{};
+    std::chrono::milliseconds shortest{0};
+    const char* policy = "normal";  // "idle" (SCHED_IDLE), "nice" or "normal"
+    long long timer_slack_us = 0;   // 0: the thread's default
+    int pinned_cpu = -1;
+    bool affinity_saved = false;
+    cpu_set_t affinity{};  // before pinning
+    double wakeup_cost_uj = 0.0;
+    double active_power_mw = 0.0;
+    // Reused from tick to tick so the loop itself does not allocate; what
+    // a tick builds (values, payloads, status) lives in the arena.
+    std::vector<Due> due;
+    common::TickArena arena;
+    SummaryState state;
+    SummaryDelta changes;
+    std::unique_ptr<CollectorRegistry> collectors;
+};
+
+// Never destroyed: the detached sampler thread may outlive static destructors.
+Sampler& sampler() {
+    static Sampler* instance = [] {
+        auto* s = new Sampler();
+        s->stealth = common::config().get_bool("sampler", "stealth", false);
+        return s;
+    }();
+    return *instance;
+}
+
+void deliver(Sampler& s, std::int64_t id, const char* payload) {
+    std::unique_lock<std::mutex> lock(s.mutex);
+    const auto it = s.subscriptions.find(id);
+    if (it == s.subscriptions.end()) {
+        return;
+    }
+    const MetricsCallback callback = it->second.callback;
+    void* const user_data = it->second.user_data;
+    s.delivering = id;
+    lock.unlock();
+    callback(id, payload, user_data);
+    lock.lock();
+    s.delivering = 0;
+    s.delivered.notify_all();
+}
+
+void notify(Sampler& s) {
+    s.wake.notify_all();
+    if (s.wake_fd >= 0) {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] const ssize_t written = write(s.wake_fd, &one, sizeof(one));
+    }
+}
+
+// Scheduling policy, nice value, timer slack and affinity are per thread,
+// so this runs on the sampler thread. Failures are not errors: the state
+// actually reached is read back for status_json().
+void apply_mode(Sampler& s, bool stealth) {
+    const common::Config& config = common::config();
+    const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+    sched_param param{};
+    if (stealth) {
+        // SCHED_IDLE only runs when nothing else wants the CPU; a nice level
+        // is the fallback where the policy is refused.
+        if (sched_setscheduler(0, SCHED_IDLE, &param) != 0) {
+            setpriority(PRIO_PROCESS, tid, static_cast<int>(config.get_int("sampler", "stealth_nice", 19)));
+        }
+        // Lets the kernel fire our timers up to the slack late, together
+        // with other wakeups, instead of waking the CPU just for us.
+        s.timer_slack_us = std::max<long long>(config.get_int("sampler", "timer_slack_ms", 20), 0) * 1000;
+        prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(s.timer_slack_us) * 1000UL, 0UL, 0UL, 0UL);
+        const long long cpu = config.get_int("sampler", "housekeeping_cpu", -1);
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            if (!s.affinity_saved) {
+                s.affinity_saved = pthread_getaffinity_np(pthread_self(), sizeof(s.affinity), &s.affinity) == 0;
+            }
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(static_cast<int>(cpu), &set);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+                s.pinned_cpu = static_cast<int>(cpu);
+            }
+        }
+    } else {
+        sched_setscheduler(0, SCHED_OTHER, &param);
+        setpriority(PRIO_PROCESS, tid, 0);  // refused without CAP_SYS_NICE; reported below
+        prctl(PR_SET_TIMERSLACK, 0UL, 0UL, 0UL, 0UL);
+        s.timer_slack_us = 0;
+        if (s.pinned_cpu >= 0 && s.affinity_saved) {
+            pthread_setaffinity_np(pthread_self(), sizeof(s.affinity), &s.affinity);
+        }
+        s.pinned_cpu = -1;
+    }
+    errno = 0;
+    const int nice = getpriority(PRIO_PROCESS, tid);
+    s.policy = sched_getscheduler(0) == SCHED_IDLE ? "idle" : (errno == 0 && nice > 0 ? "nice" : "normal");
+    s.stealth_applied = stealth;
+}
+
+// Sleeps until `deadline` or until notify(). The timerfd is armed with an
+// absolute CLOCK_MONOTONIC deadline (steady_clock's clock), so repeated
+// sleeps never accumulate drift the way relative sleeps do. Timerfd expiry
+// ignores timer slack, so in stealth mode the deadline is turned into a
+// ppoll() timeout instead, which honours it; deadlines are still absolute.
+// The condition variable remains as a fallback when the descriptors are
+// unavailable.
+void wait_until(Sampler& s, std::unique_lock<std::mutex>& lock, Clock::time_point deadline) {
+    s.armed = deadline;
+    if (s.stealth_applied && s.wake_fd >= 0) {
+        timespec timeout{};
+        const timespec* wait_for = nullptr;
+        if (deadline != Clock::time_point::max()) {
+            const auto ns = std::max<std::int64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()).count(), 0);
+            timeout.tv_sec = static_cast<time_t>(ns / 1000000000);
+            timeout.tv_nsec = static_cast<long>(ns % 1000000000);
+            wait_for = &timeout;
+        }
+        lock.unlock();
+        pollfd fd{s.wake_fd, POLLIN, 0};
+        if (ppoll(&fd, 1, wait_for, nullptr) > 0) {
+            std::uint64_t count = 0;
+            [[maybe_unused]] const ssize_t got = read(s.wake_fd, &count, sizeof(count));
+        }
+        lock.lock();
+        return;
+    }
+    if (s.timer_fd < 0 || s.wake_fd < 0) {
+        if (deadline == Clock::time_point::max()) {
+            s.wake.wait(lock);
+        } else {
+            s.wake.wait_until(lock, deadline);
+        }
+        return;
+    }
+    itimerspec spec{};
+    if (deadline != Clock::time_point::max()) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+        spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+            spec.it_value.tv_nsec = 1;  // all zero would disarm the timer
+        }
+    }
+    timerfd_settime(s.timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    lock.unlock();
+    pollfd fds[2] = {{s.timer_fd, POLLIN, 0}, {s.wake_fd, POLLIN, 0}};
+    if (poll(fds, 2, -1) > 0) {
+        std::uint64_t count = 0;
+        for (const auto& fd : fds) {
+            if ((fd.revents & POLLIN) != 0) {
+                [[maybe_unused]] const ssize_t got = read(fd.fd, &count, sizeof(count));
+            }
+        }
+    }
+    lock.lock();
+}
+
+// What adaptation saved so far. Energy is an estimate from the configured
+// cost of a wakeup and the power drawn while collecting.
+void append_adaptive_json(const Sampler& s, std::pmr::string& out) {
+    const double wakeups_saved = std::max(s.baseline_wakeups - static_cast<double>(s.wakeups), 0.0);
+    const double cpu_ms_saved = s.collectors->cpu_ms_saved();
+    const double energy_mj = wakeups_saved * s.wakeup_cost_uj / 1000.0 + cpu_ms_saved * s.active_power_mw / 1000.0;
+    out += s.adaptive.enabled ? "{\"enabled\":true" : "{\"enabled\":false";
+    out += ",\"wakeups_saved\":";
+    common::append_uint(out, static_cast<std::uint64_t>(wakeups_saved));
+    out += ",\"deliveries_saved\":";
+    common::append_uint(out, s.deliveries_saved);
+    out += ",\"runs_saved\":";
+    common::append_uint(out, s.collectors->runs_saved());
+    out += ",\"cpu_ms_saved\":";
+    common::append_fixed(out, cpu_ms_saved);
+    out += ",\"energy_mj_saved\":";
+    common::append_fixed(out, energy_mj);
+    out += '}';
+}
+
+// What wait_until() sleeps on in the given mode.
+const char* timer_name(const Sampler& s, bool stealth) {
+    if (s.wake_fd >= 0 && stealth) {
+        return "ppoll";
+    }
+    return s.wake_fd >= 0 && s.timer_fd >= 0 ? "timerfd" : "condition_variable";
+}
+
+void append_status_json(const Sampler& s, std::pmr::string& out) {
+    out += "{\"sampler\":{\"timer\":\"";
+    out += timer_name(s, s.stealth_applied);
+    out += s.stealth_applied ? "\",\"stealth\":{\"enabled\":true" : "\",\"stealth\":{\"enabled\":false";
+    out += ",\"policy\":\"";
+    out += s.policy;
+    out += "\",\"timer_slack_us\":";
+    common::append_int(out, s.timer_slack_us);
+    out += ",\"cpu\":";
+    common::append_int(out, s.pinned_cpu);
+    out += "},\"wakeups\":";
+    common::append_uint(out, s.wakeups);
+    out += ",\"jitter_us\":{\"last\":";
+    common::append_int(out, s.jitter_last_us);
+    out += ",\"mean\":";
+    common::append_fixed(out, s.wakeups > 0 ? static_cast<double>(s.jitter_total_us) / static_cast<double>(s.wakeups)
+                                            : 0.0);
+    out += ",\"max\":";
+    common::append_int(out, s.jitter_max_us);
+    out += s.visible_applied ? "},\"visible\":true" : "},\"visible\":false";
+    out += ",\"adaptive\":";
+    append_adaptive_json(s, out);
+    out += ",\"arena\":{\"capacity_bytes\":";
+    common::append_uint(out, s.arena.capacity());
+    out += ",\"overflow_ticks\":";
+    common::append_uint(out, s.arena.overflows());
+    out += "}},\"collectors\":";
+    s.collectors->append_status_json(out);
+    out += '}';
+}
+
+// Publishes the status for collectors_json() and ends the tick: everything
+// built in the arena is dropped at once.
+void finish_tick(Sampler& s) {
+    {
+        std::pmr::string status(s.arena.resource());
+        append_status_json(s, status);
+        s.status.assign(status);
+    }
+    s.arena.reset();
+}
+
+// Delivery interval of `subscription`, stretched while no client is visible.
+std::chrono::milliseconds interval_of(const Sampler& s, const Subscription& subscription) {
+    return subscription.interval * (s.visible_applied ? 1 : s.adaptive.hidden_factor);
+}
+
+void run(Sampler& s) {
+    std::unique_lock<std::mutex> lock(s.mutex);
+    s.thread_id = std::this_thread::get_id();
+    s.adaptive = adaptive_settings(common::config());
+    s.wakeup_cost_uj = static_cast<double>(common::config().get_int("sampler", "wakeup_cost_uj", 50));
+    s.active_power_mw = static_cast<double>(common::config().get_int("sampler", "active_power_mw", 1000));
+    s.collectors =
+        std::make_unique<CollectorRegistry>(collector_settings(common::config()), Clock::now(), s.adaptive);
+    for (;;) {
+        if (s.stealth != s.stealth_applied) {
+            apply_mode(s, s.stealth);
+            s.masks_changed = true;
+        }
+        if (s.visible != s.visible_applied) {
+            // Becoming visible snaps everything back: fresh values right
+            // away, then the base periods and intervals.
+            s.visible_applied = s.visible;
+            s.collectors->set_visible(s.visible);
+            for (auto& [id, subscription] : s.subscriptions) {
+                subscription.aligned = false;
+                if (s.visible) {
+                    subscription.next_due = Clock::now();
+                    subscription.held = false;
+                }
+            }
+        }
+        if (s.snap_groups != 0) {
+            s.collectors->snap(s.snap_groups);
+            s.snap_groups = 0;
+        }
+        if (s.masks_changed) {
+            unsigned wanted = 0;
+            // In stealth mode no collector runs more often than the fastest
+            // subscriber, so (with both on wall-clock multiples) collection
+            // rides on delivery wakeups instead of adding its own.
+            std::chrono::milliseconds floor{0};
+            for (const auto& [id, subscription] : s.subscriptions) {
+                wanted |= subscription.mask;
+                if (s.stealth_applied && (floor.count() == 0 || subscription.interval < floor)) {
+                    floor = subscription.interval;
+                }
+            }
+            s.collectors->set_wanted(wanted, floor);
+            s.shortest = s.collectors->shortest_period();
+            for (const auto& [id, subscription] : s.subscriptions) {
+                if (s.shortest.count() == 0 || subscription.interval < s.shortest) {
+                    s.shortest = subscription.interval;
+                }
+            }
+            s.masks_changed = false;
+            finish_tick(s);
+        }
+        if (s.subscriptions.empty()) {
+            wait_until(s, lock, Clock::time_point::max());
+            s.accounted = {};
+            continue;
+        }
+        const auto earliest =
+            std::min(s.collectors->next_due(),
+                     std::min_element(s.subscriptions.begin(), s.subscriptions.end(), [](const auto& a, const auto& b) {
+                         return a.second.next_due < b.second.next_due;
+                     })->second.next_due);
+        if (Clock::now() < earliest) {
+            wait_until(s, lock, earliest);
+            continue;
+        }
+
+        const auto now = Clock::now();
+        if (earliest == s.armed) {
+            // Woken for the deadline we slept for: how late did we run?
+            const auto late = std::chrono::duration_cast<std::chrono::microseconds>(now - earliest).count();
+            ++s.wakeups;
+            s.jitter_last_us = late;
+            s.jitter_total_us += late;
+            s.jitter_max_us = std::max<std::int64_t>(s.jitter_max_us, late);
+        }
+        if (s.shortest.count() > 0 && s.accounted != Clock::time_point{}) {
+            s.baseline_wakeups += std::chrono::duration<double>(now - s.accounted) / s.shortest;
+        }
+        s.accounted = now;
+        std::vector<Due>& due = s.due;
+        due.clear();
+        for (auto& [id, subscription] : s.subscriptions) {
+            if (subscription.next_due > now) {
+                continue;
+            }
+            Due entry;
+            entry.id = id;
+            entry.mask = subscription.mask;
+            entry.delta = subscription.delta;
+            entry.first = !subscription.delivered;
+            entry.fresh = subscription.fresh;
+            entry.since = subscription.delivered_seq;
+            due.push_back(entry);
+            // Deliveries fall on wall-clock multiples of the interval; the
+            // first one, made right away, is followed by the next boundary.
+            const auto interval = interval_of(s, subscription);
+            subscription.next_due =
+                subscription.aligned ? subscription.next_due + interval : aligned_after(now, interval);
+            subscription.aligned = true;
+            if (subscription.next_due <= now) {
+                // Fell behind (slow collection or suspend): skip the missed ticks.
+                subscription.next_due = aligned_after(now, interval);
+            }
+        }
+        lock.unlock();
+
+        // Collectors refresh their groups on their own periods; subscribers
+        // get the latest values. Whole summaries are shared by subscribers
+        // with the same mask, patches depend on what each one already holds.
+        std::uint64_t seq = 0;
+        unsigned refreshed = 0;
+        {
+            std::pmr::memory_resource* const scratch = s.arena.resource();
+            std::pmr::vector<std::pmr::string> payloads(scratch);
+            payloads.reserve(due.size());
+            try {
+                refreshed = s.collectors->run_due(now, s.state, scratch);
+                if (refreshed != 0) {
+                    s.changes.update(s.collectors->latest(), scratch);
+                }
+                seq = s.changes.seq();
+                for (std::size_t i = 0; i < due.size(); ++i) {
+                    Due& entry = due[i];
+                    // Adaptive: nothing the subscriber asked for was collected
+                    // since its last payload, so hold it until something is.
+                    entry.skip =
+                        s.adaptive.enabled && !entry.first && ((entry.fresh | refreshed) & entry.mask) == 0;
+                    if (entry.skip) {
+                        continue;
+                    }
+                    if (!entry.delta) {
+                        const auto shared = std::find_if(due.begin(), due.begin() + i, [&](const Due& other) {
+                            return !other.delta && !other.skip && other.mask == entry.mask;
+                        });
+                        if (shared != due.begin() + i) {
+                            entry.payload = shared->payload;
+                            continue;
+                        }
+                    }
+                    entry.payload = payloads.size();
+                    std::pmr::string& payload = payloads.emplace_back();
+                    if (entry.delta) {
+                        s.changes.patch_json(entry.since, entry.mask, payload);
+                    } else {
+                        append_summary_snapshot_json(s.collectors->latest(), entry.mask, payload);
+                    }
+                }
+            } catch (...) {
+                payloads.clear();
+                payloads.emplace_back(R"({"error": "internal_error"})");
+                seq = 0;
+                for (auto& entry : due) {
+                    entry.skip = false;
+                    entry.payload = 0;
+                }
+            }
+            for (const auto& entry : due) {
+                if (!entry.skip) {
+                    deliver(s, entry.id, payloads[entry.payload].c_str());
+                }
+            }
+        }
+        lock.lock();
+        for (auto& [id, subscription] : s.subscriptions) {
+            subscription.fresh |= refreshed & subscription.mask;
+        }
+        for (const auto& entry : due) {
+            const auto it = s.subscriptions.find(entry.id);
+            if (it == s.subscriptions.end()) {
+                continue;
+            }
+            Subscription& subscription = it->second;
+            if (entry.skip) {
+                subscription.held = true;
+                subscription.next_due = Clock::time_point::max();
+                ++s.deliveries_saved;
+                continue;
+            }
+            subscription.delivered = true;
+            subscription.fresh = 0;
+            if (seq != 0 && subscription.delta) {
+                subscription.delivered_seq = seq;
+            }
+        }
+        for (auto& [id, subscription] : s.subscriptions) {
+            if (subscription.held && subscription.fresh != 0) {
+                // Delivered on this wakeup; the cadence resumes after it.
+                subscription.held = false;
+                subscription.aligned = false;
+                subscription.next_due = now;
+            }
+        }
+        finish_tick(s);
+    }
+}
+
+}
+
+unsigned default_interval_ms() {
+    static const unsigned interval = [] {
+        const long long seconds = common::config().get_int("general", "refresh_interval", 2);
+        return static_cast<unsigned>(seconds > 0 ? seconds * 1000 : 2000);
+    }();
+    return interval;
+}
+
+std::int64_t subscribe(unsigned mask, unsigned interval_ms, MetricsCallback callback, void* user_data) {
+    const bool delta = (mask & kSubscribeDelta) != 0;
+    mask &= kSummaryAllGroups;
+    if (mask == 0 || callback == nullptr) {
+        return -1;
+    }
+    Sampler& s = sampler();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    const std::int64_t id = s.next_id++;
+    Subscription subscription;
+    subscription.mask = mask;
+    subscription.delta = delta;
+    if (interval_ms == 0) {
+        interval_ms = default_interval_ms();
+    }
+    subscription.interval = std::chrono::milliseconds(std::max(interval_ms, kMinIntervalMs));
+    subscription.next_due = Clock::now();
+    subscription.callback = callback;
+    subscription.user_data = user_data;
+    s.subscriptions.emplace(id, subscription);
+    s.masks_changed = true;
+    s.snap_groups |= mask;
+    if (!s.running) {
+        s.running = true;
+        s.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        s.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        std::thread(run, std::ref(s)).detach();
+    }
+    notify(s);
+    return id;
+}
+
+bool unsubscribe(std::int64_t id) {
+    Sampler& s = sampler();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    if (s.subscriptions.erase(id) == 0) {
+        return false;
+    }
+    s.masks_changed = true;
+    if (std::this_thread::get_id() != s.thread_id) {
+        s.delivered.wait(lock, [&] { return s.delivering != id; });
+    }
+    notify(s);
+    return true;
+}
+
+void set_stealth_mode(bool enabled) {
+    Sampler& s = sampler();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.stealth = enabled;
+    notify(s);
+}
+
+bool stealth_mode() {
+    Sampler& s = sampler();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.stealth;
+}
+
+void set_visibility(bool visible) {
+    Sampler& s = sampler();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.visible = visible;
+    notify(s);
+}
+
+bool visible() {
+    Sampler& s = sampler();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.visible;
+}
+
+std::string collectors_json() {
+    Sampler& s = sampler();
+    std::ostringstream json;
+    {
+        // Before the first tick: the requested mode with the timer it will
+        // use (the descriptors are created when the sampler starts) and the
+        // policy the sampler thread has reached so far.
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (!s.status.empty()) {
+            return s.status;
+        }
+        const char* timer = s.running ? timer_name(s, s.stealth) : (s.stealth ? "ppoll" : "timerfd");
+        json << "{\"sampler\":{\"timer\":\"" << timer << "\",\"stealth\":{\"enabled\":"
+             << (s.stealth ? "true" : "false") << ",\"policy\":\"" << s.policy << "\",\"timer_slack_us\":"
+             << s.timer_slack_us << ",\"cpu\":" << s.pinned_cpu << "},\"wakeups\":0,"
+             << "\"jitter_us\":{\"last\":0,\"mean\":0.00,\"max\":0},\"visible\":" << (s.visible ? "true" : "false");
+    }
+    json << ",\"adaptive\":{\"enabled\":" << (adaptive_settings(common::config()).enabled ? "true" : "false")
+         << ",\"wakeups_saved\":0,\"deliveries_saved\":0,\"runs_saved\":0,\"cpu_ms_saved\":0.00,"
+         << "\"energy_mj_saved\":0.00},\"arena\":{\"capacity_bytes\":0,\"overflow_ticks\":0}},"
+         << "\"collectors\":[";
+    const auto settings = collector_settings(common::config());
+    for (std::size_t i = 0; i < settings.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "{\"name\":\"" << settings[i].name << "\","
+             << "\"group\":\"" << summary_group_key(settings[i].group) << "\","
+             << "\"period_ms\":" << settings[i].period.count() << ","
+             << "\"enabled\":" << (settings[i].period.count() > 0 ? "true" : "false") << ","
+             << "\"active\":false,\"stretch\":1,\"volatility_percent\":0.00,\"runs\":0,\"runs_saved\":0,"
+             << "\"last_ms\":0.00}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace nanookjaro::metrics {
+
+// Receives one summary payload (see system_summary_json) per tick. Runs on
+// the sampler thread; `json` is only valid for the duration of the call.
+using MetricsCallback = void (*)(std::int64_t subscription_id, const char* json, void* user_data);
+
+inline constexpr unsigned kMinIntervalMs = 50;
+
+// Added to a subscription mask to receive SummaryDelta patches (see
+// summary_delta.hpp) instead of whole summaries: the first payload is
+// full, later ones carry only what changed since the previous delivery.
+inline constexpr unsigned kSubscribeDelta = 1u << 31;
+
+// Registers a subscription to the summary groups in `mask` (SummaryGroup
+// bits) every `interval_ms` (0 for refresh_interval from nanookjaro.conf).
+// A single background sampler thread serves all subscriptions. Groups are
+// refreshed by collectors on their own periods (see collectors.hpp), and
+// only while some subscriber wants them; each due subscriber receives the
+// latest values of the groups it asked for. The first payload is delivered
+// immediately, later ones on wall-clock multiples of the interval (:00,
+// :02, ... for two seconds). With adaptive sampling ([sampler] adaptive,
+// on by default) collectors stretch their periods while values are flat,
+// and a payload is only sent once some group of `mask` was collected again
+// since the previous one; a new subscription snaps its groups back to the
+// base periods. Returns the subscription id, or -1 for an
+// empty group mask or missing callback.
+std::int64_t subscribe(unsigned mask, unsigned interval_ms, MetricsCallback callback, void* user_data);
+
+// Stops a subscription. Once this returns the callback is not invoked again,
+// unless it is called from within that callback on the sampler thread.
+bool unsubscribe(std::int64_t id);
+
+// refresh_interval from nanookjaro.conf in milliseconds (2000 by default).
+unsigned default_interval_ms();
+
+// Low-overhead ("stealth") mode for the sampler thread, so that the monitor
+// stays out of the top of its own process list: the thread runs under
+// SCHED_IDLE (or at stealth_nice where that is refused), sleeps with a
+// timer slack of timer_slack_ms so the kernel can batch its wakeups with
+// others, optionally stays on housekeeping_cpu, and no collector runs more
+// often than the fastest subscription. Starts from [sampler] stealth in
+// nanookjaro.conf; a change takes effect at the sampler's next wakeup.
+void set_stealth_mode(bool enabled);
+bool stealth_mode();
+
+// Whether a client is showing the data, e.g. the dashboard window is not
+// minimized; true until told otherwise. While nothing is visible collector
+// periods and subscription intervals are stretched by [sampler]
+// hidden_factor (8 by default); becoming visible again brings fresh values
+// right away and the base rates back.
+void set_visibility(bool visible);
+bool visible();
+
+// Sampler self-metrics (stealth state, wakeups and how late each timed
+// wakeup ran, in microseconds, visibility and what adaptive sampling saved)
+// and the period and state of every collector: with run counts and the duration of the last run once the
+// sampler is running, otherwise from the configuration.
+std::string collectors_json();
+
+}
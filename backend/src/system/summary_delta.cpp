@@ -0,0 +1,308 @@
+#include "summary_delta.hpp"
+#include "../common/scratch.hpp"
+
+#include <chrono>
+#include <mutex>
+
+namespace nanookjaro {
+namespace {
+
+bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+std::size_t skip_space(std::string_view json, std::size_t pos) {
+    while (pos < json.size() && is_space(json[pos])) {
+        ++pos;
+    }
+    return pos;
+}
+
+// Position of the quote closing the string that starts at `pos`.
+std::size_t string_end(std::string_view json, std::size_t pos) {
+    for (++pos; pos < json.size(); ++pos) {
+        if (json[pos] == '\\') {
+            ++pos;
+        } else if (json[pos] == '"') {
+            return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// End of the value starting at `pos`: the ',' or closing bracket after it.
+std::size_t value_end(std::string_view json, std::size_t pos) {
+    int depth = 0;
+    for (; pos < json.size(); ++pos) {
+        const char c = json[pos];
+        if (c == '"') {
+            pos = string_end(json, pos);
+            if (pos == std::string_view::npos) {
+                return pos;
+            }
+        } else if (c == '{' || c == '[') {
+            ++depth;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0) {
+                return pos;
+            }
+            --depth;
+        } else if (c == ',' && depth == 0) {
+            return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// A top-level member of a value being compared, viewing into the value.
+// Array elements have no key; they are identified by position.
+struct MemberView {
+    std::string_view key;
+    std::string_view value;
+};
+
+// Splits the top level of a JSON object or array into (key, value) pairs.
+// Returns false for anything else.
+bool split_members(std::string_view json, std::pmr::vector<MemberView>& members) {
+    members.clear();
+    if (json.size() < 2 || (json.front() != '{' && json.front() != '[')) {
+        return false;
+    }
+    const bool object = json.front() == '{';
+    const char close = object ? '}' : ']';
+    std::size_t pos = skip_space(json, 1);
+    if (pos < json.size() && json[pos] == close) {
+        return skip_space(json, pos + 1) == json.size();
+    }
+    while (pos < json.size()) {
+        MemberView member;
+        if (object) {
+            if (json[pos] != '"') {
+                return false;
+            }
+            const std::size_t key_end = string_end(json, pos);
+            if (key_end == std::string_view::npos) {
+                return false;
+            }
+            member.key = json.substr(pos + 1, key_end - pos - 1);
+            pos = skip_space(json, key_end + 1);
+            if (pos >= json.size() || json[pos] != ':') {
+                return false;
+            }
+            pos = skip_space(json, pos + 1);
+        }
+        const std::size_t end = value_end(json, pos);
+        if (end == std::string_view::npos || end == pos) {
+            return false;
+        }
+        std::size_t last = end;
+        while (last > pos && is_space(json[last - 1])) {
+            --last;
+        }
+        member.value = json.substr(pos, last - pos);
+        members.push_back(member);
+        if (json[end] == close) {
+            return skip_space(json, end + 1) == json.size();
+        }
+        pos = skip_space(json, end + 1);
+    }
+    return false;
+}
+
+bool same_keys(const std::pmr::vector<MemberView>& views, const auto& members) {
+    if (views.size() != members.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < views.size(); ++i) {
+        if (views[i].key != members[i].key) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::uint64_t initial_seq() {
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+}
+
+}
+
+SummaryDelta::SummaryDelta() : first_seq_(initial_seq()), seq_(first_seq_) {}
+
+std::uint64_t SummaryDelta::update(const SummarySnapshot& snapshot, std::pmr::memory_resource* scratch) {
+    const std::uint64_t next = seq_ + 1;
+    bool changed = false;
+    std::pmr::vector<MemberView> members(scratch);
+    for (std::size_t bit = 0; bit < kSummaryGroupCount; ++bit) {
+        if ((snapshot.groups & (1u << bit)) == 0) {
+            continue;
+        }
+        Group& group = groups_[bit];
+        const std::string& value = snapshot.values[bit];
+        group.latency_us = snapshot.latency_us[bit];
+        if (value.empty()) {
+            if (group.present) {
+                group = Group{};
+                group.changed = next;
+                changed = true;
+            }
+            continue;
+        }
+        if (group.present && group.value == value) {
+            continue;
+        }
+        changed = true;
+
+        // Members are compared in place and only changed ones are copied,
+        // into strings that keep their capacity from sample to sample.
+        const char shape = split_members(value, members) ? value.front() : 's';
+        const bool reshaped = !group.present || shape != group.shape || shape == 's' ||
+                              (shape == '{' && !same_keys(members, group.members));
+        const std::size_t previous = reshaped ? 0 : group.members.size();
+        if (reshaped) {
+            group.shape = shape;
+            group.present = true;
+            group.changed = next;
+            group.length_changed = next;
+        } else if (members.size() != previous) {
+            group.length_changed = next;
+        }
+        group.members.resize(members.size());
+        for (std::size_t i = 0; i < members.size(); ++i) {
+            Member& member = group.members[i];
+            if (i < previous && member.value == members[i].value) {
+                continue;
+            }
+            if (i >= previous) {
+                if (shape == '{') {
+                    member.key.assign(members[i].key);
+                } else {
+                    member.key = std::to_string(i);
+                }
+            }
+            common::assign_kept(member.value, members[i].value);
+            member.changed = next;
+        }
+        common::assign_kept(group.value, value);
+    }
+    timestamp_ = snapshot.timestamp;
+    time_ms_ = snapshot.time_ms;
+    if (changed) {
+        seq_ = next;
+    }
+    return seq_;
+}
+
+std::string SummaryDelta::patch_json(std::uint64_t since, unsigned groups) const {
+    std::pmr::string json;
+    patch_json(since, groups, json);
+    return std::string(json);
+}
+
+void SummaryDelta::patch_json(std::uint64_t since, unsigned groups, std::pmr::string& out) const {
+    const bool full = since < first_seq_ || since > seq_;
+    out += "{\"seq\":";
+    common::append_uint(out, seq_);
+    out += full ? ",\"full\":true" : ",\"full\":false";
+    out += ",\"timestamp\":\"";
+    out += timestamp_;
+    out += "\",\"time_ms\":";
+    common::append_int(out, time_ms_);
+    out += ",\"groups\":{";
+    bool first_group = true;
+    unsigned removed = 0;
+    unsigned sent = 0;
+    auto open_group = [&](unsigned key) {
+        out += first_group ? "\"" : ",\"";
+        out += summary_group_key(key);
+        out += "\":{";
+        first_group = false;
+    };
+    for (std::size_t bit = 0; bit < kSummaryGroupCount; ++bit) {
+        const unsigned key = 1u << bit;
+        const Group& group = groups_[bit];
+        if ((groups & key) == 0) {
+            continue;
+        }
+        if (!group.present) {
+            if (!full && group.changed > since) {
+                removed |= key;
+            }
+            continue;
+        }
+        if (full || group.changed > since) {
+            open_group(key);
+            out += "\"value\":";
+            out += group.value;
+            out += '}';
+            sent |= key;
+            continue;
+        }
+        bool first_member = true;
+        for (const auto& member : group.members) {
+            if (member.changed <= since) {
+                continue;
+            }
+            if (first_member) {
+                open_group(key);
+                if (group.shape == '[') {
+                    out += "\"length\":";
+                    common::append_uint(out, group.members.size());
+                    out += ',';
+                }
+                out += "\"set\":{\"";
+            } else {
+                out += ",\"";
+            }
+            out += member.key;
+            out += "\":";
+            out += member.value;
+            first_member = false;
+        }
+        if (!first_member) {
+            out += "}}";
+            sent |= key;
+        } else if (group.shape == '[' && group.length_changed > since) {
+            // Only trailing elements went away.
+            open_group(key);
+            out += "\"length\":";
+            common::append_uint(out, group.members.size());
+            out += ",\"set\":{}}";
+            sent |= key;
+        }
+    }
+    out += "},\"removed\":[";
+    bool first = true;
+    for (std::size_t bit = 0; bit < kSummaryGroupCount; ++bit) {
+        if ((removed & (1u << bit)) != 0) {
+            out += first ? "\"" : ",\"";
+            out += summary_group_key(1u << bit);
+            out += '"';
+            first = false;
+        }
+    }
+    out += "],\"latency_us\":{";
+    first = true;
+    for (std::size_t bit = 0; bit < kSummaryGroupCount; ++bit) {
+        if ((sent & (1u << bit)) != 0) {
+            out += first ? "\"" : ",\"";
+            out += summary_group_key(1u << bit);
+            out += "\":";
+            common::append_uint(out, groups_[bit].latency_us);
+            first = false;
+        }
+    }
+    out += "}}";
+}
+
+std::string summary_since_json(std::uint64_t since) {
+    static std::mutex mutex;
+    static SummaryState state;
+    static SummaryDelta delta;
+    std::lock_guard<std::mutex> lock(mutex);
+    delta.update(collect_summary(kSummaryDefaultGroups, state));
+    return delta.patch_json(since, kSummaryDefaultGroups);
+}
+
+}
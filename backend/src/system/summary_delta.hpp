@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "system_summary.hpp"
+
+namespace nanookjaro {
+
+// Change log of summary groups, so a client that already holds the summary
+// as of sequence number `since` only receives what changed afterwards.
+// Object groups (cpu, memory, proxy) are tracked per field, array groups
+// (load_average, filesystems, gpu, network) per element, and scalar groups
+// as a whole. Sequence numbers start at the creation time in microseconds,
+// so a number handed out by an earlier process is never mistaken for a
+// current one.
+class SummaryDelta {
+public:
+    SummaryDelta();
+
+    std::uint64_t seq() const { return seq_; }
+
+    // Records the collected groups of `snapshot`. The sequence number only
+    // advances when a value changed. Returns the current sequence number.
+    // Values are split in `scratch`; only changed members are copied.
+    std::uint64_t update(const SummarySnapshot& snapshot,
+                         std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+    // Patch for `groups` since `since`:
+    //   {"seq":N,"full":false,"timestamp":"...","time_ms":T,"groups":{...},
+    //    "removed":[...],"latency_us":{...}}
+    // Each entry of "groups" is {"value":<whole group>} when the group is new
+    // or changed shape, otherwise {"set":{<field or index>:<value>,...}} plus
+    // "length" for arrays. "removed" lists groups that disappeared. When
+    // `since` is 0 or unknown, "full" is true and every group is sent whole.
+    // "latency_us" has the collection time of each group in "groups".
+    std::string patch_json(std::uint64_t since, unsigned groups) const;
+    void patch_json(std::uint64_t since, unsigned groups, std::pmr::string& out) const;
+
+private:
+    struct Member {
+        std::string key;  // escaped object key, or the array index
+        std::string value;
+        std::uint64_t changed = 0;
+    };
+
+    struct Group {
+        char shape = 0;  // '{', '[' or 's' for scalars and unparsed values
+        bool present = false;
+        std::uint64_t changed = 0;  // added, reshaped or removed
+        std::uint64_t length_changed = 0;
+        std::uint32_t latency_us = 0;  // of the latest collection
+        std::string value;
+        std::vector<Member> members;
+    };
+
+    std::array<Group, kSummaryGroupCount> groups_;
+    std::string timestamp_;
+    std::int64_t time_ms_ = 0;
+    std::uint64_t first_seq_ = 0;
+    std::uint64_t seq_ = 0;
+};
+
+// Samples every group with a process-wide CPU baseline and returns the patch
+// since `since` from a process-wide change log.
+std::string summary_since_json(std::uint64_t since);
+
+}
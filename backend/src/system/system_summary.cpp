@@ -1,21 +1,37 @@
 #include "system_summary.hpp"
+#include "cgroup_monitor.hpp"
 #include "../hardware/cpu_monitor.hpp"
 #include "../hardware/gpu_monitor.hpp"
 #include "../hardware/memory_monitor.hpp"
 #include "../hardware/disk_monitor.hpp"
+#include "../hardware/disk_usage.hpp"
+#include "../hardware/disk_usage_index.hpp"
+#include "../hardware/duplicate_finder.hpp"
 #include "../network/network_monitor.hpp"
 #include "../drivers/driver_manager.hpp"
-
+#include "../drivers/modalias_index.hpp"
+#include "../maintenance/pacman_db.hpp"
+#include "../maintenance/pacman_sync.hpp"
+#include "../maintenance/file_ownership.hpp"
+#include "../common/scratch.hpp"
+#include "../common/subprocess.hpp"
+
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <charconv>
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <unordered_set>
 #include <vector>
@@ -26,34 +42,6 @@
 namespace nanookjaro {
 namespace {
 
-std::string escape_json(const std::string& input) {
-    std::string output;
-    output.reserve(input.size());
-    for (char c : input) {
-        switch (c) {
-            case '"':
-                output += "\\\"";
-                break;
-            case '\\':
-                output += "\\\\";
-                break;
-            case '\n':
-                output += "\\n";
-                break;
-            case '\r':
-                output += "\\r";
-                break;
-            case '\t':
-                output += "\\t";
-                break;
-            default:
-                output += c;
-                break;
-        }
-    }
-    return output;
-}
-
 std::string trim(const std::string& value) {
     const auto first = value.find_first_not_of(" \t\n\r");
     if (first == std::string::npos) {
@@ -79,15 +67,30 @@ std::string read_cpu_model() {
 }
 
 int count_cpu_cores() {
-    std::ifstream file("/proc/cpuinfo");
-    std::string line;
-    int count = 0;
-    while (std::getline(file, line)) {
-        if (line.rfind("processor", 0) == 0) {
-            ++count;
-        }
+    // The number of "processor" entries in /proc/cpuinfo, without reading
+    // the whole file on every sample.
+    const long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? static_cast<int>(online) : 0;
+}
+
+// Lines of `text`, one per call; false once it is exhausted.
+bool next_line(std::string_view& text, std::string_view& line) {
+    if (text.empty()) {
+        return false;
     }
-    return count;
+    const std::size_t end = text.find('\n');
+    line = text.substr(0, end);
+    text = end == std::string_view::npos ? std::string_view{} : text.substr(end + 1);
+    return true;
+}
+
+// The number at the start of `text`, after any spaces.
+template <typename Number>
+Number leading_number(std::string_view text) {
+    const std::size_t begin = std::min(text.find_first_not_of(" \t"), text.size());
+    Number value{};
+    std::from_chars(text.data() + begin, text.data() + text.size(), value);
+    return value;
 }
 
 struct MemoryInfo {
@@ -100,23 +103,20 @@ struct MemoryInfo {
     long swap_free_kb = 0;
 };
 
-MemoryInfo read_memory_info() {
-    std::ifstream file("/proc/meminfo");
-    std::string line;
+MemoryInfo read_memory_info(std::pmr::memory_resource* memory) {
+    std::pmr::string contents(memory);
+    common::read_file("/proc/meminfo", contents);
     MemoryInfo info;
 
-    auto parse_value = [](const std::string& raw_line) -> long {
-        std::istringstream iss(raw_line);
-        std::string label;
-        long value = 0;
-        std::string unit;
-        if (iss >> label >> value >> unit) {
-            return value;
-        }
-        return 0;
+    // "MemTotal:       16314480 kB"
+    auto parse_value = [](std::string_view raw_line) -> long {
+        const std::size_t colon = raw_line.find(':');
+        return colon == std::string_view::npos ? 0 : leading_number<long>(raw_line.substr(colon + 1));
     };
 
-    while (std::getline(file, line)) {
+    std::string_view rest = contents;
+    std::string_view line;
+    while (next_line(rest, line)) {
         if (line.rfind("MemTotal", 0) == 0) {
             info.total_kb = parse_value(line);
         } else if (line.rfind("MemAvailable", 0) == 0) {
@@ -143,29 +143,24 @@ MemoryInfo read_memory_info() {
     return info;
 }
 
-std::tuple<double, double, double> read_load_average() {
-    std::ifstream file("/proc/loadavg");
-    double one = 0.0;
-    double five = 0.0;
-    double fifteen = 0.0;
-    if (file) {
-        file >> one >> five >> fifteen;
+std::tuple<double, double, double> read_load_average(std::pmr::memory_resource* memory) {
+    std::pmr::string contents(memory);
+    double values[3] = {};
+    if (common::read_file("/proc/loadavg", contents)) {
+        std::string_view rest = contents;
+        for (double& value : values) {
+            const std::size_t begin = std::min(rest.find_first_not_of(" \t"), rest.size());
+            const auto parsed = std::from_chars(rest.data() + begin, rest.data() + rest.size(), value);
+            rest = rest.substr(static_cast<std::size_t>(parsed.ptr - rest.data()));
+        }
     }
-    return {one, five, fifteen};
+    return {values[0], values[1], values[2]};
 }
 
-std::string current_timestamp_iso8601() {
-    const auto now = std::chrono::system_clock::now();
-    const auto time = std::chrono::system_clock::to_time_t(now);
-    std::tm utc{};
-#if defined(_WIN32)
-    gmtime_s(&utc, &time);
-#else
-    gmtime_r(&time, &utc);
-#endif
-    std::ostringstream oss;
-    oss << std::put_time(&utc, "%FT%TZ");
-    return oss.str();
+std::int64_t unix_time_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
 }
 
 struct FilesystemUsage {
@@ -180,26 +175,32 @@ struct CpuTimes {
     bool valid = false;
 };
 
-CpuTimes read_cpu_times() {
-    std::ifstream file("/proc/stat");
-    if (!file) {
+CpuTimes read_cpu_times(std::pmr::memory_resource* memory) {
+    std::pmr::string contents(memory);
+    if (!common::read_file("/proc/stat", contents)) {
         return {};
     }
 
-    std::string cpu_label;
-    unsigned long long user = 0;
-    unsigned long long nice = 0;
-    unsigned long long system = 0;
-    unsigned long long idle = 0;
-    unsigned long long iowait = 0;
-    unsigned long long irq = 0;
-    unsigned long long softirq = 0;
-    unsigned long long steal = 0;
-
-    file >> cpu_label >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
-    if (!file || cpu_label.rfind("cpu", 0) != 0) {
+    // "cpu  user nice system idle iowait irq softirq steal ..."
+    std::string_view line = contents;
+    line = line.substr(0, line.find('\n'));
+    if (line.rfind("cpu", 0) != 0) {
         return {};
     }
+    unsigned long long fields[8] = {};
+    std::size_t pos = line.find_first_of(" \t");
+    for (auto& field : fields) {
+        pos = line.find_first_not_of(" \t", pos);
+        if (pos == std::string_view::npos) {
+            return {};
+        }
+        const auto parsed = std::from_chars(line.data() + pos, line.data() + line.size(), field);
+        if (parsed.ec != std::errc{}) {
+            return {};
+        }
+        pos = static_cast<std::size_t>(parsed.ptr - line.data());
+    }
+    const auto [user, nice, system, idle, iowait, irq, softirq, steal] = fields;
 
     const unsigned long long idle_all = idle + iowait;
     const unsigned long long non_idle = user + nice + system + irq + softirq + steal;
@@ -252,35 +253,31 @@ std::vector<FilesystemUsage> read_filesystems() {
 
 std::vector<std::string> read_gpu_controllers() {
     std::vector<std::string> controllers;
-    static constexpr const char* kCommand =
-        "lspci -d '*:*' | grep -E '(VGA|3D|Display)' | sed 's/.*: //g'";
-
-    FILE* pipe = popen(kCommand, "r");
-    if (!pipe) {
+    common::SubprocessOptions options;
+    options.timeout = std::chrono::seconds(5);
+    const common::SubprocessResult result = common::run_subprocess({"lspci", "-d", "*:*"}, options);
+    if (result.exit_code != 0) {
         return controllers;
     }
 
-    std::array<char, 512> buffer{};
-    while (fgets(buffer.data(), static_cast<int>(buffer.size()), pipe) != nullptr) {
-        std::string line(buffer.data());
-        line = trim(line);
+    std::istringstream stream(result.out);
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (line.find("VGA") == std::string::npos && line.find("3D") == std::string::npos &&
+            line.find("Display") == std::string::npos) {
+            continue;
+        }
+        // "00:02.0 VGA compatible controller: Intel ..." -> "Intel ..."
+        const auto separator = line.rfind(": ");
+        line = trim(separator == std::string::npos ? line : line.substr(separator + 2));
         if (!line.empty()) {
             controllers.push_back(line);
         }
     }
-    pclose(pipe);
 
     return controllers;
 }
 
-std::optional<std::string> read_proxy_setting(const char* env_name) {
-    const char* value = std::getenv(env_name);
-    if (value == nullptr) {
-        return std::nullopt;
-    }
-    return std::string(value);
-}
-
 }
 
 std::string set_proxy_config_json(const std::string& http_proxy, const std::string& https_proxy) {
@@ -304,8 +301,8 @@ std::string set_proxy_config_json(const std::string& http_proxy, const std::stri
     std::ostringstream json;
     json << '{'
          << "\"ok\":" << (http_ok && https_ok ? "true" : "false") << ','
-         << "\"http_proxy\":\"" << escape_json(http_proxy) << "\",";
-    json << "\"https_proxy\":\"" << escape_json(https_proxy) << "\"";
+         << "\"http_proxy\":\"" << common::escape_json(http_proxy) << "\",";
+    json << "\"https_proxy\":\"" << common::escape_json(https_proxy) << "\"";
     if (!http_ok || !https_ok) {
         json << ",\"error\":\"failed_to_set_proxy\"";
     }
@@ -313,126 +310,292 @@ std::string set_proxy_config_json(const std::string& http_proxy, const std::stri
     return json.str();
 }
 
-std::string system_summary_json() {
-    const bool is_arch_system = access("/etc/arch-release", F_OK) != -1;
-    
-    // Get component information
-    auto cpu_info = nanookjaro::hardware::cpu::get_cpu_info();
-    auto gpu_info = nanookjaro::hardware::gpu::get_gpu_info();
-    auto disk_info = nanookjaro::hardware::disk::get_disk_info();
-    auto network_info = nanookjaro::network::get_network_interfaces();
-    auto driver_info = nanookjaro::drivers::list_drivers();
-    
-    std::string cpu_model = trim(read_cpu_model());
-    if (cpu_model.empty()) {
-        cpu_model = "unknown";
+std::string summary_timestamp(std::int64_t unix_ms) {
+    std::string timestamp;
+    summary_timestamp(unix_ms, timestamp);
+    return timestamp;
+}
+
+void summary_timestamp(std::int64_t unix_ms, std::string& out) {
+    const std::time_t time = static_cast<std::time_t>(unix_ms / 1000);
+    std::tm utc{};
+#if defined(_WIN32)
+    gmtime_s(&utc, &time);
+#else
+    gmtime_r(&time, &utc);
+#endif
+    char buffer[32];
+    out.assign(buffer, std::strftime(buffer, sizeof(buffer), "%FT%TZ", &utc));
+}
+
+const char* summary_group_key(unsigned group) {
+    switch (group) {
+        case kSummaryCpu:
+            return "cpu";
+        case kSummaryMemory:
+            return "memory";
+        case kSummaryLoad:
+            return "load_average";
+        case kSummaryFilesystems:
+            return "filesystems";
+        case kSummaryGpu:
+            return "gpu";
+        case kSummaryPackages:
+            return "packages";
+        case kSummaryNetwork:
+            return "network";
+        case kSummaryProxy:
+            return "proxy";
+        case kSummarySmart:
+            return "smart";
+        case kSummaryUpdates:
+            return "updates";
+        default:
+            return "";
     }
+}
+
+std::string summary_group_json(unsigned group, SummaryState& state) {
+    std::pmr::string json;
+    append_summary_group(group, state, json);
+    return std::string(json);
+}
 
-    const int cpu_cores = count_cpu_cores();
-    const MemoryInfo memory = read_memory_info();
-    const CpuTimes cpu_times = read_cpu_times();
-    const auto [load_one, load_five, load_fifteen] = read_load_average();
-    const std::string timestamp = current_timestamp_iso8601();
-    const auto http_proxy = read_proxy_setting("http_proxy");
-    const auto https_proxy = read_proxy_setting("https_proxy");
-    
-    int package_count = -1;
-    if (is_arch_system) {
-        FILE* pipe = popen("pacman -Qq | wc -l", "r");
-        if (pipe) {
-            char buffer[32];
-            if (fgets(buffer, sizeof(buffer), pipe)) {
-                package_count = std::stoi(std::string(buffer));
+void append_summary_group(unsigned group, SummaryState& state, std::pmr::string& out) {
+    std::pmr::memory_resource* const memory = out.get_allocator().resource();
+    switch (group) {
+        case kSummaryCpu: {
+            if (state.cpu_model.empty()) {
+                state.cpu_model = trim(read_cpu_model());
+                if (state.cpu_model.empty()) {
+                    state.cpu_model = "unknown";
+                }
             }
-            pclose(pipe);
+            const CpuTimes cpu_times = read_cpu_times(memory);
+            double cpu_usage_percent = 0.0;
+            if (cpu_times.valid) {
+                if (state.have_cpu_baseline) {
+                    const unsigned long long total_delta = cpu_times.total - state.cpu_total;
+                    const unsigned long long idle_delta = cpu_times.idle - state.cpu_idle;
+                    if (total_delta > 0 && idle_delta <= total_delta) {
+                        const unsigned long long active_delta = total_delta - idle_delta;
+                        cpu_usage_percent =
+                            static_cast<double>(active_delta) * 100.0 / static_cast<double>(total_delta);
+                    }
+                }
+                state.cpu_total = cpu_times.total;
+                state.cpu_idle = cpu_times.idle;
+                state.have_cpu_baseline = true;
+            }
+            out += "{\"model\":\"";
+            common::append_escaped(out, state.cpu_model);
+            out += "\",\"cores\":";
+            common::append_int(out, count_cpu_cores());
+            out += ",\"usage_percent\":";
+            common::append_fixed(out, cpu_usage_percent);
+            out += '}';
+            break;
         }
-    }
-
-    static unsigned long long previous_cpu_total = 0;
-    static unsigned long long previous_cpu_idle = 0;
-    static bool have_cpu_baseline = false;
-    double cpu_usage_percent = 0.0;
-    if (cpu_times.valid) {
-        if (have_cpu_baseline) {
-            const unsigned long long total_delta = cpu_times.total - previous_cpu_total;
-            const unsigned long long idle_delta = cpu_times.idle - previous_cpu_idle;
-            if (total_delta > 0 && idle_delta <= total_delta) {
-                const unsigned long long active_delta = total_delta - idle_delta;
-                cpu_usage_percent = static_cast<double>(active_delta) * 100.0 / static_cast<double>(total_delta);
+        case kSummaryMemory: {
+            const MemoryInfo memory_info = read_memory_info(memory);
+            const long used_kb =
+                memory_info.total_kb > memory_info.available_kb ? (memory_info.total_kb - memory_info.available_kb) : 0;
+            const long swap_used_kb = memory_info.swap_total_kb > memory_info.swap_free_kb
+                                          ? (memory_info.swap_total_kb - memory_info.swap_free_kb)
+                                          : 0;
+            double memory_usage_percent = 0.0;
+            if (memory_info.total_kb > 0) {
+                memory_usage_percent =
+                    static_cast<double>(used_kb) * 100.0 / static_cast<double>(memory_info.total_kb);
+            }
+            double swap_usage_percent = 0.0;
+            if (memory_info.swap_total_kb > 0) {
+                swap_usage_percent =
+                    static_cast<double>(swap_used_kb) * 100.0 / static_cast<double>(memory_info.swap_total_kb);
             }
+            out += "{\"total_kb\":";
+            common::append_int(out, memory_info.total_kb);
+            out += ",\"available_kb\":";
+            common::append_int(out, memory_info.available_kb);
+            out += ",\"used_kb\":";
+            common::append_int(out, used_kb);
+            out += ",\"usage_percent\":";
+            common::append_fixed(out, memory_usage_percent);
+            out += ",\"free_kb\":";
+            common::append_int(out, memory_info.free_kb);
+            out += ",\"buffers_kb\":";
+            common::append_int(out, memory_info.buffers_kb);
+            out += ",\"cached_kb\":";
+            common::append_int(out, memory_info.cached_kb);
+            out += ",\"swap_total_kb\":";
+            common::append_int(out, memory_info.swap_total_kb);
+            out += ",\"swap_free_kb\":";
+            common::append_int(out, memory_info.swap_free_kb);
+            out += ",\"swap_used_kb\":";
+            common::append_int(out, swap_used_kb);
+            out += ",\"swap_usage_percent\":";
+            common::append_fixed(out, swap_usage_percent);
+            out += '}';
+            break;
         }
-        previous_cpu_total = cpu_times.total;
-        previous_cpu_idle = cpu_times.idle;
-        have_cpu_baseline = true;
+        case kSummaryLoad: {
+            const auto [load_one, load_five, load_fifteen] = read_load_average(memory);
+            out += '[';
+            common::append_fixed(out, load_one);
+            out += ',';
+            common::append_fixed(out, load_five);
+            out += ',';
+            common::append_fixed(out, load_fifteen);
+            out += ']';
+            break;
+        }
+        case kSummaryFilesystems: {
+            const auto disk_info = nanookjaro::hardware::disk::get_disk_info(memory);
+            out += '[';
+            for (std::size_t i = 0; i < disk_info.size(); ++i) {
+                if (i > 0) out += ',';
+                const auto& disk = disk_info[i];
+                out += "{\"mount\":\"";
+                common::append_escaped(out, disk.mount_point);
+                out += "\",\"total_bytes\":";
+                common::append_int(out, disk.total_gb * 1024 * 1024 * 1024);
+                out += ",\"available_bytes\":";
+                common::append_int(out, disk.available_gb * 1024 * 1024 * 1024);
+                out += '}';
+            }
+            out += ']';
+            break;
+        }
+        case kSummaryGpu:
+            out += nanookjaro::hardware::gpu::gpu_info_to_json(nanookjaro::hardware::gpu::get_gpu_info());
+            break;
+        case kSummaryPackages:
+            // Only reported on Arch, where the local pacman database exists.
+            if (access("/etc/arch-release", F_OK) != -1) {
+                const long long package_count = nanookjaro::package_manager::installed_package_count();
+                if (package_count >= 0) {
+                    common::append_int(out, package_count);
+                }
+            }
+            break;
+        case kSummaryNetwork:
+            nanookjaro::network::append_network_interfaces_json(nanookjaro::network::get_network_interfaces(memory),
+                                                                out);
+            break;
+        case kSummaryProxy: {
+            auto append_setting = [&out](const char* env_name) {
+                if (const char* value = std::getenv(env_name)) {
+                    out += '"';
+                    common::append_escaped(out, value);
+                    out += '"';
+                } else {
+                    out += "null";
+                }
+            };
+            out += "{\"http\":";
+            append_setting("http_proxy");
+            out += ",\"https\":";
+            append_setting("https_proxy");
+            out += '}';
+            break;
+        }
+        case kSummarySmart: {
+            bool available = false;
+            const auto health = nanookjaro::hardware::disk::get_disk_health(available);
+            if (available) {
+                out += nanookjaro::hardware::disk::disk_health_to_json(health);
+            }
+            break;
+        }
+        case kSummaryUpdates:
+            if (access("/etc/arch-release", F_OK) != -1) {
+                bool ok = false;
+                const auto pending = nanookjaro::package_manager::find_pending_updates(ok);
+                if (ok) {
+                    std::ostringstream json;
+                    json << '[';
+                    for (std::size_t i = 0; i < pending.size(); ++i) {
+                        if (i > 0) json << ',';
+                        json << '{'
+                             << "\"name\":\"" << common::escape_json(pending[i].name) << "\","
+                             << "\"current\":\"" << common::escape_json(pending[i].current_version) << "\","
+                             << "\"available\":\"" << common::escape_json(pending[i].new_version) << "\","
+                             << "\"repository\":\"" << common::escape_json(pending[i].repository) << "\"}";
+                    }
+                    json << ']';
+                    out += json.str();
+                }
+            }
+            break;
+        default:
+            break;
     }
+}
 
-    const long used_kb = memory.total_kb > memory.available_kb ? (memory.total_kb - memory.available_kb) : 0;
-    const long swap_used_kb =
-        memory.swap_total_kb > memory.swap_free_kb ? (memory.swap_total_kb - memory.swap_free_kb) : 0;
-    double memory_usage_percent = 0.0;
-    if (memory.total_kb > 0) {
-        memory_usage_percent = static_cast<double>(used_kb) * 100.0 / static_cast<double>(memory.total_kb);
-    }
-    double swap_usage_percent = 0.0;
-    if (memory.swap_total_kb > 0) {
-        swap_usage_percent = static_cast<double>(swap_used_kb) * 100.0 / static_cast<double>(memory.swap_total_kb);
+SummarySnapshot collect_summary(unsigned groups, SummaryState& state) {
+    SummarySnapshot snapshot;
+    snapshot.time_ms = unix_time_ms();
+    snapshot.timestamp = summary_timestamp(snapshot.time_ms);
+    snapshot.groups = groups & kSummaryAllGroups;
+    for (std::size_t bit = 0; bit < kSummaryGroupCount; ++bit) {
+        if ((snapshot.groups & (1u << bit)) != 0) {
+            const auto started = std::chrono::steady_clock::now();
+            std::pmr::string value;
+            append_summary_group(1u << bit, state, value);
+            snapshot.values[bit].assign(value);
+            snapshot.latency_us[bit] = static_cast<std::uint32_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started)
+                    .count());
+        }
     }
+    return snapshot;
+}
 
-    std::ostringstream json;
-    json << '{'
-         << "\"timestamp\":\"" << escape_json(timestamp) << "\",";
-    json << "\"cpu\":{"
-        << "\"model\":\"" << escape_json(cpu_model) << "\",";
-    json << "\"cores\":" << cpu_cores << ',';
-    json << "\"usage_percent\":" << std::fixed << std::setprecision(2) << cpu_usage_percent << "},";
-    json << "\"memory\":{"
-         << "\"total_kb\":" << memory.total_kb << ','
-         << "\"available_kb\":" << memory.available_kb << ','
-         << "\"used_kb\":" << used_kb << ','
-         << "\"usage_percent\":" << std::fixed << std::setprecision(2) << memory_usage_percent << ','
-         << "\"free_kb\":" << memory.free_kb << ','
-         << "\"buffers_kb\":" << memory.buffers_kb << ','
-         << "\"cached_kb\":" << memory.cached_kb << ','
-         << "\"swap_total_kb\":" << memory.swap_total_kb << ','
-         << "\"swap_free_kb\":" << memory.swap_free_kb << ','
-         << "\"swap_used_kb\":" << swap_used_kb << ','
-         << "\"swap_usage_percent\":" << std::fixed << std::setprecision(2) << swap_usage_percent << "},";
-    json << "\"load_average\":[" << load_one << ',' << load_five << ',' << load_fifteen << "],";
-    json << "\"filesystems\":[";
-    for (std::size_t i = 0; i < disk_info.size(); ++i) {
-        if (i > 0) json << ',';
-        const auto& disk = disk_info[i];
-        json << '{'
-             << "\"mount\":\"" << escape_json(disk.mount_point) << "\",";
-        json << "\"total_bytes\":" << (disk.total_gb * 1024 * 1024 * 1024) << ',';
-        json << "\"available_bytes\":" << (disk.available_gb * 1024 * 1024 * 1024) << '}';
-    }
-    json << "],";
-    json << "\"gpu\":" << nanookjaro::hardware::gpu::gpu_info_to_json(gpu_info) << ",";
-    
-    if (is_arch_system && package_count >= 0) {
-        json << "\"packages\":" << package_count << ",";
-    }
-    
-    json << "\"network\":" << nanookjaro::network::network_interfaces_to_json(network_info) << ",";
-    
-    json << "\"proxy\":{";
-    json << "\"http\":";
-    if (http_proxy) {
-        json << "\"" << escape_json(*http_proxy) << "\"";
-    } else {
-        json << "null";
+std::string summary_snapshot_json(const SummarySnapshot& snapshot, unsigned groups) {
+    std::pmr::string json;
+    append_summary_snapshot_json(snapshot, groups, json);
+    return std::string(json);
+}
+
+void append_summary_snapshot_json(const SummarySnapshot& snapshot, unsigned groups, std::pmr::string& out) {
+    out += "{\"timestamp\":\"";
+    common::append_escaped(out, snapshot.timestamp);
+    out += "\",\"time_ms\":";
+    common::append_int(out, snapshot.time_ms);
+    const unsigned sent = groups & snapshot.groups;
+    for (std::size_t bit = 0; bit < kSummaryGroupCount; ++bit) {
+        const unsigned group = 1u << bit;
+        if ((sent & group) != 0 && !snapshot.values[bit].empty()) {
+            out += ",\"";
+            out += summary_group_key(group);
+            out += "\":";
+            out += snapshot.values[bit];
+        }
     }
-    json << ",\"https\":";
-    if (https_proxy) {
-        json << "\"" << escape_json(*https_proxy) << "\"";
-    } else {
-        json << "null";
+    out += ",\"latency_us\":{";
+    bool first = true;
+    for (std::size_t bit = 0; bit < kSummaryGroupCount; ++bit) {
+        const unsigned group = 1u << bit;
+        if ((sent & group) != 0 && !snapshot.values[bit].empty()) {
+            out += first ? "\"" : ",\"";
+            out += summary_group_key(group);
+            out += "\":";
+            common::append_uint(out, snapshot.latency_us[bit]);
+            first = false;
+        }
     }
-    json << "}";
-    json << '}';
+    out += "}}";
+}
 
-    return json.str();
+std::string system_summary_json(unsigned groups, SummaryState& state) {
+    return summary_snapshot_json(collect_summary(groups, state), groups);
+}
+
+std::string system_summary_json() {
+    static std::mutex mutex;
+    static SummaryState state;
+    std::lock_guard<std::mutex> lock(mutex);
+    return system_summary_json(kSummaryDefaultGroups, state);
 }
 
 std::string cpu_info_json() {
@@ -465,4 +628,135 @@ std::string drivers_info_json() {
     return nanookjaro::drivers::drivers_to_json(driver_info);
 }
 
+std::string device_drivers_json() {
+    auto devices = nanookjaro::drivers::resolve_device_drivers();
+    return nanookjaro::drivers::device_drivers_to_json(devices);
+}
+
+std::string cgroups_info_json(std::size_t limit) {
+    if (limit == 0) {
+        return nanookjaro::cgroup::cgroups_to_json(nanookjaro::cgroup::get_cgroup_usage());
+    }
+    return nanookjaro::cgroup::cgroups_to_json(nanookjaro::cgroup::get_top_cgroups(limit));
+}
+
+std::string disk_usage_json(const std::string& path, std::size_t top_n) {
+    nanookjaro::hardware::disk::DiskUsageOptions options;
+    if (top_n > 0) {
+        options.top_n = top_n;
+    }
+    const auto report = nanookjaro::hardware::disk::analyze_disk_usage(path.empty() ? "/" : path, options);
+    return nanookjaro::hardware::disk::disk_usage_to_json(report);
+}
+
+std::string disk_usage_index_json(const std::string& path, std::size_t top_n, bool rebuild) {
+    nanookjaro::hardware::disk::DiskUsageOptions options;
+    if (top_n > 0) {
+        options.top_n = top_n;
+    }
+    return nanookjaro::hardware::disk::disk_usage_index_json(path, options, rebuild);
+}
+
+std::string disk_usage_owners_json(const std::string& path, std::size_t top_n) {
+    nanookjaro::hardware::disk::DiskUsageOptions options;
+    if (top_n > 0) {
+        options.top_n = top_n;
+    }
+    // Every counted file is attributed to its first owner while the walk
+    // runs, so the package totals cover the whole tree.
+    const nanookjaro::package_manager::FileOwnershipLookup lookup;
+    std::vector<std::atomic<unsigned long long>> package_bytes(lookup.package_count());
+    std::vector<std::atomic<unsigned long long>> package_files(lookup.package_count());
+    std::atomic<unsigned long long> unowned_bytes{0};
+    options.on_file = [&](std::string_view file, unsigned long long bytes) {
+        const std::uint32_t id = lookup.first_owner(file);
+        if (id == nanookjaro::package_manager::FileOwnershipLookup::kUnowned) {
+            unowned_bytes.fetch_add(bytes, std::memory_order_relaxed);
+            return;
+        }
+        package_bytes[id].fetch_add(bytes, std::memory_order_relaxed);
+        package_files[id].fetch_add(1, std::memory_order_relaxed);
+    };
+    const auto report = nanookjaro::hardware::disk::analyze_disk_usage(path.empty() ? "/" : path, options);
+
+    std::vector<std::string> paths;
+    for (const auto& entry : report.largest_directories) {
+        paths.push_back(entry.path);
+    }
+    for (const auto& entry : report.largest_files) {
+        paths.push_back(entry.path);
+    }
+    const auto ownership = nanookjaro::package_manager::find_file_owners(paths);
+
+    // Shared directories can have hundreds of owners; list a few and count
+    // the rest.
+    constexpr std::size_t kListedOwners = 8;
+    auto entries_json = [&](std::ostringstream& json, const auto& entries, std::size_t first) {
+        json << "[";
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (i > 0) json << ",";
+            const auto& owners = ownership.owners[first + i].packages;
+            json << "{\"path\":\"" << common::escape_json(entries[i].path) << "\",";
+            json << "\"bytes\":" << entries[i].bytes << ",";
+            json << "\"owner_count\":" << owners.size() << ",";
+            json << "\"owners\":[";
+            for (size_t j = 0; j < owners.size() && j < kListedOwners; ++j) {
+                if (j > 0) json << ",";
+                json << "\"" << common::escape_json(owners[j]) << "\"";
+            }
+            json << "]}";
+        }
+        json << "]";
+    };
+
+    std::vector<std::pair<std::string, std::pair<unsigned long long, unsigned long long>>> packages;
+    for (std::uint32_t id = 0; id < package_files.size(); ++id) {
+        const unsigned long long files = package_files[id].load(std::memory_order_relaxed);
+        if (files > 0) {
+            packages.push_back({lookup.package_name(id), {package_bytes[id].load(std::memory_order_relaxed), files}});
+        }
+    }
+    std::sort(packages.begin(), packages.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.second.first > rhs.second.first; });
+
+    std::ostringstream json;
+    json << "{";
+    json << "\"usage\":" << nanookjaro::hardware::disk::disk_usage_to_json(report) << ",";
+    json << "\"ownership\":{";
+    json << "\"valid\":" << (ownership.valid ? "true" : "false") << ",";
+    json << "\"source\":\"" << ownership.source << "\",";
+    json << "\"packages\":" << ownership.packages << ",";
+    json << "\"paths\":" << ownership.paths << ",";
+    json << "\"open_ms\":" << std::fixed << std::setprecision(2) << ownership.open_ms << ",";
+    json << "\"lookup_ms\":" << std::fixed << std::setprecision(3) << ownership.lookup_ms;
+    json << "},";
+    json << "\"directories\":";
+    entries_json(json, report.largest_directories, 0);
+    json << ",\"files\":";
+    entries_json(json, report.largest_files, report.largest_directories.size());
+    json << ",\"packages\":[";
+    for (size_t i = 0; i < packages.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "{\"name\":\"" << common::escape_json(packages[i].first) << "\",";
+        json << "\"bytes\":" << packages[i].second.first << ",";
+        json << "\"files\":" << packages[i].second.second << "}";
+    }
+    json << "],";
+    json << "\"unowned_bytes\":" << unowned_bytes.load(std::memory_order_relaxed);
+    json << "}";
+    return json.str();
+}
+
+std::string duplicates_json(const std::string& path, std::size_t max_groups, unsigned long long min_size) {
+    nanookjaro::hardware::disk::DuplicateOptions options;
+    if (max_groups > 0) {
+        options.max_groups = max_groups;
+    }
+    if (min_size > 0) {
+        options.min_size = min_size;
+    }
+    const auto report = nanookjaro::hardware::disk::find_duplicates(path.empty() ? "/" : path, options);
+    return nanookjaro::hardware::disk::duplicates_to_json(report);
+}
+
 } // namespace nanookjaro
@@ -1,10 +1,76 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
 #include <string>
 
 namespace nanookjaro {
 
+// Metric groups of the system summary, usable as a bit mask. Bits follow
+// the order of the keys in the summary object.
+enum SummaryGroup : unsigned {
+    kSummaryCpu = 1u << 0,          // "cpu": model, cores, usage_percent
+    kSummaryMemory = 1u << 1,       // "memory"
+    kSummaryLoad = 1u << 2,         // "load_average"
+    kSummaryFilesystems = 1u << 3,  // "filesystems"
+    kSummaryGpu = 1u << 4,          // "gpu"
+    kSummaryPackages = 1u << 5,     // "packages" (Arch only)
+    kSummaryNetwork = 1u << 6,      // "network"
+    kSummaryProxy = 1u << 7,        // "proxy"
+    kSummarySmart = 1u << 8,        // "smart": disk health (needs smartctl)
+    kSummaryUpdates = 1u << 9,      // "updates": pending package updates (Arch only)
+};
+inline constexpr unsigned kSummaryAllGroups = 0x3ffu;
+// Groups of system_summary_json(); the slow disk health and update checks
+// are only collected on request.
+inline constexpr unsigned kSummaryDefaultGroups = 0xffu;
+
+// CPU usage is the delta between two readings; every independent consumer
+// of the summary keeps its own baseline.
+struct SummaryState {
+    unsigned long long cpu_total = 0;
+    unsigned long long cpu_idle = 0;
+    bool have_cpu_baseline = false;
+    std::string cpu_model;  // read from /proc/cpuinfo once
+};
+
+inline constexpr std::size_t kSummaryGroupCount = 10;
+
+// Group values collected once, so summaries of different subsets can be
+// assembled from the same sample.
+struct SummarySnapshot {
+    std::string timestamp;  // ISO 8601, whole seconds
+    std::int64_t time_ms = 0;  // Unix milliseconds the sample was taken for
+    unsigned groups = 0;
+    std::array<std::string, kSummaryGroupCount> values;  // indexed by bit position
+    std::array<std::uint32_t, kSummaryGroupCount> latency_us{};  // collection time of each value
+};
+
+// Full summary, with a process-wide CPU baseline.
 std::string system_summary_json();
+// Summary restricted to `groups`; "timestamp" is always present.
+std::string system_summary_json(unsigned groups, SummaryState& state);
+SummarySnapshot collect_summary(unsigned groups, SummaryState& state);
+// The summary object for the `groups` of `snapshot` that were collected,
+// with "time_ms" and the collection latency of each group in "latency_us".
+std::string summary_snapshot_json(const SummarySnapshot& snapshot, unsigned groups);
+void append_summary_snapshot_json(const SummarySnapshot& snapshot, unsigned groups, std::pmr::string& out);
+// ISO 8601 UTC time, whole seconds, as used for "timestamp". The second
+// form reuses the capacity of `out`.
+std::string summary_timestamp(std::int64_t unix_ms);
+void summary_timestamp(std::int64_t unix_ms, std::string& out);
+// Object key and JSON value of a single group. The value is empty when the
+// group does not apply to this system (packages outside Arch, smart
+// without smartctl).
+const char* summary_group_key(unsigned group);
+std::string summary_group_json(unsigned group, SummaryState& state);
+// Appends the value of `group` to `out`. The frequent collectors (cpu,
+// memory, load_average, filesystems, network, proxy) take every temporary
+// from the resource of `out`; the others (gpu, packages, smart, updates)
+// run external tools or parse the package database and still allocate.
+void append_summary_group(unsigned group, SummaryState& state, std::pmr::string& out);
 std::string set_proxy_config_json(const std::string& http_proxy, const std::string& https_proxy);
 
 // Individual component functions
@@ -14,5 +80,21 @@ std::string memory_info_json();
 std::string disk_info_json();
 std::string network_info_json();
 std::string drivers_info_json();
+std::string device_drivers_json();
+
+// Per-cgroup resource accounting; limit == 0 returns the whole hierarchy in
+// tree order, otherwise the top `limit` slices/services/containers.
+std::string cgroups_info_json(std::size_t limit);
+
+// "What is using space" scan of `path` (see hardware/disk_usage.hpp).
+std::string disk_usage_json(const std::string& path, std::size_t top_n);
+// Same report served from the persisted, watched index (see
+// hardware/disk_usage_index.hpp).
+std::string disk_usage_index_json(const std::string& path, std::size_t top_n, bool rebuild);
+// disk_usage_json() with the largest directories and files attributed to
+// the packages that own them (see maintenance/file_ownership.hpp).
+std::string disk_usage_owners_json(const std::string& path, std::size_t top_n);
+// Duplicate files below `path` (see hardware/duplicate_finder.hpp).
+std::string duplicates_json(const std::string& path, std::size_t max_groups, unsigned long long min_size);
 
 }
@@ -0,0 +1,105 @@
+#include "../src/maintenance/dependency_graph.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace nanookjaro::package_manager;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, std::string_view what) {
+    if (!ok) {
+        std::cerr << "failed: " << what << std::endl;
+        ++failures;
+    }
+}
+
+void check_specs() {
+    const DependencySpec versioned = parse_dependency("glibc>=2.38");
+    expect(versioned.name == "glibc" && versioned.op == ">=" && versioned.version == "2.38", "glibc>=2.38 splits");
+    const DependencySpec optional = parse_dependency("optlib: extra formats");
+    expect(optional.name == "optlib" && optional.op.empty(), "optdepends descriptions are dropped");
+    expect(version_satisfies(versioned, "2.38-1") && version_satisfies(versioned, "1:2.0-1") &&
+               !version_satisfies(versioned, "2.37-5"),
+           "version_satisfies() orders like vercmp");
+}
+
+// A local database entry; `sections` are appended to desc verbatim.
+void add_package(const fs::path& local, const std::string& name, const std::string& version, bool explicitly,
+                 const std::string& sections = {}) {
+    const fs::path entry = local / (name + "-" + version);
+    fs::create_directories(entry);
+    std::ofstream desc(entry / "desc");
+    desc << "%NAME%\n" << name << "\n\n%VERSION%\n" << version << "\n\n%SIZE%\n1000\n\n";
+    if (!explicitly) {
+        desc << "%REASON%\n1\n\n";
+    }
+    desc << sections;
+}
+
+std::vector<std::string> names(const DependencyGraph& graph, auto&& ids) {
+    std::vector<std::string> result;
+    for (const std::uint32_t id : ids) {
+        result.emplace_back(graph.name(id));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+using Names = std::vector<std::string>;
+
+void check_graph(const fs::path& db) {
+    const fs::path local = db / "local";
+    fs::create_directories(local);
+    std::ofstream(local / "ALPM_DB_VERSION") << "9\n";
+    add_package(local, "app", "1.0-1", true,
+                "%DEPENDS%\nlibfoo>=2.0\nsh\n\n%OPTDEPENDS%\noptlib: extra formats\n\n");
+    add_package(local, "libfoo", "2.1-1", false, "%DEPENDS%\nlibbase\n\n");
+    add_package(local, "libbase", "1.0-1", false);
+    add_package(local, "bash", "5.2-1", true, "%PROVIDES%\nsh=5.2\n\n");
+    add_package(local, "optlib", "1.0-1", false);
+    add_package(local, "stale", "1.0-1", false);
+    add_package(local, "legacy", "1.0-1", true, "%DEPENDS%\nlibfoo<2\n\n");
+
+    const auto graph = local_dependency_graph(db.string());
+    expect(graph->size() == 7, "every installed package is a node");
+    expect(graph->unresolved_count() == 1, "libfoo<2 is not satisfied by libfoo 2.1");
+    const std::uint32_t app = graph->find("app");
+    const std::uint32_t libbase = graph->find("libbase");
+    expect(graph->find("sh") == graph->find("bash"), "virtual names resolve to their provider");
+    expect(graph->find("missing") == DependencyGraph::kNotFound, "unknown names are not found");
+    expect(names(*graph, graph->depends(app)) == Names{"bash", "libfoo"}, "direct dependencies");
+    expect(names(*graph, graph->required_by(libbase)) == Names{"libfoo"}, "reverse dependencies");
+    expect(names(*graph, graph->orphans()) == Names{"optlib", "stale"},
+           "orphans ignore optional dependencies (pacman -Qdtt)");
+    expect(names(*graph, graph->reverse_closure(libbase)) == Names{"app", "libfoo"}, "transitive requirers");
+    expect(names(*graph, graph->removable_with(app)) == Names{"app", "libbase", "libfoo"},
+           "removing app takes its private dependencies but not explicit ones");
+}
+
+}
+
+int main() {
+    check_specs();
+
+    std::string root_template = (fs::temp_directory_path() / "nanookjaro-deps-XXXXXX").string();
+    if (!mkdtemp(root_template.data())) {
+        std::cerr << "mkdtemp failed" << std::endl;
+        return 1;
+    }
+    const fs::path root = root_template;
+    check_graph(root);
+    fs::remove_all(root);
+
+    std::cout << "{\"failures\":" << failures << "}" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
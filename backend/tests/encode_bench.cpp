@@ -0,0 +1,173 @@
+#include "../src/common/fields.hpp"
+#include "../src/hardware/cpu_monitor.hpp"
+#include "../src/network/network_monitor.hpp"
+#include "../src/performance/performance_monitor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Times the encoders generated from the metric field descriptors (JSON into
+// a fresh and a reused string, CSV, binary) against the hand-written JSON
+// serializers they replaced. Usage: encode_bench [iterations]
+
+namespace {
+
+// The hand-written serializers the field descriptors replaced, kept as the
+// baseline.
+std::string handwritten_cpu_info_json(const nanookjaro::hardware::cpu::CpuInfo& info) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"model\":\"" << info.model << "\",";
+    json << "\"cores\":" << info.cores << ",";
+    json << "\"threads\":" << info.threads << ",";
+    json << "\"base_frequency_ghz\":" << std::fixed << std::setprecision(2) << info.base_frequency_ghz << ",";
+    json << "\"current_frequency_ghz\":" << std::fixed << std::setprecision(2) << info.current_frequency_ghz << ",";
+    json << "\"temperature_celsius\":" << std::fixed << std::setprecision(2) << info.temperature_celsius << ",";
+    json << "\"cache_l1_kb\":" << info.cache_l1_kb << ",";
+    json << "\"cache_l2_kb\":" << info.cache_l2_kb << ",";
+    json << "\"cache_l3_kb\":" << info.cache_l3_kb;
+    json << "}";
+    return json.str();
+}
+
+std::string handwritten_network_json(const std::pmr::vector<nanookjaro::network::NetworkInterface>& interfaces) {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(2);
+    json << "[";
+    for (size_t i = 0; i < interfaces.size(); ++i) {
+        if (i > 0) json << ",";
+        const auto& interface = interfaces[i];
+        json << "{";
+        json << "\"name\":\"" << interface.name << "\",";
+        json << "\"mac_address\":\"" << interface.mac_address << "\",";
+        json << "\"ipv4_address\":\"" << interface.ipv4_address << "\",";
+        json << "\"ipv6_address\":\"" << interface.ipv6_address << "\",";
+        json << "\"rx_rate_kbps\":" << interface.rx_rate_kbps << ",";
+        json << "\"tx_rate_kbps\":" << interface.tx_rate_kbps << ",";
+        json << "\"is_up\":" << (interface.is_up ? "true" : "false");
+        json << "}";
+    }
+    json << "]";
+    return json.str();
+}
+
+std::string handwritten_history_json(const std::vector<nanookjaro::performance::PerformanceSample>& samples) {
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (i > 0) json << ",";
+        const auto& sample = samples[i];
+        json << "{";
+        json << "\"timestamp\":" << sample.timestamp << ",";
+        json << "\"cpu_usage_percent\":" << sample.cpu_usage_percent << ",";
+        json << "\"memory_usage_percent\":" << sample.memory_usage_percent << ",";
+        json << "\"disk_read_kbps\":" << sample.disk_read_kbps << ",";
+        json << "\"disk_write_kbps\":" << sample.disk_write_kbps << ",";
+        json << "\"network_rx_kbps\":" << sample.network_rx_kbps << ",";
+        json << "\"network_tx_kbps\":" << sample.network_tx_kbps;
+        json << "}";
+    }
+    json << "]";
+    return json.str();
+}
+
+// Mean nanoseconds per call of `encode` over `iterations` calls. The sizes
+// it returns are summed so the work cannot be optimized away.
+template <typename Encode>
+double time_encoder(long iterations, std::size_t& sink, Encode&& encode) {
+    const auto started = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        sink += encode();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations);
+}
+
+// One output line for `values` (a single struct or a container).
+template <typename Values, typename Handwritten>
+void bench_encoders(const char* name, const Values& values, long iterations, Handwritten&& handwritten) {
+    using namespace nanookjaro;
+    constexpr bool kSingle = common::Described<Values>;
+    std::size_t sink = 0;
+    std::pmr::string reused;
+    const double handwritten_ns = time_encoder(iterations, sink, [&] { return handwritten(values).size(); });
+    const double generated_ns = time_encoder(iterations, sink, [&] {
+        if constexpr (kSingle) {
+            return common::to_json(values).size();
+        } else {
+            return common::to_json_array(values).size();
+        }
+    });
+    const double reused_ns = time_encoder(iterations, sink, [&] {
+        reused.clear();
+        if constexpr (kSingle) {
+            common::append_json(values, reused);
+        } else {
+            common::append_json_array(values, reused);
+        }
+        return reused.size();
+    });
+    const std::size_t json_bytes = reused.size();
+    const double csv_ns = time_encoder(iterations, sink, [&] {
+        reused.clear();
+        if constexpr (kSingle) {
+            common::append_csv_row(values, reused);
+        } else {
+            common::append_csv(values, reused);
+        }
+        return reused.size();
+    });
+    const std::size_t csv_bytes = reused.size();
+    const double binary_ns = time_encoder(iterations, sink, [&] {
+        reused.clear();
+        if constexpr (kSingle) {
+            common::append_binary(values, reused);
+        } else {
+            for (const auto& value : values) {
+                common::append_binary(value, reused);
+            }
+        }
+        return reused.size();
+    });
+    std::cout << "{\"struct\":\"" << name << "\",\"iterations\":" << iterations
+              << ",\"handwritten_json_ns\":" << handwritten_ns << ",\"generated_json_ns\":" << generated_ns
+              << ",\"generated_json_reused_ns\":" << reused_ns << ",\"csv_ns\":" << csv_ns
+              << ",\"binary_ns\":" << binary_ns << ",\"speedup\":" << handwritten_ns / generated_ns
+              << ",\"json_bytes\":" << json_bytes << ",\"csv_bytes\":" << csv_bytes
+              << ",\"checksum\":" << sink % 1000 << "}" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    // Fixed inputs, so runs on different machines are comparable.
+    const long iterations = argc >= 2 ? std::max(std::stol(argv[1]), 1L) : 200000;
+    nanookjaro::hardware::cpu::CpuInfo cpu{"AMD Ryzen 7 7840U w/ Radeon 780M Graphics", 8, 16, 3.3, 4.71,
+                                           52.5, 512, 8192, 16384};
+    std::pmr::vector<nanookjaro::network::NetworkInterface> interfaces;
+    for (int i = 0; i < 8; ++i) {
+        auto& interface = interfaces.emplace_back();
+        interface.name = i == 0 ? "wlp1s0" : i == 1 ? "enp2s0" : "veth0a1b2c3";
+        interface.mac_address = "3c:7c:3f:1e:92:0" + std::to_string(i);
+        interface.ipv4_address = i < 2 ? "192.168.1.4" + std::to_string(i) : "N/A";
+        interface.ipv6_address = i < 2 ? "fe80::3e7c:3fff:fe1e:920" + std::to_string(i) : "N/A";
+        interface.rx_rate_kbps = 1234.5678 * i;
+        interface.tx_rate_kbps = 87.25 * i;
+        interface.is_up = i < 2;
+    }
+    std::vector<nanookjaro::performance::PerformanceSample> history;
+    for (int i = 0; i < 600; ++i) {
+        history.push_back({1792400000.0 + i, 12.5 + i % 50, 41.75, 512.0 * (i % 7), 96.5, 1480.125, 33.0});
+    }
+    std::cout << std::fixed << std::setprecision(1);
+    bench_encoders("CpuInfo", cpu, iterations, handwritten_cpu_info_json);
+    bench_encoders("NetworkInterface[8]", interfaces, std::max(iterations / 8, 1L), handwritten_network_json);
+    bench_encoders("PerformanceSample[600]", history, std::max(iterations / 600, 1L), handwritten_history_json);
+    return 0;
+}
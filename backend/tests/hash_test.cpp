@@ -0,0 +1,78 @@
+#include "../src/common/hash.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, std::string_view what) {
+    if (!ok) {
+        std::cerr << "failed: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// Digests from the xxHash reference implementation.
+void check_xxh64() {
+    using nanookjaro::common::xxh64;
+    expect(xxh64("") == 0xef46db3751d8e999ULL, "xxh64 of the empty string");
+    expect(xxh64("a") == 0xd24ec4f1a98c6e5bULL, "xxh64 of \"a\"");
+    expect(xxh64("abc") == 0x44bc2cf5ad770999ULL, "xxh64 of \"abc\"");
+    expect(xxh64("The quick brown fox jumps over the lazy dog") == 0x0b242d361fda71bcULL,
+           "xxh64 of a 43-byte string (stripe loop)");
+
+    // Fed in uneven pieces the streaming digest must match the one-shot one.
+    std::string data(1000, '\0');
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i * 31 + 7);
+    }
+    for (const std::size_t piece : {1, 7, 31, 32, 33, 100}) {
+        nanookjaro::common::Xxh64 hasher(42);
+        for (std::size_t offset = 0; offset < data.size(); offset += piece) {
+            hasher.update(data.data() + offset, std::min(piece, data.size() - offset));
+        }
+        expect(hasher.digest() == xxh64(data, 42), "xxh64 streamed in pieces of " + std::to_string(piece));
+    }
+}
+
+std::string sha256_hex(std::string_view text) {
+    using nanookjaro::common::Sha256;
+    return Sha256::to_hex(nanookjaro::common::sha256(text.data(), text.size()));
+}
+
+// FIPS 180-4 examples. The x86 SHA extensions are used when the CPU has
+// them, so on such machines this checks that path.
+void check_sha256() {
+    expect(sha256_hex("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+           "sha256 of the empty string");
+    expect(sha256_hex("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+           "sha256 of \"abc\"");
+    expect(sha256_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+               "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+           "sha256 of the two-block message");
+
+    const std::string million(1000000, 'a');
+    for (const std::size_t piece : {1000000, 63, 64, 65}) {
+        nanookjaro::common::Sha256 hasher;
+        for (std::size_t offset = 0; offset < million.size(); offset += piece) {
+            hasher.update(million.data() + offset, std::min(piece, million.size() - offset));
+        }
+        expect(nanookjaro::common::Sha256::to_hex(hasher.digest()) ==
+                   "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+               "sha256 of a million 'a' in pieces of " + std::to_string(piece));
+    }
+}
+
+}
+
+int main() {
+    check_xxh64();
+    check_sha256();
+    std::cout << "{\"failures\":" << failures << "}" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
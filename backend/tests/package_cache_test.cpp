@@ -0,0 +1,137 @@
+#include "../src/maintenance/package_cache.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+using namespace nanookjaro::package_manager;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, std::string_view what) {
+    if (!ok) {
+        std::cerr << "failed: " << what << std::endl;
+        ++failures;
+    }
+}
+
+void check_filenames() {
+    struct Case {
+        const char* filename;
+        bool valid;
+        const char* name;
+        const char* version;
+        const char* arch;
+    };
+    constexpr Case kCases[] = {
+        {"foo-1.0-1-x86_64.pkg.tar.zst", true, "foo", "1.0-1", "x86_64"},
+        {"lib32-glibc-2:2.38-3-x86_64.pkg.tar.xz", true, "lib32-glibc", "2:2.38-3", "x86_64"},
+        {"foo-1.0-1-any.pkg.tar", true, "foo", "1.0-1", "any"},
+        {"foo-1.0-1-x86_64.pkg.tar.zst.part", false, "", "", ""},
+        {"foo-1.0-1-x86_64.pkg.tar.zst.sig", false, "", "", ""},
+        {"foo-1.0-x86_64.pkg.tar.zst", false, "", "", ""},
+        {"-1.0-1-x86_64.pkg.tar.zst", false, "", "", ""},
+        {"download-a1b2c3", false, "", "", ""},
+    };
+    for (const Case& c : kCases) {
+        PackageFileName parsed;
+        const bool valid = parse_package_filename(c.filename, parsed);
+        expect(valid == c.valid && (!valid || (parsed.name == c.name && parsed.version == c.version &&
+                                               parsed.arch == c.arch)),
+               std::string("parse_package_filename(") + c.filename + ")");
+    }
+}
+
+void write_file(const fs::path& path, std::size_t bytes) {
+    std::ofstream(path) << std::string(bytes, 'x');
+}
+
+const CachedPackageFile* candidate(const PackageCacheReport& report, std::string_view filename) {
+    const auto it = std::find_if(report.candidates.begin(), report.candidates.end(),
+                                 [&](const CachedPackageFile& file) { return file.filename == filename; });
+    return it != report.candidates.end() ? &*it : nullptr;
+}
+
+// A cache with old versions, an uninstalled package, a .part download, an
+// orphaned .sig and one of pacman's download-* directories.
+void check_cache(const fs::path& root) {
+    const fs::path cache = root / "pkg";
+    const fs::path db = root / "db";
+    fs::create_directories(cache / "download-a1b2c3");
+    fs::create_directories(db / "local" / "foo-2.0-1");
+    std::ofstream(db / "local" / "ALPM_DB_VERSION") << "9\n";
+    std::ofstream(db / "local" / "foo-2.0-1" / "desc") << "%NAME%\nfoo\n\n%VERSION%\n2.0-1\n\n";
+
+    write_file(cache / "foo-1.0-1-x86_64.pkg.tar.zst", 1000);
+    write_file(cache / "foo-1.0-1-x86_64.pkg.tar.zst.sig", 10);
+    write_file(cache / "foo-2.0-1-x86_64.pkg.tar.zst", 2000);
+    write_file(cache / "foo-3.0-1-x86_64.pkg.tar.zst", 3000);
+    write_file(cache / "bar-1.0-1-any.pkg.tar.zst", 400);
+    write_file(cache / "foo-4.0-1-x86_64.pkg.tar.zst.part", 50);
+    write_file(cache / "baz-1-1-any.pkg.tar.zst.sig", 5);
+    write_file(cache / "download-a1b2c3" / "foo-4.0-1-x86_64.pkg.tar.zst.part", 70);
+
+    PackageCacheOptions options;
+    options.directories = {cache.string()};
+    options.db_path = db.string();
+    options.keep_versions = 1;
+
+    PackageCacheReport report = analyze_package_cache(options);
+    expect(report.valid && report.errors == 0, "the cache is readable");
+    expect(report.packages == 2 && report.partial_files == 3 && report.partial_bytes == 125,
+           "archives, partial downloads and orphaned signatures are told apart");
+    const CachedPackageFile* old_version = candidate(report, "foo-1.0-1-x86_64.pkg.tar.zst");
+    expect(old_version && old_version->reason == "old-version" && old_version->has_signature &&
+               old_version->bytes == 1010,
+           "an old version is a candidate together with its signature");
+    expect(!candidate(report, "foo-2.0-1-x86_64.pkg.tar.zst") && !candidate(report, "foo-3.0-1-x86_64.pkg.tar.zst"),
+           "the installed and the newest version are kept");
+    const CachedPackageFile* uninstalled = candidate(report, "bar-1.0-1-any.pkg.tar.zst");
+    expect(uninstalled && uninstalled->reason == "uninstalled", "an uninstalled package is a candidate");
+    expect(report.candidates.size() == 2, "partial downloads are only counted by default");
+
+    options.remove_partials = true;
+    std::ofstream(db / "db.lck");
+    report = analyze_package_cache(options);
+    expect(report.database_locked && report.candidates.size() == 2, "partials are kept while db.lck exists");
+
+    fs::remove(db / "db.lck");
+    report = prune_package_cache(options);
+    expect(report.candidates.size() == 5 && report.removed_files == 5 && report.errors == 0,
+           "old, uninstalled and partial files are pruned");
+    const CachedPackageFile* directory = candidate(report, "download-a1b2c3");
+    expect(directory && directory->reason == "partial" && directory->bytes == 70,
+           "a download-* directory counts with its contents");
+    const CachedPackageFile* signature = candidate(report, "baz-1-1-any.pkg.tar.zst.sig");
+    expect(signature && signature->reason == "orphan-signature", "a signature without an archive is an orphan");
+    expect(!fs::exists(cache / "download-a1b2c3") && !fs::exists(cache / "foo-1.0-1-x86_64.pkg.tar.zst.sig") &&
+               !fs::exists(cache / "foo-4.0-1-x86_64.pkg.tar.zst.part"),
+           "pruned files and directories are gone");
+    expect(fs::exists(cache / "foo-2.0-1-x86_64.pkg.tar.zst") && fs::exists(cache / "foo-3.0-1-x86_64.pkg.tar.zst"),
+           "kept archives remain");
+}
+
+}
+
+int main() {
+    check_filenames();
+
+    std::string root_template = (fs::temp_directory_path() / "nanookjaro-cache-XXXXXX").string();
+    if (!mkdtemp(root_template.data())) {
+        std::cerr << "mkdtemp failed" << std::endl;
+        return 1;
+    }
+    const fs::path root = root_template;
+    check_cache(root);
+    fs::remove_all(root);
+
+    std::cout << "{\"failures\":" << failures << "}" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include "../src/maintenance/pacman_log.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+using namespace nanookjaro::package_manager;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, std::string_view what) {
+    if (!ok) {
+        std::cerr << "failed: " << what << std::endl;
+        ++failures;
+    }
+}
+
+constexpr std::string_view kOldLog =
+    "[2012-11-30 09:15] installed foo (1.0-1)\n"
+    "[2012-11-30 09:15] installed bar (2.0-1)\n"
+    "[2012-12-01 10:00] [PACMAN] synchronizing package lists\n";
+
+constexpr std::string_view kTransaction =
+    "[2024-01-02T10:00:00+0100] [PACMAN] Running 'pacman -Syu'\n"
+    "[2024-01-02T10:00:01+0100] [ALPM] transaction started\n"
+    "[2024-01-02T10:00:02+0100] [ALPM] upgraded foo (1.0-1 -> 1.1-1)\n"
+    "[2024-01-02T10:00:02+0100] [ALPM] removed bar (2.0-1)\n"
+    "[2024-01-02T10:00:03+0100] [ALPM] transaction completed\n";
+
+// Old logs without transaction markers, a newer transaction with a
+// timezone offset, then an append that must be parsed incrementally.
+void check_index(const fs::path& log) {
+    std::ofstream(log) << kOldLog << kTransaction;
+    auto index = pacman_log_index(log.string());
+    expect(index->valid() && index->size() == 4, "four package records");
+    expect(index->transactions().size() == 2, "an implicit and a marked transaction");
+    if (index->transactions().size() == 2) {
+        const LogTransaction& implicit = index->transactions()[0];
+        const LogTransaction& marked = index->transactions()[1];
+        expect(implicit.state == "implicit" && implicit.record_count == 2, "consecutive old records form one");
+        expect(marked.state == "completed" && marked.command == "pacman -Syu" && marked.record_count == 2,
+               "a marked transaction keeps its command and records");
+        expect(marked.started == 1704186001, "timestamps honour the UTC offset");
+    }
+    const auto foo = index->package_records("foo");
+    expect(foo.size() == 2 && index->action(foo[1]) == LogAction::upgraded && index->old_version(foo[1]) == "1.0-1" &&
+               index->new_version(foo[1]) == "1.1-1",
+           "an upgrade records both versions");
+    const auto bar = index->package_records("bar");
+    expect(bar.size() == 2 && index->action(bar[1]) == LogAction::removed && index->old_version(bar[1]) == "2.0-1" &&
+               index->new_version(bar[1]).empty(),
+           "a removal records the old version");
+    expect(index->package_records("baz").empty(), "unknown packages have no records");
+
+    const std::uint64_t indexed = index->bytes_indexed();
+    std::ofstream(log, std::ios::app) << "[2024-02-01T08:00:00+0000] [ALPM] transaction started\n"
+                                      << "[2024-02-01T08:00:01+0000] [ALPM] installed baz (0.1-1)\n"
+                                      << "[2024-02-01T08:00:02+0000] [ALPM] transaction completed\n"
+                                      << "[2024-02-01T08:00:03+0000] [ALPM] installed partial";
+    index = pacman_log_index(log.string());
+    expect(index->size() == 5 && index->package_records("baz").size() == 1, "appended records are indexed");
+    expect(index->last_parsed_bytes() < index->bytes_indexed() && index->bytes_indexed() > indexed,
+           "only the appended lines are parsed");
+    expect(index->first_transaction_since(1706774400) == 2, "transactions are found by start time");
+
+    // A rewritten log is indexed again from the start.
+    std::ofstream(log) << kTransaction;
+    index = pacman_log_index(log.string());
+    expect(index->size() == 2 && index->transactions().size() == 1, "a rewritten log is indexed from scratch");
+
+    // Commands are copied from the log as they are; control characters
+    // must come out escaped.
+    std::ofstream(log) << "[2024-03-01T08:00:00+0000] [PACMAN] Running 'pacman -S \x1b[1mfoo'\n"
+                       << "[2024-03-01T08:00:01+0000] [ALPM] transaction started\n"
+                       << "[2024-03-01T08:00:02+0000] [ALPM] installed foo (1.0-1)\n";
+    index = pacman_log_index(log.string());
+    const std::string json = pacman_log_history_to_json(*index, "", 0, 10);
+    expect(json.find("pacman -S \\u001b[1mfoo") != std::string::npos && json.find('\x1b') == std::string::npos,
+           "control characters in the history JSON are escaped");
+}
+
+}
+
+int main() {
+    std::string root_template = (fs::temp_directory_path() / "nanookjaro-log-XXXXXX").string();
+    if (!mkdtemp(root_template.data())) {
+        std::cerr << "mkdtemp failed" << std::endl;
+        return 1;
+    }
+    const fs::path root = root_template;
+    check_index(root / "pacman.log");
+    fs::remove_all(root);
+
+    std::cout << "{\"failures\":" << failures << "}" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#include "../src/system/metrics_sampler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+
+// Every heap allocation of the process. Replacing the global operator new
+// in the executable also covers the library, which resolves it from here.
+static std::atomic<unsigned long long> heap_allocations{0};
+
+void* operator new(std::size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+namespace {
+
+std::atomic<long> payloads{0};
+
+void count_payload(std::int64_t, const char*, void*) {
+    ++payloads;
+}
+
+}
+
+// One whole-summary and one delta subscriber at 10 Hz must not allocate once
+// the per-tick arena has grown to fit. Collectors that had not run yet and
+// buffers still growing are left to the warm-up.
+int main(int argc, char** argv) {
+    using namespace nanookjaro;
+    const int seconds = argc >= 2 ? std::max(std::atoi(argv[1]), 1) : 5;
+    const unsigned mask = 0xcfu;  // cpu, memory, load, filesystems, network, proxy
+
+    const auto whole = metrics::subscribe(mask, 100, count_payload, nullptr);
+    const auto delta = metrics::subscribe(mask | metrics::kSubscribeDelta, 100, count_payload, nullptr);
+    if (whole < 0 || delta < 0) {
+        std::cerr << "subscribe failed" << std::endl;
+        return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+    const long delivered = payloads.load();
+    const unsigned long long before = heap_allocations.load();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    const unsigned long long allocations = heap_allocations.load() - before;
+    const long count = payloads.load() - delivered;
+    metrics::unsubscribe(whole);
+    metrics::unsubscribe(delta);
+
+    std::cout << "{\"seconds\":" << seconds << ",\"payloads\":" << count << ",\"allocations\":" << allocations
+              << "}" << std::endl;
+    if (count == 0) {
+        std::cerr << "no payloads delivered" << std::endl;
+        return 1;
+    }
+    return allocations == 0 ? 0 : 1;
+}
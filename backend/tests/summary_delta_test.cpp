@@ -0,0 +1,213 @@
+#include "../src/system/summary_delta.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using nanookjaro::SummaryDelta;
+using nanookjaro::SummarySnapshot;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, std::string_view what) {
+    if (!ok) {
+        std::cerr << "failed: " << what << std::endl;
+        ++failures;
+    }
+}
+
+using Members = std::vector<std::pair<std::string, std::string>>;
+
+// Top-level members of compact JSON: raw keys (empty for array elements)
+// and value texts.
+Members split(std::string_view json) {
+    Members members;
+    const bool object = json.front() == '{';
+    std::size_t pos = 1;
+    while (pos + 1 < json.size()) {
+        std::string key;
+        if (object) {
+            const std::size_t close = json.find('"', pos + 1);
+            key = json.substr(pos + 1, close - pos - 1);
+            pos = close + 2;  // past '"' and ':'
+        }
+        int depth = 0;
+        std::size_t end = pos;
+        for (; end < json.size(); ++end) {
+            const char c = json[end];
+            if (c == '"') {
+                for (++end; json[end] != '"'; ++end) {
+                    end += json[end] == '\\' ? 1 : 0;
+                }
+            } else if (c == '{' || c == '[') {
+                ++depth;
+            } else if ((c == '}' || c == ']') && depth-- == 0) {
+                break;
+            } else if (c == ',' && depth == 0) {
+                break;
+            }
+        }
+        members.emplace_back(std::move(key), std::string(json.substr(pos, end - pos)));
+        pos = end + 1;
+    }
+    return members;
+}
+
+std::string join(const Members& members, bool object) {
+    std::string json(1, object ? '{' : '[');
+    for (std::size_t i = 0; i < members.size(); ++i) {
+        if (i > 0) json += ',';
+        if (object) json += '"' + members[i].first + "\":";
+        json += members[i].second;
+    }
+    json += object ? '}' : ']';
+    return json;
+}
+
+std::string member_text(const Members& members, std::string_view key) {
+    for (const auto& [name, value] : members) {
+        if (name == key) {
+            return value;
+        }
+    }
+    return {};
+}
+
+// What a client holds: the text of each group by key, rebuilt from patches
+// the way the documented format describes.
+using Summary = std::map<std::string, std::string>;
+
+void apply_patch(Summary& summary, const std::string& patch) {
+    const Members top = split(patch);
+    if (member_text(top, "full") == "true") {
+        summary.clear();
+    }
+    for (const auto& [key, change] : split(member_text(top, "groups"))) {
+        const Members parts = split(change);
+        if (const std::string value = member_text(parts, "value"); !value.empty()) {
+            summary[key] = value;
+            continue;
+        }
+        std::string& text = summary[key];
+        const bool object = text.front() == '{';
+        Members members = split(text);
+        if (const std::string length = member_text(parts, "length"); !length.empty()) {
+            members.resize(std::stoul(length));
+        }
+        for (const auto& [field, value] : split(member_text(parts, "set"))) {
+            if (object) {
+                for (auto& member : members) {
+                    if (member.first == field) {
+                        member.second = value;
+                    }
+                }
+            } else {
+                members[std::stoul(field)].second = value;
+            }
+        }
+        text = join(members, object);
+    }
+    for (const auto& element : split(member_text(top, "removed"))) {
+        summary.erase(element.second.substr(1, element.second.size() - 2));  // unquoted
+    }
+}
+
+struct Sample {
+    unsigned groups;
+    std::map<unsigned, std::string> values;  // by group bit; empty: the group went away
+};
+
+SummarySnapshot snapshot(const Sample& sample, std::int64_t time_ms) {
+    SummarySnapshot snapshot;
+    snapshot.timestamp = nanookjaro::summary_timestamp(time_ms);
+    snapshot.time_ms = time_ms;
+    snapshot.groups = sample.groups;
+    for (const auto& [group, value] : sample.values) {
+        for (std::size_t bit = 0; bit < nanookjaro::kSummaryGroupCount; ++bit) {
+            if (group == 1u << bit) {
+                snapshot.values[bit] = value;
+            }
+        }
+    }
+    return snapshot;
+}
+
+Summary expected(const Sample& sample) {
+    Summary summary;
+    for (const auto& [group, value] : sample.values) {
+        if (!value.empty()) {
+            summary[nanookjaro::summary_group_key(group)] = value;
+        }
+    }
+    return summary;
+}
+
+}
+
+// Patches applied to what a client already holds must reproduce each new
+// sample exactly: changed fields and elements, arrays that shrink or grow,
+// reshaped objects, scalars, and groups that appear or go away.
+int main() {
+    using namespace nanookjaro;
+    constexpr unsigned kGroups = kSummaryCpu | kSummaryMemory | kSummaryLoad | kSummaryFilesystems | kSummaryGpu |
+                                 kSummaryPackages;
+    const std::vector<Sample> samples = {
+        {kGroups,
+         {{kSummaryCpu, R"({"model":"a \"b\", c","cores":4,"usage_percent":1.50})"},
+          {kSummaryMemory, R"({"total":100,"used":50})"},
+          {kSummaryLoad, "[0.10,0.20,0.30]"},
+          {kSummaryFilesystems, R"([{"mount":"/","used":1},{"mount":"/home","used":2}])"},
+          {kSummaryPackages, "5"}}},
+        {kGroups,
+         {{kSummaryCpu, R"({"model":"a \"b\", c","cores":4,"usage_percent":7.25})"},
+          {kSummaryMemory, ""},
+          {kSummaryLoad, "[0.10,0.90,0.30]"},
+          {kSummaryFilesystems, R"([{"mount":"/","used":1}])"},
+          {kSummaryGpu, R"([{"name":"gpu0"}])"},
+          {kSummaryPackages, "6"}}},
+        {kGroups,
+         {{kSummaryCpu, R"({"model":"a \"b\", c","cores":4,"usage_percent":7.25,"temperature":40})"},
+          {kSummaryLoad, "[0.10,0.90,0.30]"},
+          {kSummaryFilesystems, R"([{"mount":"/","used":3},{"mount":"/home","used":2},{"mount":"/srv","used":9}])"},
+          {kSummaryGpu, R"([{"name":"gpu0"}])"},
+          {kSummaryPackages, "6"}}},
+    };
+
+    SummaryDelta delta;
+    std::vector<std::uint64_t> seqs;
+    std::vector<Summary> held(samples.size());
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        const std::uint64_t previous = delta.seq();
+        seqs.push_back(delta.update(snapshot(samples[i], 1700000000000 + static_cast<std::int64_t>(i) * 1000)));
+        expect(seqs.back() == previous + 1, "a changed sample advances the sequence number");
+        held[i] = i == 0 ? Summary{} : held[i - 1];
+        apply_patch(held[i], delta.patch_json(i == 0 ? 0 : seqs[i - 1], kSummaryAllGroups));
+        expect(held[i] == expected(samples[i]), "patch " + std::to_string(i) + " reproduces the sample");
+    }
+
+    // A client two samples behind catches up with a single patch.
+    Summary behind = held[0];
+    apply_patch(behind, delta.patch_json(seqs[0], kSummaryAllGroups));
+    expect(behind == expected(samples.back()), "a patch spanning two samples reproduces the latest");
+
+    // An unchanged sample keeps the sequence number, and its patch is empty.
+    expect(delta.update(snapshot(samples.back(), 1700000009000)) == seqs.back(), "unchanged samples keep seq");
+    expect(member_text(split(delta.patch_json(seqs.back(), kSummaryAllGroups)), "groups") == "{}",
+           "nothing changed since the current seq");
+
+    // Unknown sequence numbers get everything.
+    const std::string full = delta.patch_json(1, kSummaryAllGroups);
+    expect(member_text(split(full), "full") == "true", "an unknown seq gets a full patch");
+    Summary fresh;
+    apply_patch(fresh, full);
+    expect(fresh == expected(samples.back()), "a full patch reproduces the sample");
+
+    std::cout << "{\"failures\":" << failures << "}" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
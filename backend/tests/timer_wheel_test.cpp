@@ -0,0 +1,114 @@
+#include "../src/common/timer_wheel.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using nanookjaro::common::TimerWheel;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, std::string_view what) {
+    if (!ok) {
+        std::cerr << "failed: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// Deadlines on both sides of every level boundary and past the wheel's span.
+std::vector<TimerWheel::Tick> boundary_deadlines(TimerWheel::Tick start) {
+    std::vector<TimerWheel::Tick> deadlines;
+    for (const TimerWheel::Tick span : {64ULL, 4096ULL, 262144ULL, 16777216ULL}) {
+        for (const TimerWheel::Tick offset : {span - 1, span, span + 1}) {
+            deadlines.push_back(start + offset);
+        }
+    }
+    deadlines.push_back(start + 1);
+    deadlines.push_back(start + 40000000);
+    return deadlines;
+}
+
+// Steps from event to event; every timer must fire exactly at its deadline
+// after being moved down through the levels.
+void check_cascade(TimerWheel::Tick start) {
+    TimerWheel wheel(start);
+    const auto deadlines = boundary_deadlines(start);
+    for (std::uint32_t id = 0; id < deadlines.size(); ++id) {
+        wheel.schedule(id, deadlines[id]);
+    }
+    std::vector<std::uint32_t> expired;
+    std::size_t fired = 0;
+    while (const auto next = wheel.next_event()) {
+        expect(*next > wheel.now(), "next_event() lies ahead");
+        expired.clear();
+        wheel.advance(*next, expired);
+        for (const std::uint32_t id : expired) {
+            expect(deadlines[id] == wheel.now(), "timer " + std::to_string(id) + " from " + std::to_string(start) +
+                                                     " fired at " + std::to_string(wheel.now()) + ", due " +
+                                                     std::to_string(deadlines[id]));
+            ++fired;
+        }
+    }
+    expect(fired == deadlines.size() && wheel.empty(), "every timer fired once");
+}
+
+// One jump over all deadlines reports them in deadline order.
+void check_single_advance() {
+    TimerWheel wheel(5);
+    const auto deadlines = boundary_deadlines(5);
+    for (std::uint32_t id = 0; id < deadlines.size(); ++id) {
+        wheel.schedule(id, deadlines[id]);
+    }
+    std::vector<std::uint32_t> expired;
+    wheel.advance(deadlines.back(), expired);
+    expect(expired.size() == deadlines.size(), "one advance fires every timer");
+    expect(std::is_sorted(expired.begin(), expired.end(),
+                          [&](std::uint32_t lhs, std::uint32_t rhs) { return deadlines[lhs] < deadlines[rhs]; }),
+           "timers fire in deadline order");
+}
+
+void check_past_deadline() {
+    TimerWheel wheel(1000);
+    wheel.schedule(0, 10);
+    wheel.schedule(1, 1000);
+    expect(wheel.next_event() == TimerWheel::Tick{1001}, "overdue timers are due on the next tick");
+    std::vector<std::uint32_t> expired;
+    wheel.advance(1000, expired);
+    expect(expired.empty(), "advancing to the current tick fires nothing");
+    wheel.advance(1001, expired);
+    std::sort(expired.begin(), expired.end());
+    expect(expired == std::vector<std::uint32_t>{0, 1}, "overdue timers fire on the next advance");
+    expect(!wheel.scheduled(0) && wheel.empty(), "fired timers are no longer scheduled");
+}
+
+void check_cancel_and_reschedule() {
+    TimerWheel wheel;
+    wheel.schedule(0, 100);
+    wheel.schedule(1, 5000);
+    wheel.schedule(2, 300);
+    wheel.cancel(1);
+    wheel.schedule(2, 70000);  // moves it to a higher level
+    std::vector<std::uint32_t> expired;
+    wheel.advance(69999, expired);
+    expect(expired == std::vector<std::uint32_t>{0}, "cancelled and rescheduled timers do not fire early");
+    wheel.advance(70000, expired);
+    expect(expired == std::vector<std::uint32_t>{0, 2}, "a rescheduled timer fires at its new deadline");
+    expect(wheel.empty() && !wheel.next_event(), "nothing left after the last timer");
+}
+
+}
+
+int main() {
+    check_cascade(0);
+    check_cascade(1000003);  // not aligned to any level
+    check_single_advance();
+    check_past_deadline();
+    check_cancel_and_reschedule();
+    std::cout << "{\"failures\":" << failures << "}" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
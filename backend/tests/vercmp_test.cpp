@@ -0,0 +1,88 @@
+#include "../src/maintenance/vercmp.hpp"
+
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+struct Case {
+    const char* a;
+    const char* b;
+    int expected;
+};
+
+// From pacman's test/util/vercmptest.sh.
+constexpr Case kCases[] = {
+    {"1.5.0", "1.5.0", 0},
+    {"1.5.1", "1.5.0", 1},
+    {"1.5.1", "1.5", 1},
+    // pkgrel
+    {"1.5.0-1", "1.5.0-1", 0},
+    {"1.5.0-1", "1.5.0-2", -1},
+    {"1.5.0-1", "1.5.1-1", -1},
+    {"1.5.0-2", "1.5.1-1", -1},
+    {"1.5-1", "1.5.1-1", -1},
+    {"1.5-2", "1.5.1-1", -1},
+    {"1.5-2", "1.5.1-2", -1},
+    {"1.5", "1.5-1", 0},
+    {"1.1-1", "1.1", 0},
+    {"1.0-1", "1.1", -1},
+    {"1.1-1", "1.0", 1},
+    // alphanumeric versions
+    {"1.5b-1", "1.5-1", -1},
+    {"1.5b", "1.5", -1},
+    {"1.5b-1", "1.5", -1},
+    {"1.5b", "1.5.1", -1},
+    {"1.0a", "1.0alpha", -1},
+    {"1.0alpha", "1.0b", -1},
+    {"1.0b", "1.0beta", -1},
+    {"1.0beta", "1.0rc", -1},
+    {"1.0rc", "1.0", -1},
+    {"1.5.a", "1.5", 1},
+    {"1.5.b", "1.5.a", 1},
+    {"1.5.1", "1.5.b", 1},
+    {"1.5.b-1", "1.5.b", 0},
+    {"1.5-1", "1.5.b", -1},
+    // separators
+    {"2.0", "2_0", 0},
+    {"2.0_a", "2_0.a", 0},
+    {"2.0a", "2.0.a", -1},
+    {"2___a", "2_a", 1},
+    // epoch
+    {"0:1.0", "0:1.0", 0},
+    {"0:1.0", "0:1.1", -1},
+    {"1:1.0", "0:1.0", 1},
+    {"1:1.0", "0:1.1", 1},
+    {"1:1.0", "2:1.1", -1},
+    {"1:1.0", "0:1.0-1", 1},
+    {"1:1.0-1", "0:1.1-1", 1},
+    {"0:1.0", "1.0", 0},
+    {"0:1.0", "1.1", -1},
+    {"0:1.1", "1.0", 1},
+    {"1:1.0", "1.0", 1},
+    {"1:1.0", "1.1", 1},
+    {"1:1.1", "1.1", 1},
+};
+
+int sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+}
+
+// Each case is checked in both orders, like vercmptest.sh does.
+int main() {
+    using nanookjaro::package_manager::vercmp;
+    int failures = 0;
+    for (const Case& c : kCases) {
+        const int forward = sign(vercmp(c.a, c.b));
+        const int backward = sign(vercmp(c.b, c.a));
+        if (forward != c.expected || backward != -c.expected) {
+            std::cerr << "vercmp(" << c.a << ", " << c.b << ") = " << forward << ", reversed " << backward
+                      << ", expected " << c.expected << std::endl;
+            ++failures;
+        }
+    }
+    std::cout << "{\"cases\":" << std::size(kCases) << ",\"failures\":" << failures << "}" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
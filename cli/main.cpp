@@ -1,18 +1,67 @@
 #include "../backend/src/system/system_summary.hpp"
 #include "../backend/src/maintenance/package_manager.hpp"
+#include "../backend/src/maintenance/package_verify.hpp"
+#include "../backend/src/system/metrics_sampler.hpp"
+#include "../backend/src/system/summary_delta.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
 
 namespace {
 
 void print_usage() {
     std::cout << "Usage:\n"
               << "  nanookjaro-cli                  # system summary JSON\n"
+              << "  nanookjaro-cli cgroups [top-n]        # per-slice/service usage\n"
+              << "  nanookjaro-cli devices                # device -> driver resolution\n"
+              << "  nanookjaro-cli collectors  # collector periods from nanookjaro.conf\n"
+              << "  nanookjaro-cli summary-since [seq]  # summary patch since a sequence number (0 for all)\n"
+              << "  nanookjaro-cli watch [interval-ms] [count] [group-mask]  # pushed summaries, mask bits as in nj_subscribe\n"
+              << "  nanookjaro-cli sampler-cost [seconds] [group-mask]  # own CPU time and wakeups at 1/10 Hz, normal and stealth\n"
+              << "  nanookjaro-cli du [path] [top-n]      # largest directories/files, treemap\n"
+              << "  nanookjaro-cli du-owners [path] [top-n]  # du with owning packages\n"
+              << "  nanookjaro-cli du-index [path] [top-n] [--rebuild]  # same, from the persisted index\n"
+              << "  nanookjaro-cli dupes [path] [max-groups] [min-size]  # duplicate files, reclaimable bytes\n"
               << "  nanookjaro-cli pacman list-updates\n"
+              << "  nanookjaro-cli pacman list-installed\n"
+              << "  nanookjaro-cli pacman cache [keep-n] [--keep-uninstalled N] [--partials] [--prune]\n"
+              << "  nanookjaro-cli pacman search [--limit N] <term>...  # ranked name/description matches\n"
+              << "  nanookjaro-cli pacman history [pkg] [--since unix-seconds] [--limit N]  # from pacman.log\n"
+              << "  nanookjaro-cli pacman owns <path>...   # owning packages, like pacman -Qo\n"
+              << "  nanookjaro-cli pacman verify [--no-checksums] [pkg]...  # like pacman -Qkk, streams one JSON line per issue\n"
+              << "  nanookjaro-cli pacman deps [pkg]      # orphans; reverse deps and removable set of pkg\n"
               << "  nanookjaro-cli pacman upgrade [--assume-yes]\n"
               << "  nanookjaro-cli pacman install <pkg>... [--assume-yes]\n";
 }
 
+struct ProcessUsage {
+    double cpu_ms = 0.0;
+    long voluntary_switches = 0;
+};
+
+// CPU time of this process and of the children it waited for (collectors
+// that run external tools), and how often it went to sleep.
+ProcessUsage process_usage() {
+    rusage self{};
+    rusage children{};
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    const auto ms = [](const timeval& tv) { return static_cast<double>(tv.tv_sec) * 1000.0 + tv.tv_usec / 1000.0; };
+    ProcessUsage usage;
+    usage.cpu_ms = ms(self.ru_utime) + ms(self.ru_stime) + ms(children.ru_utime) + ms(children.ru_stime);
+    usage.voluntary_switches = self.ru_nvcsw;
+    return usage;
+}
+
 bool parse_assume_yes(int argc, char** argv, int start_index) {
     for (int i = start_index; i < argc; ++i) {
         const std::string_view arg{argv[i]};
@@ -34,6 +83,132 @@ int main(int argc, char** argv) {
         }
 
         const std::string_view command{argv[1]};
+        if (command == "devices") {
+            std::cout << nanookjaro::device_drivers_json() << std::endl;
+            return 0;
+        }
+        if (command == "collectors") {
+            std::cout << nanookjaro::metrics::collectors_json() << std::endl;
+            return 0;
+        }
+        if (command == "summary-since") {
+            const unsigned long long seq = argc >= 3 ? std::stoull(argv[2]) : 0;
+            std::cout << nanookjaro::summary_since_json(seq) << std::endl;
+            return 0;
+        }
+        if (command == "watch") {
+            // Streams summaries from the push-based sampler (see nj_subscribe).
+            const unsigned interval_ms = argc >= 3 ? static_cast<unsigned>(std::stoul(argv[2])) : 1000;
+            const long count = argc >= 4 ? std::stol(argv[3]) : 5;
+            const unsigned mask = argc >= 5 ? static_cast<unsigned>(std::stoul(argv[4], nullptr, 0))
+                                            : nanookjaro::kSummaryDefaultGroups;
+            static std::mutex mutex;
+            static std::condition_variable done;
+            static long remaining = 0;
+            remaining = count;
+            const auto id = nanookjaro::metrics::subscribe(
+                mask, interval_ms,
+                [](std::int64_t, const char* json, void*) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (remaining > 0) {
+                        std::cout << json << std::endl;
+                        --remaining;
+                    }
+                    done.notify_all();
+                },
+                nullptr);
+            if (id < 0) {
+                std::cerr << "Invalid group mask" << std::endl;
+                return 1;
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                done.wait(lock, [] { return remaining <= 0; });
+            }
+            nanookjaro::metrics::unsubscribe(id);
+            return 0;
+        }
+        if (command == "sampler-cost") {
+            // The toolkit's own footprint while serving one subscriber. The
+            // main thread sleeps throughout, so the process's CPU time and
+            // voluntary context switches are the sampler's.
+            const int seconds = argc >= 3 ? std::max(std::stoi(argv[2]), 1) : 10;
+            const unsigned mask = argc >= 4 ? static_cast<unsigned>(std::stoul(argv[3], nullptr, 0))
+                                            : nanookjaro::kSummaryDefaultGroups;
+            static std::atomic<long> payloads{0};
+            std::cout << std::fixed << std::setprecision(2);
+            for (const bool stealth : {false, true}) {
+                nanookjaro::metrics::set_stealth_mode(stealth);
+                for (const unsigned interval_ms : {1000u, 100u}) {
+                    const auto id = nanookjaro::metrics::subscribe(
+                        mask, interval_ms, [](std::int64_t, const char*, void*) { ++payloads; }, nullptr);
+                    if (id < 0) {
+                        std::cerr << "Invalid group mask" << std::endl;
+                        return 1;
+                    }
+                    // Leave out the first run of every collector.
+                    std::this_thread::sleep_for(std::chrono::seconds(2));
+                    const long delivered = payloads.load();
+                    const ProcessUsage before = process_usage();
+                    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+                    const ProcessUsage after = process_usage();
+                    const long count = payloads.load() - delivered;
+                    nanookjaro::metrics::unsubscribe(id);
+                    const double cpu_ms = after.cpu_ms - before.cpu_ms;
+                    std::cout << "{\"mode\":\"" << (stealth ? "stealth" : "normal") << "\","
+                              << "\"hz\":" << 1000 / interval_ms << ","
+                              << "\"seconds\":" << seconds << ","
+                              << "\"payloads\":" << count << ","
+                              << "\"cpu_ms\":" << cpu_ms << ","
+                              << "\"cpu_percent\":" << cpu_ms / (seconds * 10.0) << ","
+                              << "\"wakeups_per_s\":"
+                              << static_cast<double>(after.voluntary_switches - before.voluntary_switches) / seconds
+                              << "}" << std::endl;
+                }
+            }
+            std::cout << nanookjaro::metrics::collectors_json() << std::endl;
+            return 0;
+        }
+        if (command == "du") {
+            const std::string path = argc >= 3 ? argv[2] : "/";
+            const std::size_t top_n = argc >= 4 ? static_cast<std::size_t>(std::stoul(argv[3])) : 0;
+            std::cout << nanookjaro::disk_usage_json(path, top_n) << std::endl;
+            return 0;
+        }
+        if (command == "du-owners") {
+            const std::string path = argc >= 3 ? argv[2] : "/";
+            const std::size_t top_n = argc >= 4 ? static_cast<std::size_t>(std::stoul(argv[3])) : 0;
+            std::cout << nanookjaro::disk_usage_owners_json(path, top_n) << std::endl;
+            return 0;
+        }
+        if (command == "du-index") {
+            bool rebuild = false;
+            std::vector<std::string> positional;
+            for (int i = 2; i < argc; ++i) {
+                const std::string_view arg{argv[i]};
+                if (arg == "--rebuild") {
+                    rebuild = true;
+                } else {
+                    positional.emplace_back(arg);
+                }
+            }
+            const std::string path = !positional.empty() ? positional[0] : "/";
+            const std::size_t top_n = positional.size() >= 2 ? static_cast<std::size_t>(std::stoul(positional[1])) : 0;
+            std::cout << nanookjaro::disk_usage_index_json(path, top_n, rebuild) << std::endl;
+            return 0;
+        }
+        if (command == "dupes") {
+            const std::string path = argc >= 3 ? argv[2] : "/";
+            const std::size_t max_groups = argc >= 4 ? static_cast<std::size_t>(std::stoul(argv[3])) : 0;
+            const unsigned long long min_size = argc >= 5 ? std::stoull(argv[4]) : 0;
+            std::cout << nanookjaro::duplicates_json(path, max_groups, min_size) << std::endl;
+            return 0;
+        }
+        if (command == "cgroups") {
+            const std::size_t limit = argc >= 3 ? static_cast<std::size_t>(std::stoul(argv[2])) : 0;
+            std::cout << nanookjaro::cgroups_info_json(limit) << std::endl;
+            return 0;
+        }
         if (command == "pacman") {
             if (argc >= 3) {
                 const std::string_view subcommand{argv[2]};
@@ -50,6 +225,97 @@ int main(int argc, char** argv) {
                     std::cout << result_json << std::endl;
                     return 0;
                 }
+                if (subcommand == "list-installed") {
+                    std::cout << nanookjaro::package_manager::pacman_local_packages_json() << std::endl;
+                    return 0;
+                }
+                if (subcommand == "cache") {
+                    std::size_t keep_versions = 3;
+                    std::size_t keep_uninstalled = 0;
+                    bool prune = false;
+                    bool remove_partials = false;
+                    for (int i = 3; i < argc; ++i) {
+                        const std::string_view arg{argv[i]};
+                        if (arg == "--prune") {
+                            prune = true;
+                        } else if (arg == "--partials") {
+                            remove_partials = true;
+                        } else if (arg == "--keep-uninstalled" && i + 1 < argc) {
+                            keep_uninstalled = static_cast<std::size_t>(std::stoul(argv[++i]));
+                        } else if (arg.starts_with("--")) {
+                            std::cerr << "Invalid option: " << arg << std::endl;
+                            print_usage();
+                            return 1;
+                        } else {
+                            keep_versions = static_cast<std::size_t>(std::stoul(argv[i]));
+                        }
+                    }
+                    std::cout << nanookjaro::package_manager::pacman_package_cache_json(
+                                     keep_versions, keep_uninstalled, prune, remove_partials)
+                              << std::endl;
+                    return 0;
+                }
+                if (subcommand == "search" && argc >= 4) {
+                    std::size_t limit = 50;
+                    std::string query;
+                    for (int i = 3; i < argc; ++i) {
+                        const std::string_view arg{argv[i]};
+                        if (arg == "--limit" && i + 1 < argc) {
+                            limit = std::strtoull(argv[++i], nullptr, 10);
+                            continue;
+                        }
+                        if (!query.empty()) {
+                            query += ' ';
+                        }
+                        query += arg;
+                    }
+                    std::cout << nanookjaro::package_manager::pacman_search_json(query, limit) << std::endl;
+                    return 0;
+                }
+                if (subcommand == "history") {
+                    std::string package;
+                    long long since = 0;
+                    std::size_t limit = 20;
+                    for (int i = 3; i < argc; ++i) {
+                        const std::string_view arg{argv[i]};
+                        if (arg == "--since" && i + 1 < argc) {
+                            since = std::strtoll(argv[++i], nullptr, 10);
+                        } else if (arg == "--limit" && i + 1 < argc) {
+                            limit = std::strtoull(argv[++i], nullptr, 10);
+                        } else {
+                            package = arg;
+                        }
+                    }
+                    std::cout << nanookjaro::package_manager::pacman_history_json(package, since, limit) << std::endl;
+                    return 0;
+                }
+                if (subcommand == "owns" && argc >= 4) {
+                    const std::vector<std::string> paths(argv + 3, argv + argc);
+                    std::cout << nanookjaro::package_manager::pacman_file_owners_json(paths) << std::endl;
+                    return 0;
+                }
+                if (subcommand == "verify") {
+                    nanookjaro::package_manager::VerifyOptions options;
+                    for (int i = 3; i < argc; ++i) {
+                        const std::string arg = argv[i];
+                        if (arg == "--no-checksums") {
+                            options.checksums = false;
+                        } else {
+                            options.packages.push_back(arg);
+                        }
+                    }
+                    const auto report = nanookjaro::package_manager::verify_installed_files(
+                        options, [](const nanookjaro::package_manager::VerifyIssue& issue) {
+                            std::cout << nanookjaro::package_manager::verify_issue_to_json(issue) << std::endl;
+                        });
+                    std::cout << nanookjaro::package_manager::verify_report_to_json(report, false) << std::endl;
+                    return report.valid && report.issues.empty() && report.unknown_packages.empty() ? 0 : 1;
+                }
+                if (subcommand == "deps") {
+                    const std::string package = argc >= 4 ? argv[3] : "";
+                    std::cout << nanookjaro::package_manager::pacman_dependency_graph_json(package) << std::endl;
+                    return 0;
+                }
                 if (subcommand == "install" && argc >= 4) {
                     std::vector<std::string> packages;
                     bool assume_yes = false;
@@ -121,6 +121,10 @@ class AppLocalizations {
       'upgradeInvokeFailed': 'Failed to invoke pacman upgrade',
       'upgradeDialogTitle': 'Run System Upgrade',
       'upgradeDialogResultTitle': 'Upgrade Result',
+      'upgradeCancel': 'Cancel Upgrade',
+      'upgradeCancelling': 'Cancelling...',
+      'upgradeCancelled': 'Upgrade cancelled',
+      'upgradeWaitingOutput': 'Waiting for pacman output...',
       'languageSystem': 'Follow system',
       'languageEnglish': 'English',
       'languageChinese': '中文',
@@ -225,6 +229,10 @@ class AppLocalizations {
       'upgradeInvokeFailed': '调用 pacman 升级失败',
       'upgradeDialogTitle': '执行系统升级',
       'upgradeDialogResultTitle': '升级结果',
+      'upgradeCancel': '取消升级',
+      'upgradeCancelling': '正在取消...',
+      'upgradeCancelled': '升级已取消',
+      'upgradeWaitingOutput': '正在等待 pacman 输出...',
       'languageSystem': '跟随系统',
       'languageEnglish': 'English',
       'languageChinese': '中文',
@@ -348,6 +356,10 @@ class AppLocalizations {
   String get upgradeInvokeFailed => _value('upgradeInvokeFailed');
   String get upgradeDialogTitle => _value('upgradeDialogTitle');
   String get upgradeDialogResultTitle => _value('upgradeDialogResultTitle');
+  String get upgradeCancel => _value('upgradeCancel');
+  String get upgradeCancelling => _value('upgradeCancelling');
+  String get upgradeCancelled => _value('upgradeCancelled');
+  String get upgradeWaitingOutput => _value('upgradeWaitingOutput');
   String get languageSystem => _value('languageSystem');
   String get languageEnglish => _value('languageEnglish');
   String get languageChinese => _value('languageChinese');
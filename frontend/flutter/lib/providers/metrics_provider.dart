@@ -1,6 +1,7 @@
-import 'dart:async';
 import 'dart:convert';
+import 'dart:isolate';
 
+import 'package:flutter/widgets.dart';
 import 'package:flutter_riverpod/flutter_riverpod.dart';
 
 import '../services/ffi_bridge.dart';
@@ -96,26 +97,66 @@ class MetricsNotifier extends StateNotifier<AsyncValue<SystemSummary>> {
     _loadInitial();
   }
 
-  Timer? _timer;
+  // Summaries pushed by the backend sampler thread; replaces polling. After
+  // the first payload only changed fields and array entries are sent.
+  static const int _subscriptionMask = NanookjaroBridge.metricsDelta |
+      NanookjaroBridge.metricsCpu |
+      NanookjaroBridge.metricsMemory |
+      NanookjaroBridge.metricsLoad |
+      NanookjaroBridge.metricsFilesystems |
+      NanookjaroBridge.metricsGpu |
+      NanookjaroBridge.metricsNetwork |
+      NanookjaroBridge.metricsProxy;
+
+  ReceivePort? _port;
+  int _subscription = -1;
+  AppLifecycleListener? _lifecycle;
+  final Map<String, dynamic> _summary = <String, dynamic>{};
   final List<double> _cpuHistory = <double>[];
   final List<double> _memoryHistory = <double>[];
 
   Future<void> _loadInitial() async {
-    await refresh();
-    _timer = Timer.periodic(const Duration(seconds: 2), (_) {
-      refresh();
+    final port = ReceivePort();
+    port.listen((message) {
+      if (message is String) {
+        _applyPayload(message);
+      }
     });
+    _port = port;
+    _subscription = NanookjaroBridge.instance.subscribeMetrics(_subscriptionMask, 0, port.sendPort.nativePort);
+    if (_subscription < 0) {
+      port.close();
+      _port = null;
+      state = AsyncValue.error(StateError('system_summary: subscribe_failed'), StackTrace.current);
+      return;
+    }
+    // A hidden or minimized window lets the sampler slow down; an unfocused
+    // but visible one (inactive) still counts as visible.
+    _lifecycle = AppLifecycleListener(
+      onStateChange: (lifecycle) => NanookjaroBridge.instance.setVisibility(
+          lifecycle == AppLifecycleState.resumed || lifecycle == AppLifecycleState.inactive),
+    );
   }
 
   Future<void> refresh() async {
-    final previous = state;
     state = const AsyncValue.loading();
+    _applyPayload(NanookjaroBridge.instance.getSystemSummaryJson());
+  }
+
+  void _applyPayload(String rawJson) {
     try {
-      final rawJson = NanookjaroBridge.instance.getSystemSummaryJson();
-      final decoded = jsonDecode(rawJson) as Map<String, dynamic>;
-      if (decoded.containsKey('error')) {
-        throw StateError('system_summary: ${decoded['error']}');
+      final message = jsonDecode(rawJson) as Map<String, dynamic>;
+      if (message.containsKey('error')) {
+        throw StateError('system_summary: ${message['error']}');
       }
+      if (message.containsKey('seq')) {
+        _mergePatch(message);
+      } else {
+        _summary
+          ..clear()
+          ..addAll(message);
+      }
+      final decoded = _summary;
 
       final cpu = decoded['cpu'] as Map<String, dynamic>? ?? {};
       final memory = decoded['memory'] as Map<String, dynamic>? ?? {};
@@ -189,10 +230,52 @@ class MetricsNotifier extends StateNotifier<AsyncValue<SystemSummary>> {
 
   @override
   void dispose() {
-    _timer?.cancel();
+    _lifecycle?.dispose();
+    _lifecycle = null;
+    if (_subscription >= 0) {
+      NanookjaroBridge.instance.unsubscribeMetrics(_subscription);
+      _subscription = -1;
+    }
+    _port?.close();
+    _port = null;
     super.dispose();
   }
 
+  /// Applies a delta payload (see `nj_get_summary_since`) to [_summary].
+  void _mergePatch(Map<String, dynamic> patch) {
+    if (patch['full'] == true) {
+      _summary.clear();
+    }
+    _summary['timestamp'] = patch['timestamp'];
+    final groups = patch['groups'] as Map<String, dynamic>? ?? const {};
+    groups.forEach((key, raw) {
+      final change = raw as Map<String, dynamic>;
+      if (change.containsKey('value')) {
+        _summary[key] = change['value'];
+        return;
+      }
+      final fields = change['set'] as Map<String, dynamic>? ?? const {};
+      final current = _summary[key];
+      if (current is List) {
+        final length = (change['length'] as num? ?? current.length).toInt();
+        final list = List<dynamic>.of(current);
+        if (list.length > length) {
+          list.length = length;
+        }
+        while (list.length < length) {
+          list.add(null);
+        }
+        fields.forEach((index, value) => list[int.parse(index)] = value);
+        _summary[key] = list;
+      } else if (current is Map<String, dynamic>) {
+        _summary[key] = <String, dynamic>{...current, ...fields};
+      }
+    });
+    for (final key in patch['removed'] as List<dynamic>? ?? const []) {
+      _summary.remove(key);
+    }
+  }
+
   void _pushHistoryPoint(List<double> history, double value) {
     if (!value.isFinite) {
       return;
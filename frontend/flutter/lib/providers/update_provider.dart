@@ -47,6 +47,7 @@ class PacmanUpgradeResult {
     required this.exitCode,
     required this.requiresPassword,
     required this.output,
+    this.cancelled = false,
   });
 
   final String command;
@@ -54,13 +55,17 @@ class PacmanUpgradeResult {
   final int exitCode;
   final bool requiresPassword;
   final String output;
+  final bool cancelled;
 
-  bool get success => exitCode == 0;
+  bool get success => exitCode == 0 && !cancelled;
 
   String get summaryMessage {
     if (success) {
       return 'System upgrade completed successfully';
     }
+    if (cancelled) {
+      return 'System upgrade cancelled';
+    }
     if (requiresPassword) {
       return 'Authentication required. Run the interactive command in a terminal.';
     }
@@ -109,27 +114,72 @@ class UpdateNotifier extends StateNotifier<AsyncValue<UpdateInfo>> {
     }
   }
 
-  Future<PacmanUpgradeResult> upgrade({bool assumeYes = false}) async {
-    final rawJson = NanookjaroBridge.instance.pacmanSyncUpgradeJson(assumeYes: assumeYes);
-    final decoded = jsonDecode(rawJson) as Map<String, dynamic>;
-    if (decoded.containsKey('error')) {
-      throw StateError('pacman_sync_upgrade: ${decoded['error']}');
+  static const Duration _jobPollInterval = Duration(milliseconds: 200);
+
+  int? _activeJobId;
+
+  bool get upgradeRunning => _activeJobId != null;
+
+  /// Runs `pacman -Syu` as a background job. [onOutput] receives new output
+  /// lines as they arrive; the future completes when the job has finished.
+  Future<PacmanUpgradeResult> upgrade({
+    bool assumeYes = false,
+    void Function(List<String> lines)? onOutput,
+  }) async {
+    final bridge = NanookjaroBridge.instance;
+    final jobId = bridge.jobStart('pacman-upgrade', assumeYes ? const ['--noconfirm'] : const []);
+    if (jobId < 0) {
+      throw StateError('pacman_sync_upgrade: job_start_failed');
     }
+    _activeJobId = jobId;
 
-    final result = PacmanUpgradeResult(
-      command: decoded['command'] as String? ?? 'pacman -Syu',
-      interactiveCommand: decoded['interactive_command'] as String? ??
-          (decoded['command'] as String? ?? 'pacman -Syu'),
-      exitCode: (decoded['exit_code'] as num? ?? -1).toInt(),
-      requiresPassword: decoded['requires_password'] as bool? ?? false,
-      output: decoded['output'] as String? ?? '',
-    );
-
-    if (result.success) {
-      await refresh();
+    final output = StringBuffer();
+    var lastSeq = 0;
+    try {
+      while (true) {
+        final decoded = jsonDecode(bridge.jobPollJson(jobId, afterSeq: lastSeq)) as Map<String, dynamic>;
+        if (decoded.containsKey('error')) {
+          throw StateError('pacman_sync_upgrade: ${decoded['error']}');
+        }
+
+        final lines = (decoded['lines'] as List<dynamic>? ?? const []).cast<String>();
+        lastSeq = (decoded['last_seq'] as num? ?? lastSeq).toInt();
+        if (lines.isNotEmpty) {
+          lines.forEach(output.writeln);
+          onOutput?.call(lines);
+        }
+
+        final jobState = decoded['state'] as String? ?? 'running';
+        if (jobState != 'running') {
+          final exitCode = (decoded['exit_code'] as num? ?? -1).toInt();
+          final result = PacmanUpgradeResult(
+            command: decoded['command'] as String? ?? 'pacman -Syu',
+            interactiveCommand: decoded['interactive_command'] as String? ??
+                (decoded['command'] as String? ?? 'pacman -Syu'),
+            exitCode: exitCode,
+            requiresPassword: (decoded['requires_password'] as bool? ?? false) && exitCode != 0,
+            output: output.toString(),
+            cancelled: jobState == 'cancelled',
+          );
+          if (result.success) {
+            await refresh();
+          }
+          return result;
+        }
+
+        await Future<void>.delayed(_jobPollInterval);
+      }
+    } finally {
+      bridge.jobRelease(jobId);
+      _activeJobId = null;
     }
+  }
 
-    return result;
+  /// Interrupts a running [upgrade]. pacman is sent SIGINT only and exits
+  /// at its next safe point.
+  bool cancelUpgrade() {
+    final jobId = _activeJobId;
+    return jobId != null && NanookjaroBridge.instance.jobCancel(jobId);
   }
 }
 
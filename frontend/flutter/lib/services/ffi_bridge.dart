@@ -28,6 +28,23 @@ class NanookjaroBridge {
         _library.lookupFunction<Pointer<Utf8> Function(), Pointer<Utf8> Function()>('nj_get_network_info');
     _getDriversInfo =
         _library.lookupFunction<Pointer<Utf8> Function(), Pointer<Utf8> Function()>('nj_get_drivers_info');
+    _jobStart = _library.lookupFunction<
+        Int64 Function(Pointer<Utf8>, Pointer<Pointer<Utf8>>, Int32),
+        int Function(Pointer<Utf8>, Pointer<Pointer<Utf8>>, int)>('nj_job_start');
+    _jobPoll = _library.lookupFunction<
+        Pointer<Utf8> Function(Int64, Uint64, Int32),
+        Pointer<Utf8> Function(int, int, int)>('nj_job_poll');
+    _jobCancel = _library.lookupFunction<Int32 Function(Int64), int Function(int)>('nj_job_cancel');
+    _jobRelease = _library.lookupFunction<Int32 Function(Int64), int Function(int)>('nj_job_release');
+    _getSummarySince =
+        _library.lookupFunction<Pointer<Utf8> Function(Uint64), Pointer<Utf8> Function(int)>('nj_get_summary_since');
+    _setDartPostCObject = _library.lookupFunction<Void Function(Pointer<Void>), void Function(Pointer<Void>)>(
+        'nj_set_dart_post_cobject');
+    _subscribePort = _library.lookupFunction<Int64 Function(Uint32, Int32, Int64), int Function(int, int, int)>(
+        'nj_subscribe_port');
+    _unsubscribe = _library.lookupFunction<Int32 Function(Int64), int Function(int)>('nj_unsubscribe');
+    _setVisibility = _library.lookupFunction<Void Function(Int32), void Function(int)>('nj_set_visibility');
+    _setDartPostCObject(NativeApi.postCObject.cast());
   }
 
   static final NanookjaroBridge instance = NanookjaroBridge._();
@@ -44,6 +61,15 @@ class NanookjaroBridge {
   late final Pointer<Utf8> Function() _getDiskInfo;
   late final Pointer<Utf8> Function() _getNetworkInfo;
   late final Pointer<Utf8> Function() _getDriversInfo;
+  late final int Function(Pointer<Utf8>, Pointer<Pointer<Utf8>>, int) _jobStart;
+  late final Pointer<Utf8> Function(int, int, int) _jobPoll;
+  late final int Function(int) _jobCancel;
+  late final int Function(int) _jobRelease;
+  late final Pointer<Utf8> Function(int) _getSummarySince;
+  late final void Function(Pointer<Void>) _setDartPostCObject;
+  late final int Function(int, int, int) _subscribePort;
+  late final int Function(int) _unsubscribe;
+  late final void Function(int) _setVisibility;
 
   static DynamicLibrary _loadLibrary() {
     final envPath = Platform.environment['NANOOKJARO_CORE_PATH'];
@@ -163,6 +189,10 @@ class NanookjaroBridge {
 
   String getSystemSummaryJson() => _invokeString(_getSystemSummary);
 
+  /// Summary fields that changed after sequence number [seq]; pass the
+  /// previous response's `seq`, or 0 for everything.
+  String getSummarySinceJson(int seq) => _invokeString(() => _getSummarySince(seq));
+
   String pacmanSyncUpgradeJson({bool assumeYes = false}) {
     return _invokeString(() => _pacmanSyncUpgrade(assumeYes ? 1 : 0));
   }
@@ -201,6 +231,62 @@ class NanookjaroBridge {
 
   String getDriversInfoJson() => _invokeString(_getDriversInfo);
 
+  /// Starts a background job (e.g. `pacman-upgrade`) and returns its id, or a
+  /// negative value when the request was rejected.
+  int jobStart(String kind, List<String> args) {
+    final kindPtr = kind.toNativeUtf8();
+    final argv = malloc<Pointer<Utf8>>(args.isEmpty ? 1 : args.length);
+    for (var i = 0; i < args.length; i++) {
+      argv[i] = args[i].toNativeUtf8();
+    }
+    try {
+      return _jobStart(kindPtr, argv, args.length);
+    } finally {
+      for (var i = 0; i < args.length; i++) {
+        malloc.free(argv[i]);
+      }
+      malloc.free(argv);
+      malloc.free(kindPtr);
+    }
+  }
+
+  String jobPollJson(int id, {int afterSeq = 0, int maxLines = 0}) {
+    return _invokeString(() => _jobPoll(id, afterSeq, maxLines));
+  }
+
+  bool jobCancel(int id) => _jobCancel(id) != 0;
+
+  bool jobRelease(int id) => _jobRelease(id) != 0;
+
+  /// Summary group bits for [subscribeMetrics].
+  static const int metricsCpu = 1 << 0;
+  static const int metricsMemory = 1 << 1;
+  static const int metricsLoad = 1 << 2;
+  static const int metricsFilesystems = 1 << 3;
+  static const int metricsGpu = 1 << 4;
+  static const int metricsPackages = 1 << 5;
+  static const int metricsNetwork = 1 << 6;
+  static const int metricsProxy = 1 << 7;
+  static const int metricsSmart = 1 << 8;
+  static const int metricsUpdates = 1 << 9;
+
+  /// Added to the mask to receive patches (as from `nj_get_summary_since`)
+  /// instead of whole summaries.
+  static const int metricsDelta = 1 << 31;
+
+  /// Asks the backend sampler to post a summary JSON string with the groups
+  /// in [mask] to [nativePort] (a `ReceivePort.sendPort.nativePort`) every
+  /// [intervalMs] (0 for `refresh_interval` from nanookjaro.conf). Returns the
+  /// subscription id, or a negative value on error.
+  int subscribeMetrics(int mask, int intervalMs, int nativePort) => _subscribePort(mask, intervalMs, nativePort);
+
+  bool unsubscribeMetrics(int id) => _unsubscribe(id) != 0;
+
+  /// Tells the sampler whether the dashboard is on screen. While it is not,
+  /// collectors and subscriptions slow down; showing it again brings fresh
+  /// values right away.
+  void setVisibility(bool visible) => _setVisibility(visible ? 1 : 0);
+
   String _invokeString(Pointer<Utf8> Function() fn) {
     final pointer = fn();
     try {
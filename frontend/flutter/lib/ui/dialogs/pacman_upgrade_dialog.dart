@@ -13,20 +13,58 @@ class PacmanUpgradeDialog extends ConsumerStatefulWidget {
 }
 
 class _PacmanUpgradeDialogState extends ConsumerState<PacmanUpgradeDialog> {
+  static const int _maxLiveLines = 500;
+
   bool _assumeYes = false;
   bool _running = false;
+  bool _cancelling = false;
   PacmanUpgradeResult? _result;
   Object? _error;
+  final List<String> _liveOutput = <String>[];
+  final ScrollController _outputScroll = ScrollController();
+
+  @override
+  void dispose() {
+    _outputScroll.dispose();
+    super.dispose();
+  }
+
+  void _appendOutput(List<String> lines) {
+    if (!mounted) {
+      return;
+    }
+    setState(() {
+      _liveOutput.addAll(lines);
+      if (_liveOutput.length > _maxLiveLines) {
+        _liveOutput.removeRange(0, _liveOutput.length - _maxLiveLines);
+      }
+    });
+    WidgetsBinding.instance.addPostFrameCallback((_) {
+      if (_outputScroll.hasClients) {
+        _outputScroll.jumpTo(_outputScroll.position.maxScrollExtent);
+      }
+    });
+  }
+
+  void _cancelUpgrade() {
+    if (ref.read(updateProvider.notifier).cancelUpgrade()) {
+      setState(() {
+        _cancelling = true;
+      });
+    }
+  }
 
   Future<void> _runUpgrade() async {
     setState(() {
       _running = true;
+      _cancelling = false;
       _error = null;
       _result = null;
+      _liveOutput.clear();
     });
     try {
       final notifier = ref.read(updateProvider.notifier);
-      final result = await notifier.upgrade(assumeYes: _assumeYes);
+      final result = await notifier.upgrade(assumeYes: _assumeYes, onOutput: _appendOutput);
       if (!mounted) {
         return;
       }
@@ -82,15 +120,52 @@ class _PacmanUpgradeDialogState extends ConsumerState<PacmanUpgradeDialog> {
 
   Widget _buildContent(ThemeData theme, AppLocalizations loc) {
     if (_running) {
+      final surfaceHigh = theme.colorScheme.surfaceContainerHigh;
       return Padding(
-        padding: const EdgeInsets.symmetric(vertical: 16),
+        padding: const EdgeInsets.symmetric(vertical: 8),
         child: Column(
           mainAxisSize: MainAxisSize.min,
+          crossAxisAlignment: CrossAxisAlignment.start,
           children: [
-            const SizedBox(height: 12),
-            const CircularProgressIndicator(),
+            Row(
+              children: [
+                const SizedBox(
+                  width: 20,
+                  height: 20,
+                  child: CircularProgressIndicator(strokeWidth: 2.4),
+                ),
+                const SizedBox(width: 14),
+                Text(_cancelling ? loc.upgradeCancelling : loc.upgradeRunning),
+              ],
+            ),
             const SizedBox(height: 16),
-            Text(loc.upgradeRunning),
+            Container(
+              height: 240,
+              width: double.infinity,
+              decoration: BoxDecoration(
+                borderRadius: BorderRadius.circular(16),
+                color: surfaceHigh.withValues(alpha: 0.4),
+                border: Border.all(color: theme.colorScheme.outline.withValues(alpha: 0.2)),
+              ),
+              child: _liveOutput.isEmpty
+                  ? Center(child: Text(loc.upgradeWaitingOutput, style: theme.textTheme.bodySmall))
+                  : Scrollbar(
+                      controller: _outputScroll,
+                      thumbVisibility: true,
+                      child: ListView.builder(
+                        controller: _outputScroll,
+                        padding: const EdgeInsets.all(12),
+                        itemCount: _liveOutput.length,
+                        itemBuilder: (context, index) => Text(
+                          _liveOutput[index],
+                          style: theme.textTheme.bodySmall?.copyWith(
+                                fontFamily: 'RobotoMono',
+                                height: 1.32,
+                              ),
+                        ),
+                      ),
+                    ),
+            ),
           ],
         ),
       );
@@ -99,22 +174,27 @@ class _PacmanUpgradeDialogState extends ConsumerState<PacmanUpgradeDialog> {
     if (_result != null) {
       final result = _result!;
       final success = result.success;
-      final requiresPassword = result.requiresPassword && !success;
+      final cancelled = result.cancelled;
+      final requiresPassword = result.requiresPassword && !success && !cancelled;
       final statusColor = success
           ? Colors.greenAccent.shade200
-          : requiresPassword
+          : requiresPassword || cancelled
               ? theme.colorScheme.secondary
               : theme.colorScheme.error;
       final statusIcon = success
           ? Icons.check_circle_rounded
-          : requiresPassword
-              ? Icons.lock_person_rounded
-              : Icons.error_rounded;
+          : cancelled
+              ? Icons.cancel_rounded
+              : requiresPassword
+                  ? Icons.lock_person_rounded
+                  : Icons.error_rounded;
       final statusLabel = success
           ? loc.upgradeCompleted
-          : requiresPassword
-              ? loc.upgradePasswordRequired
-              : loc.upgradeFailedExit(result.exitCode);
+          : cancelled
+              ? loc.upgradeCancelled
+              : requiresPassword
+                  ? loc.upgradePasswordRequired
+                  : loc.upgradeFailedExit(result.exitCode);
       final outputRaw = result.output.trim();
       final outputText = outputRaw.isEmpty ? loc.noOutput : outputRaw;
 
@@ -218,13 +298,9 @@ class _PacmanUpgradeDialogState extends ConsumerState<PacmanUpgradeDialog> {
           child: Text(loc.close),
         ),
         FilledButton.icon(
-          onPressed: null,
-          icon: const SizedBox(
-            width: 18,
-            height: 18,
-            child: CircularProgressIndicator(strokeWidth: 2),
-          ),
-          label: Text(loc.upgradeRunning),
+          onPressed: _cancelling ? null : _cancelUpgrade,
+          icon: const Icon(Icons.stop_circle_outlined),
+          label: Text(_cancelling ? loc.upgradeCancelling : loc.upgradeCancel),
         ),
       ];
     }
@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Benchmark for the parallel disk usage analyzer.
+# Builds a synthetic tree (or uses TARGET) and compares `nanookjaro-cli du`
+# against `du -sx`.
+
+set -e
+
+BUILD_DIR=${BUILD_DIR:-build}
+DIRS=${DIRS:-200}
+FILES_PER_DIR=${FILES_PER_DIR:-500}
+CLI=${BUILD_DIR}/cli/nanookjaro-cli
+
+if [ ! -x "${CLI}" ]; then
+  echo "nanookjaro-cli not found at ${CLI}; build with -DNANOOKJARO_BUILD_CLI=ON first" >&2
+  exit 1
+fi
+
+if [ -z "${TARGET}" ]; then
+  TARGET=$(mktemp -d /tmp/nanookjaro-du-bench.XXXXXX)
+  trap 'rm -rf "${TARGET}"' EXIT
+  echo "Creating $((DIRS * FILES_PER_DIR)) files under ${TARGET}..."
+  for d in $(seq 1 ${DIRS}); do
+    dir="${TARGET}/d$((d % 16))/sub${d}"
+    mkdir -p "${dir}"
+    (cd "${dir}" && seq 1 ${FILES_PER_DIR} | xargs touch)
+    head -c $((d * 1024)) /dev/zero > "${dir}/payload"
+  done
+fi
+
+# Drop the page cache when allowed so the first run measures cold metadata I/O.
+if [ -w /proc/sys/vm/drop_caches ]; then
+  sync && echo 3 > /proc/sys/vm/drop_caches
+fi
+
+for run in cold warm; do
+  echo "nanookjaro-cli du ${TARGET} (${run})"
+  ${CLI} du "${TARGET}" 1 | tr ',' '\n' | grep -E '"(total_bytes|inodes|threads|elapsed_ms|inodes_per_second)"'
+done
+
+echo "du -sx ${TARGET}"
+time du -sx --block-size=1 "${TARGET}"
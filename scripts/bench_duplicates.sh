@@ -0,0 +1,54 @@
+#!/bin/bash
+
+# Benchmark for the duplicate finder.
+# Builds a fixture set (or uses TARGET) of random files with copies, files
+# that only differ in the middle, and many small files, then reports the
+# hashing throughput of `nanookjaro-cli dupes`.
+
+set -e
+
+BUILD_DIR=${BUILD_DIR:-build}
+LARGE_FILES=${LARGE_FILES:-24}
+LARGE_MB=${LARGE_MB:-16}
+SMALL_FILES=${SMALL_FILES:-2000}
+CLI=${BUILD_DIR}/cli/nanookjaro-cli
+
+if [ ! -x "${CLI}" ]; then
+  echo "nanookjaro-cli not found at ${CLI}; build with -DNANOOKJARO_BUILD_CLI=ON first" >&2
+  exit 1
+fi
+
+if [ -z "${TARGET}" ]; then
+  TARGET=$(mktemp -d /tmp/nanookjaro-dupes-bench.XXXXXX)
+  trap 'rm -rf "${TARGET}"' EXIT
+  echo "Creating fixture under ${TARGET}..."
+  mkdir -p "${TARGET}/originals" "${TARGET}/copies" "${TARGET}/near" "${TARGET}/small"
+  for i in $(seq 1 ${LARGE_FILES}); do
+    head -c $((LARGE_MB * 1024 * 1024)) /dev/urandom > "${TARGET}/originals/f${i}"
+    cp "${TARGET}/originals/f${i}" "${TARGET}/copies/f${i}"
+    # Same size and edges, different middle: only the full hash tells.
+    cp "${TARGET}/originals/f${i}" "${TARGET}/near/f${i}"
+    printf 'x' | dd of="${TARGET}/near/f${i}" bs=1 seek=$((LARGE_MB * 512 * 1024)) conv=notrunc 2>/dev/null
+  done
+  for i in $(seq 1 ${SMALL_FILES}); do
+    echo "small file $((i % 500))" > "${TARGET}/small/s${i}"
+  done
+  sync
+fi
+
+run() {
+  ${CLI} dupes "${TARGET}" 0 | sed 's/,"groups".*//' | tr ',' '\n' |
+    grep -E '"(files_scanned|duplicate_groups|reclaimable_bytes|bytes_hashed|hash_seconds|hash_gb_per_second|elapsed_ms)"'
+}
+
+# Drop the page cache when allowed so the first run measures disk reads.
+if [ -w /proc/sys/vm/drop_caches ]; then
+  echo 3 > /proc/sys/vm/drop_caches
+  echo "cold cache:"
+  run
+fi
+
+# Warm the cache; the finder itself drops pages it hashed in full.
+cat "${TARGET}"/originals/* "${TARGET}"/copies/* "${TARGET}"/near/* > /dev/null
+echo "warm cache:"
+run
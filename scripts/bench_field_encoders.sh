@@ -0,0 +1,20 @@
+#!/bin/bash
+
+# Benchmark for the encoders generated from metric field descriptors.
+# Serializes fixed CpuInfo, NetworkInterface and PerformanceSample data with
+# the hand-written ostringstream JSON the descriptors replaced and with the
+# generated JSON (fresh std::string and reused buffer), CSV and binary
+# encoders, and reports nanoseconds per call and output sizes.
+
+set -e
+
+BUILD_DIR=${BUILD_DIR:-build}
+ITERATIONS=${ITERATIONS:-200000}
+BENCH=${BUILD_DIR}/backend/tests/encode_bench
+
+if [ ! -x "${BENCH}" ]; then
+  echo "encode_bench not found at ${BENCH}; build with -DNANOOKJARO_BUILD_TESTS=ON first" >&2
+  exit 1
+fi
+
+${BENCH} "${ITERATIONS}"
@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# Benchmark for the trigram package search index.
+# Types QUERY one character at a time like a search box and reports the
+# index build time, its memory footprint and the per-query latency, next to
+# `pacman -Ss` for the same prefix when pacman is installed.
+
+set -e
+
+BUILD_DIR=${BUILD_DIR:-build}
+QUERY=${QUERY:-firefox}
+CLI=${BUILD_DIR}/cli/nanookjaro-cli
+
+if [ ! -x "${CLI}" ]; then
+  echo "nanookjaro-cli not found at ${CLI}; build with -DNANOOKJARO_BUILD_CLI=ON first" >&2
+  exit 1
+fi
+
+# Every CLI run builds the index from scratch, so each line shows both costs.
+${CLI} pacman search --limit 0 "${QUERY}" | sed 's/,"query_us".*//' | sed 's/.*"index":{//' | tr ',}' '\n\n' |
+  grep -E '"(documents|ngrams|postings|memory_bytes|build_ms)"'
+
+for i in $(seq 1 ${#QUERY}); do
+  prefix=${QUERY:0:${i}}
+  stats=$(${CLI} pacman search --limit 20 "${prefix}" | grep -oE '"(query_us|total)":[0-9.]+' | tr '\n' ' ')
+  line="${prefix}: ${stats}"
+  if command -v pacman > /dev/null; then
+    start=$(date +%s%N)
+    pacman -Ss "${prefix}" > /dev/null || true
+    line="${line} pacman_ss_ms:$((($(date +%s%N) - start) / 1000000))"
+  fi
+  echo "${line}"
+done
@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# Benchmark for the sampler's own footprint.
+# Serves one subscriber at 1 Hz and 10 Hz, first normally and then in stealth
+# mode (SCHED_IDLE, timer slack, coalesced collectors), and reports the CPU
+# time, CPU share and wakeups per second the toolkit itself spent, followed
+# by the sampler's wakeup jitter and collector run counts.
+
+set -e
+
+BUILD_DIR=${BUILD_DIR:-build}
+SECONDS_PER_RUN=${SECONDS_PER_RUN:-10}
+MASK=${MASK:-0xff}
+CLI=${BUILD_DIR}/cli/nanookjaro-cli
+
+if [ ! -x "${CLI}" ]; then
+  echo "nanookjaro-cli not found at ${CLI}; build with -DNANOOKJARO_BUILD_CLI=ON first" >&2
+  exit 1
+fi
+
+# Optional: NANOOKJARO_CONFIG=... to try other timer_slack_ms or
+# housekeeping_cpu values from a [sampler] section.
+${CLI} sampler-cost "${SECONDS_PER_RUN}" "${MASK}"